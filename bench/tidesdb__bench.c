@@ -169,6 +169,14 @@ int main()
 
     tdb_config->db_path = "benchmarktdb";
     tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
 
     tidesdb_err_t *err = tidesdb_open(tdb_config, &tdb);
     if (err != NULL)
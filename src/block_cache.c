@@ -0,0 +1,293 @@
+/*
+ *
+ * Copyright (C) TidesDB
+ *
+ * Original Author: Alex Gaetano Padula
+ *
+ * Licensed under the Mozilla Public License, v. 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.mozilla.org/en-US/MPL/2.0/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "block_cache.h"
+
+int block_cache_open(size_t capacity, block_cache_t** cache)
+{
+    if (cache == NULL) return -1;
+
+    *cache = calloc(1, sizeof(block_cache_t));
+    if (*cache == NULL) return -1;
+
+    (*cache)->capacity = capacity;
+    atomic_init(&(*cache)->next_id, 1);
+    atomic_init(&(*cache)->hits, 0);
+    atomic_init(&(*cache)->misses, 0);
+    atomic_init(&(*cache)->evictions, 0);
+
+    /* every shard gets an even part of the budget */
+    for (int i = 0; i < BLOCK_CACHE_SHARDS; i++)
+    {
+        block_cache_shard_t* shard = &(*cache)->shards[i];
+        shard->capacity = capacity / BLOCK_CACHE_SHARDS;
+        shard->num_buckets = BLOCK_CACHE_MIN_BUCKETS;
+        shard->buckets = calloc(shard->num_buckets, sizeof(block_cache_entry_t*));
+
+        if (shard->buckets == NULL || pthread_mutex_init(&shard->lock, NULL) != 0)
+        {
+            free(shard->buckets);
+            for (int j = 0; j < i; j++)
+            {
+                pthread_mutex_destroy(&(*cache)->shards[j].lock);
+                free((*cache)->shards[j].buckets);
+            }
+            free(*cache);
+            *cache = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void block_cache_close(block_cache_t* cache)
+{
+    if (cache == NULL) return;
+
+    for (int i = 0; i < BLOCK_CACHE_SHARDS; i++)
+    {
+        block_cache_shard_t* shard = &cache->shards[i];
+
+        while (shard->head != NULL) block_cache_shard_remove(shard, shard->head);
+
+        pthread_mutex_destroy(&shard->lock);
+        free(shard->buckets);
+    }
+
+    free(cache);
+}
+
+uint64_t block_cache_new_id(block_cache_t* cache)
+{
+    return atomic_fetch_add(&cache->next_id, 1);
+}
+
+uint64_t block_cache_hash(uint64_t id, uint64_t page)
+{
+    /* we mix the two halves of the key so consecutive pages spread over the shards */
+    uint64_t h = id * 0x9E3779B97F4A7C15ULL ^ page;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+block_cache_entry_t* block_cache_lookup(block_cache_t* cache, uint64_t id, uint64_t page)
+{
+    uint64_t hash = block_cache_hash(id, page);
+    block_cache_shard_t* shard = &cache->shards[hash % BLOCK_CACHE_SHARDS];
+
+    pthread_mutex_lock(&shard->lock);
+
+    /* the shard is picked with the low bits, the bucket with the bits above them */
+    block_cache_entry_t* entry =
+        shard->buckets[(hash / BLOCK_CACHE_SHARDS) & (shard->num_buckets - 1)];
+    while (entry != NULL && (entry->id != id || entry->page != page)) entry = entry->hash_next;
+
+    if (entry == NULL)
+    {
+        pthread_mutex_unlock(&shard->lock);
+        atomic_fetch_add(&cache->misses, 1);
+        return NULL;
+    }
+
+    /* the entry moves to the front of the LRU list */
+    if (shard->head != entry)
+    {
+        entry->lru_prev->lru_next = entry->lru_next;
+        if (entry->lru_next != NULL)
+            entry->lru_next->lru_prev = entry->lru_prev;
+        else
+            shard->tail = entry->lru_prev;
+
+        entry->lru_prev = NULL;
+        entry->lru_next = shard->head;
+        shard->head->lru_prev = entry;
+        shard->head = entry;
+    }
+
+    entry->refs++;
+
+    pthread_mutex_unlock(&shard->lock);
+    atomic_fetch_add(&cache->hits, 1);
+
+    return entry;
+}
+
+block_cache_entry_t* block_cache_insert(block_cache_t* cache, uint64_t id, uint64_t page,
+                                        uint8_t* data, size_t len)
+{
+    block_cache_entry_t* entry = calloc(1, sizeof(block_cache_entry_t));
+    if (entry == NULL)
+    {
+        free(data);
+        return NULL;
+    }
+
+    entry->id = id;
+    entry->page = page;
+    entry->hash = block_cache_hash(id, page);
+    entry->data = data;
+    entry->len = len;
+    entry->charge = len + BLOCK_CACHE_ENTRY_CHARGE;
+    entry->refs = 1; /* the reference of the caller */
+
+    block_cache_shard_t* shard = &cache->shards[entry->hash % BLOCK_CACHE_SHARDS];
+
+    /* a block that does not fit the shard would evict everything and still not fit */
+    if (entry->charge > shard->capacity) return entry;
+
+    pthread_mutex_lock(&shard->lock);
+
+    /* a reader that missed the same block at the same time cached it first, we replace it */
+    block_cache_entry_t** slot =
+        &shard->buckets[(entry->hash / BLOCK_CACHE_SHARDS) & (shard->num_buckets - 1)];
+    for (block_cache_entry_t* old = *slot; old != NULL; old = old->hash_next)
+    {
+        if (old->id == id && old->page == page)
+        {
+            block_cache_shard_remove(shard, old);
+            break;
+        }
+    }
+
+    /* we evict the least recently used entries until the new one fits, an entry that is being
+     * read is freed once it is released */
+    while (shard->usage + entry->charge > shard->capacity && shard->tail != NULL)
+    {
+        block_cache_shard_remove(shard, shard->tail);
+        atomic_fetch_add(&cache->evictions, 1);
+    }
+
+    if (shard->num_entries >= shard->num_buckets) block_cache_shard_grow(shard);
+
+    slot = &shard->buckets[(entry->hash / BLOCK_CACHE_SHARDS) & (shard->num_buckets - 1)];
+    entry->hash_next = *slot;
+    *slot = entry;
+
+    entry->lru_next = shard->head;
+    if (shard->head != NULL)
+        shard->head->lru_prev = entry;
+    else
+        shard->tail = entry;
+    shard->head = entry;
+
+    entry->in_cache = true;
+    entry->refs++; /* the reference of the cache */
+    shard->num_entries++;
+    shard->usage += entry->charge;
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return entry;
+}
+
+void block_cache_release(block_cache_t* cache, block_cache_entry_t* entry)
+{
+    if (entry == NULL) return;
+
+    block_cache_shard_t* shard = &cache->shards[entry->hash % BLOCK_CACHE_SHARDS];
+
+    pthread_mutex_lock(&shard->lock);
+    block_cache_entry_unref(entry);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+size_t block_cache_usage(block_cache_t* cache, size_t* num_entries)
+{
+    size_t usage = 0;
+    size_t entries = 0;
+
+    for (int i = 0; i < BLOCK_CACHE_SHARDS; i++)
+    {
+        block_cache_shard_t* shard = &cache->shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+        usage += shard->usage;
+        entries += shard->num_entries;
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    if (num_entries != NULL) *num_entries = entries;
+
+    return usage;
+}
+
+void block_cache_shard_remove(block_cache_shard_t* shard, block_cache_entry_t* entry)
+{
+    block_cache_entry_t** slot =
+        &shard->buckets[(entry->hash / BLOCK_CACHE_SHARDS) & (shard->num_buckets - 1)];
+    while (*slot != entry) slot = &(*slot)->hash_next;
+    *slot = entry->hash_next;
+
+    if (entry->lru_prev != NULL)
+        entry->lru_prev->lru_next = entry->lru_next;
+    else
+        shard->head = entry->lru_next;
+
+    if (entry->lru_next != NULL)
+        entry->lru_next->lru_prev = entry->lru_prev;
+    else
+        shard->tail = entry->lru_prev;
+
+    entry->hash_next = NULL;
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+    entry->in_cache = false;
+
+    shard->num_entries--;
+    shard->usage -= entry->charge;
+
+    block_cache_entry_unref(entry);
+}
+
+void block_cache_shard_grow(block_cache_shard_t* shard)
+{
+    size_t num_buckets = shard->num_buckets * 2;
+    block_cache_entry_t** buckets = calloc(num_buckets, sizeof(block_cache_entry_t*));
+    if (buckets == NULL) return;
+
+    for (size_t i = 0; i < shard->num_buckets; i++)
+    {
+        block_cache_entry_t* entry = shard->buckets[i];
+        while (entry != NULL)
+        {
+            block_cache_entry_t* next = entry->hash_next;
+            block_cache_entry_t** slot =
+                &buckets[(entry->hash / BLOCK_CACHE_SHARDS) & (num_buckets - 1)];
+            entry->hash_next = *slot;
+            *slot = entry;
+            entry = next;
+        }
+    }
+
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->num_buckets = num_buckets;
+}
+
+void block_cache_entry_unref(block_cache_entry_t* entry)
+{
+    if (--entry->refs > 0) return;
+
+    free(entry->data);
+    free(entry);
+}
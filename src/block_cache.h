@@ -0,0 +1,225 @@
+/*
+ *
+ * Copyright (C) TidesDB
+ *
+ * Original Author: Alex Gaetano Padula
+ *
+ * Licensed under the Mozilla Public License, v. 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.mozilla.org/en-US/MPL/2.0/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * A block cache keeps decoded data blocks in memory within one byte budget, however many
+ * SSTables and column families read through it.  A block is keyed by the id of its SSTable and
+ * the page it starts at, the id is handed out by the cache so the SSTables of different column
+ * families never share a key.  The cache is split into BLOCK_CACHE_SHARDS shards by the hash of
+ * the key, each with its own lock, hash table and LRU list and an even part of the budget, so
+ * readers of different blocks rarely wait for each other.
+ *
+ * An entry is reference counted.  The cache holds a reference while the entry is in it and every
+ * lookup takes one more, an entry evicted while it is being read is freed once its last reader
+ * releases it.
+ */
+
+#define BLOCK_CACHE_SHARDS       16 /* the number of shards, each with its own lock */
+#define BLOCK_CACHE_MIN_BUCKETS  64 /* the initial number of hash buckets of a shard */
+#define BLOCK_CACHE_ENTRY_CHARGE sizeof(block_cache_entry_t) /* what an entry costs besides data */
+
+typedef struct block_cache_entry_t block_cache_entry_t;
+
+/*
+ * block_cache_entry_t
+ * a decoded block in the cache
+ * @param id the id of the SSTable the block belongs to
+ * @param page the page the block starts at
+ * @param hash the hash of the id and page
+ * @param data the decoded block
+ * @param len the length of the decoded block
+ * @param charge what the entry counts against the budget
+ * @param refs the references to the entry, the cache holds one while the entry is in it
+ * @param in_cache whether the entry is in the hash table and LRU list of its shard
+ * @param hash_next the next entry in the same hash bucket
+ * @param lru_prev the more recently used entry
+ * @param lru_next the less recently used entry
+ */
+struct block_cache_entry_t
+{
+    uint64_t id;                    /* the id of the SSTable the block belongs to */
+    uint64_t page;                  /* the page the block starts at */
+    uint64_t hash;                  /* the hash of the id and page */
+    uint8_t* data;                  /* the decoded block */
+    size_t len;                     /* the length of the decoded block */
+    size_t charge;                  /* what the entry counts against the budget */
+    uint32_t refs;                  /* the references to the entry */
+    bool in_cache;                  /* whether the entry is in its shard */
+    block_cache_entry_t* hash_next; /* the next entry in the same hash bucket */
+    block_cache_entry_t* lru_prev;  /* the more recently used entry */
+    block_cache_entry_t* lru_next;  /* the less recently used entry */
+};
+
+/*
+ * block_cache_shard_t
+ * a shard of the block cache
+ * @param lock the lock for the shard
+ * @param buckets the hash buckets
+ * @param num_buckets the number of hash buckets, a power of two
+ * @param num_entries the number of entries in the shard
+ * @param capacity the bytes the entries of the shard may take
+ * @param usage the bytes the entries of the shard take
+ * @param head the most recently used entry
+ * @param tail the least recently used entry
+ */
+typedef struct
+{
+    pthread_mutex_t lock;          /* the lock for the shard */
+    block_cache_entry_t** buckets; /* the hash buckets */
+    size_t num_buckets;            /* the number of hash buckets, a power of two */
+    size_t num_entries;            /* the number of entries in the shard */
+    size_t capacity;               /* the bytes the entries of the shard may take */
+    size_t usage;                  /* the bytes the entries of the shard take */
+    block_cache_entry_t* head;     /* the most recently used entry */
+    block_cache_entry_t* tail;     /* the least recently used entry */
+} block_cache_shard_t;
+
+/*
+ * block_cache_t
+ * the block cache
+ * @param shards the shards
+ * @param capacity the byte budget of the whole cache
+ * @param next_id the id handed to the next SSTable
+ * @param hits the number of lookups that found their block
+ * @param misses the number of lookups that did not
+ * @param evictions the number of entries evicted to stay within the budget
+ */
+typedef struct
+{
+    block_cache_shard_t shards[BLOCK_CACHE_SHARDS]; /* the shards */
+    size_t capacity;                                /* the byte budget of the whole cache */
+    atomic_uint_fast64_t next_id;                   /* the id handed to the next SSTable */
+    atomic_uint_fast64_t hits;                      /* the lookups that found their block */
+    atomic_uint_fast64_t misses;                    /* the lookups that did not */
+    atomic_uint_fast64_t evictions;                 /* the entries evicted for the budget */
+} block_cache_t;
+
+/* Block cache function prototypes */
+
+/*
+ * block_cache_open
+ * creates a block cache
+ * @param capacity the byte budget of the cache
+ * @param cache the block cache
+ * @return 0 if the cache was created, -1 otherwise
+ */
+int block_cache_open(size_t capacity, block_cache_t** cache);
+
+/*
+ * block_cache_close
+ * frees the block cache and every entry in it, nothing may hold an entry
+ * @param cache the block cache
+ */
+void block_cache_close(block_cache_t* cache);
+
+/*
+ * block_cache_new_id
+ * hands out the id an SSTable keys its blocks with
+ * @param cache the block cache
+ * @return the id, never 0
+ */
+uint64_t block_cache_new_id(block_cache_t* cache);
+
+/*
+ * block_cache_hash
+ * hashes the key of a block
+ * @param id the id of the SSTable
+ * @param page the page the block starts at
+ * @return the hash
+ */
+uint64_t block_cache_hash(uint64_t id, uint64_t page);
+
+/*
+ * block_cache_lookup
+ * looks up a block and takes a reference to it
+ * @param cache the block cache
+ * @param id the id of the SSTable
+ * @param page the page the block starts at
+ * @return the entry, released with block_cache_release, NULL if the block is not cached
+ */
+block_cache_entry_t* block_cache_lookup(block_cache_t* cache, uint64_t id, uint64_t page);
+
+/*
+ * block_cache_insert
+ * puts a block in the cache and takes a reference to it.  a block cached under the same key is
+ * replaced, a block larger than the budget of its shard is handed back without being cached
+ * @param cache the block cache
+ * @param id the id of the SSTable
+ * @param page the page the block starts at
+ * @param data the decoded block, the cache takes it over
+ * @param len the length of the decoded block
+ * @return the entry, released with block_cache_release, NULL if it could not be allocated in
+ * which case data is freed
+ */
+block_cache_entry_t* block_cache_insert(block_cache_t* cache, uint64_t id, uint64_t page,
+                                        uint8_t* data, size_t len);
+
+/*
+ * block_cache_release
+ * releases a reference to an entry, an entry that is no longer in the cache is freed with its
+ * last reference
+ * @param cache the block cache
+ * @param entry the entry
+ */
+void block_cache_release(block_cache_t* cache, block_cache_entry_t* entry);
+
+/*
+ * block_cache_usage
+ * sums the bytes the entries of every shard take
+ * @param cache the block cache
+ * @param num_entries the number of entries in the cache, can be NULL
+ * @return the bytes the entries take
+ */
+size_t block_cache_usage(block_cache_t* cache, size_t* num_entries);
+
+/*
+ * block_cache_shard_remove
+ * takes an entry out of the hash table and LRU list of its shard and drops the reference of the
+ * cache, the lock of the shard is held
+ * @param shard the shard
+ * @param entry the entry
+ */
+void block_cache_shard_remove(block_cache_shard_t* shard, block_cache_entry_t* entry);
+
+/*
+ * block_cache_shard_grow
+ * doubles the hash buckets of a shard, the lock of the shard is held.  a shard that cannot grow
+ * keeps its buckets, its chains just get longer
+ * @param shard the shard
+ */
+void block_cache_shard_grow(block_cache_shard_t* shard);
+
+/*
+ * block_cache_entry_unref
+ * drops a reference to an entry and frees it with the last one, the lock of its shard is held
+ * @param entry the entry
+ */
+void block_cache_entry_unref(block_cache_entry_t* entry);
+
+#endif /* BLOCK_CACHE_H */
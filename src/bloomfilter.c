@@ -125,4 +125,103 @@ int bloomfilter_add(bloomfilter_t *bf, const uint8_t *data, unsigned int data_le
     current->count++;
 
     return 0;
-}
\ No newline at end of file
+}
+
+blocked_bloomfilter_t *blocked_bloomfilter_alloc(uint32_t num_blocks, uint32_t num_probes)
+{
+    if (num_blocks == 0 || num_probes == 0 || num_probes > BLOCKED_BLOOMFILTER_MAX_PROBES)
+        return NULL;
+
+    blocked_bloomfilter_t *bf = malloc(sizeof(blocked_bloomfilter_t));
+    if (bf == NULL) return NULL;
+
+    bf->num_blocks = num_blocks;
+    bf->num_probes = num_probes;
+
+    /* we align the blocks to the cache line so a block is never split across two lines */
+    size_t size = (size_t)num_blocks * BLOCKED_BLOOMFILTER_BLOCK_WORDS * sizeof(uint64_t);
+    bf->blocks = aligned_alloc(64, size);
+    if (bf->blocks == NULL)
+    {
+        free(bf);
+        return NULL;
+    }
+    memset(bf->blocks, 0, size);
+
+    return bf;
+}
+
+blocked_bloomfilter_t *blocked_bloomfilter_create(uint64_t num_keys, uint32_t bits_per_key)
+{
+    if (bits_per_key == 0) bits_per_key = BLOCKED_BLOOMFILTER_DEFAULT_BITS;
+    if (num_keys == 0) num_keys = 1;
+
+    uint64_t num_bits = num_keys * bits_per_key;
+    uint64_t num_blocks =
+        (num_bits + BLOCKED_BLOOMFILTER_BLOCK_BITS - 1) / BLOCKED_BLOOMFILTER_BLOCK_BITS;
+    if (num_blocks > UINT32_MAX) return NULL;
+
+    /* the optimal number of probes is bits_per_key * ln(2), we round 0.69 * bits_per_key */
+    uint32_t num_probes = (bits_per_key * 69 + 50) / 100;
+    if (num_probes < 1) num_probes = 1;
+    if (num_probes > BLOCKED_BLOOMFILTER_MAX_PROBES) num_probes = BLOCKED_BLOOMFILTER_MAX_PROBES;
+
+    return blocked_bloomfilter_alloc((uint32_t)num_blocks, num_probes);
+}
+
+void blocked_bloomfilter_destroy(blocked_bloomfilter_t *bf)
+{
+    if (bf == NULL) return;
+
+    free(bf->blocks);
+    free(bf);
+}
+
+uint64_t blocked_bloomfilter_hash(const uint8_t *data, size_t data_len)
+{
+    return XXH3_64bits(data, data_len); /* we hash using xxhash */
+}
+
+uint32_t blocked_bloomfilter_mask(const blocked_bloomfilter_t *bf, uint64_t hash, uint64_t *mask)
+{
+    /* the upper half of the hash picks the block, we map it onto the blocks without a modulo */
+    uint32_t block = (uint32_t)(((hash >> 32) * (uint64_t)bf->num_blocks) >> 32);
+
+    /* the lower half drives the probes within the block using double hashing */
+    uint32_t h = (uint32_t)hash;
+    uint32_t delta = (h >> 17) | (h << 15);
+
+    for (int i = 0; i < BLOCKED_BLOOMFILTER_BLOCK_WORDS; i++) mask[i] = 0;
+
+    for (uint32_t i = 0; i < bf->num_probes; i++)
+    {
+        uint32_t bit = h & (BLOCKED_BLOOMFILTER_BLOCK_BITS - 1);
+        mask[bit >> 6] |= (uint64_t)1 << (bit & 63);
+        h += delta;
+    }
+
+    return block;
+}
+
+void blocked_bloomfilter_add(blocked_bloomfilter_t *bf, uint64_t hash)
+{
+    uint64_t mask[BLOCKED_BLOOMFILTER_BLOCK_WORDS];
+    uint32_t block = blocked_bloomfilter_mask(bf, hash, mask);
+
+    uint64_t *words = bf->blocks + (size_t)block * BLOCKED_BLOOMFILTER_BLOCK_WORDS;
+    for (int i = 0; i < BLOCKED_BLOOMFILTER_BLOCK_WORDS; i++) words[i] |= mask[i];
+}
+
+int blocked_bloomfilter_check(const blocked_bloomfilter_t *bf, uint64_t hash)
+{
+    uint64_t mask[BLOCKED_BLOOMFILTER_BLOCK_WORDS];
+    uint32_t block = blocked_bloomfilter_mask(bf, hash, mask);
+
+    /* we compare the whole block against the mask without branching so the compiler can turn
+     * the loop into a few vector instructions */
+    const uint64_t *words = bf->blocks + (size_t)block * BLOCKED_BLOOMFILTER_BLOCK_WORDS;
+    uint64_t missing = 0;
+    for (int i = 0; i < BLOCKED_BLOOMFILTER_BLOCK_WORDS; i++) missing |= mask[i] & ~words[i];
+
+    return missing == 0 ? 0 : -1;
+}
@@ -25,6 +25,13 @@
 
 #include "../external/xxhash.h"
 
+#define BLOCKED_BLOOMFILTER_BLOCK_BITS   512 /* bits in a filter block, one 64 byte cache line */
+#define BLOCKED_BLOOMFILTER_BLOCK_WORDS  8   /* 64 bit words in a filter block */
+#define BLOCKED_BLOOMFILTER_DEFAULT_BITS 10  /* default bits per key, about 1% false positives */
+#define BLOCKED_BLOOMFILTER_MIN_BITS     1   /* minimum bits per key */
+#define BLOCKED_BLOOMFILTER_MAX_BITS     32  /* maximum bits per key */
+#define BLOCKED_BLOOMFILTER_MAX_PROBES   16  /* maximum number of probes per key */
+
 /* we define the bloomfilter struct here so
  * we can use it in the struct definition for the next member */
 typedef struct bloomfilter_t bloomfilter_t;
@@ -43,6 +50,21 @@ struct bloomfilter_t
     bloomfilter_t *next; /* Pointer to the next bloomfilter (for chaining) */
 };
 
+/*
+ * blocked_bloomfilter_t
+ * a bloom filter sized up front from a key count and a bits per key setting.  every probe for a key
+ * lands in the same 64 byte block so a check touches a single cache line
+ * @param num_blocks the number of 64 byte blocks
+ * @param num_probes the number of bits set per key
+ * @param blocks the filter blocks, 64 byte aligned
+ */
+typedef struct
+{
+    uint32_t num_blocks; /* the number of 64 byte blocks */
+    uint32_t num_probes; /* the number of bits set per key */
+    uint64_t *blocks;    /* the filter blocks, 64 byte aligned */
+} blocked_bloomfilter_t;
+
 /* Bloom filter function prototypes */
 
 /*
@@ -114,4 +136,65 @@ unsigned int hash2(const uint8_t *data, unsigned int data_len);
  */
 unsigned int bloomfilter_get_size(bloomfilter_t *bf);
 
+/*
+ * blocked_bloomfilter_create
+ * create a new blocked bloom filter sized for a number of keys
+ * @param num_keys the number of keys the filter will hold
+ * @param bits_per_key the number of filter bits per key, 0 for the default
+ * @return the new blocked bloom filter, NULL on failure
+ */
+blocked_bloomfilter_t *blocked_bloomfilter_create(uint64_t num_keys, uint32_t bits_per_key);
+
+/*
+ * blocked_bloomfilter_alloc
+ * allocate an empty blocked bloom filter with a known shape, used when decoding a filter
+ * @param num_blocks the number of 64 byte blocks
+ * @param num_probes the number of bits set per key
+ * @return the new blocked bloom filter, NULL on failure
+ */
+blocked_bloomfilter_t *blocked_bloomfilter_alloc(uint32_t num_blocks, uint32_t num_probes);
+
+/*
+ * blocked_bloomfilter_destroy
+ * destroy a blocked bloom filter
+ * @param bf the blocked bloom filter to destroy
+ */
+void blocked_bloomfilter_destroy(blocked_bloomfilter_t *bf);
+
+/*
+ * blocked_bloomfilter_hash
+ * hashes a key for a blocked bloom filter, the hash can be reused to check any number of filters
+ * @param data the data to hash
+ * @param data_len the length of the data
+ * @return the 64 bit hash value
+ */
+uint64_t blocked_bloomfilter_hash(const uint8_t *data, size_t data_len);
+
+/*
+ * blocked_bloomfilter_add
+ * add a hashed key to a blocked bloom filter
+ * @param bf the blocked bloom filter to add to
+ * @param hash the hash of the key from blocked_bloomfilter_hash
+ */
+void blocked_bloomfilter_add(blocked_bloomfilter_t *bf, uint64_t hash);
+
+/*
+ * blocked_bloomfilter_check
+ * check if a hashed key is in a blocked bloom filter
+ * @param bf the blocked bloom filter to check
+ * @param hash the hash of the key from blocked_bloomfilter_hash
+ * @return 0 if the key may be in the filter, -1 if it is not
+ */
+int blocked_bloomfilter_check(const blocked_bloomfilter_t *bf, uint64_t hash);
+
+/*
+ * blocked_bloomfilter_mask
+ * builds the bits a hashed key sets within its block
+ * @param bf the blocked bloom filter
+ * @param hash the hash of the key
+ * @param mask the mask to fill, BLOCKED_BLOOMFILTER_BLOCK_WORDS words
+ * @return the block the key maps to
+ */
+uint32_t blocked_bloomfilter_mask(const blocked_bloomfilter_t *bf, uint64_t hash, uint64_t *mask);
+
 #endif /* BLOOMFILTER_H */
\ No newline at end of file
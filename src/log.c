@@ -0,0 +1,582 @@
+/*
+ *
+ * Copyright (C) TidesDB
+ *
+ * Original Author: Alex Gaetano Padula
+ *
+ * Licensed under the Mozilla Public License, v. 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.mozilla.org/en-US/MPL/2.0/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/* the xxhash streaming state is kept on the stack */
+#define XXH_STATIC_LINKING_ONLY
+
+#include "log.h"
+
+int log_open(const char* filename, uint64_t number, log_t** log)
+{
+    /* we check if the filename is NULL */
+    if (filename == NULL || log == NULL) return -1;
+
+    /* we allocate memory for the log */
+    *log = malloc(sizeof(log_t));
+    if (*log == NULL) return -1;
+
+    /* we open the file with provided filename, writes go to explicit offsets */
+    (*log)->fd = open(filename, O_RDWR | O_CREAT, 0644);
+    if ((*log)->fd == -1)
+    {
+        free(*log);
+        return -1;
+    }
+
+    /* we copy over filename */
+    (*log)->filename = strdup(filename);
+    if ((*log)->filename == NULL)
+    {
+        close((*log)->fd);
+        free(*log);
+        return -1;
+    }
+
+    /* entries are appended after what is in the file */
+    struct stat file_stat;
+    if (fstat((*log)->fd, &file_stat) != 0)
+    {
+        free((*log)->filename);
+        close((*log)->fd);
+        free(*log);
+        return -1;
+    }
+
+    (*log)->size = (size_t)file_stat.st_size;
+    (*log)->number = number;
+    (*log)->sync_service = NULL;
+    sync_file_init(&(*log)->sync_file, (*log)->fd);
+
+    if (pthread_mutex_init(&(*log)->lock, NULL) != 0)
+    {
+        free((*log)->filename);
+        close((*log)->fd);
+        free(*log);
+        return -1;
+    }
+
+    return 0;
+}
+
+int log_create(const char* filename, uint64_t number, size_t preallocate_size, log_t** log)
+{
+    if (log_open(filename, number, log) == -1) return -1;
+
+    /* a recycled file is written over from the start, what it held fails the checksums of the new
+     * number */
+    (*log)->size = 0;
+
+    if (preallocate_size > 0 && log_preallocate(*log, preallocate_size) == -1)
+    {
+        log_close(*log);
+        *log = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int log_preallocate(log_t* log, size_t size)
+{
+    if (log == NULL) return -1;
+
+    int result = posix_fallocate(log->fd, 0, (off_t)size);
+
+    /* a file system that cannot preallocate grows the file as it is written */
+    if (result != 0 && result != EINVAL && result != EOPNOTSUPP) return -1;
+
+    return 0;
+}
+
+int log_close(log_t* log)
+{
+    /* we check if the log is NULL */
+    if (log == NULL) return -1;
+
+    /* the sync service lets go of the file before it goes away */
+    if (log->sync_service != NULL) sync_service_remove(log->sync_service, &log->sync_file);
+
+    /* what was appended since the last sync is synced now */
+    int result = fdatasync(log->fd) == 0 ? 0 : -1;
+
+    if (close(log->fd) != 0) result = -1;
+
+    pthread_mutex_destroy(&log->lock);
+
+    free(log->filename);
+    free(log);
+
+    return result;
+}
+
+uint32_t log_checksum_seed(uint64_t number, uint8_t type)
+{
+    /* the type seeds the hash so a record that changed its type fails its checksum too, so does the
+     * number so a record left in a recycled file fails it in the log written over it */
+    return (uint32_t)(number << 8) | type;
+}
+
+uint32_t log_checksum(uint64_t number, uint8_t type, const uint8_t* data, size_t data_len)
+{
+    return XXH32(data, data_len, log_checksum_seed(number, type));
+}
+
+size_t log_encoded_size(size_t size, size_t data_len)
+{
+    size_t offset = size % LOG_BLOCK_SIZE;
+    size_t encoded_size = 0;
+
+    while (true)
+    {
+        size_t room = LOG_BLOCK_SIZE - offset;
+
+        /* a block tail too small for a header is padded */
+        if (room < LOG_HEADER_SIZE)
+        {
+            encoded_size += room;
+            offset = 0;
+            continue;
+        }
+
+        size_t fragment = data_len < room - LOG_HEADER_SIZE ? data_len : room - LOG_HEADER_SIZE;
+
+        encoded_size += LOG_HEADER_SIZE + fragment;
+        offset = (offset + LOG_HEADER_SIZE + fragment) % LOG_BLOCK_SIZE;
+        data_len -= fragment;
+
+        if (data_len == 0) break;
+    }
+
+    return encoded_size;
+}
+
+int log_append_batchv(log_t* log, const struct iovec* parts, const size_t* parts_count,
+                      size_t count, bool sync)
+{
+    if (log == NULL || parts == NULL || parts_count == NULL || count == 0) return -1;
+
+    /* an entry takes at most a record per block it touches, each with padding before it */
+    size_t max_records = 0;
+    size_t total_parts = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t entry_len = 0;
+        for (size_t j = total_parts; j < total_parts + parts_count[i]; j++)
+        {
+            if (parts[j].iov_base == NULL && parts[j].iov_len > 0) return -1;
+
+            entry_len += parts[j].iov_len;
+        }
+
+        if (entry_len == 0) return -1;
+
+        total_parts += parts_count[i];
+        max_records += entry_len / (LOG_BLOCK_SIZE - LOG_HEADER_SIZE) + 2;
+    }
+
+    /* a small batch is laid out on the stack, a larger one on the heap */
+    uint8_t stack_headers[LOG_STACK_RECORDS * LOG_HEADER_SIZE + LOG_HEADER_SIZE];
+    struct iovec stack_iov[LOG_STACK_RECORDS * 3 + LOG_STACK_PARTS];
+    bool on_stack = max_records <= LOG_STACK_RECORDS && total_parts <= LOG_STACK_PARTS;
+
+    /* the record headers followed by the zeros we pad block tails with */
+    uint8_t* headers = on_stack ? stack_headers
+                                : malloc(max_records * LOG_HEADER_SIZE + LOG_HEADER_SIZE);
+    if (headers == NULL) return -1;
+
+    uint8_t* padding = headers + max_records * LOG_HEADER_SIZE;
+    memset(padding, 0, LOG_HEADER_SIZE);
+
+    /* padding and header for every record and the pieces of the parts its payload is cut from, a
+     * record splits at most one part so there are no more pieces than parts and records */
+    struct iovec* iov =
+        on_stack ? stack_iov : malloc((max_records * 3 + total_parts) * sizeof(struct iovec));
+    if (iov == NULL)
+    {
+        if (!on_stack) free(headers);
+        return -1;
+    }
+
+    pthread_mutex_lock(&log->lock);
+
+    size_t offset = log->size % LOG_BLOCK_SIZE;
+    size_t written = 0;
+    size_t records = 0;
+    int iovcnt = 0;
+
+    const struct iovec* part = parts;
+    for (size_t i = 0; i < count; i++)
+    {
+        const struct iovec* entry_end = part + parts_count[i];
+
+        size_t left = 0;
+        for (const struct iovec* p = part; p < entry_end; p++) left += p->iov_len;
+
+        size_t part_offset = 0;
+        bool first = true;
+
+        while (true)
+        {
+            size_t room = LOG_BLOCK_SIZE - offset;
+
+            /* a block tail too small for a header is padded */
+            if (room < LOG_HEADER_SIZE)
+            {
+                iov[iovcnt].iov_base = padding;
+                iov[iovcnt++].iov_len = room;
+                written += room;
+                offset = 0;
+                continue;
+            }
+
+            size_t fragment = left < room - LOG_HEADER_SIZE ? left : room - LOG_HEADER_SIZE;
+
+            uint8_t type;
+            if (first)
+                type = fragment == left ? LOG_RECORD_FULL : LOG_RECORD_FIRST;
+            else
+                type = fragment == left ? LOG_RECORD_LAST : LOG_RECORD_MIDDLE;
+
+            uint8_t* header = headers + records * LOG_HEADER_SIZE;
+            records++;
+
+            iov[iovcnt].iov_base = header;
+            iov[iovcnt++].iov_len = LOG_HEADER_SIZE;
+
+            /* the payload is gathered from the parts in place, the checksum is computed over the
+             * same pieces */
+            XXH32_state_t state;
+            XXH32_reset(&state, log_checksum_seed(log->number, type));
+
+            size_t needed = fragment;
+            while (needed > 0)
+            {
+                size_t available = part->iov_len - part_offset;
+                if (available == 0)
+                {
+                    part++;
+                    part_offset = 0;
+                    continue;
+                }
+
+                size_t piece = needed < available ? needed : available;
+                uint8_t* base = (uint8_t*)part->iov_base + part_offset;
+
+                XXH32_update(&state, base, piece);
+                iov[iovcnt].iov_base = base;
+                iov[iovcnt++].iov_len = piece;
+
+                part_offset += piece;
+                needed -= piece;
+            }
+
+            /* the header is little endian */
+            uint32_t checksum = XXH32_digest(&state);
+            header[0] = (uint8_t)checksum;
+            header[1] = (uint8_t)(checksum >> 8);
+            header[2] = (uint8_t)(checksum >> 16);
+            header[3] = (uint8_t)(checksum >> 24);
+            header[4] = (uint8_t)fragment;
+            header[5] = (uint8_t)(fragment >> 8);
+            header[6] = type;
+
+            written += LOG_HEADER_SIZE + fragment;
+            offset = (offset + LOG_HEADER_SIZE + fragment) % LOG_BLOCK_SIZE;
+            left -= fragment;
+            first = false;
+
+            if (left == 0) break;
+        }
+
+        part = entry_end;
+    }
+
+    /* a failed write is not counted, the next append writes over what it left behind */
+    if (log_pwritev_all(log->fd, iov, iovcnt, (off_t)log->size) == -1 ||
+        (sync && fdatasync(log->fd) != 0))
+    {
+        pthread_mutex_unlock(&log->lock);
+        if (!on_stack)
+        {
+            free(iov);
+            free(headers);
+        }
+        return -1;
+    }
+
+    log->size += written;
+
+    pthread_mutex_unlock(&log->lock);
+
+    /* a synced batch leaves nothing for the sync service */
+    if (!sync && log->sync_service != NULL)
+        sync_service_mark(log->sync_service, &log->sync_file, count);
+
+    if (!on_stack)
+    {
+        free(iov);
+        free(headers);
+    }
+
+    return 0;
+}
+
+int log_append_batch(log_t* log, uint8_t** data, size_t* data_len, size_t count, bool sync)
+{
+    if (log == NULL || data == NULL || data_len == NULL || count == 0) return -1;
+
+    /* every entry is a single part */
+    struct iovec* parts = malloc(count * sizeof(struct iovec));
+    size_t* parts_count = malloc(count * sizeof(size_t));
+    if (parts == NULL || parts_count == NULL)
+    {
+        free(parts);
+        free(parts_count);
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        parts[i].iov_base = data[i];
+        parts[i].iov_len = data_len[i];
+        parts_count[i] = 1;
+    }
+
+    int result = log_append_batchv(log, parts, parts_count, count, sync);
+
+    free(parts);
+    free(parts_count);
+
+    return result;
+}
+
+int log_append(log_t* log, uint8_t* data, size_t data_len, bool sync)
+{
+    struct iovec part = {data, data_len};
+    size_t parts_count = 1;
+
+    return log_append_batchv(log, &part, &parts_count, 1, sync);
+}
+
+int log_size(log_t* log, size_t* size)
+{
+    if (log == NULL || size == NULL) return -1;
+
+    pthread_mutex_lock(&log->lock);
+    *size = log->size;
+    pthread_mutex_unlock(&log->lock);
+
+    return 0;
+}
+
+int log_truncate(log_t* log, size_t size)
+{
+    if (log == NULL) return -1;
+
+    pthread_mutex_lock(&log->lock);
+
+    if (ftruncate(log->fd, (off_t)size) != 0)
+    {
+        pthread_mutex_unlock(&log->lock);
+        return -1;
+    }
+
+    /* new entries are appended after the truncated end */
+    log->size = size;
+
+    pthread_mutex_unlock(&log->lock);
+
+    return 0;
+}
+
+int log_sync(log_t* log)
+{
+    if (log == NULL) return -1;
+
+    return fdatasync(log->fd) == 0 ? 0 : -1;
+}
+
+int log_pwritev_all(int fd, struct iovec* iov, int iovcnt, off_t offset)
+{
+    while (iovcnt > 0)
+    {
+        ssize_t written = pwritev(fd, iov, iovcnt > IOV_MAX ? IOV_MAX : iovcnt, offset);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+
+            return -1;
+        }
+
+        offset += written;
+
+        /* we skip the buffers written in full and move into a partially written one */
+        while (iovcnt > 0 && (size_t)written >= iov->iov_len)
+        {
+            written -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (uint8_t*)iov->iov_base + written;
+            iov->iov_len -= (size_t)written;
+        }
+    }
+
+    return 0;
+}
+
+void log_set_sync_service(log_t* log, sync_service_t* service)
+{
+    log->sync_service = service;
+}
+
+int log_reader_open(log_t* log, log_reader_t** reader)
+{
+    if (log == NULL || reader == NULL) return -1;
+
+    *reader = malloc(sizeof(log_reader_t));
+    if (*reader == NULL) return -1;
+
+    (*reader)->buffer = malloc(LOG_READ_SIZE);
+    if ((*reader)->buffer == NULL)
+    {
+        free(*reader);
+        *reader = NULL;
+        return -1;
+    }
+
+    /* the log is read front to back, the kernel can read ahead of us */
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(log->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    (*reader)->log = log;
+    (*reader)->buffer_size = 0;
+    (*reader)->buffer_offset = 0;
+    (*reader)->file_offset = 0;
+    (*reader)->end_offset = 0;
+    (*reader)->entry = NULL;
+    (*reader)->entry_size = 0;
+    (*reader)->entry_capacity = 0;
+
+    return 0;
+}
+
+int log_reader_next(log_reader_t* reader, uint8_t** data, size_t* data_len)
+{
+    if (reader == NULL || data == NULL || data_len == NULL) return -1;
+
+    bool in_entry = false;
+    reader->entry_size = 0;
+
+    while (true)
+    {
+        /* the buffer starts on a block boundary, records never cross the end of their block */
+        size_t block_end = (reader->buffer_offset / LOG_BLOCK_SIZE + 1) * LOG_BLOCK_SIZE;
+        if (block_end > reader->buffer_size) block_end = reader->buffer_size;
+
+        /* the rest of the block is padding, we move to the next block */
+        if (block_end - reader->buffer_offset < LOG_HEADER_SIZE)
+        {
+            if (block_end < reader->buffer_size)
+            {
+                reader->buffer_offset = block_end;
+                continue;
+            }
+
+            /* the buffer is used up, we read the next blocks */
+            ssize_t read_size =
+                pread(reader->log->fd, reader->buffer, LOG_READ_SIZE, (off_t)reader->file_offset);
+            if (read_size <= 0) return -1; /* the end of the log */
+
+            reader->buffer_size = (size_t)read_size;
+            reader->buffer_offset = 0;
+            reader->file_offset += (size_t)read_size;
+            continue;
+        }
+
+        uint8_t* header = reader->buffer + reader->buffer_offset;
+        uint32_t checksum = (uint32_t)header[0] | (uint32_t)header[1] << 8 |
+                            (uint32_t)header[2] << 16 | (uint32_t)header[3] << 24;
+        size_t length = (size_t)header[4] | (size_t)header[5] << 8;
+        uint8_t type = header[6];
+
+        /* a zeroed record is space that was never written */
+        if (type == LOG_RECORD_ZERO) return -1;
+
+        /* a record cut short or failing its checksum is a torn write */
+        if (reader->buffer_offset + LOG_HEADER_SIZE + length > block_end) return -1;
+
+        uint8_t* payload = header + LOG_HEADER_SIZE;
+        if (log_checksum(reader->log->number, type, payload, length) != checksum) return -1;
+
+        reader->buffer_offset += LOG_HEADER_SIZE + length;
+
+        if (type == LOG_RECORD_FULL)
+        {
+            /* an entry left unfinished before a whole one is not something we wrote */
+            if (in_entry) return -1;
+
+            *data = payload;
+            *data_len = length;
+        }
+        else
+        {
+            if ((type == LOG_RECORD_FIRST) == in_entry || type > LOG_RECORD_LAST) return -1;
+
+            in_entry = true;
+
+            if (reader->entry_size + length > reader->entry_capacity)
+            {
+                size_t capacity = reader->entry_capacity == 0 ? LOG_BLOCK_SIZE
+                                                              : reader->entry_capacity;
+                while (capacity < reader->entry_size + length) capacity *= 2;
+
+                uint8_t* entry = realloc(reader->entry, capacity);
+                if (entry == NULL) return -1;
+
+                reader->entry = entry;
+                reader->entry_capacity = capacity;
+            }
+
+            memcpy(reader->entry + reader->entry_size, payload, length);
+            reader->entry_size += length;
+
+            if (type != LOG_RECORD_LAST) continue;
+
+            *data = reader->entry;
+            *data_len = reader->entry_size;
+        }
+
+        /* the log is whole up to here */
+        reader->end_offset = reader->file_offset - reader->buffer_size + reader->buffer_offset;
+        return 0;
+    }
+}
+
+void log_reader_free(log_reader_t* reader)
+{
+    if (reader == NULL) return;
+
+    free(reader->buffer);
+    free(reader->entry);
+    free(reader);
+}
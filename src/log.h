@@ -0,0 +1,299 @@
+/*
+ *
+ * Copyright (C) TidesDB
+ *
+ * Original Author: Alex Gaetano Padula
+ *
+ * Licensed under the Mozilla Public License, v. 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.mozilla.org/en-US/MPL/2.0/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef LOG_H
+#define LOG_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "../external/xxhash.h"
+#include "pager.h"
+#include "sync_service.h"
+
+/*
+ * A log is an append-only file of records packed back to back into blocks of LOG_BLOCK_SIZE
+ * bytes.  Every record starts with a header of
+ *
+ * [checksum (4 bytes)] [length (2 bytes)] [type (1 byte)]
+ *
+ * followed by length bytes of payload, the checksum covers the type and the payload and is seeded
+ * with the number of the log.  An entry
+ * that fits in the rest of a block is written as a single LOG_RECORD_FULL record, a larger entry
+ * is split into a LOG_RECORD_FIRST, LOG_RECORD_MIDDLE(s) and a LOG_RECORD_LAST record that each
+ * fill what is left of their block.  A record never crosses a block boundary, a block tail too
+ * small for a header is padded with zeros.
+ *
+ * A reader stops at the first record that is zero, cut short or fails its checksum, that is where
+ * a write was torn by a crash.  Entries before it are returned whole, a partial entry at the tail
+ * is dropped.  A log can be preallocated or created over a file recycled from an older log, the
+ * zeros or the records of the older log that follow what was written fail the checks the same way.
+ */
+
+#define LOG_BLOCK_SIZE    32768 /* the size of a log block */
+#define LOG_HEADER_SIZE   7     /* the size of a record header */
+#define LOG_RECORD_ZERO   0     /* padding or space not written yet */
+#define LOG_RECORD_FULL   1     /* a whole entry */
+#define LOG_RECORD_FIRST  2     /* the first fragment of an entry */
+#define LOG_RECORD_MIDDLE 3     /* a middle fragment of an entry */
+#define LOG_RECORD_LAST   4     /* the last fragment of an entry */
+#define LOG_STACK_RECORDS 64    /* most records of an append laid out on the stack */
+#define LOG_STACK_PARTS   64    /* most entry parts of an append laid out on the stack */
+#define LOG_READ_SIZE     (LOG_BLOCK_SIZE * 32) /* the bytes a reader reads at once */
+
+/*
+ * log_t
+ * an append-only log file of checksummed records
+ * @param fd the file descriptor of the log
+ * @param filename the filename of the log
+ * @param number the number of the log, it seeds the record checksums
+ * @param lock the lock for appending to the log
+ * @param size the number of bytes in the log
+ * @param sync_service the service that syncs what is appended without a sync, NULL if none does
+ * @param sync_file the log as the sync service tracks it
+ */
+typedef struct
+{
+    int fd;                       /* the file descriptor of the log */
+    char* filename;               /* the filename of the log */
+    uint64_t number;              /* the number of the log, it seeds the record checksums */
+    pthread_mutex_t lock;         /* the lock for appending to the log */
+    size_t size;                  /* the number of bytes in the log */
+    sync_service_t* sync_service; /* the service that syncs unsynced appends, NULL if none */
+    sync_file_t sync_file;        /* the log as the sync service tracks it */
+} log_t;
+
+/*
+ * log_reader_t
+ * reads the entries of a log from its start, several blocks at a time
+ * @param log the log being read
+ * @param buffer the blocks being read
+ * @param buffer_size the number of bytes read into the buffer
+ * @param buffer_offset the offset of the next record in the buffer
+ * @param file_offset the offset in the log of the bytes after the buffer
+ * @param end_offset the offset just past the last whole entry read, a torn tail starts here
+ * @param entry the entry being assembled from its records
+ * @param entry_size the size of the entry
+ * @param entry_capacity the capacity of the entry buffer
+ */
+typedef struct
+{
+    log_t* log;            /* the log being read */
+    uint8_t* buffer;       /* the blocks being read */
+    size_t buffer_size;    /* the number of bytes read into the buffer */
+    size_t buffer_offset;  /* the offset of the next record in the buffer */
+    size_t file_offset;    /* the offset in the log of the bytes after the buffer */
+    size_t end_offset;     /* the offset just past the last whole entry read */
+    uint8_t* entry;        /* the entry being assembled from its records */
+    size_t entry_size;     /* the size of the entry */
+    size_t entry_capacity; /* the capacity of the entry buffer */
+} log_reader_t;
+
+/* Log function prototypes */
+
+/*
+ * log_open
+ * opens a log with the given filename, creating it if it does not exist.  entries are appended
+ * after what is in the file already
+ * @param filename the filename of the log
+ * @param number the number of the log, it must be the number the log was written with
+ * @param log the log
+ * @return 0 if the log was opened successfully, -1 otherwise
+ */
+int log_open(const char* filename, uint64_t number, log_t** log);
+
+/*
+ * log_create
+ * creates a log with the given filename that starts empty.  the file may be one recycled from an
+ * older log, it is written over from the start instead of being truncated
+ * @param filename the filename of the log
+ * @param number the number of the log, it must differ from the number of a recycled file
+ * @param preallocate_size the number of bytes to preallocate for the log, 0 for none
+ * @param log the log
+ * @return 0 if the log was created successfully, -1 otherwise
+ */
+int log_create(const char* filename, uint64_t number, size_t preallocate_size, log_t** log);
+
+/*
+ * log_preallocate
+ * allocates disk space for the log up front so appends do not grow the file.  file systems that
+ * cannot preallocate are left to grow the file as it is written
+ * @param log the log
+ * @param size the number of bytes to allocate from the start of the log
+ * @return 0 if the space was allocated or cannot be, -1 otherwise
+ */
+int log_preallocate(log_t* log, size_t size);
+
+/*
+ * log_close
+ * closes the log and frees the memory, what was appended is synced first
+ * @param log the log to close
+ * @return 0 if the log was closed successfully, -1 otherwise
+ */
+int log_close(log_t* log);
+
+/*
+ * log_append_batchv
+ * appends entries that are each gathered from several parts to the log with a single vectored
+ * write, the parts are not copied
+ * @param log the log to append to
+ * @param parts the parts of every entry, one entry after the other
+ * @param parts_count the number of parts of each entry
+ * @param count the number of entries
+ * @param sync whether the log is synced to disk before returning, otherwise its sync service does
+ * @return 0 if every entry was appended (and synced), -1 otherwise
+ */
+int log_append_batchv(log_t* log, const struct iovec* parts, const size_t* parts_count,
+                      size_t count, bool sync);
+
+/*
+ * log_append_batch
+ * appends entries to the log with a single vectored write, the payloads are not copied
+ * @param log the log to append to
+ * @param data the data of each entry
+ * @param data_len the length of each entry
+ * @param count the number of entries
+ * @param sync whether the log is synced to disk before returning, otherwise its sync service does
+ * @return 0 if every entry was appended (and synced), -1 otherwise
+ */
+int log_append_batch(log_t* log, uint8_t** data, size_t* data_len, size_t count, bool sync);
+
+/*
+ * log_append
+ * appends an entry to the log
+ * @param log the log to append to
+ * @param data the entry
+ * @param data_len the length of the entry
+ * @param sync whether the log is synced to disk before returning, otherwise its sync service does
+ * @return 0 if the entry was appended (and synced), -1 otherwise
+ */
+int log_append(log_t* log, uint8_t* data, size_t data_len, bool sync);
+
+/*
+ * log_encoded_size
+ * returns the number of bytes an entry takes in the log when it is appended at the given size
+ * @param size the size of the log before the entry
+ * @param data_len the length of the entry
+ * @return the number of bytes the entry takes, including headers and block padding
+ */
+size_t log_encoded_size(size_t size, size_t data_len);
+
+/*
+ * log_checksum_seed
+ * returns the seed of the checksum of a record
+ * @param number the number of the log
+ * @param type the type of the record
+ * @return the seed
+ */
+uint32_t log_checksum_seed(uint64_t number, uint8_t type);
+
+/*
+ * log_checksum
+ * computes the checksum of a record
+ * @param number the number of the log
+ * @param type the type of the record
+ * @param data the payload of the record
+ * @param data_len the length of the payload
+ * @return the checksum
+ */
+uint32_t log_checksum(uint64_t number, uint8_t type, const uint8_t* data, size_t data_len);
+
+/*
+ * log_size
+ * returns the number of bytes in the log
+ * @param log the log
+ * @param size the number of bytes in the log
+ * @return 0 if the size was retrieved successfully, -1 otherwise
+ */
+int log_size(log_t* log, size_t* size);
+
+/*
+ * log_truncate
+ * truncates the log to the given size
+ * @param log the log to truncate
+ * @param size the size to truncate the log to
+ * @return 0 if the log was truncated successfully, -1 otherwise
+ */
+int log_truncate(log_t* log, size_t size);
+
+/*
+ * log_sync
+ * syncs the log to disk
+ * @param log the log to sync
+ * @return 0 if the log was synced successfully, -1 otherwise
+ */
+int log_sync(log_t* log);
+
+/*
+ * log_pwritev_all
+ * writes every buffer of an io vector to a file descriptor at an offset, retrying short writes
+ * @param fd the file descriptor
+ * @param iov the buffers to write, advanced in place as they are written
+ * @param iovcnt the number of buffers
+ * @param offset the offset to write at
+ * @return 0 if every buffer was written, -1 otherwise
+ */
+int log_pwritev_all(int fd, struct iovec* iov, int iovcnt, off_t offset);
+
+/*
+ * log_set_sync_service
+ * hands what is appended to the log without a sync to a sync service, a log without one is only
+ * synced when asked to and when it is closed
+ * @param log the log
+ * @param service the sync service, NULL for none
+ */
+void log_set_sync_service(log_t* log, sync_service_t* service);
+
+/*
+ * log_reader_open
+ * opens a reader at the start of the log.  the log is read LOG_READ_SIZE bytes at a time and the
+ * kernel is told the reads are sequential
+ * @param log the log to read
+ * @param reader the reader
+ * @return 0 if the reader was opened successfully, -1 otherwise
+ */
+int log_reader_open(log_t* log, log_reader_t** reader);
+
+/*
+ * log_reader_next
+ * reads the next entry of the log
+ * @param reader the reader
+ * @param data the entry, owned by the reader and valid until the next call
+ * @param data_len the length of the entry
+ * @return 0 if an entry was read, -1 at the end of the log or at a torn or corrupt record
+ */
+int log_reader_next(log_reader_t* reader, uint8_t** data, size_t* data_len);
+
+/*
+ * log_reader_free
+ * frees the reader
+ * @param reader the reader to free
+ */
+void log_reader_free(log_reader_t* reader);
+
+#endif /* LOG_H */
@@ -0,0 +1,575 @@
+/*
+ *
+ * Copyright (C) TidesDB
+ *
+ * Original Author: Alex Gaetano Padula
+ *
+ * Licensed under the Mozilla Public License, v. 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.mozilla.org/en-US/MPL/2.0/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "manifest.h"
+
+bool manifest_exists(const char* dir)
+{
+    if (dir == NULL) return false;
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, MANIFEST_FILE);
+
+    return access(path, F_OK) == 0;
+}
+
+int manifest_open(const char* dir, manifest_t** manifest)
+{
+    /* we check if the directory is NULL */
+    if (dir == NULL || manifest == NULL) return -1;
+
+    *manifest = malloc(sizeof(manifest_t));
+    if (*manifest == NULL) return -1;
+
+    (*manifest)->dir = strdup(dir);
+    (*manifest)->path = malloc(PATH_MAX);
+    (*manifest)->log = NULL;
+    (*manifest)->tables = NULL;
+    (*manifest)->num_tables = 0;
+    (*manifest)->tables_capacity = 0;
+    (*manifest)->next_file_number = 0;
+    (*manifest)->next_sequence = 0;
+    (*manifest)->stale = false;
+
+    if ((*manifest)->dir == NULL || (*manifest)->path == NULL)
+    {
+        manifest_close(*manifest);
+        return -1;
+    }
+
+    snprintf((*manifest)->path, PATH_MAX, "%s/%s", dir, MANIFEST_FILE);
+
+    /* the names of the sstables removed by the edits, their files may have outlived a crash */
+    char** removed = NULL;
+    size_t num_removed = 0;
+    int rc = 0;
+
+    if (access((*manifest)->path, F_OK) == 0)
+    {
+        log_t* log = NULL;
+        if (log_open((*manifest)->path, MANIFEST_LOG_NUMBER, &log) == -1)
+        {
+            manifest_close(*manifest);
+            return -1;
+        }
+
+        log_reader_t* reader = NULL;
+        if (log_reader_open(log, &reader) == -1)
+        {
+            log_close(log);
+            manifest_close(*manifest);
+            return -1;
+        }
+
+        uint8_t* data = NULL;
+        size_t data_len = 0;
+
+        /* the reader stops at a torn or corrupt record, the edits before it are the manifest */
+        while (rc == 0 && log_reader_next(reader, &data, &data_len) == 0)
+        {
+            manifest_edit_t* edit = NULL;
+
+            /* an entry that does not decode ends the manifest like a torn one */
+            if (manifest_decode_edit(data, data_len, &edit) == -1) break;
+
+            rc = manifest_apply_edit(*manifest, edit);
+
+            if (rc == 0 && edit->num_removed > 0)
+            {
+                char** temp_removed =
+                    realloc(removed, (num_removed + edit->num_removed) * sizeof(char*));
+                if (temp_removed == NULL)
+                    rc = -1;
+                else
+                    removed = temp_removed;
+
+                for (uint32_t i = 0; rc == 0 && i < edit->num_removed; i++)
+                {
+                    removed[num_removed] = strdup(edit->removed[i]);
+                    if (removed[num_removed] == NULL)
+                        rc = -1;
+                    else
+                        num_removed++;
+                }
+            }
+
+            manifest_free_edit(edit);
+        }
+
+        log_reader_free(reader);
+        log_close(log);
+    }
+
+    /* a removed sstable whose name is not live again is gone for good */
+    for (size_t i = 0; i < num_removed; i++)
+    {
+        if (rc == 0 && manifest_find(*manifest, removed[i]) == -1)
+        {
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "%s/%s", dir, removed[i]);
+            remove(path);
+        }
+
+        free(removed[i]);
+    }
+    free(removed);
+
+    /* we start over from the live sstables, the removed ones and a torn tail are left behind */
+    if (rc == -1 || manifest_rewrite(*manifest) == -1)
+    {
+        manifest_close(*manifest);
+        return -1;
+    }
+
+    return 0;
+}
+
+int manifest_append(manifest_t* manifest, const manifest_edit_t* edit)
+{
+    if (manifest == NULL || manifest->log == NULL || edit == NULL) return -1;
+
+    size_t size = manifest_edit_size(edit);
+    uint8_t* buffer = malloc(size);
+    if (buffer == NULL) return -1;
+
+    manifest_encode_edit(edit, buffer);
+
+    /* the edit is durable before the sstables it adds are used or the ones it removes are gone */
+    if (log_append(manifest->log, buffer, size, true) == -1)
+    {
+        free(buffer);
+        return -1;
+    }
+
+    free(buffer);
+
+    /* the edit is in the manifest from here on, whatever fails after it.  live sstables that
+     * missed it must not be rewritten over the log, the next open replays it */
+    if (manifest_apply_edit(manifest, edit) == -1)
+    {
+        manifest->stale = true;
+        return 0;
+    }
+
+    /* the edits of a long running column family are folded into one once they add up.  a
+     * rewrite that fails leaves the log as it was, we try again on the next append */
+    size_t log_size_now = 0;
+    if (log_size(manifest->log, &log_size_now) == 0 && log_size_now > MANIFEST_MAX_SIZE)
+        (void)manifest_rewrite(manifest);
+
+    return 0;
+}
+
+int manifest_rewrite(manifest_t* manifest)
+{
+    if (manifest == NULL || manifest->stale) return -1;
+
+    /* the live sstables are written as a single edit */
+    manifest_edit_t edit = {manifest->tables, manifest->num_tables, NULL, 0,
+                            manifest->next_file_number, manifest->next_sequence};
+
+    size_t size = manifest_edit_size(&edit);
+    uint8_t* buffer = malloc(size);
+    if (buffer == NULL) return -1;
+
+    manifest_encode_edit(&edit, buffer);
+
+    char tmp_path[PATH_MAX];
+    snprintf(tmp_path, sizeof(tmp_path), "%s%s", manifest->path, MANIFEST_TMP_EXT);
+
+    remove(tmp_path); /* what a rewrite cut short left behind */
+
+    log_t* log = NULL;
+    if (log_create(tmp_path, MANIFEST_LOG_NUMBER, 0, &log) == -1)
+    {
+        free(buffer);
+        return -1;
+    }
+
+    if (log_append(log, buffer, size, true) == -1)
+    {
+        free(buffer);
+        log_close(log);
+        remove(tmp_path);
+        return -1;
+    }
+
+    free(buffer);
+
+    /* the new manifest takes the place of the old one in a single rename */
+    if (rename(tmp_path, manifest->path) == -1)
+    {
+        log_close(log);
+        remove(tmp_path);
+        return -1;
+    }
+
+    /* the old manifest is unlinked, edits are appended to the new one from now on even if the
+     * rename is not durable yet */
+    if (manifest->log != NULL) log_close(manifest->log);
+    manifest->log = log;
+
+    if (manifest_sync_dir(manifest->dir) == -1) return -1;
+
+    return 0;
+}
+
+int manifest_close(manifest_t* manifest)
+{
+    if (manifest == NULL) return -1;
+
+    int rc = 0;
+    if (manifest->log != NULL && log_close(manifest->log) == -1) rc = -1;
+
+    for (uint32_t i = 0; i < manifest->num_tables; i++) manifest_free_table(&manifest->tables[i]);
+
+    free(manifest->tables);
+    free(manifest->path);
+    free(manifest->dir);
+    free(manifest);
+
+    return rc;
+}
+
+int manifest_apply_edit(manifest_t* manifest, const manifest_edit_t* edit)
+{
+    if (manifest == NULL || edit == NULL) return -1;
+
+    if (edit->next_file_number > manifest->next_file_number)
+        manifest->next_file_number = edit->next_file_number;
+    if (edit->next_sequence > manifest->next_sequence)
+        manifest->next_sequence = edit->next_sequence;
+
+    /* the removed sstables go first, the live ones keep the order they were added in */
+    for (uint32_t i = 0; i < edit->num_removed; i++)
+    {
+        int index = manifest_find(manifest, edit->removed[i]);
+        if (index == -1) continue;
+
+        manifest_free_table(&manifest->tables[index]);
+        memmove(&manifest->tables[index], &manifest->tables[index + 1],
+                (manifest->num_tables - index - 1) * sizeof(manifest_table_t));
+        manifest->num_tables--;
+    }
+
+    if (manifest->num_tables + edit->num_added > manifest->tables_capacity)
+    {
+        uint32_t capacity = manifest->tables_capacity ? manifest->tables_capacity * 2 : 16;
+        while (capacity < manifest->num_tables + edit->num_added) capacity *= 2;
+
+        manifest_table_t* temp_tables =
+            realloc(manifest->tables, capacity * sizeof(manifest_table_t));
+        if (temp_tables == NULL) return -1;
+
+        manifest->tables = temp_tables;
+        manifest->tables_capacity = capacity;
+    }
+
+    for (uint32_t i = 0; i < edit->num_added; i++)
+    {
+        const manifest_table_t* added = &edit->added[i];
+        manifest_table_t* table = &manifest->tables[manifest->num_tables];
+
+        *table = *added;
+        table->name = strdup(added->name);
+        table->min_key = NULL;
+        table->max_key = NULL;
+
+        if (added->min_key != NULL)
+        {
+            table->min_key = malloc(added->min_key_size ? added->min_key_size : 1);
+            if (table->min_key != NULL)
+                memcpy(table->min_key, added->min_key, added->min_key_size);
+        }
+
+        if (added->max_key != NULL)
+        {
+            table->max_key = malloc(added->max_key_size ? added->max_key_size : 1);
+            if (table->max_key != NULL)
+                memcpy(table->max_key, added->max_key, added->max_key_size);
+        }
+
+        if (table->name == NULL || (added->min_key != NULL && table->min_key == NULL) ||
+            (added->max_key != NULL && table->max_key == NULL))
+        {
+            manifest_free_table(table);
+            return -1;
+        }
+
+        manifest->num_tables++;
+    }
+
+    return 0;
+}
+
+int manifest_find(manifest_t* manifest, const char* name)
+{
+    if (manifest == NULL || name == NULL) return -1;
+
+    for (uint32_t i = 0; i < manifest->num_tables; i++)
+        if (strcmp(manifest->tables[i].name, name) == 0) return (int)i;
+
+    return -1;
+}
+
+size_t manifest_edit_size(const manifest_edit_t* edit)
+{
+    size_t size = MANIFEST_HEADER_SIZE;
+
+    for (uint32_t i = 0; i < edit->num_added; i++)
+    {
+        const manifest_table_t* table = &edit->added[i];
+
+        size += sizeof(uint32_t) + strlen(table->name) + 1;
+        size += sizeof(table->level) + sizeof(table->sequence) + sizeof(table->file_number) +
+                sizeof(table->num_entries) + sizeof(table->size) + sizeof(table->num_tombstones) +
+                sizeof(table->num_ttl) + sizeof(table->min_ttl) + sizeof(table->max_ttl);
+        size += sizeof(uint32_t) + (table->min_key != NULL ? table->min_key_size : 0);
+        size += sizeof(uint32_t) + (table->max_key != NULL ? table->max_key_size : 0);
+    }
+
+    for (uint32_t i = 0; i < edit->num_removed; i++)
+        size += sizeof(uint32_t) + strlen(edit->removed[i]) + 1;
+
+    return size;
+}
+
+void manifest_encode_edit(const manifest_edit_t* edit, uint8_t* buffer)
+{
+    uint8_t* ptr = buffer;
+
+    memcpy(ptr, &edit->num_added, sizeof(edit->num_added));
+    ptr += sizeof(edit->num_added);
+    memcpy(ptr, &edit->num_removed, sizeof(edit->num_removed));
+    ptr += sizeof(edit->num_removed);
+    memcpy(ptr, &edit->next_file_number, sizeof(edit->next_file_number));
+    ptr += sizeof(edit->next_file_number);
+    memcpy(ptr, &edit->next_sequence, sizeof(edit->next_sequence));
+    ptr += sizeof(edit->next_sequence);
+
+    for (uint32_t i = 0; i < edit->num_added; i++)
+    {
+        const manifest_table_t* table = &edit->added[i];
+
+        /* the name is kept with its terminator so a decoded edit can point at it */
+        uint32_t name_size = (uint32_t)strlen(table->name) + 1;
+        memcpy(ptr, &name_size, sizeof(name_size));
+        ptr += sizeof(name_size);
+        memcpy(ptr, table->name, name_size);
+        ptr += name_size;
+
+        memcpy(ptr, &table->level, sizeof(table->level));
+        ptr += sizeof(table->level);
+        memcpy(ptr, &table->sequence, sizeof(table->sequence));
+        ptr += sizeof(table->sequence);
+        memcpy(ptr, &table->file_number, sizeof(table->file_number));
+        ptr += sizeof(table->file_number);
+        memcpy(ptr, &table->num_entries, sizeof(table->num_entries));
+        ptr += sizeof(table->num_entries);
+        memcpy(ptr, &table->size, sizeof(table->size));
+        ptr += sizeof(table->size);
+        memcpy(ptr, &table->num_tombstones, sizeof(table->num_tombstones));
+        ptr += sizeof(table->num_tombstones);
+        memcpy(ptr, &table->num_ttl, sizeof(table->num_ttl));
+        ptr += sizeof(table->num_ttl);
+        memcpy(ptr, &table->min_ttl, sizeof(table->min_ttl));
+        ptr += sizeof(table->min_ttl);
+        memcpy(ptr, &table->max_ttl, sizeof(table->max_ttl));
+        ptr += sizeof(table->max_ttl);
+
+        /* an unknown key is written with a size of UINT32_MAX */
+        uint32_t key_size = table->min_key != NULL ? table->min_key_size : UINT32_MAX;
+        memcpy(ptr, &key_size, sizeof(key_size));
+        ptr += sizeof(key_size);
+        if (table->min_key != NULL)
+        {
+            memcpy(ptr, table->min_key, table->min_key_size);
+            ptr += table->min_key_size;
+        }
+
+        key_size = table->max_key != NULL ? table->max_key_size : UINT32_MAX;
+        memcpy(ptr, &key_size, sizeof(key_size));
+        ptr += sizeof(key_size);
+        if (table->max_key != NULL)
+        {
+            memcpy(ptr, table->max_key, table->max_key_size);
+            ptr += table->max_key_size;
+        }
+    }
+
+    for (uint32_t i = 0; i < edit->num_removed; i++)
+    {
+        uint32_t name_size = (uint32_t)strlen(edit->removed[i]) + 1;
+        memcpy(ptr, &name_size, sizeof(name_size));
+        ptr += sizeof(name_size);
+        memcpy(ptr, edit->removed[i], name_size);
+        ptr += name_size;
+    }
+}
+
+int manifest_decode_edit(const uint8_t* buffer, size_t size, manifest_edit_t** edit)
+{
+    if (buffer == NULL || edit == NULL || size < MANIFEST_HEADER_SIZE) return -1;
+
+    uint32_t num_added;
+    uint32_t num_removed;
+    memcpy(&num_added, buffer, sizeof(num_added));
+    memcpy(&num_removed, buffer + sizeof(num_added), sizeof(num_removed));
+
+    /* every table and name takes at least its size field, the counts cannot claim more */
+    size_t remaining = size - MANIFEST_HEADER_SIZE;
+    if ((uint64_t)num_added + num_removed > remaining / sizeof(uint32_t)) return -1;
+
+    *edit = malloc(sizeof(manifest_edit_t));
+    if (*edit == NULL) return -1;
+
+    (*edit)->num_added = num_added;
+    (*edit)->num_removed = num_removed;
+    memcpy(&(*edit)->next_file_number, buffer + 8, sizeof(uint64_t));
+    memcpy(&(*edit)->next_sequence, buffer + 16, sizeof(uint64_t));
+    (*edit)->added = calloc(num_added ? num_added : 1, sizeof(manifest_table_t));
+    (*edit)->removed = calloc(num_removed ? num_removed : 1, sizeof(char*));
+    if ((*edit)->added == NULL || (*edit)->removed == NULL)
+    {
+        manifest_free_edit(*edit);
+        return -1;
+    }
+
+    const uint8_t* ptr = buffer + MANIFEST_HEADER_SIZE;
+    const uint8_t* end = buffer + size;
+    uint32_t decoded = 0;
+
+    for (uint32_t i = 0; i < num_added; i++)
+    {
+        manifest_table_t* table = &(*edit)->added[i];
+
+        uint32_t name_size;
+        if ((size_t)(end - ptr) < sizeof(name_size)) break;
+        memcpy(&name_size, ptr, sizeof(name_size));
+        ptr += sizeof(name_size);
+        if (name_size == 0 || (size_t)(end - ptr) < name_size || ptr[name_size - 1] != '\0') break;
+        table->name = (char*)ptr;
+        ptr += name_size;
+
+        size_t fixed_size = sizeof(table->level) + sizeof(table->sequence) +
+                            sizeof(table->file_number) + sizeof(table->num_entries) +
+                            sizeof(table->size) + sizeof(table->num_tombstones) +
+                            sizeof(table->num_ttl) + sizeof(table->min_ttl) +
+                            sizeof(table->max_ttl);
+        if ((size_t)(end - ptr) < fixed_size) break;
+        memcpy(&table->level, ptr, sizeof(table->level));
+        ptr += sizeof(table->level);
+        memcpy(&table->sequence, ptr, sizeof(table->sequence));
+        ptr += sizeof(table->sequence);
+        memcpy(&table->file_number, ptr, sizeof(table->file_number));
+        ptr += sizeof(table->file_number);
+        memcpy(&table->num_entries, ptr, sizeof(table->num_entries));
+        ptr += sizeof(table->num_entries);
+        memcpy(&table->size, ptr, sizeof(table->size));
+        ptr += sizeof(table->size);
+        memcpy(&table->num_tombstones, ptr, sizeof(table->num_tombstones));
+        ptr += sizeof(table->num_tombstones);
+        memcpy(&table->num_ttl, ptr, sizeof(table->num_ttl));
+        ptr += sizeof(table->num_ttl);
+        memcpy(&table->min_ttl, ptr, sizeof(table->min_ttl));
+        ptr += sizeof(table->min_ttl);
+        memcpy(&table->max_ttl, ptr, sizeof(table->max_ttl));
+        ptr += sizeof(table->max_ttl);
+
+        uint32_t key_size;
+        if ((size_t)(end - ptr) < sizeof(key_size)) break;
+        memcpy(&key_size, ptr, sizeof(key_size));
+        ptr += sizeof(key_size);
+        if (key_size != UINT32_MAX)
+        {
+            if ((size_t)(end - ptr) < key_size) break;
+            table->min_key = (uint8_t*)ptr;
+            table->min_key_size = key_size;
+            ptr += key_size;
+        }
+
+        if ((size_t)(end - ptr) < sizeof(key_size)) break;
+        memcpy(&key_size, ptr, sizeof(key_size));
+        ptr += sizeof(key_size);
+        if (key_size != UINT32_MAX)
+        {
+            if ((size_t)(end - ptr) < key_size) break;
+            table->max_key = (uint8_t*)ptr;
+            table->max_key_size = key_size;
+            ptr += key_size;
+        }
+
+        decoded++;
+    }
+
+    for (uint32_t i = 0; i < num_removed; i++)
+    {
+        uint32_t name_size;
+        if ((size_t)(end - ptr) < sizeof(name_size)) break;
+        memcpy(&name_size, ptr, sizeof(name_size));
+        ptr += sizeof(name_size);
+        if (name_size == 0 || (size_t)(end - ptr) < name_size || ptr[name_size - 1] != '\0') break;
+        (*edit)->removed[i] = (char*)ptr;
+        ptr += name_size;
+
+        decoded++;
+    }
+
+    /* an edit that was cut short or has bytes left over is malformed */
+    if (decoded != num_added + num_removed || ptr != end)
+    {
+        manifest_free_edit(*edit);
+        *edit = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+void manifest_free_edit(manifest_edit_t* edit)
+{
+    if (edit == NULL) return;
+
+    free(edit->added);
+    free(edit->removed);
+    free(edit);
+}
+
+void manifest_free_table(manifest_table_t* table)
+{
+    if (table == NULL) return;
+
+    free(table->name);
+    free(table->min_key);
+    free(table->max_key);
+
+    table->name = NULL;
+    table->min_key = NULL;
+    table->max_key = NULL;
+}
+
+int manifest_sync_dir(const char* dir)
+{
+    int fd = open(dir, O_RDONLY);
+    if (fd == -1) return -1;
+
+    int rc = fsync(fd) == 0 ? 0 : -1;
+    close(fd);
+
+    return rc;
+}
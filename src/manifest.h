@@ -0,0 +1,267 @@
+/*
+ *
+ * Copyright (C) TidesDB
+ *
+ * Original Author: Alex Gaetano Padula
+ *
+ * Licensed under the Mozilla Public License, v. 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.mozilla.org/en-US/MPL/2.0/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "log.h"
+
+/*
+ * A manifest records the live sstables of a column family as an append-only log of version
+ * edits.  Every edit adds and removes sstables in one log entry, so a flush or a compaction
+ * reaches the manifest whole or not at all.  An edit is encoded as
+ *
+ * [num_added (4 bytes)] [num_removed (4 bytes)] [next_file_number (8 bytes)]
+ * [next_sequence (8 bytes)] [added table]... [removed name]...
+ *
+ * an added table as
+ *
+ * [name_size (4 bytes)] [name] [level (4 bytes)] [sequence (8 bytes)] [file_number (8 bytes)]
+ * [num_entries (8 bytes)] [size (8 bytes)] [num_tombstones (8 bytes)] [num_ttl (8 bytes)]
+ * [min_ttl (8 bytes)] [max_ttl (8 bytes)] [min_key_size (4 bytes)] [min_key]
+ * [max_key_size (4 bytes)] [max_key]
+ *
+ * and a removed name as [name_size (4 bytes)] [name].  Names are the file names of the sstables
+ * in the column family directory and are written with their terminator, a key that is not known
+ * is written with a size of UINT32_MAX.  A table carries what its sstable would otherwise have to
+ * be opened for, so a column family can be loaded without opening any of its sstables.
+ *
+ * The counters of an edit are the next file number and sequence number the column family hands
+ * out, 0 leaves them as they are.  The manifest keeps the largest of each it has seen, so neither
+ * goes back across a reopen even when the sstables that had the largest ones are gone.
+ *
+ * Opening a manifest replays its edits into the set of live sstables.  The files of sstables it
+ * removed that are still on disk are removed then, and the live set is written to a new manifest
+ * that is renamed over the old one, so the removed sstables and a torn tail are left behind.  A
+ * manifest that grows past MANIFEST_MAX_SIZE is rewritten the same way.
+ */
+
+#define MANIFEST_FILE        "MANIFEST"        /* the file name of a manifest */
+#define MANIFEST_TMP_EXT     ".tmp"            /* extension of a manifest being rewritten */
+#define MANIFEST_LOG_NUMBER  1                 /* the number the manifest log is written with */
+#define MANIFEST_MAX_SIZE    (4 * 1024 * 1024) /* bytes a manifest grows to before a rewrite */
+#define MANIFEST_HEADER_SIZE 24                /* encoded size of the counts and counters */
+
+/*
+ * manifest_table_t
+ * an sstable as the manifest records it
+ * @param name the file name of the sstable
+ * @param level the level of the LSM tree the sstable belongs to
+ * @param sequence the sequence number of the sstable, higher is newer
+ * @param file_number the number the sstable file is named with, 0 if it has none
+ * @param num_entries the number of key-value pairs in the sstable
+ * @param size the size of the sstable in bytes
+ * @param num_tombstones the number of tombstones in the sstable
+ * @param num_ttl the number of entries with a ttl in the sstable
+ * @param min_ttl the earliest ttl in the sstable, 0 if no entry has one
+ * @param max_ttl the latest ttl in the sstable, 0 if no entry has one
+ * @param min_key the smallest key in the sstable, NULL if unknown
+ * @param min_key_size the size of the smallest key
+ * @param max_key the largest key in the sstable, NULL if unknown
+ * @param max_key_size the size of the largest key
+ */
+typedef struct
+{
+    char* name;              /* the file name of the sstable */
+    uint32_t level;          /* the level of the LSM tree the sstable belongs to */
+    uint64_t sequence;       /* the sequence number of the sstable, higher is newer */
+    uint64_t file_number;    /* the number the sstable file is named with, 0 if it has none */
+    uint64_t num_entries;    /* the number of key-value pairs in the sstable */
+    uint64_t size;           /* the size of the sstable in bytes */
+    uint64_t num_tombstones; /* the number of tombstones in the sstable */
+    uint64_t num_ttl;        /* the number of entries with a ttl in the sstable */
+    int64_t min_ttl;         /* the earliest ttl in the sstable, 0 if no entry has one */
+    int64_t max_ttl;         /* the latest ttl in the sstable, 0 if no entry has one */
+    uint8_t* min_key;        /* the smallest key in the sstable, NULL if unknown */
+    uint32_t min_key_size;   /* the size of the smallest key */
+    uint8_t* max_key;        /* the largest key in the sstable, NULL if unknown */
+    uint32_t max_key_size;   /* the size of the largest key */
+} manifest_table_t;
+
+/*
+ * manifest_edit_t
+ * a change to the live sstables, applied whole
+ * @param added the sstables added
+ * @param num_added the number of sstables added
+ * @param removed the file names of the sstables removed
+ * @param num_removed the number of sstables removed
+ * @param next_file_number the next file number to hand out, 0 if unchanged
+ * @param next_sequence the next sequence number to hand out, 0 if unchanged
+ */
+typedef struct
+{
+    manifest_table_t* added;   /* the sstables added */
+    uint32_t num_added;        /* the number of sstables added */
+    char** removed;            /* the file names of the sstables removed */
+    uint32_t num_removed;      /* the number of sstables removed */
+    uint64_t next_file_number; /* the next file number to hand out, 0 if unchanged */
+    uint64_t next_sequence;    /* the next sequence number to hand out, 0 if unchanged */
+} manifest_edit_t;
+
+/*
+ * manifest_t
+ * the manifest of a column family
+ * @param dir the directory of the column family
+ * @param path the path of the manifest
+ * @param log the log edits are appended to
+ * @param tables the live sstables, in the order they were added
+ * @param num_tables the number of live sstables
+ * @param tables_capacity the capacity of the tables array
+ * @param next_file_number the largest next file number an edit recorded, 0 if none did
+ * @param next_sequence the largest next sequence number an edit recorded, 0 if none did
+ * @param stale whether the live sstables missed an edit the log has, they are not rewritten then
+ */
+typedef struct
+{
+    char* dir;                 /* the directory of the column family */
+    char* path;                /* the path of the manifest */
+    log_t* log;                /* the log edits are appended to */
+    manifest_table_t* tables;  /* the live sstables, in the order they were added */
+    uint32_t num_tables;       /* the number of live sstables */
+    uint32_t tables_capacity;  /* the capacity of the tables array */
+    uint64_t next_file_number; /* the largest next file number an edit recorded */
+    uint64_t next_sequence;    /* the largest next sequence number an edit recorded */
+    bool stale;                /* whether the live sstables missed an edit the log has */
+} manifest_t;
+
+/* Manifest function prototypes */
+
+/*
+ * manifest_exists
+ * checks whether a directory has a manifest
+ * @param dir the directory
+ * @return true if the directory has a manifest, false otherwise
+ */
+bool manifest_exists(const char* dir);
+
+/*
+ * manifest_open
+ * opens the manifest of a directory, creating an empty one if there is none.  the edits are
+ * replayed into the live sstables, up to a torn or corrupt entry, and the live sstables are
+ * rewritten to a new manifest that edits are appended to
+ * @param dir the directory
+ * @param manifest the manifest
+ * @return 0 if the manifest was opened, -1 otherwise
+ */
+int manifest_open(const char* dir, manifest_t** manifest);
+
+/*
+ * manifest_append
+ * appends an edit to the manifest and syncs it, then applies it to the live sstables and rewrites
+ * the manifest if it has grown past MANIFEST_MAX_SIZE.  once the edit is synced the append
+ * succeeds, a failure to apply it or to rewrite is left for the next open or append.  appends
+ * must not run at the same time as each other
+ * @param manifest the manifest
+ * @param edit the edit
+ * @return 0 if the edit is durable in the manifest, -1 if it is not in it
+ */
+int manifest_append(manifest_t* manifest, const manifest_edit_t* edit);
+
+/*
+ * manifest_rewrite
+ * writes the live sstables and the counters as a single edit to a new manifest and puts it in
+ * place of the current one.  once it is renamed in place edits are appended to it, even if the
+ * directory could not be synced
+ * @param manifest the manifest
+ * @return 0 if the manifest was rewritten and the rename is durable, -1 otherwise
+ */
+int manifest_rewrite(manifest_t* manifest);
+
+/*
+ * manifest_close
+ * closes the manifest and frees the memory
+ * @param manifest the manifest
+ * @return 0 if the manifest was closed, -1 otherwise
+ */
+int manifest_close(manifest_t* manifest);
+
+/*
+ * manifest_apply_edit
+ * applies an edit to the live sstables and counters, a removed sstable that is not live is
+ * skipped and a counter only moves forward
+ * @param manifest the manifest
+ * @param edit the edit
+ * @return 0 if the edit was applied, -1 otherwise
+ */
+int manifest_apply_edit(manifest_t* manifest, const manifest_edit_t* edit);
+
+/*
+ * manifest_find
+ * finds a live sstable by its file name
+ * @param manifest the manifest
+ * @param name the file name of the sstable
+ * @return the index of the sstable, -1 if it is not live
+ */
+int manifest_find(manifest_t* manifest, const char* name);
+
+/*
+ * manifest_edit_size
+ * returns the size of an encoded edit
+ * @param edit the edit
+ * @return the size of the encoded edit
+ */
+size_t manifest_edit_size(const manifest_edit_t* edit);
+
+/*
+ * manifest_encode_edit
+ * encodes an edit into a buffer of manifest_edit_size bytes
+ * @param edit the edit
+ * @param buffer the buffer
+ */
+void manifest_encode_edit(const manifest_edit_t* edit, uint8_t* buffer);
+
+/*
+ * manifest_decode_edit
+ * decodes an edit, the names and keys point into the buffer
+ * @param buffer the encoded edit
+ * @param size the size of the encoded edit
+ * @param edit the edit, freed with manifest_free_edit
+ * @return 0 if the edit was decoded, -1 if it is malformed
+ */
+int manifest_decode_edit(const uint8_t* buffer, size_t size, manifest_edit_t** edit);
+
+/*
+ * manifest_free_edit
+ * frees a decoded edit, what it points into is left alone
+ * @param edit the edit
+ */
+void manifest_free_edit(manifest_edit_t* edit);
+
+/*
+ * manifest_free_table
+ * frees the name and the keys of a live sstable
+ * @param table the sstable
+ */
+void manifest_free_table(manifest_table_t* table);
+
+/*
+ * manifest_sync_dir
+ * syncs a directory so the files renamed into it are durable
+ * @param dir the directory
+ * @return 0 if the directory was synced, -1 otherwise
+ */
+int manifest_sync_dir(const char* dir);
+
+#endif /* MANIFEST_H */
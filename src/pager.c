@@ -67,9 +67,13 @@ int pager_open(const char* filename, pager_t** p)
 
     /* set the number of pages */
     (*p)->num_pages = page_count;
+    (*p)->fd = fileno((*p)->file);
+    (*p)->immutable = false;
+    (*p)->map = NULL;
+    (*p)->map_size = 0;
 
-    /* allocate memory for the page locks */
-    (*p)->page_locks = malloc(sizeof(pthread_rwlock_t) * page_count);
+    /* allocate memory for the page locks, a fixed number of them for any file size */
+    (*p)->page_locks = malloc(sizeof(pthread_rwlock_t) * PAGER_LOCK_STRIPES);
     if ((*p)->page_locks == NULL)
     {
         pthread_rwlock_destroy(&(*p)->file_lock);
@@ -80,7 +84,7 @@ int pager_open(const char* filename, pager_t** p)
     }
 
     /* Initialize the page locks */
-    for (unsigned int i = 0; i < page_count; i++)
+    for (unsigned int i = 0; i < PAGER_LOCK_STRIPES; i++)
     {
         if (pthread_rwlock_init(&(*p)->page_locks[i], NULL) != 0)
         {
@@ -95,46 +99,39 @@ int pager_open(const char* filename, pager_t** p)
         }
     }
 
-    /* initialize the sync mutex */
-    if (pthread_mutex_init(&(*p)->sync_mutex, NULL) != 0)
-    {
-        for (unsigned int i = 0; i < page_count; i++) pthread_rwlock_destroy(&(*p)->page_locks[i]);
+    return 0;
+}
 
-        free((*p)->page_locks);
-        pthread_rwlock_destroy(&(*p)->file_lock);
-        free((*p)->filename);
-        fclose((*p)->file);
+int pager_open_immutable(const char* filename, pager_t** p)
+{
+    if (filename == NULL || p == NULL) return -1;
+
+    *p = calloc(1, sizeof(pager_t));
+    if (*p == NULL) return -1;
+
+    /* the file is only read from, the stream is kept for the size and the cursor functions */
+    (*p)->file = fopen(filename, "rb");
+    if ((*p)->file == NULL)
+    {
         free(*p);
         return -1;
     }
 
-    /* initialize the sync condition variable */
-    if (pthread_cond_init(&(*p)->sync_cond, NULL) != 0)
+    (*p)->filename = strdup(filename);
+    if ((*p)->filename == NULL || pthread_rwlock_init(&(*p)->file_lock, NULL) != 0)
     {
-        pthread_mutex_destroy(&(*p)->sync_mutex);
-        for (unsigned int i = 0; i < page_count; i++) pthread_rwlock_destroy(&(*p)->page_locks[i]);
-        free((*p)->page_locks);
-        pthread_rwlock_destroy(&(*p)->file_lock);
         free((*p)->filename);
         fclose((*p)->file);
         free(*p);
         return -1;
     }
 
-    /* set the write count to 0 */
-    (*p)->write_count = 0;
+    (*p)->fd = fileno((*p)->file);
+    (*p)->immutable = true;
+    (*p)->page_locks = NULL; /* no page is ever written, so no page is locked */
 
-    /* set the stop sync thread flag to false */
-    (*p)->stop_sync_thread = false;
-
-    /* start the sync thread */
-    if (pthread_create(&(*p)->sync_thread, NULL, pager_sync_thread, *p) != 0)
+    if (pager_pages_count(*p, &(*p)->num_pages) == -1)
     {
-        pthread_cond_destroy(&(*p)->sync_cond);
-        pthread_mutex_destroy(&(*p)->sync_mutex);
-        for (unsigned int i = 0; i < page_count; i++) pthread_rwlock_destroy(&(*p)->page_locks[i]);
-
-        free((*p)->page_locks);
         pthread_rwlock_destroy(&(*p)->file_lock);
         free((*p)->filename);
         fclose((*p)->file);
@@ -145,11 +142,125 @@ int pager_open(const char* filename, pager_t** p)
     return 0;
 }
 
+int pager_seal(pager_t* p)
+{
+    if (p == NULL) return -1;
+    if (p->immutable) return 0;
+
+    /* what is still buffered in the stream must be in the file before it is read with pread */
+    if (fflush(p->file) != 0) return -1;
+
+    for (unsigned int i = 0; i < PAGER_LOCK_STRIPES; i++) pthread_rwlock_destroy(&p->page_locks[i]);
+    free(p->page_locks);
+    p->page_locks = NULL;
+
+    p->immutable = true;
+
+    return 0;
+}
+
+pthread_rwlock_t* pager_page_lock(pager_t* p, long page_number)
+{
+    return &p->page_locks[(size_t)page_number % PAGER_LOCK_STRIPES];
+}
+
+int pager_map(pager_t* p)
+{
+    if (p == NULL || !p->immutable) return -1;
+    if (p->map != NULL) return 0;
+
+    size_t size = 0;
+    if (pager_size(p, &size) == -1 || size == 0) return -1;
+
+    void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, p->fd, 0);
+    if (map == MAP_FAILED) return -1;
+
+    /* point reads touch a block here and there, readahead would only evict what is cached */
+    (void)madvise(map, size, MADV_RANDOM);
+
+    p->map = map;
+    p->map_size = size;
+
+    return 0;
+}
+
+int pager_advise(pager_t* p, int advice)
+{
+    if (p == NULL) return -1;
+    if (p->map == NULL) return 0;
+
+    return madvise(p->map, p->map_size, advice) == 0 ? 0 : -1;
+}
+
+int pager_view(pager_t* p, unsigned int start_page_number, pager_view_t* view)
+{
+    if (p == NULL || p->map == NULL || view == NULL) return -1;
+
+    size_t full_pages = p->map_size / PAGE_SIZE;
+    long page_number = start_page_number;
+
+    /* we only follow the headers, nothing is copied */
+    while ((size_t)page_number < full_pages)
+    {
+        const uint8_t* page = p->map + page_number * PAGE_SIZE;
+
+        long next_page_number;
+        memcpy(&next_page_number, page, sizeof(next_page_number));
+
+        if (next_page_number == -1)
+        {
+            size_t len;
+            memcpy(&len, page + sizeof(long), sizeof(len));
+
+            /* the length must fit in the pages we walked */
+            if (len > (size_t)(page_number - start_page_number + 1) * PAGE_BODY) return -1;
+
+            view->pages = p->map + (size_t)start_page_number * PAGE_SIZE;
+            view->len = len;
+            return 0;
+        }
+
+        /* an entry whose pages are not in order is read the long way */
+        if (next_page_number != page_number + 1) return -1;
+
+        page_number = next_page_number;
+    }
+
+    return -1;
+}
+
+void pager_view_copy(const pager_view_t* view, size_t offset, uint8_t* buffer, size_t len)
+{
+    while (len > 0)
+    {
+        size_t body_offset = offset % PAGE_BODY;
+        size_t chunk = PAGE_BODY - body_offset;
+        if (chunk > len) chunk = len;
+
+        memcpy(buffer, view->pages + (offset / PAGE_BODY) * PAGE_SIZE + PAGE_HEADER + body_offset,
+               chunk);
+
+        buffer += chunk;
+        offset += chunk;
+        len -= chunk;
+    }
+}
+
+const uint8_t* pager_view_ptr(const pager_view_t* view, size_t offset, size_t len)
+{
+    if (len > 0 && offset / PAGE_BODY != (offset + len - 1) / PAGE_BODY) return NULL;
+
+    return view->pages + (offset / PAGE_BODY) * PAGE_SIZE + PAGE_HEADER + offset % PAGE_BODY;
+}
+
 int pager_close(pager_t* p)
 {
     /* we check if the pager is NULL */
     if (p == NULL) return -1;
 
+    /* we unmap the file before we close it */
+    if (p->map != NULL) (void)munmap(p->map, p->map_size);
+
     /* we close the file */
     if (fclose(p->file) != 0) return -1;
 
@@ -159,31 +270,14 @@ int pager_close(pager_t* p)
     /* we destroy the file lock */
     if (pthread_rwlock_destroy(&p->file_lock) != 0) return -1;
 
-    /* we destroy the page locks */
-    for (unsigned int i = 0; i < p->num_pages; i++)
-        if (pthread_rwlock_destroy(&p->page_locks[i]) != 0) return -1;
+    /* we destroy the page locks, an immutable file has none */
+    if (p->page_locks != NULL)
+        for (unsigned int i = 0; i < PAGER_LOCK_STRIPES; i++)
+            if (pthread_rwlock_destroy(&p->page_locks[i]) != 0) return -1;
 
     /* we free the page locks */
     free(p->page_locks);
 
-    /* we set the stop sync thread flag to true */
-    p->stop_sync_thread = true;
-
-    /* we join the sync thread */
-    if (pthread_join(p->sync_thread, NULL) != 0) return -1;
-
-    /* we destroy the sync mutex */
-    if (pthread_mutex_destroy(&p->sync_mutex) != 0)
-    {
-        return -1;
-    }
-
-    /* we destroy the sync condition variable */
-    if (pthread_cond_destroy(&p->sync_cond) != 0)
-    {
-        return -1;
-    }
-
     /* we free the pager */
     free(p);
 
@@ -194,41 +288,23 @@ int pager_close(pager_t* p)
 
 int pager_write(pager_t* p, uint8_t* data, size_t data_len, unsigned int* init_page_number)
 {
-    if (!p || !p->file || !p->page_locks || !data || data_len == 0) return -1;
+    if (!p || !p->file || p->immutable || !data || data_len == 0) return -1;
 
     size_t pages_needed = (data_len + PAGE_BODY - 1) / PAGE_BODY;
     size_t remaining_data = data_len;
     uint8_t buffer[PAGE_SIZE];
     size_t offset = 0;
 
+    pthread_rwlock_wrlock(&p->file_lock); /* lock the file for writing */
+
+    /* we read the number of pages under the file lock as a truncate can change it */
     long page_number = (long)p->num_pages; /* start from the current number of pages */
     long initial_page_number = page_number;
 
-    pthread_rwlock_wrlock(&p->file_lock); /* lock the file for writing */
-
     for (size_t i = 0; i < pages_needed; ++i)
     {
-        if (page_number >= (long)p->num_pages)
-        {
-            /* allocate more locks if needed */
-            pthread_rwlock_t* new_locks =
-                realloc(p->page_locks, (p->num_pages + 1) * sizeof(pthread_rwlock_t));
-            if (new_locks == NULL)
-            {
-                pthread_rwlock_unlock(&p->file_lock);
-                return -1;
-            }
-
-            p->page_locks = new_locks;
-            if (pthread_rwlock_init(&p->page_locks[p->num_pages], NULL) != 0)
-            {
-                pthread_rwlock_unlock(&p->file_lock);
-
-                return -1;
-            }
-
-            p->num_pages++;
-        }
+        /* a new page needs no lock of its own, it shares one of the stripes */
+        if (page_number >= (long)p->num_pages) p->num_pages++;
 
         size_t chunk_size = remaining_data > PAGE_BODY ? PAGE_BODY : remaining_data;
         memset(buffer, 0, PAGE_SIZE);
@@ -259,37 +335,168 @@ int pager_write(pager_t* p, uint8_t* data, size_t data_len, unsigned int* init_p
         offset += chunk_size;
         remaining_data -= chunk_size;
 
-        pthread_rwlock_wrlock(&p->page_locks[page_number]);
+        pthread_rwlock_wrlock(pager_page_lock(p, page_number));
         if (fseek(p->file, page_number * PAGE_SIZE, SEEK_SET) != 0 ||
             fwrite(buffer, 1, PAGE_SIZE, p->file) != PAGE_SIZE)
         {
-            pthread_rwlock_unlock(&p->page_locks[page_number]);
+            pthread_rwlock_unlock(pager_page_lock(p, page_number));
             pthread_rwlock_unlock(&p->file_lock);
 
             return -1;
         }
-        pthread_rwlock_unlock(&p->page_locks[page_number]);
+        pthread_rwlock_unlock(pager_page_lock(p, page_number));
 
         page_number++;
     }
 
-    pthread_mutex_lock(&p->sync_mutex);
-    p->write_count++;
+    pthread_rwlock_unlock(&p->file_lock); /* unlock the file */
+
+    *init_page_number = initial_page_number; /* set the initial page number */
+
+    return 0;
+}
+
+int pager_write_batch(pager_t* p, uint8_t** data, size_t* data_len, size_t count,
+                      unsigned int* init_page_numbers, bool sync)
+{
+    if (!p || !p->file || p->immutable || !data || !data_len || !init_page_numbers || count == 0)
+        return -1;
+
+    size_t total_pages = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (data[i] == NULL || data_len[i] == 0) return -1;
+
+        total_pages += (data_len[i] + PAGE_BODY - 1) / PAGE_BODY;
+    }
+
+    /* a header for every page and a page body of zeros we pad the last page of each entry with */
+    uint8_t* headers = calloc(total_pages * PAGE_HEADER + PAGE_BODY, 1);
+    if (headers == NULL) return -1;
+
+    uint8_t* padding = headers + total_pages * PAGE_HEADER;
+
+    /* header, data and padding for every page, the data is not copied */
+    struct iovec* iov = malloc(total_pages * 3 * sizeof(struct iovec));
+    if (iov == NULL)
+    {
+        free(headers);
+        return -1;
+    }
+
+    pthread_rwlock_wrlock(&p->file_lock); /* lock the file for writing */
+
+    /* we write through the file descriptor, anything still buffered in the file goes first */
+    if (fflush(p->file) != 0)
+    {
+        pthread_rwlock_unlock(&p->file_lock);
+        free(iov);
+        free(headers);
+        return -1;
+    }
+
+    long first_page_number = (long)p->num_pages;
+    long page_number = first_page_number;
+    int iovcnt = 0;
 
-    if (p->write_count >= SYNC_INTERVAL) pthread_cond_signal(&p->sync_cond);
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t pages_needed = (data_len[i] + PAGE_BODY - 1) / PAGE_BODY;
+        size_t offset = 0;
+
+        init_page_numbers[i] = (unsigned int)page_number;
 
-    pthread_mutex_unlock(&p->sync_mutex);
+        for (size_t j = 0; j < pages_needed; j++)
+        {
+            uint8_t* header = headers + (page_number - first_page_number) * PAGE_HEADER;
+
+            if (j < pages_needed - 1)
+            {
+                long next_page_number = page_number + 1;
+                memcpy(header, &next_page_number, sizeof(next_page_number));
+            }
+            else
+            {
+                long no_overflow = -1;
+                memcpy(header, &no_overflow, sizeof(no_overflow));
+                /* include the actual data length in the last page header */
+                memcpy(header + sizeof(long), &data_len[i], sizeof(data_len[i]));
+            }
+
+            size_t chunk_size = data_len[i] - offset > PAGE_BODY ? PAGE_BODY : data_len[i] - offset;
+
+            iov[iovcnt].iov_base = header;
+            iov[iovcnt++].iov_len = PAGE_HEADER;
+            iov[iovcnt].iov_base = data[i] + offset;
+            iov[iovcnt++].iov_len = chunk_size;
+
+            if (chunk_size < PAGE_BODY)
+            {
+                iov[iovcnt].iov_base = padding;
+                iov[iovcnt++].iov_len = PAGE_BODY - chunk_size;
+            }
+
+            offset += chunk_size;
+            page_number++;
+        }
+    }
+
+    /* the file is opened for appending so the pages land at its end */
+    if (pager_writev_all(fileno(p->file), iov, iovcnt) == -1 ||
+        (sync && fdatasync(fileno(p->file)) != 0))
+    {
+        pthread_rwlock_unlock(&p->file_lock);
+        free(iov);
+        free(headers);
+        return -1;
+    }
+
+    p->num_pages += total_pages;
 
     pthread_rwlock_unlock(&p->file_lock); /* unlock the file */
 
-    *init_page_number = initial_page_number; /* set the initial page number */
+    free(iov);
+    free(headers);
+
+    return 0;
+}
+
+int pager_writev_all(int fd, struct iovec* iov, int iovcnt)
+{
+    while (iovcnt > 0)
+    {
+        ssize_t written = writev(fd, iov, iovcnt > IOV_MAX ? IOV_MAX : iovcnt);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+
+            return -1;
+        }
+
+        /* we skip the buffers written in full and move into a partially written one */
+        while (iovcnt > 0 && (size_t)written >= iov->iov_len)
+        {
+            written -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (uint8_t*)iov->iov_base + written;
+            iov->iov_len -= (size_t)written;
+        }
+    }
 
     return 0;
 }
 
 int pager_read(pager_t* p, unsigned int start_page_number, uint8_t** buffer, size_t* buffer_len)
 {
-    if (!p || !p->file || !p->page_locks || !buffer || !buffer_len) return -1;
+    if (!p || !p->file || !buffer || !buffer_len) return -1;
+
+    /* a file that is not written to anymore is read without locks */
+    if (p->immutable) return pager_read_immutable(p, start_page_number, buffer, buffer_len);
 
     size_t offset = 0;
     uint8_t page_buffer[PAGE_SIZE];
@@ -298,20 +505,20 @@ int pager_read(pager_t* p, unsigned int start_page_number, uint8_t** buffer, siz
 
     while (1)
     {
-        pthread_rwlock_rdlock(&p->page_locks[page_number]);
+        pthread_rwlock_rdlock(pager_page_lock(p, page_number));
         if (fseek(p->file, page_number * PAGE_SIZE, SEEK_SET) != 0)
         {
-            pthread_rwlock_unlock(&p->page_locks[page_number]);
+            pthread_rwlock_unlock(pager_page_lock(p, page_number));
             return -1;
         }
 
         if (fread(page_buffer, 1, PAGE_SIZE, p->file) != PAGE_SIZE)
         {
-            pthread_rwlock_unlock(&p->page_locks[page_number]);
+            pthread_rwlock_unlock(pager_page_lock(p, page_number));
             return -1;
         }
 
-        pthread_rwlock_unlock(&p->page_locks[page_number]);
+        pthread_rwlock_unlock(pager_page_lock(p, page_number));
 
         long next_page_number;
         memcpy(&next_page_number, page_buffer, sizeof(next_page_number));
@@ -346,6 +553,136 @@ int pager_read(pager_t* p, unsigned int start_page_number, uint8_t** buffer, siz
     return 0;
 }
 
+int pager_read_immutable(pager_t* p, unsigned int start_page_number, uint8_t** buffer,
+                         size_t* buffer_len)
+{
+    /* the pages of an entry are written one after the other, so the pages read with the one we
+     * need are usually the ones it overflows into */
+    uint8_t pages[PAGER_READ_PAGES * PAGE_SIZE];
+    long first_page = -1;
+    size_t num_read = 0;
+
+    size_t offset = 0;
+    long page_number = start_page_number;
+    size_t actual_data_len = 0;
+
+    /* a chain longer than the file loops back on itself, the file is corrupt */
+    for (size_t visited = 0; visited < p->num_pages; visited++)
+    {
+        if (page_number < 0 || (size_t)page_number >= p->num_pages) return -1;
+
+        const uint8_t* page_buffer;
+        if (p->map != NULL)
+        {
+            /* a mapped file is read in place, a torn page at its end is not read at all */
+            if ((size_t)(page_number + 1) * PAGE_SIZE > p->map_size) return -1;
+            page_buffer = p->map + page_number * PAGE_SIZE;
+        }
+        else
+        {
+            if (first_page == -1 || page_number < first_page ||
+                (size_t)(page_number - first_page) >= num_read)
+            {
+                size_t count = p->num_pages - (size_t)page_number;
+                if (count > PAGER_READ_PAGES) count = PAGER_READ_PAGES;
+
+                /* a torn page at the end of the file is left out of what was read */
+                ssize_t read =
+                    pager_pread(p->fd, pages, count * PAGE_SIZE, page_number * PAGE_SIZE);
+                if (read < PAGE_SIZE) return -1;
+
+                first_page = page_number;
+                num_read = (size_t)read / PAGE_SIZE;
+            }
+
+            page_buffer = pages + (page_number - first_page) * PAGE_SIZE;
+        }
+
+        long next_page_number;
+        memcpy(&next_page_number, page_buffer, sizeof(next_page_number));
+
+        uint8_t* new_buffer = realloc(*buffer, offset + PAGE_BODY);
+        if (new_buffer == NULL)
+        {
+            free(*buffer);
+            *buffer = NULL;
+            return -1;
+        }
+        *buffer = new_buffer;
+
+        memcpy(*buffer + offset, page_buffer + PAGE_HEADER, PAGE_BODY);
+        offset += PAGE_BODY;
+
+        if (next_page_number == -1)
+        {
+            /* the actual data length is in the header of the last page */
+            memcpy(&actual_data_len, page_buffer + sizeof(long), sizeof(actual_data_len));
+            if (actual_data_len > offset) return -1;
+
+            *buffer_len = actual_data_len;
+            return 0;
+        }
+
+        page_number = next_page_number;
+    }
+
+    return -1;
+}
+
+int pager_read_next_page(pager_t* p, long page_number, long* next_page_number)
+{
+    if (p->map != NULL)
+    {
+        if ((size_t)page_number * PAGE_SIZE + sizeof(*next_page_number) > p->map_size) return -1;
+        memcpy(next_page_number, p->map + page_number * PAGE_SIZE, sizeof(*next_page_number));
+        return 0;
+    }
+
+    /* an immutable file is read at the page without locks, the stream is left alone */
+    if (p->immutable)
+    {
+        return pager_pread(p->fd, (uint8_t*)next_page_number, sizeof(*next_page_number),
+                           page_number * PAGE_SIZE) == sizeof(*next_page_number)
+                   ? 0
+                   : -1;
+    }
+
+    uint8_t page_buffer[PAGE_SIZE];
+    pthread_rwlock_rdlock(pager_page_lock(p, page_number));
+    if (fseek(p->file, page_number * PAGE_SIZE, SEEK_SET) != 0 ||
+        fread(page_buffer, 1, PAGE_SIZE, p->file) != PAGE_SIZE)
+    {
+        pthread_rwlock_unlock(pager_page_lock(p, page_number));
+        return -1;
+    }
+    pthread_rwlock_unlock(pager_page_lock(p, page_number));
+
+    memcpy(next_page_number, page_buffer, sizeof(*next_page_number));
+
+    return 0;
+}
+
+ssize_t pager_pread(int fd, uint8_t* buffer, size_t size, off_t offset)
+{
+    size_t total = 0;
+    while (total < size)
+    {
+        ssize_t n = pread(fd, buffer + total, size - total, offset + (off_t)total);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+
+            return -1;
+        }
+
+        if (n == 0) break; /* the end of the file */
+
+        total += (size_t)n;
+    }
+
+    return (ssize_t)total;
+}
+
 int pager_cursor_init(pager_t* p, pager_cursor_t** cursor)
 {
     if (!p) return -1;
@@ -370,23 +707,10 @@ int pager_cursor_next(pager_cursor_t* cursor)
     while (cursor->page_number < (long)cursor->pager->num_pages - 1)
     {
         cursor->page_number++;
-        uint8_t page_buffer[PAGE_SIZE];
-        pthread_rwlock_rdlock(&cursor->pager->page_locks[cursor->page_number]);
-        if (fseek(cursor->pager->file, cursor->page_number * PAGE_SIZE, SEEK_SET) != 0)
-        {
-            pthread_rwlock_unlock(&cursor->pager->page_locks[cursor->page_number]);
-            return -1;
-        }
-
-        if (fread(page_buffer, 1, PAGE_SIZE, cursor->pager->file) != PAGE_SIZE)
-        {
-            pthread_rwlock_unlock(&cursor->pager->page_locks[cursor->page_number]);
-            return -1;
-        }
-        pthread_rwlock_unlock(&cursor->pager->page_locks[cursor->page_number]);
 
         long next_page_number;
-        memcpy(&next_page_number, page_buffer, sizeof(next_page_number));
+        if (pager_read_next_page(cursor->pager, cursor->page_number, &next_page_number) == -1)
+            return -1;
 
         if (next_page_number == -1) return 0; /* found a non-overflow page */
     }
@@ -401,23 +725,10 @@ int pager_cursor_prev(pager_cursor_t* cursor)
     while (cursor->page_number > 0)
     {
         cursor->page_number--;
-        uint8_t page_buffer[PAGE_SIZE];
-        pthread_rwlock_rdlock(&cursor->pager->page_locks[cursor->page_number]);
-        if (fseek(cursor->pager->file, cursor->page_number * PAGE_SIZE, SEEK_SET) != 0)
-        {
-            pthread_rwlock_unlock(&cursor->pager->page_locks[cursor->page_number]);
-            return -1;
-        }
-        if (fread(page_buffer, 1, PAGE_SIZE, cursor->pager->file) != PAGE_SIZE)
-        {
-            pthread_rwlock_unlock(&cursor->pager->page_locks[cursor->page_number]);
-            return -1;
-        }
-
-        pthread_rwlock_unlock(&cursor->pager->page_locks[cursor->page_number]);
 
         long next_page_number;
-        memcpy(&next_page_number, page_buffer, sizeof(next_page_number));
+        if (pager_read_next_page(cursor->pager, cursor->page_number, &next_page_number) == -1)
+            return -1;
 
         if (next_page_number == -1) return 0; /* found a non-overflow page */
     }
@@ -451,9 +762,22 @@ void pager_cursor_free(pager_cursor_t* cursor)
 
 int pager_truncate(pager_t* p, size_t size)
 {
-    if (!p || !p->file) return -1;
+    if (!p || !p->file || p->immutable) return -1;
 
-    if (ftruncate(fileno(p->file), (long)size) != 0) return -1;
+    pthread_rwlock_wrlock(&p->file_lock);
+
+    /* we flush buffered writes first, otherwise they land past the new end of file */
+    if (fflush(p->file) != 0 || ftruncate(fileno(p->file), (long)size) != 0)
+    {
+        pthread_rwlock_unlock(&p->file_lock);
+        return -1;
+    }
+
+    /* new pages are appended after the truncated end */
+    if ((size + PAGE_SIZE - 1) / PAGE_SIZE < p->num_pages)
+        p->num_pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    pthread_rwlock_unlock(&p->file_lock);
 
     return 0;
 }
@@ -494,34 +818,14 @@ void sleep_ms(int milliseconds)
 #endif
 }
 
-void* pager_sync_thread(void* arg)
+int pager_sync(pager_t* p)
 {
-    pager_t* p = arg;
-    struct timespec ts;
-    while (1)
-    {
-        if (clock_gettime(CLOCK_REALTIME, &ts) != 0) break;
-
-        ts.tv_sec += SYNC_ESCALATION;
-
-        pthread_mutex_lock(&p->sync_mutex);
-        while (p->write_count < SYNC_INTERVAL && !p->stop_sync_thread)
-        {
-            int wait_result = pthread_cond_timedwait(&p->sync_cond, &p->sync_mutex, &ts);
-            if (wait_result == ETIMEDOUT) break;
-        }
-
-        if (p->stop_sync_thread)
-        {
-            pthread_mutex_unlock(&p->sync_mutex);
-            break;
-        }
+    if (p == NULL) return -1;
 
-        p->write_count = 0;
-        pthread_mutex_unlock(&p->sync_mutex);
+    /* the batch writes go around the stream, the single page writes are flushed out of it */
+    pthread_rwlock_wrlock(&p->file_lock);
+    int result = fflush(p->file) == 0 && fdatasync(fileno(p->file)) == 0 ? 0 : -1;
+    pthread_rwlock_unlock(&p->file_lock);
 
-        fflush(p->file);
-        fsync(fileno(p->file));
-    }
-    return NULL;
+    return result;
 }
\ No newline at end of file
@@ -19,39 +19,56 @@
 #ifndef PAGER_H
 #define PAGER_H
 
-#define PAGE_HEADER   16L  /* The page header is used to store an overflow page number */
-#define PAGE_BODY     1024 /* The page body is used to store the actual data */
-#define PAGE_SIZE     (PAGE_HEADER + PAGE_BODY) /* The page size is the sum of the header and body */
-#define SYNC_INTERVAL 24576                     /* Sync every 24576 writes */
-#define SYNC_ESCALATION                                                               \
-    0.128 /* We sync when we hit sync escalation (128ms) or when we hit sync interval \
-           */
+#define PAGE_HEADER        16L  /* The page header is used to store an overflow page number */
+#define PAGE_BODY          1024 /* The page body is used to store the actual data */
+#define PAGE_SIZE          (PAGE_HEADER + PAGE_BODY) /* The page size is the header and body */
+#define PAGER_READ_PAGES   8  /* pages a read of an immutable file reads at once with one pread */
+#define PAGER_LOCK_STRIPES 64 /* the page locks of a mutable file, shared by the pages */
 
 #include <errno.h>
+#include <limits.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#ifndef IOV_MAX
+#define IOV_MAX 1024 /* the most buffers a single vectored write takes */
+#endif
+
 /* @TODO windows support */
 
+/*
+ * A pager is mutable while it is written to, its pages are read and written through the stdio
+ * stream under the file lock and a page lock.  There are PAGER_LOCK_STRIPES page locks however
+ * large the file grows, page n takes lock n % PAGER_LOCK_STRIPES, so opening a file and appending
+ * a page cost the same for any file size.
+ *
+ * A file that is complete is immutable, it is opened with pager_open_immutable or sealed with
+ * pager_seal once its writer is done.  Reads of an immutable file are positional preads on its
+ * file descriptor, they take no lock and share no file position, so any number of threads read it
+ * at once.  An immutable file can also be mapped with pager_map, its pages are then read straight
+ * from the page cache without a system call and a view of an entry decodes it in place.
+ */
+
 /*
  * pager_t
  * the pager struct is used to manage the file and pages
  * @param file the file the pager is assigned
  * @param filename the filename of the paged file
  * @param file_lock lock for the file (only one thread can write to file at a time)
- * @param page_locks page locks for each page
+ * @param page_locks the striped page locks of a mutable file, NULL for an immutable one
  * @param num_pages number of pages in file currently
- * @param sync_thread background sync thread
- * @param sync_mutex mutex for sync thread
- * @param sync_cond condition variable for sync thread
- * @param write_count number of writes since last sync
- * @param stop_sync_thread flag to stop the sync thread
+ * @param fd the file descriptor of the file, reads of an immutable file go through it
+ * @param immutable whether the file is complete and only read from
+ * @param map the read only mapping of an immutable file, NULL if it is not mapped
+ * @param map_size the size of the mapping in bytes
  */
 typedef struct
 {
@@ -59,15 +76,27 @@ typedef struct
     char* filename; /* the filename of the paged file */
     pthread_rwlock_t
         file_lock; /* lock for the file (only one thread can write to file at a time) */
-    pthread_rwlock_t* page_locks; /* page locks for each page */
+    pthread_rwlock_t* page_locks; /* the striped page locks, NULL for an immutable file */
     size_t num_pages;             /* number of pages in file currently */
-    pthread_t sync_thread;        /* background sync thread */
-    pthread_mutex_t sync_mutex;   /* mutex for sync thread */
-    pthread_cond_t sync_cond;     /* condition variable for sync thread */
-    size_t write_count;           /* number of writes since last sync */
-    bool stop_sync_thread;        /* flag to stop the sync thread */
+    int fd;                       /* the file descriptor of the file */
+    bool immutable;               /* whether the file is complete and only read from */
+    uint8_t* map;                 /* the mapping of an immutable file, NULL if not mapped */
+    size_t map_size;              /* the size of the mapping in bytes */
 } pager_t;
 
+/*
+ * pager_view_t
+ * an entry of a mapped file as it lies in the mapping.  the pages of an entry follow one another,
+ * its bytes are the bodies of those pages and byte n is in the body of page n / PAGE_BODY
+ * @param pages the first page of the entry in the mapping
+ * @param len the length of the entry in bytes
+ */
+typedef struct
+{
+    const uint8_t* pages; /* the first page of the entry in the mapping */
+    size_t len;           /* the length of the entry in bytes */
+} pager_view_t;
+
 /*
  * pager_cursor_t
  * the cursor struct is used to navigate the pages of the file
@@ -91,6 +120,84 @@ typedef struct
  */
 int pager_open(const char* filename, pager_t** p);
 
+/*
+ * pager_open_immutable
+ * opens a file that is no longer written to for reading only.  its pages are read with pread and
+ * no page locks are kept for it
+ * @param filename the filename of the file to open
+ * @param p the pager
+ * @return 0 if the pager was opened successfully, -1 otherwise
+ */
+int pager_open_immutable(const char* filename, pager_t** p);
+
+/*
+ * pager_seal
+ * makes the pager of a file its writer is done with immutable.  what was written is flushed, the
+ * page locks are freed and reads go through pread from then on, writes are refused.  nothing may
+ * read or write the pager while it is sealed
+ * @param p the pager to seal
+ * @return 0 if the pager was sealed, -1 otherwise
+ */
+int pager_seal(pager_t* p);
+
+/*
+ * pager_page_lock
+ * returns the striped lock of a page of a mutable file
+ * @param p the pager
+ * @param page_number the page number
+ * @return the lock the page takes
+ */
+pthread_rwlock_t* pager_page_lock(pager_t* p, long page_number);
+
+/*
+ * pager_map
+ * maps an immutable file for reading, its reads are served from the mapping from then on.  the
+ * mapping is advised for random access.  nothing may read the pager while it is mapped
+ * @param p the pager to map
+ * @return 0 if the file was mapped, -1 otherwise
+ */
+int pager_map(pager_t* p);
+
+/*
+ * pager_advise
+ * tells the kernel how the mapping of a file is going to be read, does nothing for a file that is
+ * not mapped
+ * @param p the pager
+ * @param advice MADV_RANDOM for point reads, MADV_SEQUENTIAL for reads in page order
+ * @return 0 if the advice was taken, -1 otherwise
+ */
+int pager_advise(pager_t* p, int advice);
+
+/*
+ * pager_view
+ * finds an entry in the mapping of a file without copying it
+ * @param p the pager, its file must be mapped
+ * @param start_page_number the page the entry starts at
+ * @param view the view of the entry
+ * @return 0 if the entry lies in pages that follow one another in the mapping, -1 otherwise
+ */
+int pager_view(pager_t* p, unsigned int start_page_number, pager_view_t* view);
+
+/*
+ * pager_view_copy
+ * copies bytes of an entry out of the mapping, across the page headers in between
+ * @param view the view of the entry
+ * @param offset the offset within the entry, the range must lie within it
+ * @param buffer the buffer to copy into
+ * @param len the number of bytes to copy
+ */
+void pager_view_copy(const pager_view_t* view, size_t offset, uint8_t* buffer, size_t len);
+
+/*
+ * pager_view_ptr
+ * returns where bytes of an entry are in the mapping if no page header splits them
+ * @param view the view of the entry
+ * @param offset the offset within the entry, the range must lie within it
+ * @param len the number of bytes
+ * @return the bytes in the mapping, NULL if they span two pages
+ */
+const uint8_t* pager_view_ptr(const pager_view_t* view, size_t offset, size_t len);
+
 /*
  * pager_close
  * closes the pager and frees the memory
@@ -111,6 +218,31 @@ int pager_close(pager_t* p);
  */
 int pager_write(pager_t* p, uint8_t* data, size_t data_len, unsigned int* init_page_number);
 
+/*
+ * pager_write_batch
+ * writes many entries to file with a single vectored write, each entry starts on a new page and
+ * overflows into next page(s) like with pager_write
+ * @param p the pager to write to
+ * @param data the data of each entry
+ * @param data_len the length of each entry
+ * @param count the number of entries
+ * @param init_page_numbers the page number each entry was written at
+ * @param sync whether the file is synced to disk before returning
+ * @return 0 if every entry was written (and synced), -1 otherwise
+ */
+int pager_write_batch(pager_t* p, uint8_t** data, size_t* data_len, size_t count,
+                      unsigned int* init_page_numbers, bool sync);
+
+/*
+ * pager_writev_all
+ * writes every buffer of an io vector to a file descriptor, retrying short writes
+ * @param fd the file descriptor
+ * @param iov the buffers to write, advanced in place as they are written
+ * @param iovcnt the number of buffers
+ * @return 0 if every buffer was written, -1 otherwise
+ */
+int pager_writev_all(int fd, struct iovec* iov, int iovcnt);
+
 /*
  * pager_read
  * reads a page from file will gather overflowed data from next page(s)
@@ -122,6 +254,41 @@ int pager_write(pager_t* p, uint8_t* data, size_t data_len, unsigned int* init_p
  */
 int pager_read(pager_t* p, unsigned int start_page_number, uint8_t** buffer, size_t* buffer_len);
 
+/*
+ * pager_read_immutable
+ * reads a page of an immutable file and the pages it overflows into with preads of up to
+ * PAGER_READ_PAGES pages at once, no lock is taken
+ * @param p the pager to read from
+ * @param start_page_number the page number to start reading from
+ * @param buffer the buffer to read into
+ * @param buffer_len the length of the buffer
+ * @return 0 if the read was successful, -1 otherwise
+ */
+int pager_read_immutable(pager_t* p, unsigned int start_page_number, uint8_t** buffer,
+                         size_t* buffer_len);
+
+/*
+ * pager_read_next_page
+ * reads the overflow page number from the header of a page
+ * @param p the pager to read from
+ * @param page_number the page number
+ * @param next_page_number the page the page overflows into, -1 if it does not
+ * @return 0 if the header was read, -1 otherwise
+ */
+int pager_read_next_page(pager_t* p, long page_number, long* next_page_number);
+
+/*
+ * pager_pread
+ * reads from a file descriptor at an offset until the size is read or the file ends, retrying
+ * short reads
+ * @param fd the file descriptor
+ * @param buffer the buffer to read into
+ * @param size the number of bytes to read
+ * @param offset the offset to read at
+ * @return the number of bytes read, -1 on error
+ */
+ssize_t pager_pread(int fd, uint8_t* buffer, size_t size, off_t offset);
+
 /*
  * pager_cursor_init
  * initializes a new cursor for the pager
@@ -172,11 +339,13 @@ time_t get_last_modified(const char* filename);
 void pager_cursor_free(pager_cursor_t* cursor);
 
 /*
- * pager_sync_thread
- * background thread to sync the file to disk
- * @param arg the pager to sync
+ * pager_sync
+ * flushes what was written to the file and syncs it to disk.  a paged file is synced by whoever
+ * wrote it once it is complete, nothing syncs it in the background
+ * @param p the pager to sync
+ * @return 0 if the file was synced successfully, -1 otherwise
  */
-void* pager_sync_thread(void* arg);
+int pager_sync(pager_t* p);
 
 /*
  * pager_truncate
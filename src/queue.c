@@ -102,6 +102,48 @@ int queue_enqueue(queue_t *q, void *data)
 }
 #endif
 
+#if defined(_WIN32) || defined(_WIN64)
+bool queue_enqueue_front(queue_t *q, void *data)
+{
+    /* allocate memory for the new node */
+    queue_node_t *new_node = malloc(sizeof(queue_node_t));
+    if (new_node == NULL) return false;
+
+    new_node->data = data;
+
+    /* lock the queue */
+    EnterCriticalSection(&q->lock);
+    new_node->next = q->head;
+    q->head = new_node;                      /* set the head */
+    if (q->tail == NULL) q->tail = new_node; /* set the tail */
+    q->size++;                               /* increment the size */
+    LeaveCriticalSection(&q->lock);          /* unlock the queue */
+
+    return true;
+}
+#elif __linux__ || defined(__unix__) || defined(__APPLE__)
+int queue_enqueue_front(queue_t *q, void *data)
+{
+    queue_node_t *new_node = malloc(sizeof(queue_node_t)); /* allocate memory for the new node */
+    if (new_node == NULL) return -1;                       /* check if successful */
+
+    new_node->data = data; /* set the data */
+
+    /* lock the queue */
+    pthread_rwlock_wrlock(&q->lock);
+    new_node->next = q->head; /* the old head comes after the new node */
+    q->head = new_node;
+
+    /* check if the queue was empty */
+    if (q->tail == NULL) q->tail = new_node;
+
+    q->size++;                       /* increment the size */
+    pthread_rwlock_unlock(&q->lock); /* unlock the queue */
+
+    return 0;
+}
+#endif
+
 #if defined(_WIN32) || defined(_WIN64)
 void *queue_dequeue(queue_t *q)
 {
@@ -82,6 +82,15 @@ queue_t *queue_new();
  */
 int queue_enqueue(queue_t *q, void *data);
 
+/*
+ * queue_enqueue_front
+ * adds data to front of queue
+ * @param q queue
+ * @param data data to add
+ * @return 0 if successful, -1 if not
+ */
+int queue_enqueue_front(queue_t *q, void *data);
+
 /*
  * queue_dequeue
  * removes data from front of queue
@@ -27,8 +27,9 @@
  */
 typedef enum
 {
-    OP_PUT,   /* a put operation into a column family */
-    OP_DELETE /* a delete operation from a column family */
+    OP_PUT,    /* a put operation into a column family */
+    OP_DELETE, /* a delete operation from a column family */
+    OP_BATCH   /* a batch of puts and deletes written to a column family at once */
 } OP_CODE;
 
 /*
@@ -59,6 +60,17 @@ typedef struct
  * @param max_level the max level of the column family
  * @param probability the probability of the column family
  * @param compressed the compressed status of the column family
+ * @param block_size the target size of an sstable data block, 0 for the default
+ * @param bloom_bits_per_key the number of sstable bloom filter bits per key, 0 for the default
+ * @param level_size_multiplier the size ratio between neighbouring levels, 0 for the default
+ * @param target_file_size the size at which compaction output is split, 0 for the default
+ * @param l0_compaction_trigger the number of level 0 sstables that triggers a background
+ * compaction, 0 for the default
+ * @param tombstone_ratio_trigger the percentage of tombstones in an sstable that triggers a
+ * background compaction, 0 for the default
+ * @param expired_ratio_trigger the percentage of expired pairs in an sstable that triggers a
+ * background compaction, 0 for the default
+ * @param concurrent_memtable whether the memtable takes puts without a list lock
  */
 typedef struct
 {
@@ -68,6 +80,14 @@ typedef struct
     float probability;       /* probability for the column family memtable */
     bool compressed; /* compressed flag for the column family; whether sstable data is compressed or
                         not */
+    uint32_t block_size;              /* target sstable data block size in bytes, 0 default */
+    uint32_t bloom_bits_per_key;      /* sstable bloom filter bits per key, 0 default */
+    uint32_t level_size_multiplier;   /* size ratio between neighbouring levels, 0 default */
+    uint32_t target_file_size;        /* size at which compaction output is split, 0 default */
+    uint32_t l0_compaction_trigger;   /* level 0 count that triggers compaction, 0 default */
+    uint32_t tombstone_ratio_trigger; /* tombstone percentage that triggers compaction, 0 default */
+    uint32_t expired_ratio_trigger;   /* expired percentage that triggers compaction, 0 default */
+    bool concurrent_memtable;         /* whether the memtable takes puts without a list lock */
 } column_family_config_t;
 
 /*
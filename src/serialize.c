@@ -225,6 +225,204 @@ int serialize_operation(const operation_t* op, uint8_t** buffer, size_t* encoded
     return 0;
 }
 
+int serialize_operation_parts(const operation_t* op, uint8_t* scratch, struct iovec* parts,
+                              size_t* encoded_size)
+{
+    if (!op || !op->kv || !op->kv->value || !op->column_family || !scratch || !parts ||
+        !encoded_size)
+        return -1;
+
+    /* the fixed size fields are laid out in the order they are written */
+    uint8_t* ptr = scratch;
+    memcpy(ptr, &op->op_code, sizeof(op->op_code));
+    ptr += sizeof(op->op_code);
+    memcpy(ptr, &op->kv->key_size, sizeof(op->kv->key_size));
+    ptr += sizeof(op->kv->key_size);
+    memcpy(ptr, &op->kv->value_size, sizeof(op->kv->value_size));
+    ptr += sizeof(op->kv->value_size);
+    memcpy(ptr, &op->kv->ttl, sizeof(op->kv->ttl));
+
+    /* op code and key size, key, value size, value, ttl and the column family name */
+    parts[0].iov_base = scratch;
+    parts[0].iov_len = sizeof(op->op_code) + sizeof(op->kv->key_size);
+    parts[1].iov_base = op->kv->key;
+    parts[1].iov_len = op->kv->key_size;
+    parts[2].iov_base = (uint8_t*)parts[0].iov_base + parts[0].iov_len;
+    parts[2].iov_len = sizeof(op->kv->value_size);
+    parts[3].iov_base = op->kv->value;
+    parts[3].iov_len = op->kv->value_size;
+    parts[4].iov_base = (uint8_t*)parts[2].iov_base + parts[2].iov_len;
+    parts[4].iov_len = sizeof(op->kv->ttl);
+    parts[5].iov_base = op->column_family;
+    parts[5].iov_len = strlen(op->column_family) + 1;
+
+    *encoded_size = 0;
+    for (int i = 0; i < SERIALIZE_OPERATION_PARTS; i++) *encoded_size += parts[i].iov_len;
+
+    return 0;
+}
+
+int serialize_compress_parts(const struct iovec* parts, size_t parts_count, uint8_t** buffer,
+                             size_t* encoded_size)
+{
+    if (!parts || !buffer || !encoded_size) return -1;
+
+    size_t total_size = 0;
+    for (size_t i = 0; i < parts_count; i++) total_size += parts[i].iov_len;
+
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+    if (!cctx) return -1;
+
+    /* the pledged size puts the content size in the frame header for deserialize_decompress */
+    size_t compressed_size = ZSTD_compressBound(total_size);
+    if (ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, 1)) ||
+        ZSTD_isError(ZSTD_CCtx_setPledgedSrcSize(cctx, total_size)))
+    {
+        ZSTD_freeCCtx(cctx);
+        return -1;
+    }
+
+    *buffer = (uint8_t*)malloc(compressed_size);
+    if (!*buffer)
+    {
+        ZSTD_freeCCtx(cctx);
+        return -1;
+    }
+
+    ZSTD_outBuffer out = {*buffer, compressed_size, 0};
+    size_t remaining = 0;
+    for (size_t i = 0; i <= parts_count; i++)
+    {
+        /* the frame is ended with an empty last input */
+        ZSTD_inBuffer in = {NULL, 0, 0};
+        if (i < parts_count) in = (ZSTD_inBuffer){parts[i].iov_base, parts[i].iov_len, 0};
+
+        ZSTD_EndDirective mode = i < parts_count ? ZSTD_e_continue : ZSTD_e_end;
+        do
+        {
+            remaining = ZSTD_compressStream2(cctx, &out, &in, mode);
+            if (ZSTD_isError(remaining))
+            {
+                free(*buffer);
+                ZSTD_freeCCtx(cctx);
+                return -1;
+            }
+        } while (in.pos < in.size || (mode == ZSTD_e_end && remaining != 0));
+    }
+
+    ZSTD_freeCCtx(cctx);
+    *encoded_size = out.pos;
+
+    return 0;
+}
+
+int deserialize_decompress(const uint8_t* buffer, size_t buffer_size, uint8_t** data,
+                           size_t* data_size)
+{
+    if (!buffer || !data || !data_size) return -1;
+
+    unsigned long long size = ZSTD_getFrameContentSize(buffer, buffer_size);
+    if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN) return -1;
+
+    /* an empty frame still gets a buffer so the caller can free it */
+    *data = (uint8_t*)malloc(size > 0 ? size : 1);
+    if (!*data) return -1;
+
+    size_t result = ZSTD_decompress(*data, size, buffer, buffer_size);
+    if (ZSTD_isError(result) || result != size)
+    {
+        free(*data);
+        *data = NULL;
+        return -1;
+    }
+
+    *data_size = size;
+
+    return 0;
+}
+
+int serialize_batch_header(uint32_t count, uint8_t* buffer)
+{
+    if (!buffer) return -1;
+
+    OP_CODE op_code = OP_BATCH;
+    memcpy(buffer, &op_code, sizeof(op_code));
+    memcpy(buffer + sizeof(op_code), &count, sizeof(count));
+
+    return 0;
+}
+
+int deserialize_batch_header(const uint8_t* buffer, size_t buffer_size, uint32_t* count)
+{
+    if (!buffer || !count || buffer_size < SERIALIZE_BATCH_HEADER_SIZE) return -1;
+
+    OP_CODE op_code;
+    memcpy(&op_code, buffer, sizeof(op_code));
+    if (op_code != OP_BATCH) return -1;
+
+    memcpy(count, buffer + sizeof(op_code), sizeof(*count));
+
+    return 0;
+}
+
+size_t serialize_batch_operation_size(const key_value_pair_t* kv)
+{
+    return sizeof(OP_CODE) + sizeof(kv->key_size) + kv->key_size + sizeof(kv->value_size) +
+           kv->value_size + sizeof(kv->ttl);
+}
+
+int serialize_batch_operation(OP_CODE op_code, const key_value_pair_t* kv, uint8_t* buffer)
+{
+    if (!kv || !kv->key || !kv->value || !buffer) return -1;
+
+    uint8_t* ptr = buffer;
+    memcpy(ptr, &op_code, sizeof(op_code));
+    ptr += sizeof(op_code);
+    memcpy(ptr, &kv->key_size, sizeof(kv->key_size));
+    ptr += sizeof(kv->key_size);
+    memcpy(ptr, kv->key, kv->key_size);
+    ptr += kv->key_size;
+    memcpy(ptr, &kv->value_size, sizeof(kv->value_size));
+    ptr += sizeof(kv->value_size);
+    memcpy(ptr, kv->value, kv->value_size);
+    ptr += kv->value_size;
+    memcpy(ptr, &kv->ttl, sizeof(kv->ttl));
+
+    return 0;
+}
+
+int deserialize_batch_operation(const uint8_t* buffer, size_t buffer_size, OP_CODE* op_code,
+                                key_value_pair_t* kv, size_t* encoded_size)
+{
+    if (!buffer || !op_code || !kv || !encoded_size) return -1;
+
+    /* every size is checked against what is left of the buffer before it is used */
+    const uint8_t* ptr = buffer;
+    const uint8_t* end = buffer + buffer_size;
+
+    if ((size_t)(end - ptr) < sizeof(*op_code) + sizeof(kv->key_size)) return -1;
+    memcpy(op_code, ptr, sizeof(*op_code));
+    ptr += sizeof(*op_code);
+    memcpy(&kv->key_size, ptr, sizeof(kv->key_size));
+    ptr += sizeof(kv->key_size);
+
+    if ((size_t)(end - ptr) < (size_t)kv->key_size + sizeof(kv->value_size)) return -1;
+    kv->key = (uint8_t*)ptr;
+    ptr += kv->key_size;
+    memcpy(&kv->value_size, ptr, sizeof(kv->value_size));
+    ptr += sizeof(kv->value_size);
+
+    if ((size_t)(end - ptr) < (size_t)kv->value_size + sizeof(kv->ttl)) return -1;
+    kv->value = (uint8_t*)ptr;
+    ptr += kv->value_size;
+    memcpy(&kv->ttl, ptr, sizeof(kv->ttl));
+    ptr += sizeof(kv->ttl);
+
+    *encoded_size = (size_t)(ptr - buffer);
+
+    return 0;
+}
+
 int deserialize_operation(const uint8_t* buffer, size_t buffer_size, operation_t** op,
                           bool decompress)
 {
@@ -301,7 +499,13 @@ int serialize_column_family_config(const column_family_config_t* config, uint8_t
 
     size_t name_size = strlen(config->name) + 1;
     size_t total_size = name_size + sizeof(config->flush_threshold) + sizeof(config->max_level) +
-                        sizeof(config->probability) + sizeof(config->compressed);
+                        sizeof(config->probability) + sizeof(config->compressed) +
+                        sizeof(config->block_size) + sizeof(config->bloom_bits_per_key) +
+                        sizeof(config->level_size_multiplier) + sizeof(config->target_file_size) +
+                        sizeof(config->l0_compaction_trigger) +
+                        sizeof(config->tombstone_ratio_trigger) +
+                        sizeof(config->expired_ratio_trigger) +
+                        sizeof(config->concurrent_memtable);
 
     uint8_t* temp_buffer = (uint8_t*)malloc(total_size);
     if (!temp_buffer) return -1;
@@ -316,6 +520,22 @@ int serialize_column_family_config(const column_family_config_t* config, uint8_t
     memcpy(ptr, &config->probability, sizeof(config->probability));
     ptr += sizeof(config->probability);
     memcpy(ptr, &config->compressed, sizeof(config->compressed));
+    ptr += sizeof(config->compressed);
+    memcpy(ptr, &config->block_size, sizeof(config->block_size));
+    ptr += sizeof(config->block_size);
+    memcpy(ptr, &config->bloom_bits_per_key, sizeof(config->bloom_bits_per_key));
+    ptr += sizeof(config->bloom_bits_per_key);
+    memcpy(ptr, &config->level_size_multiplier, sizeof(config->level_size_multiplier));
+    ptr += sizeof(config->level_size_multiplier);
+    memcpy(ptr, &config->target_file_size, sizeof(config->target_file_size));
+    ptr += sizeof(config->target_file_size);
+    memcpy(ptr, &config->l0_compaction_trigger, sizeof(config->l0_compaction_trigger));
+    ptr += sizeof(config->l0_compaction_trigger);
+    memcpy(ptr, &config->tombstone_ratio_trigger, sizeof(config->tombstone_ratio_trigger));
+    ptr += sizeof(config->tombstone_ratio_trigger);
+    memcpy(ptr, &config->expired_ratio_trigger, sizeof(config->expired_ratio_trigger));
+    ptr += sizeof(config->expired_ratio_trigger);
+    memcpy(ptr, &config->concurrent_memtable, sizeof(config->concurrent_memtable));
 
     *buffer = temp_buffer;
     *encoded_size = total_size;
@@ -348,6 +568,54 @@ int deserialize_column_family_config(const uint8_t* buffer, size_t buffer_size,
     memcpy(&(*config)->probability, ptr, sizeof((*config)->probability));
     ptr += sizeof((*config)->probability);
     memcpy(&(*config)->compressed, ptr, sizeof((*config)->compressed));
+    ptr += sizeof((*config)->compressed);
+
+    /* configs written before the block size was added end here */
+    (*config)->block_size = 0;
+    if ((size_t)(ptr - buffer) + sizeof((*config)->block_size) <= buffer_size)
+        memcpy(&(*config)->block_size, ptr, sizeof((*config)->block_size));
+    ptr += sizeof((*config)->block_size);
+
+    /* configs written before the bloom filter setting was added end here */
+    (*config)->bloom_bits_per_key = 0;
+    if ((size_t)(ptr - buffer) + sizeof((*config)->bloom_bits_per_key) <= buffer_size)
+        memcpy(&(*config)->bloom_bits_per_key, ptr, sizeof((*config)->bloom_bits_per_key));
+    ptr += sizeof((*config)->bloom_bits_per_key);
+
+    /* configs written before leveled compaction end here */
+    (*config)->level_size_multiplier = 0;
+    (*config)->target_file_size = 0;
+    if ((size_t)(ptr - buffer) + sizeof((*config)->level_size_multiplier) +
+            sizeof((*config)->target_file_size) <=
+        buffer_size)
+    {
+        memcpy(&(*config)->level_size_multiplier, ptr, sizeof((*config)->level_size_multiplier));
+        ptr += sizeof((*config)->level_size_multiplier);
+        memcpy(&(*config)->target_file_size, ptr, sizeof((*config)->target_file_size));
+        ptr += sizeof((*config)->target_file_size);
+    }
+
+    /* configs written before background compaction end here */
+    (*config)->l0_compaction_trigger = 0;
+    (*config)->tombstone_ratio_trigger = 0;
+    (*config)->expired_ratio_trigger = 0;
+    if ((size_t)(ptr - buffer) + sizeof((*config)->l0_compaction_trigger) +
+            sizeof((*config)->tombstone_ratio_trigger) + sizeof((*config)->expired_ratio_trigger) <=
+        buffer_size)
+    {
+        memcpy(&(*config)->l0_compaction_trigger, ptr, sizeof((*config)->l0_compaction_trigger));
+        ptr += sizeof((*config)->l0_compaction_trigger);
+        memcpy(&(*config)->tombstone_ratio_trigger, ptr,
+               sizeof((*config)->tombstone_ratio_trigger));
+        ptr += sizeof((*config)->tombstone_ratio_trigger);
+        memcpy(&(*config)->expired_ratio_trigger, ptr, sizeof((*config)->expired_ratio_trigger));
+        ptr += sizeof((*config)->expired_ratio_trigger);
+    }
+
+    /* configs written before the concurrent memtable end here */
+    (*config)->concurrent_memtable = false;
+    if ((size_t)(ptr - buffer) + sizeof((*config)->concurrent_memtable) <= buffer_size)
+        memcpy(&(*config)->concurrent_memtable, ptr, sizeof((*config)->concurrent_memtable));
 
     return 0;
 }
@@ -485,4 +753,101 @@ int deserialize_bloomfilter(const uint8_t* buffer, size_t buffer_size, bloomfilt
     if (decompress) free(temp_buffer);
     *bf = head;
     return 0;
-}
\ No newline at end of file
+}
+
+int serialize_blocked_bloomfilter(const blocked_bloomfilter_t* bf, uint8_t** buffer,
+                                  size_t* encoded_size, bool compress)
+{
+    if (bf == NULL || buffer == NULL || encoded_size == NULL) return -1;
+
+    size_t blocks_size =
+        (size_t)bf->num_blocks * BLOCKED_BLOOMFILTER_BLOCK_WORDS * sizeof(uint64_t);
+    size_t size = sizeof(uint32_t) + sizeof(uint32_t) + blocks_size;
+
+    uint8_t* temp_buffer = malloc(size);
+    if (temp_buffer == NULL) return -1;
+
+    uint8_t* ptr = temp_buffer;
+    memcpy(ptr, &bf->num_blocks, sizeof(uint32_t));
+    ptr += sizeof(uint32_t);
+    memcpy(ptr, &bf->num_probes, sizeof(uint32_t));
+    ptr += sizeof(uint32_t);
+    memcpy(ptr, bf->blocks, blocks_size);
+
+    if (compress)
+    {
+        size_t max_compressed_size = ZSTD_compressBound(size);
+        *buffer = malloc(max_compressed_size);
+        if (*buffer == NULL)
+        {
+            free(temp_buffer);
+            return -1;
+        }
+
+        *encoded_size = ZSTD_compress(*buffer, max_compressed_size, temp_buffer, size, 1);
+        free(temp_buffer);
+
+        if (ZSTD_isError(*encoded_size))
+        {
+            free(*buffer);
+            return -1;
+        }
+    }
+    else
+    {
+        *buffer = temp_buffer;
+        *encoded_size = size;
+    }
+
+    return 0;
+}
+
+int deserialize_blocked_bloomfilter(const uint8_t* buffer, size_t buffer_size,
+                                    blocked_bloomfilter_t** bf, bool decompress)
+{
+    if (buffer == NULL || bf == NULL) return -1;
+
+    uint8_t* temp_buffer;
+    size_t size;
+
+    if (decompress)
+    {
+        size = ZSTD_getFrameContentSize(buffer, buffer_size);
+        if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN) return -1;
+
+        temp_buffer = malloc(size);
+        if (temp_buffer == NULL) return -1;
+
+        size_t decompressed_size = ZSTD_decompress(temp_buffer, size, buffer, buffer_size);
+        if (ZSTD_isError(decompressed_size) || decompressed_size != size)
+        {
+            free(temp_buffer);
+            return -1;
+        }
+    }
+    else
+    {
+        temp_buffer = (uint8_t*)buffer;
+        size = buffer_size;
+    }
+
+    uint32_t num_blocks = 0;
+    uint32_t num_probes = 0;
+    if (size >= sizeof(uint32_t) * 2)
+    {
+        memcpy(&num_blocks, temp_buffer, sizeof(uint32_t));
+        memcpy(&num_probes, temp_buffer + sizeof(uint32_t), sizeof(uint32_t));
+    }
+
+    /* the blocks must fill the rest of the buffer exactly */
+    size_t blocks_size = (size_t)num_blocks * BLOCKED_BLOOMFILTER_BLOCK_WORDS * sizeof(uint64_t);
+    *bf = NULL;
+    if (size == sizeof(uint32_t) * 2 + blocks_size)
+        *bf = blocked_bloomfilter_alloc(num_blocks, num_probes);
+
+    if (*bf != NULL) memcpy((*bf)->blocks, temp_buffer + sizeof(uint32_t) * 2, blocks_size);
+
+    if (decompress) free(temp_buffer);
+
+    return *bf != NULL ? 0 : -1;
+}
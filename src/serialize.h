@@ -19,11 +19,18 @@
 #ifndef SERIALIZE_H
 #define SERIALIZE_H
 
+#include <sys/uio.h>
 #include <zstd.h>
 
 #include "bloomfilter.h"
 #include "serializable_structures.h"
 
+#define SERIALIZE_OPERATION_PARTS 6 /* the parts an uncompressed operation is gathered from */
+#define SERIALIZE_OPERATION_SCRATCH_SIZE \
+    (sizeof(OP_CODE) + 2 * sizeof(uint32_t) + sizeof(int64_t)) /* its fixed size fields */
+#define SERIALIZE_BATCH_HEADER_SIZE \
+    (sizeof(OP_CODE) + sizeof(uint32_t)) /* the op code and operation count of a batch */
+
 /*
  * serialize_key_value_pair
  * serialize a key value pair
@@ -72,6 +79,96 @@ int serialize_operation(const operation_t* op, uint8_t** buffer, size_t* encoded
 int deserialize_operation(const uint8_t* buffer, size_t buffer_size, operation_t** op,
                           bool decompress);
 
+/*
+ * serialize_operation_parts
+ * lay out an uncompressed operation as the parts it is written from, the same bytes
+ * serialize_operation encodes.  the key, value and column family name are not copied, the parts
+ * point at them, only the fixed size fields are encoded into scratch
+ * @param op the operation to lay out
+ * @param scratch SERIALIZE_OPERATION_SCRATCH_SIZE bytes for the fixed size fields
+ * @param parts SERIALIZE_OPERATION_PARTS parts to gather the operation from
+ * @param encoded_size the size of the encoded data
+ * @return 0 if the operation was successful, -1 otherwise
+ */
+int serialize_operation_parts(const operation_t* op, uint8_t* scratch, struct iovec* parts,
+                              size_t* encoded_size);
+
+/*
+ * serialize_compress_parts
+ * compress data gathered from several parts into a single frame without joining them first
+ * @param parts the parts of the data
+ * @param parts_count the number of parts
+ * @param buffer the buffer to write the compressed data to
+ * @param encoded_size the size of the compressed data
+ * @return 0 if the operation was successful, -1 otherwise
+ */
+int serialize_compress_parts(const struct iovec* parts, size_t parts_count, uint8_t** buffer,
+                             size_t* encoded_size);
+
+/*
+ * deserialize_decompress
+ * decompress a frame written by serialize_compress_parts or a compressed serialize_operation
+ * @param buffer the buffer to read the compressed data from
+ * @param buffer_size the size of the buffer
+ * @param data the decompressed data
+ * @param data_size the size of the decompressed data
+ * @return 0 if the operation was successful, -1 otherwise
+ */
+int deserialize_decompress(const uint8_t* buffer, size_t buffer_size, uint8_t** data,
+                           size_t* data_size);
+
+/*
+ * serialize_batch_header
+ * encode the header of a batch.  a batch is the header followed by its operations and the column
+ * family name, the operations are encoded like an operation without the column family name
+ * @param count the number of operations in the batch
+ * @param buffer SERIALIZE_BATCH_HEADER_SIZE bytes to write the header to
+ * @return 0 if the operation was successful, -1 otherwise
+ */
+int serialize_batch_header(uint32_t count, uint8_t* buffer);
+
+/*
+ * deserialize_batch_header
+ * decode the header of a batch
+ * @param buffer the buffer to read the header from
+ * @param buffer_size the size of the buffer
+ * @param count the number of operations in the batch
+ * @return 0 if the operation was successful, -1 if the buffer does not start with a batch header
+ */
+int deserialize_batch_header(const uint8_t* buffer, size_t buffer_size, uint32_t* count);
+
+/*
+ * serialize_batch_operation_size
+ * returns the number of bytes an operation of a batch is encoded in
+ * @param kv the key value pair of the operation
+ * @return the size of the encoded operation
+ */
+size_t serialize_batch_operation_size(const key_value_pair_t* kv);
+
+/*
+ * serialize_batch_operation
+ * encode an operation of a batch
+ * @param op_code the operation code
+ * @param kv the key value pair of the operation
+ * @param buffer serialize_batch_operation_size bytes to write the operation to
+ * @return 0 if the operation was successful, -1 otherwise
+ */
+int serialize_batch_operation(OP_CODE op_code, const key_value_pair_t* kv, uint8_t* buffer);
+
+/*
+ * deserialize_batch_operation
+ * decode the operation of a batch at the start of a buffer.  the key and value are not copied, they
+ * point into the buffer
+ * @param buffer the buffer to read the operation from
+ * @param buffer_size the size of the buffer
+ * @param op_code the operation code
+ * @param kv the key value pair of the operation
+ * @param encoded_size the size of the encoded operation
+ * @return 0 if the operation was successful, -1 if the buffer is too short
+ */
+int deserialize_batch_operation(const uint8_t* buffer, size_t buffer_size, OP_CODE* op_code,
+                                key_value_pair_t* kv, size_t* encoded_size);
+
 /*
  * serialize_column_family_config
  * serialize a column family config
@@ -118,4 +215,28 @@ int serialize_bloomfilter(const bloomfilter_t* bf, uint8_t** buffer, size_t* enc
 int deserialize_bloomfilter(const uint8_t* buffer, size_t buffer_size, bloomfilter_t** bf,
                             bool decompress);
 
+/*
+ * serialize_blocked_bloomfilter
+ * serialize a blocked bloom filter
+ * @param bf the blocked bloom filter to serialize
+ * @param buffer the buffer to write the serialized data to
+ * @param encoded_size the size of the encoded data
+ * @param compress whether to compress the data
+ * @return 0 if the operation was successful, -1 otherwise
+ */
+int serialize_blocked_bloomfilter(const blocked_bloomfilter_t* bf, uint8_t** buffer,
+                                  size_t* encoded_size, bool compress);
+
+/*
+ * deserialize_blocked_bloomfilter
+ * deserialize a blocked bloom filter
+ * @param buffer the buffer to read the serialized data from
+ * @param buffer_size the size of the buffer
+ * @param bf the blocked bloom filter to deserialize
+ * @param decompress whether to decompress the data
+ * @return 0 if the operation was successful, -1 otherwise
+ */
+int deserialize_blocked_bloomfilter(const uint8_t* buffer, size_t buffer_size,
+                                    blocked_bloomfilter_t** bf, bool decompress);
+
 #endif /* SERIALIZE_H */
\ No newline at end of file
@@ -39,20 +39,30 @@ skiplist_node_t *skiplist_create_node(int level, const uint8_t *key, size_t key_
     memcpy(node->key, key, key_size);
     node->key_size = key_size;
 
-    /* allocate memory for the value */
-    node->value = (uint8_t *)malloc(value_size);
-    if (node->value == NULL)
+    /* a node that removes its key has no value */
+    node->value = NULL;
+    node->value_size = 0;
+
+    if (value != NULL)
     {
-        free(node->key);
-        free(node);
-        return NULL;
-    }
+        /* allocate memory for the value, at least the size of a TOMBSTONE so expiring the node
+         * never allocates */
+        node->value = (uint8_t *)malloc(value_size < sizeof(uint32_t) ? sizeof(uint32_t)
+                                                                       : value_size);
+        if (node->value == NULL)
+        {
+            free(node->key);
+            free(node);
+            return NULL;
+        }
 
-    memcpy(node->value, value, value_size);
-    node->value_size = value_size;
+        memcpy(node->value, value, value_size);
+        node->value_size = value_size;
+    }
 
     /* set the TTL */
     node->ttl = ttl;
+    node->removed = false;
 
     /* init forward pointers to NULL */
     for (int i = 0; i < level; i++)
@@ -67,16 +77,12 @@ int skiplist_check_and_update_ttl(skiplist_node_t *node)
 {
     if (node == NULL) return -1;
 
-    if (node->ttl != -1 && node->ttl < time(NULL))
+    if (node->ttl != -1 && node->ttl < time(NULL) && node->value != NULL)
     {
-        /*n ode has expired */
-        free(node->value);
-
-        node->value = (uint8_t *)malloc(sizeof(TOMBSTONE));
-        if (node->value == NULL) return -1;
-
-        *(uint32_t *)node->value = TOMBSTONE; /* directly assign the value */
-        node->value_size = 4;                 /* size of TOMBSTONE */
+        /* node has expired, every value has room for a TOMBSTONE so we overwrite it in place */
+        uint32_t tombstone = TOMBSTONE;
+        memcpy(node->value, &tombstone, sizeof(tombstone));
+        node->value_size = sizeof(tombstone); /* size of TOMBSTONE */
         return 0;
     }
     return -1;
@@ -94,8 +100,14 @@ skiplist_t *new_skiplist(int max_level, float probability)
     list->max_level = max_level;
     list->probability = probability;
     list->total_size = 0;
+    list->concurrent = false;
     pthread_rwlock_init(&list->lock, NULL); /* initialize read-write lock */
 
+    /* the arena allocates its first chunk on the first put */
+    atomic_init(&list->arena.current, NULL);
+    list->arena.chunks = NULL;
+    pthread_mutex_init(&list->arena.lock, NULL);
+
     uint8_t header_key[1] = {0};
     uint8_t header_value[1] = {0};
     list->header = skiplist_create_node(max_level, header_key, 1, header_value, 1, -1);
@@ -103,6 +115,7 @@ skiplist_t *new_skiplist(int max_level, float probability)
     if (list->header == NULL)
     {
         pthread_rwlock_destroy(&list->lock); /* destroy the read-write lock */
+        pthread_mutex_destroy(&list->arena.lock);
         free(list);
         return NULL;
     }
@@ -113,15 +126,276 @@ skiplist_t *new_skiplist(int max_level, float probability)
     return list;
 }
 
+void *skiplist_arena_alloc(skiplist_t *list, size_t size)
+{
+    if (list == NULL || size == 0) return NULL;
+
+    /* we keep every allocation aligned for a pointer */
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+    while (true)
+    {
+        /* the fast path bumps the current chunk without a lock, concurrent puts race on used */
+        skiplist_arena_chunk_t *chunk =
+            atomic_load_explicit(&list->arena.current, memory_order_acquire);
+        if (chunk != NULL)
+        {
+            size_t offset = atomic_fetch_add(&chunk->used, size);
+            if (offset + size <= chunk->size)
+            {
+                atomic_fetch_add(&list->total_size, size); /* add to total size */
+                return chunk->data + offset;
+            }
+        }
+
+        pthread_mutex_lock(&list->arena.lock);
+
+        /* another put may have added a chunk whilst we waited */
+        if (atomic_load(&list->arena.current) != chunk)
+        {
+            pthread_mutex_unlock(&list->arena.lock);
+            continue;
+        }
+
+        /* a large allocation gets a chunk of its own so the current chunk is not wasted */
+        bool dedicated = size > SKIPLIST_ARENA_CHUNK_SIZE / 4;
+        size_t chunk_size = dedicated ? size : SKIPLIST_ARENA_CHUNK_SIZE;
+
+        skiplist_arena_chunk_t *new_chunk = malloc(sizeof(skiplist_arena_chunk_t) + chunk_size);
+        if (new_chunk == NULL)
+        {
+            pthread_mutex_unlock(&list->arena.lock);
+            return NULL;
+        }
+
+        new_chunk->size = chunk_size;
+        atomic_init(&new_chunk->used, size);
+        new_chunk->next = list->arena.chunks;
+        list->arena.chunks = new_chunk;
+
+        if (!dedicated)
+            atomic_store_explicit(&list->arena.current, new_chunk, memory_order_release);
+
+        pthread_mutex_unlock(&list->arena.lock);
+
+        atomic_fetch_add(&list->total_size, size); /* add to total size */
+        return new_chunk->data;
+    }
+}
+
+int skiplist_arena_reserve(skiplist_t *list, size_t size)
+{
+    if (list == NULL) return -1;
+
+    /* a reservation smaller than a chunk is what the next chunk would give anyway */
+    if (size <= SKIPLIST_ARENA_CHUNK_SIZE) return 0;
+
+    skiplist_arena_chunk_t *chunk = malloc(sizeof(skiplist_arena_chunk_t) + size);
+    if (chunk == NULL) return -1;
+
+    chunk->size = size;
+    atomic_init(&chunk->used, 0);
+
+    pthread_mutex_lock(&list->arena.lock);
+
+    /* what is left of the current chunk is given up for the reserved one */
+    chunk->next = list->arena.chunks;
+    list->arena.chunks = chunk;
+    atomic_store_explicit(&list->arena.current, chunk, memory_order_release);
+
+    pthread_mutex_unlock(&list->arena.lock);
+
+    return 0;
+}
+
+void skiplist_arena_release(skiplist_t *list)
+{
+    if (list == NULL) return;
+
+    pthread_mutex_lock(&list->arena.lock);
+
+    skiplist_arena_chunk_t *chunk = list->arena.chunks;
+    while (chunk != NULL)
+    {
+        skiplist_arena_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    list->arena.chunks = NULL;
+    atomic_store(&list->arena.current, NULL);
+
+    pthread_mutex_unlock(&list->arena.lock);
+}
+
+skiplist_node_t *skiplist_arena_create_node(skiplist_t *list, int level, const uint8_t *key,
+                                            size_t key_size, const uint8_t *value,
+                                            size_t value_size, time_t ttl)
+{
+    /* validate level to prevent overflow */
+    if (list == NULL || level <= 0) return NULL;
+
+    /* the value goes right after the tower and has room for a TOMBSTONE, the key follows it */
+    size_t node_size = sizeof(skiplist_node_t) + level * sizeof(skiplist_node_t *);
+    size_t value_room = 0;
+    if (value != NULL)
+    {
+        value_room = value_size < sizeof(uint32_t) ? sizeof(uint32_t) : value_size;
+        value_room = (value_room + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    }
+
+    uint8_t *memory = skiplist_arena_alloc(list, node_size + value_room + key_size);
+    if (memory == NULL) return NULL;
+
+    skiplist_node_t *node = (skiplist_node_t *)memory;
+
+    node->key = memory + node_size + value_room;
+    memcpy(node->key, key, key_size);
+    node->key_size = key_size;
+
+    /* a node that removes its key has no value */
+    node->value = NULL;
+    node->value_size = 0;
+
+    if (value != NULL)
+    {
+        node->value = memory + node_size;
+        memcpy(node->value, value, value_size);
+        node->value_size = value_size;
+    }
+
+    node->ttl = ttl;
+    node->removed = false;
+
+    /* init forward pointers to NULL */
+    for (int i = 0; i < level; i++) atomic_init(&node->forward[i], NULL);
+
+    return node;
+}
+
+skiplist_t *new_concurrent_skiplist(int max_level, float probability)
+{
+    skiplist_t *list = new_skiplist(max_level, probability);
+    if (list == NULL) return NULL;
+
+    list->concurrent = true;
+
+    return list;
+}
+
 int skiplist_random_level(skiplist_t *list)
 {
+    /* rand() shares its state between all threads, every thread keeps its own xorshift state */
+    static _Thread_local uint64_t state = 0;
+    if (state == 0) state = ((uint64_t)(uintptr_t)&state ^ (uint64_t)time(NULL)) | 1;
+
+    uint32_t threshold = (uint32_t)(list->probability * (double)UINT32_MAX);
+
     int level = 1;
-    float rand_max_inv = 1.0f / RAND_MAX;
-    while ((rand() * rand_max_inv) < list->probability && level < list->max_level) level++;
+    while (level < list->max_level)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        if ((uint32_t)(state >> 32) >= threshold) break;
+
+        level++;
+    }
 
     return level;
 }
 
+void skiplist_find_concurrent(skiplist_t *list, const uint8_t *key, size_t key_size,
+                              skiplist_node_t **preds, skiplist_node_t **succs)
+{
+    skiplist_node_t *pred = list->header;
+    for (int i = list->max_level - 1; i >= 0; i--)
+    {
+        skiplist_node_t *curr = atomic_load_explicit(&pred->forward[i], memory_order_acquire);
+        while (curr != NULL && skiplist_compare_keys(curr->key, curr->key_size, key, key_size) < 0)
+        {
+            pred = curr;
+            curr = atomic_load_explicit(&pred->forward[i], memory_order_acquire);
+        }
+
+        preds[i] = pred;
+        succs[i] = curr;
+    }
+}
+
+int skiplist_put_concurrent(skiplist_t *list, const uint8_t *key, size_t key_size,
+                            const uint8_t *value, size_t value_size, time_t ttl)
+{
+    if (list == NULL || key == NULL) return -1;
+
+    int level = skiplist_random_level(list);
+
+    /* the node is never changed once it is linked, readers do not lock it */
+    skiplist_node_t *node =
+        skiplist_arena_create_node(list, level, key, key_size, value, value_size, ttl);
+    if (node == NULL) return -1;
+
+    node->removed = value == NULL;
+
+    skiplist_node_t *preds[list->max_level];
+    skiplist_node_t *succs[list->max_level];
+    skiplist_find_concurrent(list, key, key_size, preds, succs);
+
+    /* the node is in the list once it is linked on level 0, in front of the older nodes of its
+     * key.  the levels above only speed up searches */
+    for (int i = 0; i < level; i++)
+    {
+        while (true)
+        {
+            atomic_store_explicit(&node->forward[i], succs[i], memory_order_relaxed);
+
+            skiplist_node_t *expected = succs[i];
+            if (atomic_compare_exchange_strong_explicit(&preds[i]->forward[i], &expected, node,
+                                                        memory_order_release,
+                                                        memory_order_relaxed))
+                break;
+
+            /* another put linked a node here first, we search again */
+            skiplist_find_concurrent(list, key, key_size, preds, succs);
+        }
+    }
+
+    int current = atomic_load(&list->level);
+    while (current < level && !atomic_compare_exchange_weak(&list->level, &current, level))
+        ;
+
+    return 0;
+}
+
+skiplist_node_t *skiplist_next_visible(skiplist_node_t *node, const uint8_t *key, size_t key_size)
+{
+    while (node != NULL)
+    {
+        skiplist_node_t *next = atomic_load_explicit(&node->forward[0], memory_order_acquire);
+
+        /* an older node of the key we come from */
+        if (key != NULL && skiplist_compare_keys(node->key, node->key_size, key, key_size) == 0)
+        {
+            node = next;
+            continue;
+        }
+
+        /* the key is removed, its older nodes are skipped too */
+        if (node->removed)
+        {
+            key = node->key;
+            key_size = node->key_size;
+            node = next;
+            continue;
+        }
+
+        return node;
+    }
+
+    return NULL;
+}
+
 int skiplist_compare_keys(const uint8_t *key1, size_t key1_size, const uint8_t *key2,
                           size_t key2_size)
 {
@@ -137,6 +411,9 @@ int skiplist_put(skiplist_t *list, const uint8_t *key, size_t key_size, const ui
 {
     if (list == NULL || key == NULL || value == NULL) return -1;
 
+    if (list->concurrent)
+        return skiplist_put_concurrent(list, key, key_size, value, value_size, ttl);
+
     pthread_rwlock_wrlock(&list->lock); /* lock the list for writing */
     skiplist_node_t *update[list->max_level];
     skiplist_node_t *x = list->header;
@@ -156,20 +433,19 @@ int skiplist_put(skiplist_t *list, const uint8_t *key, size_t key_size, const ui
 
     if (x && skiplist_compare_keys(x->key, x->key_size, key, key_size) == 0)
     {
-        list->total_size -= x->value_size; /* sub old value size */
-        free(x->value);
-
-        x->value = (uint8_t *)malloc(value_size);
-        if (x->value == NULL)
+        /* the old value stays in the arena until the skiplist is released */
+        uint8_t *new_value = skiplist_arena_alloc(
+            list, value_size < sizeof(uint32_t) ? sizeof(uint32_t) : value_size);
+        if (new_value == NULL)
         {
             pthread_rwlock_unlock(&list->lock); /* unlock sl */
             return -1;
         }
 
-        memcpy(x->value, value, value_size);
+        memcpy(new_value, value, value_size);
+        x->value = new_value;
         x->value_size = value_size; /* ensure value_size is set */
         x->ttl = ttl;
-        list->total_size += value_size; /* add up new value size */
     }
     else
     {
@@ -181,7 +457,7 @@ int skiplist_put(skiplist_t *list, const uint8_t *key, size_t key_size, const ui
             list->level = level;
         }
 
-        x = skiplist_create_node(level, key, key_size, value, value_size, ttl);
+        x = skiplist_arena_create_node(list, level, key, key_size, value, value_size, ttl);
         if (x == NULL)
         {
             pthread_rwlock_unlock(&list->lock);
@@ -192,9 +468,6 @@ int skiplist_put(skiplist_t *list, const uint8_t *key, size_t key_size, const ui
             x->forward[i] = update[i]->forward[i];
             update[i]->forward[i] = x;
         }
-
-        list->total_size += sizeof(skiplist_node_t) + level * sizeof(skiplist_node_t *) + key_size +
-                            value_size; /* add to total size */
     }
     pthread_rwlock_unlock(&list->lock);
     return 0;
@@ -205,6 +478,9 @@ int skiplist_put_no_lock(skiplist_t *list, const uint8_t *key, size_t key_size,
 {
     if (list == NULL || key == NULL || value == NULL) return -1;
 
+    if (list->concurrent)
+        return skiplist_put_concurrent(list, key, key_size, value, value_size, ttl);
+
     skiplist_node_t *update[list->max_level];
     skiplist_node_t *x = list->header;
     for (int i = list->level - 1; i >= 0; i--)
@@ -223,19 +499,18 @@ int skiplist_put_no_lock(skiplist_t *list, const uint8_t *key, size_t key_size,
 
     if (x && skiplist_compare_keys(x->key, x->key_size, key, key_size) == 0)
     {
-        list->total_size -= x->value_size; /* sub old value size */
-        free(x->value);
-
-        x->value = (uint8_t *)malloc(value_size);
-        if (x->value == NULL)
+        /* the old value stays in the arena until the skiplist is released */
+        uint8_t *new_value = skiplist_arena_alloc(
+            list, value_size < sizeof(uint32_t) ? sizeof(uint32_t) : value_size);
+        if (new_value == NULL)
         {
             return -1;
         }
 
-        memcpy(x->value, value, value_size);
+        memcpy(new_value, value, value_size);
+        x->value = new_value;
         x->value_size = value_size; /* ensure value_size is set */
         x->ttl = ttl;
-        list->total_size += value_size; /* add up new value size */
     }
     else
     {
@@ -247,7 +522,7 @@ int skiplist_put_no_lock(skiplist_t *list, const uint8_t *key, size_t key_size,
             list->level = level;
         }
 
-        x = skiplist_create_node(level, key, key_size, value, value_size, ttl);
+        x = skiplist_arena_create_node(list, level, key, key_size, value, value_size, ttl);
         if (x == NULL)
         {
             return -1;
@@ -257,9 +532,6 @@ int skiplist_put_no_lock(skiplist_t *list, const uint8_t *key, size_t key_size,
             x->forward[i] = update[i]->forward[i];
             update[i]->forward[i] = x;
         }
-
-        list->total_size += sizeof(skiplist_node_t) + level * sizeof(skiplist_node_t *) + key_size +
-                            value_size; /* add to total size */
     }
     return 0;
 }
@@ -268,6 +540,21 @@ int skiplist_delete(skiplist_t *list, const uint8_t *key, size_t key_size)
 {
     if (list == NULL || key == NULL) return -1;
 
+    if (list->concurrent)
+    {
+        skiplist_node_t *preds[list->max_level];
+        skiplist_node_t *succs[list->max_level];
+        skiplist_find_concurrent(list, key, key_size, preds, succs);
+
+        /* the newest node of the key has to be one that did not remove it */
+        skiplist_node_t *x = succs[0];
+        if (!x || x->removed || skiplist_compare_keys(x->key, x->key_size, key, key_size) != 0)
+            return -1;
+
+        /* readers may be on the node, so it stays.  we link a newer node that removes the key */
+        return skiplist_put_concurrent(list, key, key_size, NULL, 0, -1);
+    }
+
     pthread_rwlock_wrlock(&list->lock);
     skiplist_node_t *update[list->max_level];
     skiplist_node_t *x = list->header;
@@ -299,11 +586,7 @@ int skiplist_delete(skiplist_t *list, const uint8_t *key, size_t key_size)
         update[i]->forward[i] = x->forward[i];
     }
 
-    list->total_size -= sizeof(skiplist_node_t) + x->key_size + x->value_size +
-                        list->level * sizeof(skiplist_node_t *); /* sub node size */
-    free(x->key);
-    free(x->value);
-    free(x);
+    /* the unlinked node stays in the arena until the skiplist is released */
     while (list->level > 1 && list->header->forward[list->level - 1] == NULL) list->level--;
 
     pthread_rwlock_unlock(&list->lock);
@@ -315,6 +598,31 @@ int skiplist_get(skiplist_t *list, const uint8_t *key, size_t key_size, uint8_t
 {
     if (list == NULL || key == NULL || value == NULL || value_size == NULL) return -1;
 
+    if (list->concurrent)
+    {
+        /* no lock, nodes are never changed or freed whilst the list is in use */
+        skiplist_node_t *preds[list->max_level];
+        skiplist_node_t *succs[list->max_level];
+        skiplist_find_concurrent(list, key, key_size, preds, succs);
+
+        /* the first node of the key is its newest */
+        skiplist_node_t *x = succs[0];
+        if (!x || x->removed || skiplist_compare_keys(x->key, x->key_size, key, key_size) != 0)
+            return -1;
+
+        /* an expired value reads as a tombstone, the node itself is left as is */
+        bool expired = x->ttl != -1 && x->ttl < time(NULL);
+        uint32_t tombstone = TOMBSTONE;
+
+        *value_size = expired ? sizeof(tombstone) : x->value_size;
+        *value = malloc(*value_size);
+        if (*value == NULL) return -1;
+
+        memcpy(*value, expired ? (uint8_t *)&tombstone : x->value, *value_size);
+
+        return 0;
+    }
+
     pthread_rwlock_rdlock(&list->lock);
     skiplist_node_t *x = list->header;
 
@@ -364,6 +672,10 @@ skiplist_cursor_t *skiplist_cursor_init(skiplist_t *list)
 
     cursor->list = list;
     cursor->current = list->header->forward[0];
+
+    /* a concurrent list starts at the first key that is not removed */
+    if (list->concurrent) cursor->current = skiplist_next_visible(cursor->current, NULL, 0);
+
     return cursor;
 }
 
@@ -371,6 +683,20 @@ int skiplist_cursor_next(skiplist_cursor_t *cursor)
 {
     if (cursor == NULL || cursor->list == NULL) return -1;
 
+    if (cursor->list->concurrent)
+    {
+        if (cursor->current == NULL) return -1;
+
+        /* we skip the older nodes of the current key */
+        skiplist_node_t *next = skiplist_next_visible(
+            atomic_load_explicit(&cursor->current->forward[0], memory_order_acquire),
+            cursor->current->key, cursor->current->key_size);
+        if (next == NULL) return -1;
+
+        cursor->current = next;
+        return 0;
+    }
+
     pthread_rwlock_rdlock(&cursor->list->lock); /* lock the list for reading */
     if (cursor->current != NULL && cursor->current->forward[0] != NULL)
     {
@@ -388,6 +714,26 @@ int skiplist_cursor_prev(skiplist_cursor_t *cursor)
 {
     if (cursor == NULL || cursor->list == NULL || cursor->current == NULL) return -1;
 
+    if (cursor->list->concurrent)
+    {
+        /* nodes only link forward, we walk the keys from the start */
+        skiplist_node_t *prev = NULL;
+        skiplist_node_t *x = skiplist_next_visible(
+            atomic_load_explicit(&cursor->list->header->forward[0], memory_order_acquire), NULL, 0);
+
+        while (x != NULL && x != cursor->current)
+        {
+            prev = x;
+            x = skiplist_next_visible(atomic_load_explicit(&x->forward[0], memory_order_acquire),
+                                      x->key, x->key_size);
+        }
+
+        if (prev == NULL) return -1;
+
+        cursor->current = prev;
+        return 0;
+    }
+
     pthread_rwlock_rdlock(&cursor->list->lock); /* lock the list for reading */
     skiplist_node_t *x = cursor->list->header;
     skiplist_node_t *prev = NULL;
@@ -425,22 +771,8 @@ int skiplist_clear(skiplist_t *list)
     if (pthread_rwlock_wrlock(&list->lock) != 0) /* lock the sl for writing */
         return -1;
 
-    skiplist_node_t *current = list->header->forward[0];
-    while (current != NULL)
-    {
-        skiplist_node_t *next = current->forward[0];
-        free(current->key);
-        current->key = NULL;
-
-        if (current->value != NULL)
-        {
-            free(current->value);
-            current->value = NULL;
-        }
-
-        free(current);
-        current = next;
-    }
+    /* every node lives in the arena, we free its chunks instead of walking the nodes */
+    skiplist_arena_release(list);
 
     /* reset the header node's forward pointers */
     for (int i = 0; i < list->max_level; i++) list->header->forward[i] = NULL;
@@ -462,6 +794,8 @@ int skiplist_destroy(skiplist_t *list)
 
     if (pthread_rwlock_destroy(&list->lock) != 0) return -1;
 
+    pthread_mutex_destroy(&list->arena.lock);
+
     free(list->header->key);
     free(list->header->value);
     free(list->header);
@@ -494,15 +828,30 @@ skiplist_t *skiplist_copy(skiplist_t *list)
     /* lock the original skiplist for reading */
     pthread_rwlock_rdlock(&list->lock);
 
-    /* iterate through the original skiplist and copy each node */
-    skiplist_node_t *current = list->header->forward[0];
-    while (current != NULL)
+    /* iterate through the original skiplist and copy each node, of a concurrent list only the
+     * newest node of each key that is not removed */
+    skiplist_cursor_t *cursor = skiplist_cursor_init(list);
+    if (cursor == NULL)
     {
-        skiplist_put(new_list, current->key, current->key_size, current->value, current->value_size,
-                     current->ttl);
-        current = current->forward[0];
+        pthread_rwlock_unlock(&list->lock);
+        skiplist_destroy(new_list);
+        return NULL;
     }
 
+    while (cursor->current != NULL)
+    {
+        skiplist_put(new_list, cursor->current->key, cursor->current->key_size,
+                     cursor->current->value, cursor->current->value_size, cursor->current->ttl);
+
+        skiplist_node_t *next = cursor->current->forward[0];
+        if (list->concurrent)
+            next = skiplist_next_visible(next, cursor->current->key, cursor->current->key_size);
+
+        cursor->current = next;
+    }
+
+    skiplist_cursor_free(cursor);
+
     /* unlock the original skiplist */
     pthread_rwlock_unlock(&list->lock);
 
@@ -20,6 +20,8 @@
 #define SKIPLIST_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -29,7 +31,10 @@
 #define TOMBSTONE \
     0xDEADBEEF /* On expiration of a node if time to live is set we set the key's value to this */
 
+#define SKIPLIST_ARENA_CHUNK_SIZE (64 * 1024) /* the size of a skiplist arena chunk */
+
 typedef struct skiplist_node_t skiplist_node_t;
+typedef struct skiplist_arena_chunk_t skiplist_arena_chunk_t;
 
 /*
  * skiplist_node_t
@@ -39,18 +44,51 @@ typedef struct skiplist_node_t skiplist_node_t;
  * @param value the value for the node
  * @param value_size the value size
  * @param ttl an expiration time for the node (optional)
+ * @param removed whether the node removes its key, only concurrent skiplists have such nodes
  * @param forward the forward pointers for the node
  */
 struct skiplist_node_t
 {
-    uint8_t *key;               /* the key for the node */
-    size_t key_size;            /* the key size */
-    uint8_t *value;             /* the value for the node */
-    size_t value_size;          /* the value size */
-    time_t ttl;                 /* an expiration time for the node (optional) */
-    skiplist_node_t *forward[]; /* the forward pointers for the node */
+    uint8_t *key;                         /* the key for the node */
+    size_t key_size;                      /* the key size */
+    uint8_t *value;                       /* the value for the node */
+    size_t value_size;                    /* the value size */
+    time_t ttl;                           /* an expiration time for the node (optional) */
+    bool removed;                         /* whether the node removes its key */
+    _Atomic(skiplist_node_t *) forward[]; /* the forward pointers for the node */
 };
 
+/*
+ * skiplist_arena_chunk_t
+ * a chunk of memory a skiplist arena hands out
+ * @param next the chunk allocated before this one
+ * @param size the number of bytes in the chunk
+ * @param used the number of bytes handed out, runs past size once the chunk is full
+ * @param data the bytes of the chunk
+ */
+struct skiplist_arena_chunk_t
+{
+    skiplist_arena_chunk_t *next; /* the chunk allocated before this one */
+    size_t size;                  /* the number of bytes in the chunk */
+    atomic_size_t used;           /* the number of bytes handed out */
+    uint8_t data[];               /* the bytes of the chunk */
+};
+
+/*
+ * skiplist_arena_t
+ * a bump allocator for the nodes, keys and values of a skiplist.  a node is placed next to its
+ * tower, value and key and nothing is freed on its own, the chunks are released with the skiplist
+ * @param current the chunk allocations are bumped from
+ * @param chunks every chunk of the arena, newest first
+ * @param lock the lock for adding chunks
+ */
+typedef struct
+{
+    _Atomic(skiplist_arena_chunk_t *) current; /* the chunk allocations are bumped from */
+    skiplist_arena_chunk_t *chunks;            /* every chunk of the arena, newest first */
+    pthread_mutex_t lock;                      /* the lock for adding chunks */
+} skiplist_arena_t;
+
 /*
  * skiplist_t
  * the skiplist structure
@@ -58,17 +96,21 @@ struct skiplist_node_t
  * @param max_level the maximum level of the skiplist
  * @param probability the probability of a node having a certain level
  * @param header the header node of the skiplist
- * @param total_size the total size in bytes
+ * @param total_size the total size in bytes handed out by the arena
  * @param lock the read-write lock for list-level synchronization
+ * @param concurrent whether puts link nodes with compare-and-swap and reads take no lock
+ * @param arena the arena the nodes, keys and values are allocated from
  */
 typedef struct
 {
-    int level;               /* the current level of the skiplist  */
-    int max_level;           /* the maximum level of the skiplist  */
-    float probability;       /* the probability of a node having a certain level  */
-    skiplist_node_t *header; /* the header node of the skiplist  */
-    size_t total_size;       /* total size in bytes  */
-    pthread_rwlock_t lock;   /* read-write lock for list-level synchronization  */
+    atomic_int level;         /* the current level of the skiplist  */
+    int max_level;            /* the maximum level of the skiplist  */
+    float probability;        /* the probability of a node having a certain level  */
+    skiplist_node_t *header;  /* the header node of the skiplist  */
+    atomic_size_t total_size; /* total size in bytes handed out by the arena  */
+    pthread_rwlock_t lock;    /* read-write lock for list-level synchronization  */
+    bool concurrent;          /* whether puts are lock-free and reads take no lock  */
+    skiplist_arena_t arena;   /* the arena the nodes, keys and values are allocated from  */
 } skiplist_t;
 
 /*
@@ -99,9 +141,54 @@ typedef struct
 skiplist_node_t *skiplist_create_node(int level, const uint8_t *key, size_t key_size,
                                       const uint8_t *value, size_t value_size, time_t ttl);
 
+/*
+ * skiplist_arena_alloc
+ * allocates memory from the arena of a skiplist, it is freed with the skiplist.  the allocation is
+ * added to the total size of the skiplist
+ * @param list the skiplist
+ * @param size the number of bytes
+ * @return the memory, aligned for a pointer, NULL on failure
+ */
+void *skiplist_arena_alloc(skiplist_t *list, size_t size);
+
+/*
+ * skiplist_arena_reserve
+ * gives the arena of a skiplist a chunk of at least the given size up front, so a list that is
+ * about to be filled with a known amount of data does not allocate chunk by chunk.  the reserved
+ * bytes are not added to the total size until they are handed out
+ * @param list the skiplist
+ * @param size the number of bytes to reserve
+ * @return 0 if the chunk was allocated, -1 otherwise
+ */
+int skiplist_arena_reserve(skiplist_t *list, size_t size);
+
+/*
+ * skiplist_arena_release
+ * frees every chunk of the arena of a skiplist
+ * @param list the skiplist
+ */
+void skiplist_arena_release(skiplist_t *list);
+
+/*
+ * skiplist_arena_create_node
+ * create a new skiplist node in the arena of a skiplist with a single allocation, the tower,
+ * value and key follow the node
+ * @param list the skiplist
+ * @param level the level of the node
+ * @param key the key for the node
+ * @param key_size the key size
+ * @param value the value for the node, NULL for a node that removes its key
+ * @param value_size the value size
+ * @param ttl an expiration time for the node (optional)
+ * @return the new skiplist node
+ */
+skiplist_node_t *skiplist_arena_create_node(skiplist_t *list, int level, const uint8_t *key,
+                                            size_t key_size, const uint8_t *value,
+                                            size_t value_size, time_t ttl);
+
 /*
  * skiplist_destroy_node
- * destroy a skiplist node
+ * destroy a skiplist node created with skiplist_create_node
  * @param node the node to destroy
  * @return 0 if the node was destroyed successfully, -1 otherwise
  */
@@ -116,6 +203,18 @@ int skiplist_destroy_node(skiplist_node_t *node);
  */
 skiplist_t *new_skiplist(int max_level, float probability);
 
+/*
+ * new_concurrent_skiplist
+ * create a new concurrent skiplist.  puts link their nodes with compare-and-swap instead of taking
+ * the list lock and gets and cursors never wait.  nodes are never unlinked whilst the list is in
+ * use, a put of an existing key links a newer node in front of the old one and a delete links a
+ * node that removes the key.  gets and cursors only see the newest node of each key
+ * @param max_level the maximum level of the skiplist
+ * @param probability the probability of a node having a certain level
+ * @return the new skiplist
+ */
+skiplist_t *new_concurrent_skiplist(int max_level, float probability);
+
 /*
  * skiplist_destroy
  * destroy a skiplist
@@ -126,12 +225,50 @@ int skiplist_destroy(skiplist_t *list);
 
 /*
  * skiplist_random_level
- * generate a random level for a new skiplist node
+ * generate a random level for a new skiplist node, every thread has its own random generator
  * @param list the skiplist
  * @return the new level
  */
 int skiplist_random_level(skiplist_t *list);
 
+/*
+ * skiplist_find_concurrent
+ * finds the nodes a key is linked between on every level of a concurrent skiplist, the successor
+ * is the newest node of the key if it is in the list
+ * @param list the skiplist
+ * @param key the key to find
+ * @param key_size the key size
+ * @param preds the last node before the key on every level
+ * @param succs the first node at or after the key on every level
+ */
+void skiplist_find_concurrent(skiplist_t *list, const uint8_t *key, size_t key_size,
+                              skiplist_node_t **preds, skiplist_node_t **succs);
+
+/*
+ * skiplist_put_concurrent
+ * links a new node for a key into a concurrent skiplist with compare-and-swap
+ * @param list the skiplist
+ * @param key the key to put
+ * @param key_size the key size
+ * @param value the value to put, NULL for a node that removes the key
+ * @param value_size the value size
+ * @param ttl an expiration time for the node (optional)
+ * @return 0 if the node was linked successfully, -1 otherwise
+ */
+int skiplist_put_concurrent(skiplist_t *list, const uint8_t *key, size_t key_size,
+                            const uint8_t *value, size_t value_size, time_t ttl);
+
+/*
+ * skiplist_next_visible
+ * skips the older nodes of a key and removed keys in a concurrent skiplist
+ * @param node the node to start at
+ * @param key the key of the node before it, NULL if it is the header
+ * @param key_size the key size
+ * @return the first node that is the newest one of its key and does not remove it, NULL if none
+ */
+skiplist_node_t *skiplist_next_visible(skiplist_node_t *node, const uint8_t *key,
+                                       size_t key_size);
+
 /*
  * skiplist_compare_keys
  * compares two keys
@@ -231,7 +368,7 @@ skiplist_t *skiplist_copy(skiplist_t *list);
 
 /*
  * skiplist_check_and_update_ttl
- * checks if a node has expired and updates the value to TOMBSTONE
+ * checks if a node has expired and updates the value to TOMBSTONE in place
  * @param node the node to check
  * @return 0 if the node has not expired, 1 if the node has expired
  */
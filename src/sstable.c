@@ -0,0 +1,1940 @@
+/*
+ *
+ * Copyright (C) TidesDB
+ *
+ * Original Author: Alex Gaetano Padula
+ *
+ * Licensed under the Mozilla Public License, v. 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.mozilla.org/en-US/MPL/2.0/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "sstable.h"
+
+int sstable_compare_keys(const uint8_t *key1, size_t key1_size, const uint8_t *key2,
+                         size_t key2_size)
+{
+    size_t min_size = key1_size < key2_size ? key1_size : key2_size;
+    int cmp = memcmp(key1, key2, min_size);
+    if (cmp != 0) return cmp;
+
+    if (key1_size == key2_size) return 0;
+    return key1_size < key2_size ? -1 : 1;
+}
+
+void sstable_encode_footer(const sstable_t *sst, uint8_t *buffer)
+{
+    uint64_t magic = SSTABLE_MAGIC;
+    uint32_t version = SSTABLE_FORMAT_VERSION;
+    uint32_t flags = sst->compressed ? SSTABLE_FLAG_COMPRESSED : 0;
+    if (sst->blocked_bloom) flags |= SSTABLE_FLAG_BLOCKED_BLOOM;
+
+    memcpy(buffer, &magic, sizeof(uint64_t));
+    memcpy(buffer + 8, &version, sizeof(uint32_t));
+    memcpy(buffer + 12, &flags, sizeof(uint32_t));
+    memcpy(buffer + 16, &sst->filter_page, sizeof(uint64_t));
+    memcpy(buffer + 24, &sst->index_page, sizeof(uint64_t));
+    memcpy(buffer + 32, &sst->num_entries, sizeof(uint64_t));
+    memcpy(buffer + 40, &sst->num_blocks, sizeof(uint32_t));
+    memcpy(buffer + 44, &sst->level, sizeof(uint32_t));
+    memcpy(buffer + 48, &sst->meta_page, sizeof(uint64_t));
+    memcpy(buffer + 56, &sst->sequence, sizeof(uint64_t));
+    memcpy(buffer + 64, &sst->file_number, sizeof(uint64_t));
+}
+
+int sstable_decode_footer(const uint8_t *buffer, size_t buffer_len, sstable_t *sst)
+{
+    if (buffer_len != SSTABLE_FOOTER_SIZE && buffer_len != SSTABLE_FOOTER_V2_SIZE &&
+        buffer_len != SSTABLE_FOOTER_V1_SIZE)
+        return -1;
+
+    uint64_t magic;
+    uint32_t version;
+    uint32_t flags;
+
+    memcpy(&magic, buffer, sizeof(uint64_t));
+    if (magic != SSTABLE_MAGIC) return -1;
+
+    memcpy(&version, buffer + 8, sizeof(uint32_t));
+    if (version == SSTABLE_FORMAT_LEGACY || version > SSTABLE_FORMAT_VERSION) return -1;
+
+    /* older footers are shorter, version 1 has no meta block and no sequence and version 2 has
+     * no file number */
+    size_t footer_size = version == SSTABLE_FORMAT_V1   ? SSTABLE_FOOTER_V1_SIZE
+                         : version == SSTABLE_FORMAT_V2 ? SSTABLE_FOOTER_V2_SIZE
+                                                        : SSTABLE_FOOTER_SIZE;
+    if (buffer_len != footer_size) return -1;
+
+    memcpy(&flags, buffer + 12, sizeof(uint32_t));
+    memcpy(&sst->filter_page, buffer + 16, sizeof(uint64_t));
+    memcpy(&sst->index_page, buffer + 24, sizeof(uint64_t));
+    memcpy(&sst->num_entries, buffer + 32, sizeof(uint64_t));
+    memcpy(&sst->num_blocks, buffer + 40, sizeof(uint32_t));
+    memcpy(&sst->level, buffer + 44, sizeof(uint32_t));
+
+    if (version > SSTABLE_FORMAT_V1)
+    {
+        memcpy(&sst->meta_page, buffer + 48, sizeof(uint64_t));
+        memcpy(&sst->sequence, buffer + 56, sizeof(uint64_t));
+    }
+
+    if (version > SSTABLE_FORMAT_V2) memcpy(&sst->file_number, buffer + 64, sizeof(uint64_t));
+
+    sst->version = version;
+    sst->compressed = (flags & SSTABLE_FLAG_COMPRESSED) != 0;
+    sst->blocked_bloom = (flags & SSTABLE_FLAG_BLOCKED_BLOOM) != 0;
+
+    return 0;
+}
+
+int sstable_load_index(sstable_t *sst)
+{
+    uint8_t *buffer = NULL;
+    size_t buffer_len = 0;
+
+    if (pager_read(sst->pager, (unsigned int)sst->index_page, &buffer, &buffer_len) == -1)
+    {
+        free(buffer);
+        return -1;
+    }
+
+    uint32_t num_blocks;
+    if (buffer_len < sizeof(uint32_t))
+    {
+        free(buffer);
+        return -1;
+    }
+    memcpy(&num_blocks, buffer, sizeof(uint32_t));
+
+    /* the index must agree with the footer */
+    if (num_blocks != sst->num_blocks)
+    {
+        free(buffer);
+        return -1;
+    }
+
+    sst->index = calloc(num_blocks ? num_blocks : 1, sizeof(sstable_index_entry_t));
+    if (sst->index == NULL)
+    {
+        free(buffer);
+        return -1;
+    }
+
+    size_t offset = sizeof(uint32_t);
+    for (uint32_t i = 0; i < num_blocks; i++)
+    {
+        if (offset + sizeof(uint64_t) + sizeof(uint32_t) > buffer_len) goto corrupt;
+
+        memcpy(&sst->index[i].page, buffer + offset, sizeof(uint64_t));
+        offset += sizeof(uint64_t);
+        if (sst->index[i].page >= sst->index_page) goto corrupt;
+        memcpy(&sst->index[i].last_key_size, buffer + offset, sizeof(uint32_t));
+        offset += sizeof(uint32_t);
+
+        if (offset + sst->index[i].last_key_size > buffer_len) goto corrupt;
+
+        sst->index[i].last_key = malloc(sst->index[i].last_key_size);
+        if (sst->index[i].last_key == NULL) goto corrupt;
+        memcpy(sst->index[i].last_key, buffer + offset, sst->index[i].last_key_size);
+        offset += sst->index[i].last_key_size;
+    }
+
+    free(buffer);
+    return 0;
+
+corrupt:
+    for (uint32_t i = 0; i < num_blocks; i++) free(sst->index[i].last_key);
+    free(sst->index);
+    sst->index = NULL;
+    free(buffer);
+    return -1;
+}
+
+int sstable_load_filter(sstable_t *sst)
+{
+    uint8_t *buffer = NULL;
+    size_t buffer_len = 0;
+
+    /* the bloom filter of a legacy SSTable is stored in its initial pages */
+    unsigned int page = sst->version == SSTABLE_FORMAT_LEGACY ? 0 : (unsigned int)sst->filter_page;
+
+    if (pager_read(sst->pager, page, &buffer, &buffer_len) == -1)
+    {
+        free(buffer);
+        return -1;
+    }
+
+    /* tables written before the blocked bloom filter carry a chained filter */
+    int rc;
+    if (sst->blocked_bloom)
+        rc = deserialize_blocked_bloomfilter(buffer, buffer_len, &sst->filter, sst->compressed);
+    else
+        rc = deserialize_bloomfilter(buffer, buffer_len, &sst->bf, sst->compressed);
+
+    free(buffer);
+    if (rc == -1)
+    {
+        sst->bf = NULL;
+        sst->filter = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int sstable_load_meta(sstable_t *sst)
+{
+    if (sst->num_blocks == 0) return 0;
+
+    /* a version 1 SSTable has no meta block, we take the smallest key from its first block.  we
+     * are opening the reader so we read the block directly rather than through an iterator */
+    if (sst->version == SSTABLE_FORMAT_V1)
+    {
+        uint8_t *block = NULL;
+        size_t block_len = 0;
+        if (sstable_read_block(sst, 0, &block, &block_len) == -1) return -1;
+
+        /* the first entry follows the entry count of the block */
+        uint32_t key_size;
+        if (block_len < 2 * sizeof(uint32_t))
+        {
+            free(block);
+            return -1;
+        }
+        memcpy(&key_size, block + sizeof(uint32_t), sizeof(uint32_t));
+        if (key_size > block_len - 2 * sizeof(uint32_t))
+        {
+            free(block);
+            return -1;
+        }
+
+        sst->min_key = malloc(key_size ? key_size : 1);
+        if (sst->min_key == NULL)
+        {
+            free(block);
+            return -1;
+        }
+        memcpy(sst->min_key, block + 2 * sizeof(uint32_t), key_size);
+        sst->min_key_size = key_size;
+        free(block);
+
+        /* the largest key is the last key of the last block */
+        sstable_index_entry_t *last = &sst->index[sst->num_blocks - 1];
+        sst->max_key = malloc(last->last_key_size ? last->last_key_size : 1);
+        if (sst->max_key == NULL) return -1;
+        memcpy(sst->max_key, last->last_key, last->last_key_size);
+        sst->max_key_size = last->last_key_size;
+
+        return 0;
+    }
+
+    uint8_t *buffer = NULL;
+    size_t buffer_len = 0;
+    if (pager_read(sst->pager, (unsigned int)sst->meta_page, &buffer, &buffer_len) == -1)
+    {
+        free(buffer);
+        return -1;
+    }
+
+    size_t offset = 0;
+    uint32_t min_key_size;
+    uint32_t max_key_size;
+
+    if (offset + sizeof(uint32_t) > buffer_len) goto corrupt;
+    memcpy(&min_key_size, buffer + offset, sizeof(uint32_t));
+    offset += sizeof(uint32_t);
+    if (offset + min_key_size > buffer_len) goto corrupt;
+
+    sst->min_key = malloc(min_key_size ? min_key_size : 1);
+    if (sst->min_key == NULL) goto corrupt;
+    memcpy(sst->min_key, buffer + offset, min_key_size);
+    sst->min_key_size = min_key_size;
+    offset += min_key_size;
+
+    if (offset + sizeof(uint32_t) > buffer_len) goto corrupt;
+    memcpy(&max_key_size, buffer + offset, sizeof(uint32_t));
+    offset += sizeof(uint32_t);
+    if (offset + max_key_size > buffer_len) goto corrupt;
+
+    sst->max_key = malloc(max_key_size ? max_key_size : 1);
+    if (sst->max_key == NULL) goto corrupt;
+    memcpy(sst->max_key, buffer + offset, max_key_size);
+    sst->max_key_size = max_key_size;
+    offset += max_key_size;
+
+    /* the entry statistics follow the keys, meta blocks written before them end here */
+    if (offset + SSTABLE_META_STATS_SIZE <= buffer_len)
+    {
+        memcpy(&sst->num_tombstones, buffer + offset, sizeof(uint64_t));
+        memcpy(&sst->num_ttl, buffer + offset + 8, sizeof(uint64_t));
+        memcpy(&sst->min_ttl, buffer + offset + 16, sizeof(int64_t));
+        memcpy(&sst->max_ttl, buffer + offset + 24, sizeof(int64_t));
+    }
+
+    free(buffer);
+    return 0;
+
+corrupt:
+    free(sst->min_key);
+    sst->min_key = NULL;
+    sst->min_key_size = 0;
+    free(buffer);
+    return -1;
+}
+
+int sstable_open(const char *filename, bool compressed, sstable_t **sst)
+{
+    if (sstable_open_lazy(filename, compressed, NULL, sst) == -1) return -1;
+
+    /* the handle is not described, opening the reader describes it from the file */
+    (*sst)->described = false;
+
+    if (sstable_open_reader(*sst) == -1)
+    {
+        sstable_close(*sst);
+        *sst = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int sstable_open_lazy(const char *filename, bool compressed, sstable_cache_t *cache,
+                      sstable_t **sst)
+{
+    *sst = calloc(1, sizeof(sstable_t));
+    if (*sst == NULL) return -1;
+
+    (*sst)->filename = strdup(filename);
+    if ((*sst)->filename == NULL)
+    {
+        free(*sst);
+        *sst = NULL;
+        return -1;
+    }
+
+    if (pthread_mutex_init(&(*sst)->reader_lock, NULL) != 0)
+    {
+        free((*sst)->filename);
+        free(*sst);
+        *sst = NULL;
+        return -1;
+    }
+
+    (*sst)->described = true;
+    (*sst)->legacy_compressed = compressed;
+    (*sst)->compressed = compressed;
+    (*sst)->cache = cache;
+    if (cache != NULL && cache->block_cache != NULL)
+        (*sst)->block_cache_id = block_cache_new_id(cache->block_cache);
+    atomic_init(&(*sst)->refs, 1);
+
+    return 0;
+}
+
+int sstable_set_key_range(sstable_t *sst, const uint8_t *min_key, uint32_t min_key_size,
+                          const uint8_t *max_key, uint32_t max_key_size)
+{
+    /* a range we only know one end of does not prune anything, we keep neither */
+    if (min_key == NULL || max_key == NULL) return 0;
+
+    sst->min_key = malloc(min_key_size ? min_key_size : 1);
+    sst->max_key = malloc(max_key_size ? max_key_size : 1);
+    if (sst->min_key == NULL || sst->max_key == NULL)
+    {
+        free(sst->min_key);
+        free(sst->max_key);
+        sst->min_key = NULL;
+        sst->max_key = NULL;
+        return -1;
+    }
+
+    memcpy(sst->min_key, min_key, min_key_size);
+    sst->min_key_size = min_key_size;
+    memcpy(sst->max_key, max_key, max_key_size);
+    sst->max_key_size = max_key_size;
+
+    return 0;
+}
+
+void sstable_set_cache(sstable_t *sst, sstable_cache_t *cache)
+{
+    sst->cache = cache;
+    if (cache != NULL && cache->block_cache != NULL && sst->block_cache_id == 0)
+        sst->block_cache_id = block_cache_new_id(cache->block_cache);
+
+    /* a reader opened before it had a cache counts toward the capacity from now on */
+    if (cache != NULL && sst->pager != NULL)
+    {
+        sstable_map_reader(sst);
+        sstable_cache_touch(cache, sst);
+    }
+}
+
+void sstable_map_reader(sstable_t *sst)
+{
+    if (sst->pager == NULL || sst->cache == NULL || !sst->cache->mmap_reads) return;
+
+    /* mapping is an optimization, a file we cannot map is still read with pread */
+    (void)pager_map(sst->pager);
+}
+
+int sstable_acquire(sstable_t *sst)
+{
+    pthread_mutex_lock(&sst->reader_lock);
+
+    if (sst->pager == NULL)
+    {
+        if (sstable_open_reader(sst) == -1)
+        {
+            pthread_mutex_unlock(&sst->reader_lock);
+            return -1;
+        }
+
+        if (sst->cache != NULL) atomic_fetch_add(&sst->cache->opens, 1);
+    }
+
+    sst->pins++;
+    pthread_mutex_unlock(&sst->reader_lock);
+
+    /* the cache takes its own lock, we never hold the reader lock while waiting for it */
+    if (sst->cache != NULL) sstable_cache_touch(sst->cache, sst);
+
+    return 0;
+}
+
+void sstable_release(sstable_t *sst)
+{
+    pthread_mutex_lock(&sst->reader_lock);
+    sst->pins--;
+    pthread_mutex_unlock(&sst->reader_lock);
+}
+
+int sstable_open_reader(sstable_t *sst)
+{
+    /* a finished table is never written again, it is read with pread and no page locks */
+    pager_t *pager = NULL;
+    if (pager_open_immutable(sst->filename, &pager) == -1) return -1;
+
+    sst->pager = pager;
+    if (!sst->described) sst->size = (uint64_t)pager->num_pages * PAGE_SIZE;
+
+    /* the footer, index and filter are read from the mapping too */
+    sstable_map_reader(sst);
+
+    if (pager->num_pages == 0)
+    {
+        sst->version = SSTABLE_FORMAT_LEGACY;
+        sst->described = true;
+        return 0;
+    }
+
+    /* the footer is a single page record on the last page, if the last page does not decode as
+     * one the SSTable was written before the block format.  we decode it aside, what the handle
+     * was described with wins over what the footer says */
+    uint8_t *buffer = NULL;
+    size_t buffer_len = 0;
+    sstable_t footer = {0};
+    if (pager_read(pager, (unsigned int)(pager->num_pages - 1), &buffer, &buffer_len) == 0 &&
+        buffer_len <= PAGE_BODY && sstable_decode_footer(buffer, buffer_len, &footer) == 0)
+    {
+        free(buffer);
+
+        sst->version = footer.version;
+        sst->compressed = footer.compressed;
+        sst->blocked_bloom = footer.blocked_bloom;
+        sst->filter_page = footer.filter_page;
+        sst->index_page = footer.index_page;
+        sst->meta_page = footer.meta_page;
+        sst->num_blocks = footer.num_blocks;
+
+        if (!sst->described)
+        {
+            sst->num_entries = footer.num_entries;
+            sst->sequence = footer.sequence;
+            sst->file_number = footer.file_number;
+            sst->level = footer.level;
+        }
+
+        if (sst->filter_page >= pager->num_pages || sst->index_page >= pager->num_pages ||
+            (sst->version > SSTABLE_FORMAT_V1 && sst->meta_page >= pager->num_pages) ||
+            sstable_load_index(sst) == -1 || sstable_load_filter(sst) == -1 ||
+            (!sst->described && sstable_load_meta(sst) == -1))
+        {
+            sstable_close_reader(sst);
+            return -1;
+        }
+
+        sst->described = true;
+        return 0;
+    }
+
+    free(buffer);
+
+    /* a legacy SSTable records nothing about itself, only its filter is kept resident */
+    sst->version = SSTABLE_FORMAT_LEGACY;
+    sst->compressed = sst->legacy_compressed;
+    sst->blocked_bloom = false;
+    sst->num_blocks = 0;
+
+    if (sstable_load_filter(sst) == -1)
+    {
+        sstable_close_reader(sst);
+        return -1;
+    }
+
+    sst->described = true;
+    return 0;
+}
+
+void sstable_close_reader(sstable_t *sst)
+{
+    if (sst->index != NULL)
+    {
+        for (uint32_t i = 0; i < sst->num_blocks; i++) free(sst->index[i].last_key);
+        free(sst->index);
+        sst->index = NULL;
+    }
+
+    if (sst->bf != NULL) bloomfilter_destroy(sst->bf);
+    sst->bf = NULL;
+    blocked_bloomfilter_destroy(sst->filter);
+    sst->filter = NULL;
+
+    if (sst->pager != NULL) (void)pager_close(sst->pager);
+    sst->pager = NULL;
+}
+
+void sstable_close(sstable_t *sst)
+{
+    if (sst == NULL) return;
+
+    /* nothing references the table anymore, the cache must not close it under us */
+    if (sst->cache != NULL) sstable_cache_remove(sst->cache, sst);
+
+    sstable_close_reader(sst);
+
+    free(sst->min_key);
+    free(sst->max_key);
+    free(sst->filename);
+    pthread_mutex_destroy(&sst->reader_lock);
+
+    free(sst);
+}
+
+void sstable_ref(sstable_t *sst)
+{
+    atomic_fetch_add(&sst->refs, 1);
+}
+
+void sstable_unref(sstable_t *sst)
+{
+    if (sst == NULL || atomic_fetch_sub(&sst->refs, 1) != 1) return;
+
+    /* we were the last reference, nobody can read the table anymore */
+    char *filename = NULL;
+    if (atomic_load(&sst->obsolete)) filename = strdup(sst->filename);
+
+    sstable_close(sst);
+
+    if (filename != NULL)
+    {
+        remove(filename);
+        free(filename);
+    }
+}
+
+int sstable_cache_open(size_t capacity, bool mmap_reads, size_t block_cache_size,
+                       sstable_cache_t **cache)
+{
+    *cache = calloc(1, sizeof(sstable_cache_t));
+    if (*cache == NULL) return -1;
+
+    if (pthread_mutex_init(&(*cache)->lock, NULL) != 0)
+    {
+        free(*cache);
+        *cache = NULL;
+        return -1;
+    }
+
+    (*cache)->capacity = capacity ? capacity : 1;
+    (*cache)->mmap_reads = mmap_reads;
+
+    /* the readers share one budget for the blocks they decode */
+    if (block_cache_size > 0 && block_cache_open(block_cache_size, &(*cache)->block_cache) == -1)
+    {
+        pthread_mutex_destroy(&(*cache)->lock);
+        free(*cache);
+        *cache = NULL;
+        return -1;
+    }
+    atomic_init(&(*cache)->opens, 0);
+
+    return 0;
+}
+
+void sstable_cache_close(sstable_cache_t *cache)
+{
+    if (cache == NULL) return;
+
+    block_cache_close(cache->block_cache);
+
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+void sstable_cache_unlink(sstable_cache_t *cache, sstable_t *sst)
+{
+    if (sst->lru_prev != NULL)
+        sst->lru_prev->lru_next = sst->lru_next;
+    else
+        cache->head = sst->lru_next;
+
+    if (sst->lru_next != NULL)
+        sst->lru_next->lru_prev = sst->lru_prev;
+    else
+        cache->tail = sst->lru_prev;
+
+    sst->lru_prev = NULL;
+    sst->lru_next = NULL;
+}
+
+void sstable_cache_touch(sstable_cache_t *cache, sstable_t *sst)
+{
+    pthread_mutex_lock(&cache->lock);
+
+    if (sst->cached)
+    {
+        sstable_cache_unlink(cache, sst);
+    }
+    else
+    {
+        sst->cached = true;
+        cache->num_open++;
+    }
+
+    /* the most recently used reader goes to the head */
+    sst->lru_next = cache->head;
+    if (cache->head != NULL) cache->head->lru_prev = sst;
+    cache->head = sst;
+    if (cache->tail == NULL) cache->tail = sst;
+
+    /* we close readers from the tail until we are back within the capacity, a reader that is in
+     * use is skipped and closed by a later touch once it is not */
+    sstable_t *victim = cache->tail;
+    while (cache->num_open > cache->capacity && victim != NULL)
+    {
+        sstable_t *prev = victim->lru_prev;
+
+        if (victim != sst)
+        {
+            pthread_mutex_lock(&victim->reader_lock);
+            if (victim->pins == 0)
+            {
+                sstable_cache_unlink(cache, victim);
+                victim->cached = false;
+                cache->num_open--;
+                cache->evictions++;
+                sstable_close_reader(victim);
+            }
+            pthread_mutex_unlock(&victim->reader_lock);
+        }
+
+        victim = prev;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void sstable_cache_remove(sstable_cache_t *cache, sstable_t *sst)
+{
+    pthread_mutex_lock(&cache->lock);
+
+    if (sst->cached)
+    {
+        sstable_cache_unlink(cache, sst);
+        sst->cached = false;
+        cache->num_open--;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+int sstable_read_block(sstable_t *sst, uint32_t block_index, uint8_t **block, size_t *block_len)
+{
+    if (block_index >= sst->num_blocks) return -1;
+
+    /* a mapped block is copied or decompressed once, straight out of the page cache */
+    pager_view_t view;
+    if (sst->pager->map != NULL &&
+        pager_view(sst->pager, (unsigned int)sst->index[block_index].page, &view) == 0)
+    {
+        if (sst->compressed) return sstable_decompress_view(&view, block, block_len);
+
+        *block = malloc(view.len ? view.len : 1);
+        if (*block == NULL) return -1;
+
+        pager_view_copy(&view, 0, *block, view.len);
+        *block_len = view.len;
+        return 0;
+    }
+
+    uint8_t *buffer = NULL;
+    size_t buffer_len = 0;
+
+    if (pager_read(sst->pager, (unsigned int)sst->index[block_index].page, &buffer, &buffer_len) ==
+        -1)
+    {
+        free(buffer);
+        return -1;
+    }
+
+    if (!sst->compressed)
+    {
+        *block = buffer;
+        *block_len = buffer_len;
+        return 0;
+    }
+
+    /* we decompress the block, we use Zstandard for compression */
+    unsigned long long decompressed_size = ZSTD_getFrameContentSize(buffer, buffer_len);
+    if (decompressed_size == ZSTD_CONTENTSIZE_ERROR ||
+        decompressed_size == ZSTD_CONTENTSIZE_UNKNOWN)
+    {
+        free(buffer);
+        return -1;
+    }
+
+    *block = malloc(decompressed_size);
+    if (*block == NULL)
+    {
+        free(buffer);
+        return -1;
+    }
+
+    size_t result = ZSTD_decompress(*block, decompressed_size, buffer, buffer_len);
+    free(buffer);
+    if (ZSTD_isError(result))
+    {
+        free(*block);
+        *block = NULL;
+        return -1;
+    }
+
+    *block_len = result;
+    return 0;
+}
+
+int sstable_decompress_view(const pager_view_t *view, uint8_t **block, size_t *block_len)
+{
+    /* the frame header is at the start of the first page body */
+    size_t first = view->len < PAGE_BODY ? view->len : PAGE_BODY;
+    unsigned long long decompressed_size =
+        ZSTD_getFrameContentSize(pager_view_ptr(view, 0, first), first);
+    if (decompressed_size == ZSTD_CONTENTSIZE_ERROR ||
+        decompressed_size == ZSTD_CONTENTSIZE_UNKNOWN)
+        return -1;
+
+    *block = malloc(decompressed_size ? decompressed_size : 1);
+    if (*block == NULL) return -1;
+
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    if (dctx == NULL)
+    {
+        free(*block);
+        *block = NULL;
+        return -1;
+    }
+
+    /* we stream the page bodies into the decoder instead of gathering them first */
+    ZSTD_outBuffer out = {*block, decompressed_size, 0};
+    size_t remaining = 1;
+    for (size_t offset = 0; offset < view->len && remaining != 0 && !ZSTD_isError(remaining);)
+    {
+        size_t chunk = PAGE_BODY - offset % PAGE_BODY;
+        if (chunk > view->len - offset) chunk = view->len - offset;
+
+        ZSTD_inBuffer in = {pager_view_ptr(view, offset, chunk), chunk, 0};
+        while (in.pos < in.size && remaining != 0 && !ZSTD_isError(remaining))
+        {
+            size_t in_pos = in.pos;
+            size_t out_pos = out.pos;
+            remaining = ZSTD_decompressStream(dctx, &out, &in);
+
+            /* a frame larger than it said it was stops making progress once out is full */
+            if (in.pos == in_pos && out.pos == out_pos) break;
+        }
+
+        if (in.pos < in.size) break;
+
+        offset += chunk;
+    }
+
+    ZSTD_freeDCtx(dctx);
+
+    /* the frame must end within the block and fill exactly what it said it holds */
+    if (remaining != 0 || out.pos != decompressed_size)
+    {
+        free(*block);
+        *block = NULL;
+        return -1;
+    }
+
+    *block_len = out.pos;
+    return 0;
+}
+
+int sstable_view_get(const pager_view_t *view, const uint8_t *key, size_t key_size,
+                     uint8_t **value, size_t *value_size, int64_t *ttl)
+{
+    uint32_t num_entries = 0;
+    if (view->len < sizeof(uint32_t)) return -2;
+    pager_view_copy(view, 0, (uint8_t *)&num_entries, sizeof(uint32_t));
+
+    /* we scan the block where it lies, entries are sorted so we stop once we pass the key.  a
+     * block cut short is corrupt, it cannot tell us the key is not there */
+    size_t offset = sizeof(uint32_t);
+    for (uint32_t i = 0; i < num_entries; i++)
+    {
+        uint32_t entry_key_size;
+        uint32_t entry_value_size;
+
+        if (offset + sizeof(uint32_t) > view->len) return -2;
+        pager_view_copy(view, offset, (uint8_t *)&entry_key_size, sizeof(uint32_t));
+        offset += sizeof(uint32_t);
+        size_t key_offset = offset;
+        offset += entry_key_size;
+
+        if (offset + sizeof(uint32_t) > view->len) return -2;
+        pager_view_copy(view, offset, (uint8_t *)&entry_value_size, sizeof(uint32_t));
+        offset += sizeof(uint32_t);
+        size_t value_offset = offset;
+        offset += entry_value_size;
+
+        if (offset + sizeof(int64_t) > view->len) return -2;
+
+        /* a key split by a page header is the only thing we copy to compare */
+        const uint8_t *entry_key = pager_view_ptr(view, key_offset, entry_key_size);
+        uint8_t *split_key = NULL;
+        if (entry_key == NULL)
+        {
+            split_key = malloc(entry_key_size);
+            if (split_key == NULL) return -2;
+            pager_view_copy(view, key_offset, split_key, entry_key_size);
+            entry_key = split_key;
+        }
+
+        int cmp = sstable_compare_keys(entry_key, entry_key_size, key, key_size);
+        free(split_key);
+
+        if (cmp == 0)
+        {
+            *value = malloc(entry_value_size ? entry_value_size : 1);
+            if (*value == NULL) return -2;
+            pager_view_copy(view, value_offset, *value, entry_value_size);
+            *value_size = entry_value_size;
+            pager_view_copy(view, offset, (uint8_t *)ttl, sizeof(int64_t));
+
+            return 0;
+        }
+
+        if (cmp > 0) break;
+
+        offset += sizeof(int64_t);
+    }
+
+    return -1;
+}
+
+int64_t sstable_find_block(sstable_t *sst, const uint8_t *key, size_t key_size)
+{
+    uint32_t low = 0;
+    uint32_t high = sst->num_blocks;
+
+    /* we look for the first block whose last key is >= key */
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        if (sstable_compare_keys(sst->index[mid].last_key, sst->index[mid].last_key_size, key,
+                                 key_size) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low == sst->num_blocks) return -1;
+
+    return low;
+}
+
+int sstable_may_contain(sstable_t *sst, const uint8_t *key, size_t key_size, uint64_t hash)
+{
+    /* we check the key range first, it costs at most two compares */
+    if (sst->min_key != NULL &&
+        sstable_compare_keys(key, key_size, sst->min_key, sst->min_key_size) < 0)
+        return -1;
+
+    if (sst->max_key != NULL &&
+        sstable_compare_keys(key, key_size, sst->max_key, sst->max_key_size) > 0)
+        return -1;
+
+    /* the blocked filter reuses the hash the caller computed once for every SSTable */
+    if (sst->filter != NULL && blocked_bloomfilter_check(sst->filter, hash) != 0) return -1;
+
+    if (sst->bf != NULL && bloomfilter_check(sst->bf, key, (unsigned int)key_size) != 0)
+        return -1;
+
+    return 0;
+}
+
+int sstable_legacy_get(sstable_t *sst, const uint8_t *key, size_t key_size, uint64_t hash,
+                       uint8_t **value, size_t *value_size, int64_t *ttl)
+{
+    if (sstable_may_contain(sst, key, key_size, hash) == -1) return -1;
+
+    /* a legacy SSTable without pairs has no iterator */
+    sstable_iterator_t *it = NULL;
+    int rc = sstable_iterator_init(sst, &it);
+    if (rc != 0) return rc;
+
+    do
+    {
+        key_value_pair_t kv;
+        if (sstable_iterator_get(it, &kv) == -1)
+        {
+            rc = -2;
+            break;
+        }
+
+        if (sstable_compare_keys(kv.key, kv.key_size, key, key_size) == 0)
+        {
+            *value = malloc(kv.value_size ? kv.value_size : 1);
+            if (*value == NULL)
+            {
+                rc = -2;
+                break;
+            }
+            memcpy(*value, kv.value, kv.value_size);
+            *value_size = kv.value_size;
+            *ttl = kv.ttl;
+
+            sstable_iterator_free(it);
+            return 0;
+        }
+    } while ((rc = sstable_iterator_next(it)) == 0);
+
+    sstable_iterator_free(it);
+    return rc == -2 ? -2 : -1;
+}
+
+int sstable_get(sstable_t *sst, const uint8_t *key, size_t key_size, uint64_t hash,
+                uint8_t **value, size_t *value_size, int64_t *ttl)
+{
+    /* the key range is part of the handle, a key outside it leaves an idle table closed */
+    if (sst->min_key != NULL && sst->max_key != NULL &&
+        (sstable_compare_keys(key, key_size, sst->min_key, sst->min_key_size) < 0 ||
+         sstable_compare_keys(key, key_size, sst->max_key, sst->max_key_size) > 0))
+        return -1;
+
+    /* a reader we cannot open is an error, not a miss, the key may well be in the table */
+    if (sstable_acquire(sst) == -1) return -2;
+
+    int rc = sst->version == SSTABLE_FORMAT_LEGACY
+                 ? sstable_legacy_get(sst, key, key_size, hash, value, value_size, ttl)
+                 : sstable_block_get(sst, key, key_size, hash, value, value_size, ttl);
+
+    sstable_release(sst);
+
+    return rc;
+}
+
+int sstable_block_get(sstable_t *sst, const uint8_t *key, size_t key_size, uint64_t hash,
+                      uint8_t **value, size_t *value_size, int64_t *ttl)
+{
+    if (sst->num_blocks == 0) return -1;
+
+    /* we check the resident key range and filter first, a miss never touches the disk */
+    if (sstable_may_contain(sst, key, key_size, hash) == -1) return -1;
+
+    /* we find the only block that can hold the key */
+    int64_t block_index = sstable_find_block(sst, key, key_size);
+    if (block_index == -1) return -1;
+
+    /* an uncompressed block in a mapping is searched where it lies */
+    pager_view_t view;
+    if (sst->pager->map != NULL && !sst->compressed &&
+        pager_view(sst->pager, (unsigned int)sst->index[block_index].page, &view) == 0)
+        return sstable_view_get(&view, key, key_size, value, value_size, ttl);
+
+    /* a block in the block cache is searched without reading or decoding it again */
+    block_cache_t *block_cache = sst->cache != NULL ? sst->cache->block_cache : NULL;
+    uint64_t page = sst->index[block_index].page;
+    block_cache_entry_t *entry = NULL;
+    if (block_cache != NULL && sst->block_cache_id != 0)
+    {
+        entry = block_cache_lookup(block_cache, sst->block_cache_id, page);
+        if (entry == NULL)
+        {
+            uint8_t *block = NULL;
+            size_t block_len = 0;
+            if (sstable_read_block(sst, (uint32_t)block_index, &block, &block_len) == -1)
+                return -2;
+
+            entry = block_cache_insert(block_cache, sst->block_cache_id, page, block, block_len);
+            if (entry == NULL) return -2;
+        }
+
+        int rc = sstable_search_block(entry->data, entry->len, key, key_size, value, value_size,
+                                      ttl);
+        block_cache_release(block_cache, entry);
+        return rc;
+    }
+
+    uint8_t *block = NULL;
+    size_t block_len = 0;
+    if (sstable_read_block(sst, (uint32_t)block_index, &block, &block_len) == -1) return -2;
+
+    int rc = sstable_search_block(block, block_len, key, key_size, value, value_size, ttl);
+    free(block);
+    return rc;
+}
+
+int sstable_search_block(const uint8_t *block, size_t block_len, const uint8_t *key,
+                         size_t key_size, uint8_t **value, size_t *value_size, int64_t *ttl)
+{
+    uint32_t num_entries = 0;
+    if (block_len < sizeof(uint32_t)) return -2;
+    memcpy(&num_entries, block, sizeof(uint32_t));
+
+    /* we scan the block, entries are sorted so we stop once we pass the key.  a block cut short
+     * is corrupt, it cannot tell us the key is not there */
+    size_t offset = sizeof(uint32_t);
+    for (uint32_t i = 0; i < num_entries; i++)
+    {
+        uint32_t entry_key_size;
+        uint32_t entry_value_size;
+
+        if (offset + sizeof(uint32_t) > block_len) return -2;
+        memcpy(&entry_key_size, block + offset, sizeof(uint32_t));
+        offset += sizeof(uint32_t);
+        const uint8_t *entry_key = block + offset;
+        offset += entry_key_size;
+
+        if (offset + sizeof(uint32_t) > block_len) return -2;
+        memcpy(&entry_value_size, block + offset, sizeof(uint32_t));
+        offset += sizeof(uint32_t);
+        const uint8_t *entry_value = block + offset;
+        offset += entry_value_size;
+
+        if (offset + sizeof(int64_t) > block_len) return -2;
+
+        int cmp = sstable_compare_keys(entry_key, entry_key_size, key, key_size);
+        if (cmp == 0)
+        {
+            *value = malloc(entry_value_size ? entry_value_size : 1);
+            if (*value == NULL) return -2;
+            memcpy(*value, entry_value, entry_value_size);
+            *value_size = entry_value_size;
+            memcpy(ttl, block + offset, sizeof(int64_t));
+
+            return 0;
+        }
+
+        if (cmp > 0) break;
+
+        offset += sizeof(int64_t);
+    }
+
+    return -1;
+}
+
+int sstable_writer_open(const char *filename, size_t block_size, bool compressed,
+                        uint32_t bits_per_key, uint64_t sequence, uint64_t file_number,
+                        uint32_t level, sstable_writer_t **writer)
+{
+    *writer = calloc(1, sizeof(sstable_writer_t));
+    if (*writer == NULL) return -1;
+
+    /* the pager appends to what is there, a file a crash left under this name is not ours */
+    remove(filename);
+
+    if (pager_open(filename, &(*writer)->pager) == -1)
+    {
+        free(*writer);
+        *writer = NULL;
+        return -1;
+    }
+
+    (*writer)->block_size = block_size ? block_size : SSTABLE_DEFAULT_BLOCK_SIZE;
+    (*writer)->compressed = compressed;
+    (*writer)->sequence = sequence;
+    (*writer)->file_number = file_number;
+    (*writer)->level = level;
+    (*writer)->bits_per_key = bits_per_key ? bits_per_key : BLOCKED_BLOOMFILTER_DEFAULT_BITS;
+    (*writer)->block_cap = (*writer)->block_size;
+    (*writer)->block = malloc((*writer)->block_cap);
+
+    if ((*writer)->block == NULL)
+    {
+        sstable_writer_abandon(*writer);
+        *writer = NULL;
+        return -1;
+    }
+
+    /* the first 4 bytes of a data block hold its entry count */
+    (*writer)->block_len = sizeof(uint32_t);
+
+    return 0;
+}
+
+int sstable_writer_add(sstable_writer_t *writer, const uint8_t *key, size_t key_size,
+                       const uint8_t *value, size_t value_size, int64_t ttl)
+{
+    if (writer == NULL || key == NULL || (value == NULL && value_size > 0)) return -1;
+
+    size_t entry_size = sizeof(uint32_t) + key_size + sizeof(uint32_t) + value_size +
+                        sizeof(int64_t);
+
+    /* a single pair larger than the block size gets a block of its own */
+    if (writer->block_len + entry_size > writer->block_cap)
+    {
+        size_t new_cap = writer->block_cap * 2;
+        if (new_cap < writer->block_len + entry_size) new_cap = writer->block_len + entry_size;
+
+        uint8_t *new_block = realloc(writer->block, new_cap);
+        if (new_block == NULL) return -1;
+
+        writer->block = new_block;
+        writer->block_cap = new_cap;
+    }
+
+    /* the filter is sized from the key count once we know it, until then we keep the hashes */
+    if (writer->num_entries == writer->hashes_cap)
+    {
+        uint64_t new_cap = writer->hashes_cap ? writer->hashes_cap * 2 : 1024;
+        uint64_t *new_hashes = realloc(writer->hashes, new_cap * sizeof(uint64_t));
+        if (new_hashes == NULL) return -1;
+
+        writer->hashes = new_hashes;
+        writer->hashes_cap = new_cap;
+    }
+
+    uint32_t key_size32 = (uint32_t)key_size;
+    uint32_t value_size32 = (uint32_t)value_size;
+
+    /* pairs are added in sorted order so the first key is the smallest */
+    if (writer->num_entries == 0)
+    {
+        writer->first_key = malloc(key_size ? key_size : 1);
+        if (writer->first_key == NULL) return -1;
+        memcpy(writer->first_key, key, key_size);
+        writer->first_key_size = key_size32;
+    }
+
+    writer->last_entry = writer->block_len;
+
+    uint8_t *ptr = writer->block + writer->block_len;
+    memcpy(ptr, &key_size32, sizeof(uint32_t));
+    ptr += sizeof(uint32_t);
+    memcpy(ptr, key, key_size);
+    ptr += key_size;
+    memcpy(ptr, &value_size32, sizeof(uint32_t));
+    ptr += sizeof(uint32_t);
+    if (value_size > 0) memcpy(ptr, value, value_size);
+    ptr += value_size;
+    memcpy(ptr, &ttl, sizeof(int64_t));
+
+    writer->hashes[writer->num_entries] = blocked_bloomfilter_hash(key, key_size);
+
+    if (ttl != -1)
+    {
+        if (writer->num_ttl == 0 || ttl < writer->min_ttl) writer->min_ttl = ttl;
+        if (writer->num_ttl == 0 || ttl > writer->max_ttl) writer->max_ttl = ttl;
+        writer->num_ttl++;
+    }
+
+    writer->block_len += entry_size;
+    writer->block_entries++;
+    writer->num_entries++;
+
+    if (writer->block_len >= writer->block_size) return sstable_writer_flush_block(writer);
+
+    return 0;
+}
+
+int sstable_writer_flush_block(sstable_writer_t *writer)
+{
+    if (writer->block_entries == 0) return 0;
+
+    if (writer->num_blocks == writer->index_cap)
+    {
+        uint32_t new_cap = writer->index_cap ? writer->index_cap * 2 : 16;
+        sstable_index_entry_t *new_index =
+            realloc(writer->index, new_cap * sizeof(sstable_index_entry_t));
+        if (new_index == NULL) return -1;
+
+        writer->index = new_index;
+        writer->index_cap = new_cap;
+    }
+
+    memcpy(writer->block, &writer->block_entries, sizeof(uint32_t));
+
+    /* the last key of the block goes into the sparse index */
+    sstable_index_entry_t *entry = &writer->index[writer->num_blocks];
+    memcpy(&entry->last_key_size, writer->block + writer->last_entry, sizeof(uint32_t));
+    entry->last_key = malloc(entry->last_key_size ? entry->last_key_size : 1);
+    if (entry->last_key == NULL) return -1;
+    memcpy(entry->last_key, writer->block + writer->last_entry + sizeof(uint32_t),
+           entry->last_key_size);
+
+    uint8_t *data = writer->block;
+    size_t data_len = writer->block_len;
+    uint8_t *compressed_block = NULL;
+
+    if (writer->compressed)
+    {
+        size_t bound = ZSTD_compressBound(writer->block_len);
+        compressed_block = malloc(bound);
+        if (compressed_block == NULL)
+        {
+            free(entry->last_key);
+            return -1;
+        }
+
+        data_len = ZSTD_compress(compressed_block, bound, writer->block, writer->block_len, 1);
+        if (ZSTD_isError(data_len))
+        {
+            free(compressed_block);
+            free(entry->last_key);
+            return -1;
+        }
+        data = compressed_block;
+    }
+
+    unsigned int page;
+    int rc = pager_write(writer->pager, data, data_len, &page);
+    free(compressed_block);
+    if (rc == -1)
+    {
+        free(entry->last_key);
+        return -1;
+    }
+
+    entry->page = page;
+    writer->num_blocks++;
+
+    writer->block_len = sizeof(uint32_t);
+    writer->block_entries = 0;
+
+    /* a block grown for an oversized pair is shrunk back to the block size */
+    if (writer->block_cap > writer->block_size * 2)
+    {
+        uint8_t *new_block = realloc(writer->block, writer->block_size);
+        if (new_block != NULL)
+        {
+            writer->block = new_block;
+            writer->block_cap = writer->block_size;
+        }
+    }
+
+    return 0;
+}
+
+int sstable_writer_finish(sstable_writer_t *writer, sstable_t **sst)
+{
+    if (sstable_writer_flush_block(writer) == -1) return -1;
+
+    *sst = calloc(1, sizeof(sstable_t));
+    if (*sst == NULL) return -1;
+
+    (*sst)->version = SSTABLE_FORMAT_VERSION;
+    (*sst)->compressed = writer->compressed;
+    (*sst)->described = true;
+    atomic_init(&(*sst)->refs, 1);
+    (*sst)->num_entries = writer->num_entries;
+    (*sst)->num_blocks = writer->num_blocks;
+    (*sst)->sequence = writer->sequence;
+    (*sst)->file_number = writer->file_number;
+    (*sst)->level = writer->level;
+    (*sst)->blocked_bloom = true;
+    (*sst)->num_tombstones = writer->num_tombstones;
+    (*sst)->num_ttl = writer->num_ttl;
+    (*sst)->min_ttl = writer->min_ttl;
+    (*sst)->max_ttl = writer->max_ttl;
+
+    /* we build the filter now that we know how many keys it holds */
+    (*sst)->filter = blocked_bloomfilter_create(writer->num_entries, writer->bits_per_key);
+    if ((*sst)->filter == NULL) goto fail;
+
+    for (uint64_t i = 0; i < writer->num_entries; i++)
+        blocked_bloomfilter_add((*sst)->filter, writer->hashes[i]);
+
+    /* we write the filter block */
+    uint8_t *buffer = NULL;
+    size_t buffer_len = 0;
+    if (serialize_blocked_bloomfilter((*sst)->filter, &buffer, &buffer_len, writer->compressed) ==
+        -1)
+        goto fail;
+
+    unsigned int page;
+    if (pager_write(writer->pager, buffer, buffer_len, &page) == -1)
+    {
+        free(buffer);
+        goto fail;
+    }
+    free(buffer);
+    (*sst)->filter_page = page;
+
+    /* we write the index block */
+    buffer_len = sizeof(uint32_t);
+    for (uint32_t i = 0; i < writer->num_blocks; i++)
+        buffer_len += sizeof(uint64_t) + sizeof(uint32_t) + writer->index[i].last_key_size;
+
+    buffer = malloc(buffer_len);
+    if (buffer == NULL) goto fail;
+
+    uint8_t *ptr = buffer;
+    memcpy(ptr, &writer->num_blocks, sizeof(uint32_t));
+    ptr += sizeof(uint32_t);
+    for (uint32_t i = 0; i < writer->num_blocks; i++)
+    {
+        memcpy(ptr, &writer->index[i].page, sizeof(uint64_t));
+        ptr += sizeof(uint64_t);
+        memcpy(ptr, &writer->index[i].last_key_size, sizeof(uint32_t));
+        ptr += sizeof(uint32_t);
+        memcpy(ptr, writer->index[i].last_key, writer->index[i].last_key_size);
+        ptr += writer->index[i].last_key_size;
+    }
+
+    if (pager_write(writer->pager, buffer, buffer_len, &page) == -1)
+    {
+        free(buffer);
+        goto fail;
+    }
+    free(buffer);
+    (*sst)->index_page = page;
+
+    /* we write the meta block, the smallest and largest key and the entry statistics */
+    uint32_t max_key_size = writer->num_blocks ? writer->index[writer->num_blocks - 1].last_key_size
+                                               : 0;
+    buffer_len = sizeof(uint32_t) + writer->first_key_size + sizeof(uint32_t) + max_key_size +
+                 SSTABLE_META_STATS_SIZE;
+    buffer = malloc(buffer_len);
+    if (buffer == NULL) goto fail;
+
+    ptr = buffer;
+    memcpy(ptr, &writer->first_key_size, sizeof(uint32_t));
+    ptr += sizeof(uint32_t);
+    if (writer->first_key_size > 0) memcpy(ptr, writer->first_key, writer->first_key_size);
+    ptr += writer->first_key_size;
+    memcpy(ptr, &max_key_size, sizeof(uint32_t));
+    ptr += sizeof(uint32_t);
+    if (max_key_size > 0)
+        memcpy(ptr, writer->index[writer->num_blocks - 1].last_key, max_key_size);
+    ptr += max_key_size;
+    memcpy(ptr, &writer->num_tombstones, sizeof(uint64_t));
+    memcpy(ptr + 8, &writer->num_ttl, sizeof(uint64_t));
+    memcpy(ptr + 16, &writer->min_ttl, sizeof(int64_t));
+    memcpy(ptr + 24, &writer->max_ttl, sizeof(int64_t));
+
+    if (pager_write(writer->pager, buffer, buffer_len, &page) == -1)
+    {
+        free(buffer);
+        goto fail;
+    }
+    free(buffer);
+    (*sst)->meta_page = page;
+
+    /* we write the footer last, a table without one is never treated as finished */
+    uint8_t footer[SSTABLE_FOOTER_SIZE];
+    sstable_encode_footer(*sst, footer);
+    if (pager_write(writer->pager, footer, SSTABLE_FOOTER_SIZE, &page) == -1) goto fail;
+
+    /* the table is synced once here and never written again, it is durable before anything
+     * records it */
+    if (pager_sync(writer->pager) == -1) goto fail;
+    if (pager_seal(writer->pager) == -1) goto fail;
+
+    (*sst)->filename = strdup(writer->pager->filename);
+    if ((*sst)->filename == NULL) goto fail;
+
+    if (pthread_mutex_init(&(*sst)->reader_lock, NULL) != 0)
+    {
+        free((*sst)->filename);
+        goto fail;
+    }
+
+    /* the SSTable takes over the pager and the index and keeps the filter it was built with, so a
+     * table we just wrote never has to read them back */
+    (*sst)->pager = writer->pager;
+    (*sst)->index = writer->index;
+    (*sst)->size = (uint64_t)writer->pager->num_pages * PAGE_SIZE;
+
+    if (writer->num_blocks > 0)
+    {
+        (*sst)->min_key = writer->first_key;
+        (*sst)->min_key_size = writer->first_key_size;
+        writer->first_key = NULL;
+
+        sstable_index_entry_t *last = &writer->index[writer->num_blocks - 1];
+        (*sst)->max_key = malloc(last->last_key_size ? last->last_key_size : 1);
+        if ((*sst)->max_key != NULL)
+        {
+            memcpy((*sst)->max_key, last->last_key, last->last_key_size);
+            (*sst)->max_key_size = last->last_key_size;
+        }
+        else
+        {
+            /* without a resident max key we simply do not prune on the upper bound */
+            free((*sst)->min_key);
+            (*sst)->min_key = NULL;
+            (*sst)->min_key_size = 0;
+        }
+    }
+
+    free(writer->first_key);
+    free(writer->hashes);
+    free(writer->block);
+    free(writer);
+
+    return 0;
+
+fail:
+    blocked_bloomfilter_destroy((*sst)->filter);
+    free(*sst);
+    *sst = NULL;
+    return -1;
+}
+
+uint64_t sstable_writer_size(sstable_writer_t *writer)
+{
+    return (uint64_t)writer->pager->num_pages * PAGE_SIZE + writer->block_len;
+}
+
+uint64_t sstable_size(sstable_t *sst)
+{
+    return sst->size;
+}
+
+bool sstable_overlaps(sstable_t *sst, const uint8_t *min_key, size_t min_key_size,
+                      const uint8_t *max_key, size_t max_key_size)
+{
+    if (sst->min_key == NULL || sst->max_key == NULL) return true;
+
+    /* the ranges are disjoint only if one ends before the other starts */
+    if (max_key != NULL &&
+        sstable_compare_keys(sst->min_key, sst->min_key_size, max_key, max_key_size) > 0)
+        return false;
+
+    if (min_key != NULL &&
+        sstable_compare_keys(sst->max_key, sst->max_key_size, min_key, min_key_size) < 0)
+        return false;
+
+    return true;
+}
+
+uint64_t sstable_expired_entries(sstable_t *sst, int64_t now)
+{
+    if (sst->num_ttl == 0 || now < sst->min_ttl) return 0;
+    if (now >= sst->max_ttl) return sst->num_ttl;
+
+    /* we only know the earliest and the latest ttl, we assume the ones between are spread evenly */
+    double expired = (double)(now - sst->min_ttl) / (double)(sst->max_ttl - sst->min_ttl);
+
+    return (uint64_t)(expired * (double)sst->num_ttl);
+}
+
+void sstable_writer_abandon(sstable_writer_t *writer)
+{
+    if (writer == NULL) return;
+
+    char *filename = NULL;
+    if (writer->pager != NULL)
+    {
+        filename = strdup(writer->pager->filename);
+        (void)pager_close(writer->pager);
+    }
+
+    if (filename != NULL)
+    {
+        (void)remove(filename);
+        free(filename);
+    }
+
+    if (writer->index != NULL)
+    {
+        for (uint32_t i = 0; i < writer->num_blocks; i++) free(writer->index[i].last_key);
+        free(writer->index);
+    }
+
+    free(writer->hashes);
+    free(writer->first_key);
+    free(writer->block);
+    free(writer);
+}
+
+int sstable_iterator_load_block(sstable_iterator_t *it, uint32_t block_index)
+{
+    uint8_t *block = NULL;
+    size_t block_len = 0;
+
+    if (sstable_read_block(it->sst, block_index, &block, &block_len) == -1) return -1;
+
+    uint32_t num_entries;
+    if (block_len < sizeof(uint32_t))
+    {
+        free(block);
+        return -1;
+    }
+    memcpy(&num_entries, block, sizeof(uint32_t));
+
+    size_t *offsets = malloc((num_entries ? num_entries : 1) * sizeof(size_t));
+    if (offsets == NULL)
+    {
+        free(block);
+        return -1;
+    }
+
+    /* we index the entries of the block so we can move in both directions */
+    size_t offset = sizeof(uint32_t);
+    for (uint32_t i = 0; i < num_entries; i++)
+    {
+        uint32_t size;
+
+        offsets[i] = offset;
+
+        if (offset + sizeof(uint32_t) > block_len) goto corrupt;
+        memcpy(&size, block + offset, sizeof(uint32_t));
+        offset += sizeof(uint32_t) + size;
+
+        if (offset + sizeof(uint32_t) > block_len) goto corrupt;
+        memcpy(&size, block + offset, sizeof(uint32_t));
+        offset += sizeof(uint32_t) + size + sizeof(int64_t);
+
+        if (offset > block_len) goto corrupt;
+    }
+
+    free(it->block);
+    free(it->offsets);
+
+    it->block = block;
+    it->offsets = offsets;
+    it->num_entries = num_entries;
+    it->block_index = block_index;
+    it->entry_index = 0;
+
+    return 0;
+
+corrupt:
+    free(offsets);
+    free(block);
+    return -1;
+}
+
+int sstable_iterator_init(sstable_t *sst, sstable_iterator_t **it)
+{
+    /* the reader stays open for as long as the iterator is around */
+    if (sstable_acquire(sst) == -1) return -2;
+
+    *it = calloc(1, sizeof(sstable_iterator_t));
+    if (*it == NULL)
+    {
+        sstable_release(sst);
+        return -2;
+    }
+
+    (*it)->sst = sst;
+    sstable_begin_scan(sst);
+
+    if (sst->version != SSTABLE_FORMAT_LEGACY)
+    {
+        if (sst->num_blocks == 0 || sstable_iterator_load_block(*it, 0) == -1)
+        {
+            int rc = sst->num_blocks == 0 ? -1 : -2;
+            sstable_iterator_free(*it);
+            *it = NULL;
+            return rc;
+        }
+
+        return 0;
+    }
+
+    if (pager_cursor_init(sst->pager, &(*it)->legacy_cursor) == -1)
+    {
+        sstable_iterator_free(*it);
+        *it = NULL;
+        return -2;
+    }
+
+    /* we skip the bloom filter pages at the start of a legacy SSTable */
+    uint8_t *buffer = NULL;
+    size_t buffer_len = 0;
+    if (pager_read(sst->pager, 0, &buffer, &buffer_len) == -1)
+    {
+        free(buffer);
+        sstable_iterator_free(*it);
+        *it = NULL;
+        return -2;
+    }
+    free(buffer);
+
+    (*it)->legacy_first_page = (unsigned int)((buffer_len + PAGE_BODY - 1) / PAGE_BODY);
+    if ((*it)->legacy_first_page >= sst->pager->num_pages)
+    {
+        sstable_iterator_free(*it);
+        *it = NULL;
+        return -1;
+    }
+
+    /* the cursor holds the first page of the current key-value pair */
+    (*it)->legacy_cursor->page_number = (*it)->legacy_first_page;
+
+    return 0;
+}
+
+int sstable_iterator_next(sstable_iterator_t *it)
+{
+    if (it->legacy_cursor != NULL)
+    {
+        /* a pair can span overflow pages, so we step over all of its pages */
+        uint8_t *buffer = NULL;
+        size_t buffer_len = 0;
+        if (pager_read(it->sst->pager, it->legacy_cursor->page_number, &buffer, &buffer_len) ==
+            -1)
+        {
+            free(buffer);
+            return -2;
+        }
+        free(buffer);
+
+        unsigned int next_page = it->legacy_cursor->page_number +
+                                 (unsigned int)((buffer_len + PAGE_BODY - 1) / PAGE_BODY);
+        if (next_page >= it->sst->pager->num_pages) return -1;
+        it->legacy_cursor->page_number = next_page;
+
+        if (it->legacy_kv != NULL)
+        {
+            free(it->legacy_kv->key);
+            free(it->legacy_kv->value);
+            free(it->legacy_kv);
+            it->legacy_kv = NULL;
+        }
+
+        return 0;
+    }
+
+    if (it->entry_index + 1 < it->num_entries)
+    {
+        it->entry_index++;
+        return 0;
+    }
+
+    if (it->block_index + 1 >= it->sst->num_blocks) return -1;
+
+    /* a block we cannot read is not the end of the SSTable */
+    return sstable_iterator_load_block(it, it->block_index + 1) == -1 ? -2 : 0;
+}
+
+int sstable_iterator_prev(sstable_iterator_t *it)
+{
+    if (it->legacy_cursor != NULL)
+    {
+        /* we never move back onto the bloom filter pages */
+        unsigned int page = it->legacy_cursor->page_number;
+        if (page <= it->legacy_first_page) return -1;
+
+        /* the page before us ends the previous pair, the pair before that ends where it starts */
+        if (pager_cursor_prev(it->legacy_cursor) == -1 ||
+            pager_cursor_prev(it->legacy_cursor) == -1)
+        {
+            it->legacy_cursor->page_number = page;
+            return -1;
+        }
+        it->legacy_cursor->page_number++;
+
+        if (it->legacy_kv != NULL)
+        {
+            free(it->legacy_kv->key);
+            free(it->legacy_kv->value);
+            free(it->legacy_kv);
+            it->legacy_kv = NULL;
+        }
+
+        return 0;
+    }
+
+    if (it->entry_index > 0)
+    {
+        it->entry_index--;
+        return 0;
+    }
+
+    if (it->block_index == 0) return -1;
+
+    if (sstable_iterator_load_block(it, it->block_index - 1) == -1) return -2;
+    it->entry_index = it->num_entries ? it->num_entries - 1 : 0;
+
+    return 0;
+}
+
+int sstable_iterator_get(sstable_iterator_t *it, key_value_pair_t *kv)
+{
+    if (it->legacy_cursor != NULL)
+    {
+        if (it->legacy_kv == NULL)
+        {
+            uint8_t *buffer = NULL;
+            size_t buffer_len = 0;
+
+            if (pager_read(it->sst->pager, it->legacy_cursor->page_number, &buffer, &buffer_len) ==
+                -1)
+            {
+                free(buffer);
+                return -1;
+            }
+
+            if (deserialize_key_value_pair(buffer, buffer_len, &it->legacy_kv,
+                                           it->sst->compressed) == -1)
+            {
+                free(buffer);
+                it->legacy_kv = NULL;
+                return -1;
+            }
+            free(buffer);
+        }
+
+        *kv = *it->legacy_kv;
+        return 0;
+    }
+
+    if (it->entry_index >= it->num_entries) return -1;
+
+    const uint8_t *ptr = it->block + it->offsets[it->entry_index];
+
+    memcpy(&kv->key_size, ptr, sizeof(uint32_t));
+    ptr += sizeof(uint32_t);
+    kv->key = (uint8_t *)ptr;
+    ptr += kv->key_size;
+    memcpy(&kv->value_size, ptr, sizeof(uint32_t));
+    ptr += sizeof(uint32_t);
+    kv->value = (uint8_t *)ptr;
+    ptr += kv->value_size;
+    memcpy(&kv->ttl, ptr, sizeof(int64_t));
+
+    return 0;
+}
+
+void sstable_iterator_free(sstable_iterator_t *it)
+{
+    if (it == NULL) return;
+
+    if (it->legacy_cursor != NULL) pager_cursor_free(it->legacy_cursor);
+
+    if (it->legacy_kv != NULL)
+    {
+        free(it->legacy_kv->key);
+        free(it->legacy_kv->value);
+        free(it->legacy_kv);
+    }
+
+    free(it->block);
+    free(it->offsets);
+
+    if (it->sst != NULL)
+    {
+        sstable_end_scan(it->sst);
+        sstable_release(it->sst);
+    }
+
+    free(it);
+}
+
+void sstable_begin_scan(sstable_t *sst)
+{
+    pthread_mutex_lock(&sst->reader_lock);
+
+    /* the first scan turns readahead on, point reads of the table meanwhile get it too */
+    if (sst->scans++ == 0) (void)pager_advise(sst->pager, MADV_SEQUENTIAL);
+
+    pthread_mutex_unlock(&sst->reader_lock);
+}
+
+void sstable_end_scan(sstable_t *sst)
+{
+    pthread_mutex_lock(&sst->reader_lock);
+
+    if (--sst->scans == 0) (void)pager_advise(sst->pager, MADV_RANDOM);
+
+    pthread_mutex_unlock(&sst->reader_lock);
+}
+
+bool sstable_merge_iterator_less(sstable_merge_iterator_t *it, uint32_t a, uint32_t b)
+{
+    key_value_pair_t kv_a;
+    key_value_pair_t kv_b;
+
+    /* an input in the heap always has a current pair, a failed read sorts last */
+    if (sstable_iterator_get(it->inputs[a], &kv_a) == -1) return false;
+    if (sstable_iterator_get(it->inputs[b], &kv_b) == -1) return true;
+
+    int cmp = sstable_compare_keys(kv_a.key, kv_a.key_size, kv_b.key, kv_b.key_size);
+    if (cmp != 0) return cmp < 0;
+
+    /* inputs are ordered oldest first, so the higher input holds the newer version */
+    return a > b;
+}
+
+void sstable_merge_iterator_sift_down(sstable_merge_iterator_t *it, uint32_t pos)
+{
+    while (true)
+    {
+        uint32_t smallest = pos;
+        uint32_t left = pos * 2 + 1;
+        uint32_t right = left + 1;
+
+        if (left < it->heap_len &&
+            sstable_merge_iterator_less(it, it->heap[left], it->heap[smallest]))
+            smallest = left;
+        if (right < it->heap_len &&
+            sstable_merge_iterator_less(it, it->heap[right], it->heap[smallest]))
+            smallest = right;
+
+        if (smallest == pos) return;
+
+        uint32_t tmp = it->heap[pos];
+        it->heap[pos] = it->heap[smallest];
+        it->heap[smallest] = tmp;
+        pos = smallest;
+    }
+}
+
+int sstable_merge_iterator_init(sstable_t **ssts, uint32_t num_ssts, sstable_merge_iterator_t **it)
+{
+    *it = calloc(1, sizeof(sstable_merge_iterator_t));
+    if (*it == NULL) return -1;
+
+    (*it)->inputs = calloc(num_ssts ? num_ssts : 1, sizeof(sstable_iterator_t *));
+    (*it)->heap = malloc((num_ssts ? num_ssts : 1) * sizeof(uint32_t));
+    if ((*it)->inputs == NULL || (*it)->heap == NULL)
+    {
+        sstable_merge_iterator_free(*it);
+        *it = NULL;
+        return -1;
+    }
+
+    (*it)->num_inputs = num_ssts;
+
+    /* an empty SSTable has no iterator and never enters the heap */
+    for (uint32_t i = 0; i < num_ssts; i++)
+    {
+        if (ssts[i]->version != SSTABLE_FORMAT_LEGACY && ssts[i]->num_blocks == 0) continue;
+
+        int rc = sstable_iterator_init(ssts[i], &(*it)->inputs[i]);
+        if (rc != 0)
+        {
+            /* a legacy SSTable without pairs has no iterator, an input we cannot read is an
+             * error as merging without it would lose its pairs */
+            (*it)->inputs[i] = NULL;
+            if (rc == -1) continue;
+
+            sstable_merge_iterator_free(*it);
+            *it = NULL;
+            return -1;
+        }
+
+        (*it)->heap[(*it)->heap_len++] = i;
+    }
+
+    /* we heapify bottom up */
+    for (uint32_t i = (*it)->heap_len / 2; i > 0; i--) sstable_merge_iterator_sift_down(*it, i - 1);
+
+    return 0;
+}
+
+int sstable_merge_iterator_get(sstable_merge_iterator_t *it, key_value_pair_t *kv)
+{
+    if (it->heap_len == 0) return -1;
+
+    return sstable_iterator_get(it->inputs[it->heap[0]], kv);
+}
+
+int sstable_merge_iterator_next(sstable_merge_iterator_t *it)
+{
+    if (it->heap_len == 0) return -1;
+
+    /* we take the newest version off the heap but leave its iterator in place, the current key
+     * points into its block and we still need it to find the older versions */
+    uint32_t top = it->heap[0];
+    key_value_pair_t current;
+    if (sstable_iterator_get(it->inputs[top], &current) == -1) return -1;
+
+    it->heap[0] = it->heap[--it->heap_len];
+    sstable_merge_iterator_sift_down(it, 0);
+
+    /* the older versions of the current key are at the top of the heap, we skip them */
+    while (it->heap_len > 0)
+    {
+        uint32_t input = it->heap[0];
+        key_value_pair_t kv;
+        if (sstable_iterator_get(it->inputs[input], &kv) == -1 ||
+            sstable_compare_keys(kv.key, kv.key_size, current.key, current.key_size) != 0)
+            break;
+
+        int rc = sstable_iterator_next(it->inputs[input]);
+        if (rc == -2) return -2;
+
+        if (rc == 0)
+        {
+            sstable_merge_iterator_sift_down(it, 0);
+        }
+        else
+        {
+            it->heap[0] = it->heap[--it->heap_len];
+            sstable_merge_iterator_sift_down(it, 0);
+        }
+    }
+
+    /* now we advance the input we took off and put it back */
+    int rc = sstable_iterator_next(it->inputs[top]);
+    if (rc == -2) return -2;
+
+    if (rc == 0)
+    {
+        uint32_t pos = it->heap_len++;
+        it->heap[pos] = top;
+
+        while (pos > 0)
+        {
+            uint32_t parent = (pos - 1) / 2;
+            if (!sstable_merge_iterator_less(it, it->heap[pos], it->heap[parent])) break;
+
+            uint32_t tmp = it->heap[pos];
+            it->heap[pos] = it->heap[parent];
+            it->heap[parent] = tmp;
+            pos = parent;
+        }
+    }
+
+    return it->heap_len > 0 ? 0 : -1;
+}
+
+void sstable_merge_iterator_free(sstable_merge_iterator_t *it)
+{
+    if (it == NULL) return;
+
+    if (it->inputs != NULL)
+    {
+        for (uint32_t i = 0; i < it->num_inputs; i++) sstable_iterator_free(it->inputs[i]);
+        free(it->inputs);
+    }
+
+    free(it->heap);
+    free(it);
+}
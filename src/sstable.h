@@ -0,0 +1,859 @@
+/*
+ *
+ * Copyright (C) TidesDB
+ *
+ * Original Author: Alex Gaetano Padula
+ *
+ * Licensed under the Mozilla Public License, v. 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.mozilla.org/en-US/MPL/2.0/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SSTABLE_H
+#define SSTABLE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zstd.h>
+
+#include "block_cache.h"
+#include "bloomfilter.h"
+#include "pager.h"
+#include "serialize.h"
+
+/*
+ * An SSTable is a sequence of pager records laid out as
+ *
+ * [data block 0] ... [data block n-1] [filter block] [index block] [meta block] [footer]
+ *
+ * a data block holds sorted key-value pairs up to the configured block size, the index block holds
+ * the last key of every data block and the page the block starts at, the meta block holds the
+ * smallest and largest key followed by the entry statistics, and the footer is a single fixed size
+ * record on the last page of the file. Version 1 tables have no meta block and a shorter footer.
+ * Tables written before the block format (one key-value pair per page, bloom filter in the initial
+ * page(s)) have no footer and are read as SSTABLE_FORMAT_LEGACY.
+ *
+ * The footer also records the level of the LSM tree the table was written for, tables written
+ * before levels were introduced carry 0 there and belong to level 0.  Version 3 footers add the
+ * file number the table was named with, older tables have none and read it as 0.
+ *
+ * An open table is a handle and a reader.  The handle holds what the table is, its file name,
+ * level, sequence, key range and entry statistics, and lives as long as the table is referenced.
+ * The reader holds the pager, the index and the filter, which are read when the reader is opened
+ * (or kept from the writer when the table is created) and stay resident until it is closed.
+ *
+ * A table opened lazily is only a handle, its reader is opened on first access.  Tables given a
+ * table cache keep their readers in the cache's LRU, the least recently used reader that nothing
+ * is reading from is closed once the cache holds more than its capacity.  A reader in use is
+ * never closed, so the capacity can be exceeded while more tables than that are read at once.
+ *
+ * An open table is reference counted, it is closed when its last reference is released and its
+ * file is removed as well if it was marked obsolete.
+ */
+
+#define BLOOMFILTER_SIZE                                                                     \
+    1000 /* size of each chained bloom filter in older SSTables.  Bloom filters are linked once \
+            they reach this size in occupied capacity */
+#define SSTABLE_MAGIC              0x3142545353424454ULL /* "TDBSSTB1" footer magic */
+#define SSTABLE_FORMAT_LEGACY      0     /* one key-value pair per page, no footer */
+#define SSTABLE_FORMAT_V1          1     /* block based format without a meta block */
+#define SSTABLE_FORMAT_V2          2     /* block based format without a file number */
+#define SSTABLE_FORMAT_VERSION     3     /* current block based format version */
+#define SSTABLE_FOOTER_V1_SIZE     48    /* encoded size of a version 1 footer */
+#define SSTABLE_FOOTER_V2_SIZE     64    /* encoded size of a version 2 footer */
+#define SSTABLE_FOOTER_SIZE        72    /* encoded size of the footer */
+#define SSTABLE_FLAG_COMPRESSED    0x1   /* data blocks are compressed with zstd */
+#define SSTABLE_FLAG_BLOCKED_BLOOM 0x2   /* the filter block holds a blocked bloom filter */
+#define SSTABLE_DEFAULT_BLOCK_SIZE 4096  /* default target size of a data block in bytes */
+#define SSTABLE_MIN_BLOCK_SIZE     4096  /* smallest configurable data block size */
+#define SSTABLE_MAX_BLOCK_SIZE     65536 /* largest configurable data block size */
+#define SSTABLE_META_STATS_SIZE    32    /* encoded size of the meta block entry statistics */
+
+typedef struct sstable_t sstable_t;
+
+/*
+ * sstable_index_entry_t
+ * an entry in the sparse index of an SSTable, one per data block
+ * @param last_key the last key in the data block
+ * @param last_key_size the size of the last key
+ * @param page the page number the data block starts at
+ */
+typedef struct
+{
+    uint8_t *last_key;      /* the last key in the data block */
+    uint32_t last_key_size; /* the size of the last key */
+    uint64_t page;          /* the page number the data block starts at */
+} sstable_index_entry_t;
+
+/*
+ * sstable_t
+ * struct for the SSTable
+ * @param filename the filename of the SSTable
+ * @param described whether the handle fields are known, a lazily opened SSTable is described by
+ * its caller and an SSTable opened from its file when its reader is first opened
+ * @param legacy_compressed whether the data of a legacy SSTable is compressed, it has no footer to
+ * record it
+ * @param size the size of the SSTable file in bytes
+ * @param pager the pager for the SSTable, NULL while the reader is closed
+ * @param version the format version of the SSTable
+ * @param compressed whether the SSTable data is compressed
+ * @param num_entries the number of key-value pairs in the SSTable
+ * @param filter_page the page number of the filter block
+ * @param index_page the page number of the index block
+ * @param num_blocks the number of data blocks
+ * @param index the sparse index, one entry per data block
+ * @param meta_page the page number of the meta block
+ * @param sequence the file sequence number, higher is newer
+ * @param file_number the number the file was named with, 0 for tables from before file numbers
+ * @param level the level of the LSM tree the SSTable belongs to
+ * @param bf the resident chained bloom filter of an older SSTable, NULL otherwise
+ * @param filter the resident blocked bloom filter, NULL for older SSTables
+ * @param blocked_bloom whether the filter block holds a blocked bloom filter
+ * @param min_key the smallest key in the SSTable, NULL if unknown
+ * @param min_key_size the size of the smallest key
+ * @param max_key the largest key in the SSTable, NULL if unknown
+ * @param max_key_size the size of the largest key
+ * @param num_tombstones the number of entries marked as tombstones by the writer
+ * @param num_ttl the number of entries with a ttl
+ * @param min_ttl the earliest ttl in the SSTable, 0 if no entry has one
+ * @param max_ttl the latest ttl in the SSTable, 0 if no entry has one
+ * @param refs the number of references to the SSTable
+ * @param obsolete whether the file is removed once the last reference is released
+ * @param reader_lock lock for opening and closing the reader and for its pins
+ * @param pins the number of reads using the reader, it is not closed while there are any
+ * @param scans the number of iterators reading the reader, a mapped file is advised for sequential
+ * access while there are any
+ * @param cache the table cache the reader is kept in, NULL if it stays open
+ * @param block_cache_id the id the data blocks of the SSTable are cached under, 0 if they are not
+ * @param cached whether the reader is in the LRU of the cache, guarded by the cache lock
+ * @param lru_prev the more recently used reader in the cache
+ * @param lru_next the less recently used reader in the cache
+ */
+struct sstable_t
+{
+    char *filename;                   /* the filename of the SSTable */
+    bool described;                   /* whether the handle fields are known */
+    bool legacy_compressed;           /* whether the data of a legacy SSTable is compressed */
+    uint64_t size;                    /* the size of the SSTable file in bytes */
+    pager_t *pager;                   /* the pager for the SSTable, NULL while closed */
+    uint32_t version;                 /* the format version of the SSTable */
+    bool compressed;                  /* whether the SSTable data is compressed */
+    uint64_t num_entries;             /* the number of key-value pairs in the SSTable */
+    uint64_t filter_page;             /* the page number of the filter block */
+    uint64_t index_page;              /* the page number of the index block */
+    uint32_t num_blocks;              /* the number of data blocks */
+    sstable_index_entry_t *index;     /* the sparse index, one entry per data block */
+    uint64_t meta_page;               /* the page number of the meta block */
+    uint64_t sequence;                /* the file sequence number, higher is newer */
+    uint64_t file_number;             /* the number the file was named with, 0 if it has none */
+    uint32_t level;                   /* the level of the LSM tree the SSTable belongs to */
+    bloomfilter_t *bf;                /* the resident chained bloom filter of an older SSTable */
+    blocked_bloomfilter_t *filter;    /* the resident blocked bloom filter */
+    bool blocked_bloom;               /* whether the filter block holds a blocked bloom filter */
+    uint8_t *min_key;                 /* the smallest key in the SSTable, NULL if unknown */
+    uint32_t min_key_size;            /* the size of the smallest key */
+    uint8_t *max_key;                 /* the largest key in the SSTable, NULL if unknown */
+    uint32_t max_key_size;            /* the size of the largest key */
+    uint64_t num_tombstones;          /* the number of entries marked as tombstones by the writer */
+    uint64_t num_ttl;                 /* the number of entries with a ttl */
+    int64_t min_ttl;                  /* the earliest ttl in the SSTable, 0 if no entry has one */
+    int64_t max_ttl;                  /* the latest ttl in the SSTable, 0 if no entry has one */
+    atomic_uint refs;                 /* the number of references to the SSTable */
+    atomic_bool obsolete;             /* whether the file is removed with the last reference */
+    pthread_mutex_t reader_lock;      /* lock for opening and closing the reader and its pins */
+    uint32_t pins;                    /* the number of reads using the reader */
+    uint32_t scans;                   /* the number of iterators reading the reader */
+    struct sstable_cache_t *cache;    /* the table cache the reader is kept in, NULL if none */
+    uint64_t block_cache_id;          /* the id the data blocks are cached under, 0 if not */
+    bool cached;                      /* whether the reader is in the LRU of the cache */
+    sstable_t *lru_prev;              /* the more recently used reader in the cache */
+    sstable_t *lru_next;              /* the less recently used reader in the cache */
+};
+
+/*
+ * sstable_cache_t
+ * a table cache, keeps at most capacity SSTable readers open and closes the least recently used
+ * one that is not in use beyond that.  it is shared by every SSTable given to it
+ * @param lock the lock for the LRU list
+ * @param capacity the most readers kept open
+ * @param mmap_reads whether the readers map their files and read blocks from the mapping
+ * @param block_cache the cache of decoded data blocks the readers share, NULL if none
+ * @param num_open the number of readers in the LRU list
+ * @param head the most recently used reader
+ * @param tail the least recently used reader
+ * @param opens the number of readers opened by first accesses since the cache was created
+ * @param evictions the number of readers closed to stay within the capacity
+ */
+typedef struct sstable_cache_t
+{
+    pthread_mutex_t lock;       /* the lock for the LRU list */
+    size_t capacity;            /* the most readers kept open */
+    bool mmap_reads;            /* whether the readers map their files */
+    block_cache_t *block_cache; /* the cache of decoded data blocks, NULL if none */
+    size_t num_open;            /* the number of readers in the LRU list */
+    sstable_t *head;            /* the most recently used reader */
+    sstable_t *tail;            /* the least recently used reader */
+    atomic_uint_fast64_t opens; /* the number of readers opened by first accesses */
+    uint64_t evictions;         /* the number of readers closed to stay within the capacity */
+} sstable_cache_t;
+
+/*
+ * sstable_writer_t
+ * struct for building a new SSTable from sorted key-value pairs
+ * @param pager the pager for the SSTable being written
+ * @param block_size the target size of a data block
+ * @param compressed whether data blocks should be compressed
+ * @param block the data block being built
+ * @param block_len the length of the data block being built
+ * @param block_cap the capacity of the data block buffer
+ * @param block_entries the number of entries in the data block being built
+ * @param index the index entries for the data blocks written so far
+ * @param num_blocks the number of data blocks written so far
+ * @param index_cap the capacity of the index array
+ * @param bits_per_key the number of bloom filter bits per key
+ * @param hashes the filter hashes of the keys added, the filter is sized from their count
+ * @param hashes_cap the capacity of the hashes array
+ * @param num_entries the number of key-value pairs added
+ * @param last_entry the offset of the last entry in the data block being built
+ * @param sequence the file sequence number of the SSTable being written
+ * @param file_number the number the SSTable being written is named with
+ * @param level the level of the LSM tree the SSTable is written for
+ * @param first_key the first key added
+ * @param first_key_size the size of the first key added
+ * @param num_tombstones the number of entries marked as tombstones, counted by the caller
+ * @param num_ttl the number of entries with a ttl
+ * @param min_ttl the earliest ttl added
+ * @param max_ttl the latest ttl added
+ */
+typedef struct
+{
+    pager_t *pager;               /* the pager for the SSTable being written */
+    size_t block_size;            /* the target size of a data block */
+    bool compressed;              /* whether data blocks should be compressed */
+    uint8_t *block;               /* the data block being built */
+    size_t block_len;             /* the length of the data block being built */
+    size_t block_cap;             /* the capacity of the data block buffer */
+    uint32_t block_entries;       /* the number of entries in the data block being built */
+    sstable_index_entry_t *index; /* the index entries for the data blocks written so far */
+    uint32_t num_blocks;          /* the number of data blocks written so far */
+    uint32_t index_cap;           /* the capacity of the index array */
+    uint32_t bits_per_key;        /* the number of bloom filter bits per key */
+    uint64_t *hashes;             /* the filter hashes of the keys added */
+    uint64_t hashes_cap;          /* the capacity of the hashes array */
+    uint64_t num_entries;         /* the number of key-value pairs added */
+    size_t last_entry;            /* the offset of the last entry in the data block being built */
+    uint64_t sequence;            /* the file sequence number of the SSTable being written */
+    uint64_t file_number;         /* the number the SSTable being written is named with */
+    uint32_t level;               /* the level of the LSM tree the SSTable is written for */
+    uint8_t *first_key;           /* the first key added */
+    uint32_t first_key_size;      /* the size of the first key added */
+    uint64_t num_tombstones;      /* the number of entries marked as tombstones by the caller */
+    uint64_t num_ttl;             /* the number of entries with a ttl */
+    int64_t min_ttl;              /* the earliest ttl added */
+    int64_t max_ttl;              /* the latest ttl added */
+} sstable_writer_t;
+
+/*
+ * sstable_iterator_t
+ * struct for iterating over the key-value pairs of an SSTable in order
+ * @param sst the SSTable
+ * @param block_index the index of the current data block
+ * @param block the current decoded data block
+ * @param offsets the offsets of the entries within the current data block
+ * @param num_entries the number of entries in the current data block
+ * @param entry_index the index of the current entry within the data block
+ * @param legacy_cursor the page cursor for legacy SSTables
+ * @param legacy_first_page the page of the first key-value pair in a legacy SSTable
+ * @param legacy_kv the current key-value pair for legacy SSTables
+ */
+typedef struct
+{
+    sstable_t *sst;                 /* the SSTable */
+    uint32_t block_index;           /* the index of the current data block */
+    uint8_t *block;                 /* the current decoded data block */
+    size_t *offsets;                /* the offsets of the entries within the current data block */
+    uint32_t num_entries;           /* the number of entries in the current data block */
+    uint32_t entry_index;           /* the index of the current entry within the data block */
+    pager_cursor_t *legacy_cursor;  /* the page cursor for legacy SSTables */
+    unsigned int legacy_first_page; /* the page of the first key-value pair in a legacy SSTable */
+    key_value_pair_t *legacy_kv;    /* the current key-value pair for legacy SSTables */
+} sstable_iterator_t;
+
+/*
+ * sstable_merge_iterator_t
+ * struct for streaming the key-value pairs of several SSTables in key order.  inputs are ordered
+ * oldest to newest and when more than one input holds a key only the newest version is returned
+ * @param inputs the iterators over the input SSTables
+ * @param num_inputs the number of inputs
+ * @param heap a min-heap of the inputs that are not exhausted, ordered by their current key
+ * @param heap_len the number of inputs in the heap
+ */
+typedef struct
+{
+    sstable_iterator_t **inputs; /* the iterators over the input SSTables */
+    uint32_t num_inputs;         /* the number of inputs */
+    uint32_t *heap;              /* a min-heap of the inputs that are not exhausted */
+    uint32_t heap_len;           /* the number of inputs in the heap */
+} sstable_merge_iterator_t;
+
+/* SSTable function prototypes */
+
+/*
+ * sstable_open
+ * opens an existing SSTable and its reader, the handle is described from its footer and meta block
+ * @param filename the filename of the SSTable
+ * @param compressed whether legacy SSTable data is compressed, block based SSTables record this in
+ * their footer
+ * @param sst the opened SSTable
+ * @return 0 if the SSTable was opened, -1 if not
+ */
+int sstable_open(const char *filename, bool compressed, sstable_t **sst);
+
+/*
+ * sstable_open_lazy
+ * creates the handle of an existing SSTable without touching its file, the caller describes it
+ * (level, sequence, file number, size, key range and entry statistics) and the reader is opened on
+ * first access
+ * @param filename the filename of the SSTable
+ * @param compressed whether legacy SSTable data is compressed
+ * @param cache the table cache the reader is kept in, NULL to keep it open once opened
+ * @param sst the SSTable
+ * @return 0 if the handle was created, -1 if not
+ */
+int sstable_open_lazy(const char *filename, bool compressed, sstable_cache_t *cache,
+                      sstable_t **sst);
+
+/*
+ * sstable_set_key_range
+ * describes the smallest and largest key of an SSTable, the keys are copied
+ * @param sst the SSTable
+ * @param min_key the smallest key, NULL if unknown
+ * @param min_key_size the size of the smallest key
+ * @param max_key the largest key, NULL if unknown
+ * @param max_key_size the size of the largest key
+ * @return 0 if the key range was set, -1 if not
+ */
+int sstable_set_key_range(sstable_t *sst, const uint8_t *min_key, uint32_t min_key_size,
+                          const uint8_t *max_key, uint32_t max_key_size);
+
+/*
+ * sstable_set_cache
+ * hands the reader of an SSTable to a table cache, an open reader counts toward its capacity
+ * straight away
+ * @param sst the SSTable
+ * @param cache the table cache
+ */
+void sstable_set_cache(sstable_t *sst, sstable_cache_t *cache);
+
+/*
+ * sstable_acquire
+ * opens the reader of an SSTable if it is closed and pins it, a pinned reader is not closed by the
+ * cache.  every successful acquire is paired with sstable_release
+ * @param sst the SSTable
+ * @return 0 if the reader is open and pinned, -1 if it could not be opened
+ */
+int sstable_acquire(sstable_t *sst);
+
+/*
+ * sstable_release
+ * unpins the reader of an SSTable
+ * @param sst the SSTable
+ */
+void sstable_release(sstable_t *sst);
+
+/*
+ * sstable_open_reader
+ * opens the pager of an SSTable and reads its footer, index and filter.  an SSTable that is not
+ * described yet is described from its footer and meta block.  called with the reader lock held
+ * @param sst the SSTable
+ * @return 0 if the reader was opened, -1 if not
+ */
+int sstable_open_reader(sstable_t *sst);
+
+/*
+ * sstable_close_reader
+ * closes the pager of an SSTable and frees its index and filter, the handle is left as it is.
+ * called with the reader lock held
+ * @param sst the SSTable
+ */
+void sstable_close_reader(sstable_t *sst);
+
+/*
+ * sstable_map_reader
+ * maps the file of an open reader if its table cache reads from mappings, a file that cannot be
+ * mapped is read with pread.  called before the reader is shared
+ * @param sst the SSTable
+ */
+void sstable_map_reader(sstable_t *sst);
+
+/*
+ * sstable_cache_open
+ * creates a table cache
+ * @param capacity the most readers kept open
+ * @param mmap_reads whether the readers map their files and read blocks from the mapping
+ * @param block_cache_size the byte budget of the block cache the readers share, 0 for none
+ * @param cache the table cache
+ * @return 0 if the cache was created, -1 if not
+ */
+int sstable_cache_open(size_t capacity, bool mmap_reads, size_t block_cache_size,
+                       sstable_cache_t **cache);
+
+/*
+ * sstable_cache_close
+ * frees a table cache, every SSTable given to it must be closed first
+ * @param cache the table cache
+ */
+void sstable_cache_close(sstable_cache_t *cache);
+
+/*
+ * sstable_cache_touch
+ * makes the open reader of an SSTable the most recently used one, it is added to the cache if it
+ * is not in it yet.  readers past the capacity that are not in use are closed, least recently used
+ * first
+ * @param cache the table cache
+ * @param sst the SSTable
+ */
+void sstable_cache_touch(sstable_cache_t *cache, sstable_t *sst);
+
+/*
+ * sstable_cache_remove
+ * takes the reader of an SSTable out of the cache, it is left open
+ * @param cache the table cache
+ * @param sst the SSTable
+ */
+void sstable_cache_remove(sstable_cache_t *cache, sstable_t *sst);
+
+/*
+ * sstable_cache_unlink
+ * unlinks an SSTable from the LRU list of a cache, called with the cache lock held
+ * @param cache the table cache
+ * @param sst the SSTable
+ */
+void sstable_cache_unlink(sstable_cache_t *cache, sstable_t *sst);
+
+/*
+ * sstable_close
+ * closes an SSTable and frees its memory
+ * @param sst the SSTable
+ */
+void sstable_close(sstable_t *sst);
+
+/*
+ * sstable_ref
+ * takes a reference to an SSTable, an opened or written SSTable starts with one
+ * @param sst the SSTable
+ */
+void sstable_ref(sstable_t *sst);
+
+/*
+ * sstable_unref
+ * releases a reference to an SSTable, the last one closes it and removes its file if it is
+ * obsolete
+ * @param sst the SSTable
+ */
+void sstable_unref(sstable_t *sst);
+
+/*
+ * sstable_get
+ * point lookup of a key in an SSTable, a key outside its key range never opens the reader.  a
+ * reader that cannot be opened, a block that cannot be read or decoded and a failed allocation
+ * are errors and not misses, the key may be in the SSTable
+ * @param sst the SSTable
+ * @param key the key
+ * @param key_size the size of the key
+ * @param hash the filter hash of the key from blocked_bloomfilter_hash
+ * @param value the value (allocated, caller frees)
+ * @param value_size the size of the value
+ * @param ttl the time-to-live of the key-value pair
+ * @return 0 if the key was found, -1 if not, -2 if the SSTable could not be read
+ */
+int sstable_get(sstable_t *sst, const uint8_t *key, size_t key_size, uint64_t hash,
+                uint8_t **value, size_t *value_size, int64_t *ttl);
+
+/*
+ * sstable_writer_open
+ * creates a new SSTable file and a writer for it, a file left behind under the same name is
+ * replaced
+ * @param filename the filename of the new SSTable
+ * @param block_size the target size of a data block
+ * @param compressed whether data blocks should be compressed
+ * @param bits_per_key the number of bloom filter bits per key, 0 for the default
+ * @param sequence the file sequence number of the new SSTable, higher is newer
+ * @param file_number the number the new SSTable is named with
+ * @param level the level of the LSM tree the new SSTable is written for
+ * @param writer the new writer
+ * @return 0 if the writer was created, -1 if not
+ */
+int sstable_writer_open(const char *filename, size_t block_size, bool compressed,
+                        uint32_t bits_per_key, uint64_t sequence, uint64_t file_number,
+                        uint32_t level, sstable_writer_t **writer);
+
+/*
+ * sstable_writer_size
+ * gets the number of bytes the SSTable being written takes so far
+ * @param writer the writer
+ * @return the size in bytes
+ */
+uint64_t sstable_writer_size(sstable_writer_t *writer);
+
+/*
+ * sstable_size
+ * gets the size of an SSTable file
+ * @param sst the SSTable
+ * @return the size in bytes
+ */
+uint64_t sstable_size(sstable_t *sst);
+
+/*
+ * sstable_overlaps
+ * checks if the key range of an SSTable overlaps a key range, an SSTable with an unknown range
+ * overlaps everything
+ * @param sst the SSTable
+ * @param min_key the smallest key of the range, NULL for no lower bound
+ * @param min_key_size the size of the smallest key
+ * @param max_key the largest key of the range, NULL for no upper bound
+ * @param max_key_size the size of the largest key
+ * @return true if the ranges overlap
+ */
+bool sstable_overlaps(sstable_t *sst, const uint8_t *min_key, size_t min_key_size,
+                      const uint8_t *max_key, size_t max_key_size);
+
+/*
+ * sstable_expired_entries
+ * estimates how many entries of an SSTable have expired, the ttls are taken to be spread evenly
+ * between the earliest and the latest one
+ * @param sst the SSTable
+ * @param now the current time
+ * @return the estimated number of expired entries
+ */
+uint64_t sstable_expired_entries(sstable_t *sst, int64_t now);
+
+/*
+ * sstable_writer_add
+ * adds a key-value pair to the SSTable being written, keys must be added in ascending order
+ * @param writer the writer
+ * @param key the key
+ * @param key_size the size of the key
+ * @param value the value
+ * @param value_size the size of the value
+ * @param ttl the time-to-live of the key-value pair
+ * @return 0 if the key-value pair was added, -1 if not
+ */
+int sstable_writer_add(sstable_writer_t *writer, const uint8_t *key, size_t key_size,
+                       const uint8_t *value, size_t value_size, int64_t ttl);
+
+/*
+ * sstable_writer_finish
+ * writes the remaining data block, the filter block, the index block and the footer, syncs the
+ * file and frees the writer.  On failure the writer is left for sstable_writer_abandon
+ * @param writer the writer
+ * @param sst the finished SSTable, ready for reads
+ * @return 0 if the SSTable was finished, -1 if not
+ */
+int sstable_writer_finish(sstable_writer_t *writer, sstable_t **sst);
+
+/*
+ * sstable_writer_abandon
+ * frees the writer and removes the partially written SSTable file
+ * @param writer the writer
+ */
+void sstable_writer_abandon(sstable_writer_t *writer);
+
+/*
+ * sstable_writer_flush_block
+ * writes the data block being built to the SSTable and records it in the index
+ * @param writer the writer
+ * @return 0 if the block was written, -1 if not
+ */
+int sstable_writer_flush_block(sstable_writer_t *writer);
+
+/*
+ * sstable_encode_footer
+ * encodes the footer of an SSTable
+ * @param sst the SSTable
+ * @param buffer the buffer to encode into, at least SSTABLE_FOOTER_SIZE bytes
+ */
+void sstable_encode_footer(const sstable_t *sst, uint8_t *buffer);
+
+/*
+ * sstable_decode_footer
+ * decodes the footer of an SSTable
+ * @param buffer the encoded footer
+ * @param buffer_len the length of the encoded footer
+ * @param sst the SSTable to decode into
+ * @return 0 if the buffer held a valid footer, -1 if not
+ */
+int sstable_decode_footer(const uint8_t *buffer, size_t buffer_len, sstable_t *sst);
+
+/*
+ * sstable_load_index
+ * reads and decodes the index block of an SSTable
+ * @param sst the SSTable
+ * @return 0 if the index was loaded, -1 if not
+ */
+int sstable_load_index(sstable_t *sst);
+
+/*
+ * sstable_load_filter
+ * reads and decodes the bloom filter of an SSTable so it stays resident
+ * @param sst the SSTable
+ * @return 0 if the filter was loaded, -1 if not
+ */
+int sstable_load_filter(sstable_t *sst);
+
+/*
+ * sstable_load_meta
+ * reads the smallest and largest key of an SSTable so they stay resident
+ * @param sst the SSTable
+ * @return 0 if the meta data was loaded, -1 if not
+ */
+int sstable_load_meta(sstable_t *sst);
+
+/*
+ * sstable_may_contain
+ * checks the resident key range and bloom filter of an SSTable without touching the disk, the
+ * reader must be pinned
+ * @param sst the SSTable
+ * @param key the key
+ * @param key_size the size of the key
+ * @param hash the filter hash of the key from blocked_bloomfilter_hash
+ * @return 0 if the key may be in the SSTable, -1 if it is not
+ */
+int sstable_may_contain(sstable_t *sst, const uint8_t *key, size_t key_size, uint64_t hash);
+
+/*
+ * sstable_block_get
+ * point lookup of a key in a block based SSTable whose reader is pinned
+ * @param sst the SSTable
+ * @param key the key
+ * @param key_size the size of the key
+ * @param hash the filter hash of the key from blocked_bloomfilter_hash
+ * @param value the value (allocated, caller frees)
+ * @param value_size the size of the value
+ * @param ttl the time-to-live of the key-value pair
+ * @return 0 if the key was found, -1 if not, -2 if the SSTable could not be read
+ */
+int sstable_block_get(sstable_t *sst, const uint8_t *key, size_t key_size, uint64_t hash,
+                      uint8_t **value, size_t *value_size, int64_t *ttl);
+
+/*
+ * sstable_legacy_get
+ * point lookup of a key in a legacy page-per-pair SSTable whose reader is pinned
+ * @param sst the SSTable
+ * @param key the key
+ * @param key_size the size of the key
+ * @param hash the filter hash of the key from blocked_bloomfilter_hash
+ * @param value the value (allocated, caller frees)
+ * @param value_size the size of the value
+ * @param ttl the time-to-live of the key-value pair
+ * @return 0 if the key was found, -1 if not, -2 if the SSTable could not be read
+ */
+int sstable_legacy_get(sstable_t *sst, const uint8_t *key, size_t key_size, uint64_t hash,
+                       uint8_t **value, size_t *value_size, int64_t *ttl);
+
+/*
+ * sstable_read_block
+ * reads and decodes a data block
+ * @param sst the SSTable
+ * @param block_index the index of the data block
+ * @param block the decoded data block (allocated, caller frees)
+ * @param block_len the length of the decoded data block
+ * @return 0 if the block was read, -1 if not
+ */
+int sstable_read_block(sstable_t *sst, uint32_t block_index, uint8_t **block, size_t *block_len);
+
+/*
+ * sstable_search_block
+ * point lookup of a key in a decoded data block
+ * @param block the decoded data block
+ * @param block_len the length of the decoded data block
+ * @param key the key
+ * @param key_size the size of the key
+ * @param value the value (allocated, caller frees)
+ * @param value_size the size of the value
+ * @param ttl the time-to-live of the key-value pair
+ * @return 0 if the key was found, -1 if not, -2 if the SSTable could not be read
+ */
+int sstable_search_block(const uint8_t *block, size_t block_len, const uint8_t *key,
+                         size_t key_size, uint8_t **value, size_t *value_size, int64_t *ttl);
+
+/*
+ * sstable_decompress_view
+ * decompresses a block straight from the page bodies it lies in within a mapping
+ * @param view the view of the compressed block
+ * @param block the decoded data block (allocated, caller frees)
+ * @param block_len the length of the decoded data block
+ * @return 0 if the block was decompressed, -1 if not
+ */
+int sstable_decompress_view(const pager_view_t *view, uint8_t **block, size_t *block_len);
+
+/*
+ * sstable_view_get
+ * point lookup of a key in an uncompressed data block where it lies in a mapping, only the value
+ * that is found is copied
+ * @param view the view of the data block
+ * @param key the key
+ * @param key_size the size of the key
+ * @param value the value (allocated, caller frees)
+ * @param value_size the size of the value
+ * @param ttl the time-to-live of the key-value pair
+ * @return 0 if the key was found, -1 if not, -2 if the SSTable could not be read
+ */
+int sstable_view_get(const pager_view_t *view, const uint8_t *key, size_t key_size,
+                     uint8_t **value, size_t *value_size, int64_t *ttl);
+
+/*
+ * sstable_begin_scan
+ * advises the mapping of a pinned reader for sequential access while an iterator reads it
+ * @param sst the SSTable
+ */
+void sstable_begin_scan(sstable_t *sst);
+
+/*
+ * sstable_end_scan
+ * advises the mapping of a reader for random access again once its last iterator is done
+ * @param sst the SSTable
+ */
+void sstable_end_scan(sstable_t *sst);
+
+/*
+ * sstable_find_block
+ * binary searches the sparse index for the first data block whose last key is >= key
+ * @param sst the SSTable
+ * @param key the key
+ * @param key_size the size of the key
+ * @return the index of the data block, -1 if the key is past the last key of the SSTable
+ */
+int64_t sstable_find_block(sstable_t *sst, const uint8_t *key, size_t key_size);
+
+/*
+ * sstable_iterator_init
+ * initializes a new iterator positioned at the first key-value pair of the SSTable, the reader is
+ * pinned until the iterator is freed
+ * @param sst the SSTable
+ * @param it the new iterator
+ * @return 0 if the iterator was initialized, -1 if the SSTable has no pairs, -2 if it could not be
+ * read
+ */
+int sstable_iterator_init(sstable_t *sst, sstable_iterator_t **it);
+
+/*
+ * sstable_iterator_load_block
+ * loads a data block into the iterator and indexes its entries
+ * @param it the iterator
+ * @param block_index the index of the data block
+ * @return 0 if the block was loaded, -1 if not
+ */
+int sstable_iterator_load_block(sstable_iterator_t *it, uint32_t block_index);
+
+/*
+ * sstable_iterator_next
+ * moves the iterator to the next key-value pair
+ * @param it the iterator
+ * @return 0 if the iterator was moved, -1 if at the end, -2 if the next block could not be read
+ */
+int sstable_iterator_next(sstable_iterator_t *it);
+
+/*
+ * sstable_iterator_prev
+ * moves the iterator to the previous key-value pair
+ * @param it the iterator
+ * @return 0 if the iterator was moved, -1 if at the beginning, -2 if the previous block could not
+ * be read
+ */
+int sstable_iterator_prev(sstable_iterator_t *it);
+
+/*
+ * sstable_iterator_get
+ * gets the current key-value pair, the key and value point into the iterator and are valid until
+ * it is moved or freed
+ * @param it the iterator
+ * @param kv the current key-value pair
+ * @return 0 if there is a current key-value pair, -1 if not
+ */
+int sstable_iterator_get(sstable_iterator_t *it, key_value_pair_t *kv);
+
+/*
+ * sstable_iterator_free
+ * frees the iterator and unpins the reader
+ * @param it the iterator
+ */
+void sstable_iterator_free(sstable_iterator_t *it);
+
+/*
+ * sstable_merge_iterator_init
+ * initializes a merge iterator over several SSTables, only one block per input is held in memory
+ * @param ssts the input SSTables, oldest first
+ * @param num_ssts the number of input SSTables
+ * @param it the new merge iterator
+ * @return 0 if the merge iterator was created, -1 if not
+ */
+int sstable_merge_iterator_init(sstable_t **ssts, uint32_t num_ssts, sstable_merge_iterator_t **it);
+
+/*
+ * sstable_merge_iterator_get
+ * gets the newest version of the current key, pointers are valid until the iterator moves
+ * @param it the merge iterator
+ * @param kv the key-value pair
+ * @return 0 if there is a current key-value pair, -1 if the iterator is exhausted
+ */
+int sstable_merge_iterator_get(sstable_merge_iterator_t *it, key_value_pair_t *kv);
+
+/*
+ * sstable_merge_iterator_next
+ * moves to the next key, skipping the older versions of the current key
+ * @param it the merge iterator
+ * @return 0 if the iterator moved, -1 if it is exhausted, -2 if an input could not be read
+ */
+int sstable_merge_iterator_next(sstable_merge_iterator_t *it);
+
+/*
+ * sstable_merge_iterator_less
+ * compares the current keys of two inputs, on equal keys the newer input comes first
+ * @param it the merge iterator
+ * @param a the first input
+ * @param b the second input
+ * @return true if input a sorts before input b
+ */
+bool sstable_merge_iterator_less(sstable_merge_iterator_t *it, uint32_t a, uint32_t b);
+
+/*
+ * sstable_merge_iterator_sift_down
+ * restores the heap order below a position
+ * @param it the merge iterator
+ * @param pos the position in the heap
+ */
+void sstable_merge_iterator_sift_down(sstable_merge_iterator_t *it, uint32_t pos);
+
+/*
+ * sstable_merge_iterator_free
+ * frees the merge iterator and its input iterators
+ * @param it the merge iterator
+ */
+void sstable_merge_iterator_free(sstable_merge_iterator_t *it);
+
+/*
+ * sstable_compare_keys
+ * compares two keys
+ * @param key1 the first key
+ * @param key1_size the size of the first key
+ * @param key2 the second key
+ * @param key2_size the size of the second key
+ * @return 0 if the keys are equal, < 0 if key1 is less than key2, > 0 if key1 is greater
+ */
+int sstable_compare_keys(const uint8_t *key1, size_t key1_size, const uint8_t *key2,
+                         size_t key2_size);
+
+#endif /* SSTABLE_H */
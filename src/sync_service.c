@@ -0,0 +1,223 @@
+/*
+ *
+ * Copyright (C) TidesDB
+ *
+ * Original Author: Alex Gaetano Padula
+ *
+ * Licensed under the Mozilla Public License, v. 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.mozilla.org/en-US/MPL/2.0/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "sync_service.h"
+
+int sync_service_open(double interval, sync_service_t** service)
+{
+    if (service == NULL) return -1;
+
+    *service = calloc(1, sizeof(sync_service_t));
+    if (*service == NULL) return -1;
+
+    (*service)->interval = interval;
+
+    if (pthread_mutex_init(&(*service)->lock, NULL) != 0)
+    {
+        free(*service);
+        *service = NULL;
+        return -1;
+    }
+
+    if (pthread_cond_init(&(*service)->cond, NULL) != 0)
+    {
+        pthread_mutex_destroy(&(*service)->lock);
+        free(*service);
+        *service = NULL;
+        return -1;
+    }
+
+    if (pthread_cond_init(&(*service)->idle_cond, NULL) != 0)
+    {
+        pthread_cond_destroy(&(*service)->cond);
+        pthread_mutex_destroy(&(*service)->lock);
+        free(*service);
+        *service = NULL;
+        return -1;
+    }
+
+    /* we start the one thread that syncs for every file */
+    if (pthread_create(&(*service)->thread, NULL, sync_service_thread, *service) != 0)
+    {
+        pthread_cond_destroy(&(*service)->idle_cond);
+        pthread_cond_destroy(&(*service)->cond);
+        pthread_mutex_destroy(&(*service)->lock);
+        free(*service);
+        *service = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int sync_service_close(sync_service_t* service)
+{
+    if (service == NULL) return -1;
+
+    /* the thread syncs what is still queued before it stops */
+    pthread_mutex_lock(&service->lock);
+    service->stop = true;
+    pthread_cond_signal(&service->cond);
+    pthread_mutex_unlock(&service->lock);
+
+    if (pthread_join(service->thread, NULL) != 0) return -1;
+
+    pthread_cond_destroy(&service->idle_cond);
+    pthread_cond_destroy(&service->cond);
+    pthread_mutex_destroy(&service->lock);
+
+    free(service);
+
+    return 0;
+}
+
+void sync_file_init(sync_file_t* file, int fd)
+{
+    file->fd = fd;
+    file->pending = 0;
+    file->queued = false;
+    file->prev = NULL;
+    file->next = NULL;
+}
+
+void sync_service_mark(sync_service_t* service, sync_file_t* file, size_t writes)
+{
+    pthread_mutex_lock(&service->lock);
+
+    file->pending += writes;
+
+    if (!file->queued)
+    {
+        /* the first file queued starts the wait and wakes the thread from its sleep */
+        if (service->head == NULL)
+        {
+            clock_gettime(CLOCK_REALTIME, &service->dirty_since);
+            pthread_cond_signal(&service->cond);
+        }
+
+        file->queued = true;
+        file->prev = service->tail;
+        file->next = NULL;
+        if (service->tail != NULL)
+            service->tail->next = file;
+        else
+            service->head = file;
+        service->tail = file;
+    }
+
+    /* a file with this many writes pending is not left to wait out the interval */
+    if (file->pending >= SYNC_INTERVAL && !service->urgent)
+    {
+        service->urgent = true;
+        pthread_cond_signal(&service->cond);
+    }
+
+    pthread_mutex_unlock(&service->lock);
+}
+
+void sync_service_unlink(sync_service_t* service, sync_file_t* file)
+{
+    if (!file->queued) return;
+
+    if (file->prev != NULL)
+        file->prev->next = file->next;
+    else
+        service->head = file->next;
+
+    if (file->next != NULL)
+        file->next->prev = file->prev;
+    else
+        service->tail = file->prev;
+
+    file->prev = NULL;
+    file->next = NULL;
+    file->queued = false;
+}
+
+void sync_service_remove(sync_service_t* service, sync_file_t* file)
+{
+    pthread_mutex_lock(&service->lock);
+
+    sync_service_unlink(service, file);
+
+    /* the file descriptor must stay open until its sync returns */
+    while (service->syncing == file) pthread_cond_wait(&service->idle_cond, &service->lock);
+
+    pthread_mutex_unlock(&service->lock);
+}
+
+void sync_service_drain(sync_service_t* service)
+{
+    service->urgent = false;
+
+    while (service->head != NULL)
+    {
+        sync_file_t* file = service->head;
+        sync_service_unlink(service, file);
+
+        /* writes marked while the file is synced queue it again */
+        file->pending = 0;
+        service->syncing = file;
+        pthread_mutex_unlock(&service->lock);
+
+        fdatasync(file->fd);
+
+        pthread_mutex_lock(&service->lock);
+        service->syncing = NULL;
+        service->syncs++;
+        pthread_cond_broadcast(&service->idle_cond);
+    }
+}
+
+void* sync_service_thread(void* arg)
+{
+    sync_service_t* service = arg;
+
+    pthread_mutex_lock(&service->lock);
+
+    while (!service->stop)
+    {
+        /* nothing is dirty, we sleep until a file is marked */
+        if (service->head == NULL)
+        {
+            pthread_cond_wait(&service->cond, &service->lock);
+            continue;
+        }
+
+        if (!service->urgent)
+        {
+            /* the queued files are synced once the oldest of them has waited the interval */
+            struct timespec deadline = service->dirty_since;
+            deadline.tv_nsec += (long)(service->interval * 1e9);
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+
+            if (pthread_cond_timedwait(&service->cond, &service->lock, &deadline) != ETIMEDOUT)
+                continue;
+        }
+
+        sync_service_drain(service);
+    }
+
+    /* what is still queued is synced before we stop */
+    sync_service_drain(service);
+
+    pthread_mutex_unlock(&service->lock);
+
+    return NULL;
+}
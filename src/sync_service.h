@@ -0,0 +1,166 @@
+/*
+ *
+ * Copyright (C) TidesDB
+ *
+ * Original Author: Alex Gaetano Padula
+ *
+ * Licensed under the Mozilla Public License, v. 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.mozilla.org/en-US/MPL/2.0/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SYNC_SERVICE_H
+#define SYNC_SERVICE_H
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * A sync service syncs the files written to without a sync of their own, on one thread for
+ * however many files there are.  A file that is written to is marked dirty with the service and
+ * queued, the service syncs the queued files once the oldest of them has waited
+ * SYNC_ESCALATION or sooner once a file has SYNC_INTERVAL writes pending.  With nothing queued
+ * the thread sleeps until a file is marked, so an idle database costs no wakeups.
+ *
+ * A file removes itself from the service before it is closed, a sync of it that is running is
+ * waited out so the service never syncs a closed file descriptor.
+ */
+
+#define SYNC_INTERVAL   24576 /* writes pending on a file before it is synced early */
+#define SYNC_ESCALATION 0.128 /* seconds the oldest dirty file waits before the files are synced */
+
+typedef struct sync_file_t sync_file_t;
+
+/*
+ * sync_file_t
+ * a file as the sync service tracks it, kept in the struct of whatever owns the file
+ * @param fd the file descriptor to sync
+ * @param pending the number of writes since the file was last synced
+ * @param queued whether the file is queued to be synced
+ * @param prev the file queued before this one
+ * @param next the file queued after this one
+ */
+struct sync_file_t
+{
+    int fd;            /* the file descriptor to sync */
+    size_t pending;    /* the number of writes since the file was last synced */
+    bool queued;       /* whether the file is queued to be synced */
+    sync_file_t* prev; /* the file queued before this one */
+    sync_file_t* next; /* the file queued after this one */
+};
+
+/*
+ * sync_service_t
+ * the service that syncs dirty files in the background
+ * @param lock the lock for the queue
+ * @param cond the condition variable the sync thread waits on
+ * @param idle_cond the condition variable a removal waits on while its file is synced
+ * @param thread the sync thread
+ * @param interval the seconds the oldest dirty file waits before the files are synced
+ * @param head the file queued first
+ * @param tail the file queued last
+ * @param dirty_since when the oldest queued file was queued
+ * @param urgent whether a queued file has SYNC_INTERVAL writes pending
+ * @param syncing the file being synced, NULL if none is
+ * @param syncs the number of syncs the service has done
+ * @param stop whether the service is stopping
+ */
+typedef struct
+{
+    pthread_mutex_t lock;        /* the lock for the queue */
+    pthread_cond_t cond;         /* the condition variable the sync thread waits on */
+    pthread_cond_t idle_cond;    /* the condition variable a removal waits on */
+    pthread_t thread;            /* the sync thread */
+    double interval;             /* the seconds the oldest dirty file waits */
+    sync_file_t* head;           /* the file queued first */
+    sync_file_t* tail;           /* the file queued last */
+    struct timespec dirty_since; /* when the oldest queued file was queued */
+    bool urgent;                 /* whether a queued file has SYNC_INTERVAL writes pending */
+    sync_file_t* syncing;        /* the file being synced, NULL if none is */
+    uint64_t syncs;              /* the number of syncs the service has done */
+    bool stop;                   /* whether the service is stopping */
+} sync_service_t;
+
+/* Sync service function prototypes */
+
+/*
+ * sync_service_open
+ * starts a sync service and its thread
+ * @param interval the seconds the oldest dirty file waits before the files are synced
+ * @param service the sync service
+ * @return 0 if the service was started, -1 otherwise
+ */
+int sync_service_open(double interval, sync_service_t** service);
+
+/*
+ * sync_service_close
+ * syncs the files still queued, stops the thread and frees the service.  the files must not be
+ * written to through the service anymore
+ * @param service the sync service
+ * @return 0 if the service was closed, -1 otherwise
+ */
+int sync_service_close(sync_service_t* service);
+
+/*
+ * sync_file_init
+ * initializes a file the sync service can track
+ * @param file the file
+ * @param fd the file descriptor to sync
+ */
+void sync_file_init(sync_file_t* file, int fd);
+
+/*
+ * sync_service_mark
+ * marks a file dirty with writes that still have to be synced, it is queued if it is not
+ * @param service the sync service
+ * @param file the file
+ * @param writes the number of writes
+ */
+void sync_service_mark(sync_service_t* service, sync_file_t* file, size_t writes);
+
+/*
+ * sync_service_remove
+ * takes a file out of the queue and waits out a sync of it that is running, the file can be
+ * closed after
+ * @param service the sync service
+ * @param file the file
+ */
+void sync_service_remove(sync_service_t* service, sync_file_t* file);
+
+/*
+ * sync_service_unlink
+ * takes a file out of the queue, the lock of the service is held
+ * @param service the sync service
+ * @param file the file
+ */
+void sync_service_unlink(sync_service_t* service, sync_file_t* file);
+
+/*
+ * sync_service_drain
+ * syncs every queued file one at a time, the lock of the service is held and is released while
+ * a file is synced
+ * @param service the sync service
+ */
+void sync_service_drain(sync_service_t* service);
+
+/*
+ * sync_service_thread
+ * the thread that syncs the queued files
+ * @param arg the sync service
+ */
+void* sync_service_thread(void* arg);
+
+#endif /* SYNC_SERVICE_H */
@@ -29,6 +29,15 @@ tidesdb_err_t* tidesdb_open(const tidesdb_config_t* config, tidesdb_t** tdb)
     /* we check if the tdb is NULL */
     if (tdb == NULL) return tidesdb_err_new(1002, "TidesDB is NULL");
 
+    /* we check the number of background compaction threads, 0 disables them */
+    if (config->compaction_threads < 0 ||
+        config->compaction_threads > TIDESDB_MAX_COMPACTION_THREADS)
+        return tidesdb_err_new(1091, "Compaction threads is out of range");
+
+    /* we check the number of sstables kept open, 0 means the default */
+    if (config->max_open_files < 0)
+        return tidesdb_err_new(1103, "Max open files is out of range");
+
     /* first we allocate memory for the tidesdb struct */
     *tdb = malloc(sizeof(tidesdb_t));
 
@@ -47,6 +56,9 @@ tidesdb_err_t* tidesdb_open(const tidesdb_config_t* config, tidesdb_t** tdb)
     (*tdb)->column_families = NULL;
     (*tdb)->num_column_families = 0; /* 0 for now until we read db path */
 
+    /* loading the column families replays their wals and fills in the recovery stats */
+    memset(&(*tdb)->recovery_stats, 0, sizeof((*tdb)->recovery_stats));
+
     /* we check to see if the db path exists
      * if not we create it */
     if (access(config->db_path, F_OK) == -1) /* we create the directory **/
@@ -57,30 +69,55 @@ tidesdb_err_t* tidesdb_open(const tidesdb_config_t* config, tidesdb_t** tdb)
             return tidesdb_err_new(1004, "Failed to create db directory");
         }
 
-    /* now we load the column families */
-    if (_load_column_families(*tdb) == -1)
+    /* the write-ahead logs can be kept apart from the sstables, on a device of their own */
+    if (config->wal_dir != NULL && access(config->wal_dir, F_OK) == -1)
+        if (mkdir(config->wal_dir, 0777) == -1)
+        {
+            free((*tdb)->config.db_path);
+            free(*tdb);
+            return tidesdb_err_new(1098, "Failed to create wal directory");
+        }
+
+    /* initialize column_families_lock, loading the column families takes it */
+    if (pthread_rwlock_init(&(*tdb)->column_families_lock, NULL) != 0)
     {
         free((*tdb)->config.db_path);
         free(*tdb);
-        return tidesdb_err_new(1041, "Failed to load column families");
+        return tidesdb_err_new(1013, "Failed to initialize column families lock");
     }
 
-    if ((*tdb)->num_column_families > 0)
+    /* the sstables of every column family open their readers through one table cache */
+    if (sstable_cache_open(config->max_open_files ? config->max_open_files
+                                                  : TIDESDB_DEFAULT_MAX_OPEN_FILES,
+                           config->mmap_reads, config->block_cache_size,
+                           &(*tdb)->table_cache) == -1)
     {
-        /* we iterate over the column families
-         * loading their sstables and sorting them by last modified being last */
-        for (int i = 0; i < (*tdb)->num_column_families; i++)
-        {
-            /* we load the sstables */
-            _load_sstables(&(*tdb)->column_families[i]); /* there could be no sstables */
+        pthread_rwlock_destroy(&(*tdb)->column_families_lock);
+        free((*tdb)->config.db_path);
+        free(*tdb);
+        return tidesdb_err_new(1104, "Failed to initialize table cache");
+    }
 
-            if ((*tdb)->column_families[i].num_sstables > 0)
-            {
-                /* we sort the sstables */
-                _sort_sstables(
-                    &(*tdb)->column_families[i]); /* we don't need to catch the error here */
-            }
-        }
+    /* one thread syncs the write-ahead logs of every column family, a write that syncs itself
+     * leaves it nothing to do */
+    if (sync_service_open(SYNC_ESCALATION, &(*tdb)->sync_service) == -1)
+    {
+        sstable_cache_close((*tdb)->table_cache);
+        pthread_rwlock_destroy(&(*tdb)->column_families_lock);
+        free((*tdb)->config.db_path);
+        free(*tdb);
+        return tidesdb_err_new(1105, "Failed to start sync service");
+    }
+
+    /* now we load the column families, their sstables and their wals */
+    if (_load_column_families(*tdb) == -1)
+    {
+        sstable_cache_close((*tdb)->table_cache);
+        sync_service_close((*tdb)->sync_service);
+        pthread_rwlock_destroy(&(*tdb)->column_families_lock);
+        free((*tdb)->config.db_path);
+        free(*tdb);
+        return tidesdb_err_new(1041, "Failed to load column families");
     }
 
     /* initialize the flush queue */
@@ -88,6 +125,9 @@ tidesdb_err_t* tidesdb_open(const tidesdb_config_t* config, tidesdb_t** tdb)
     if ((*tdb)->flush_queue == NULL)
     {
         _free_column_families(*tdb);
+        sstable_cache_close((*tdb)->table_cache);
+        sync_service_close((*tdb)->sync_service);
+        pthread_rwlock_destroy(&(*tdb)->column_families_lock);
         free((*tdb)->config.db_path);
         free(*tdb);
         return tidesdb_err_new(1010, "Failed to initialize flush queue");
@@ -97,7 +137,10 @@ tidesdb_err_t* tidesdb_open(const tidesdb_config_t* config, tidesdb_t** tdb)
     if (pthread_mutex_init(&(*tdb)->flush_lock, NULL) != 0)
     {
         _free_column_families(*tdb);
+        sstable_cache_close((*tdb)->table_cache);
+        sync_service_close((*tdb)->sync_service);
         queue_destroy((*tdb)->flush_queue);
+        pthread_rwlock_destroy(&(*tdb)->column_families_lock);
         free((*tdb)->config.db_path);
         free(*tdb);
         return tidesdb_err_new(1046, "Failed to initialize flush lock");
@@ -108,71 +151,183 @@ tidesdb_err_t* tidesdb_open(const tidesdb_config_t* config, tidesdb_t** tdb)
     {
         pthread_mutex_destroy(&(*tdb)->flush_lock);
         _free_column_families(*tdb);
+        sstable_cache_close((*tdb)->table_cache);
+        sync_service_close((*tdb)->sync_service);
         queue_destroy((*tdb)->flush_queue);
+        pthread_rwlock_destroy(&(*tdb)->column_families_lock);
         free((*tdb)->config.db_path);
         free(*tdb);
         return tidesdb_err_new(1047, "Failed to initialize flush condition variable");
     }
 
+    /* initialize the condition variable writers stall on whilst the flush queue is full */
+    if (pthread_cond_init(&(*tdb)->flush_stall_cond, NULL) != 0)
+    {
+        pthread_cond_destroy(&(*tdb)->flush_cond);
+        pthread_mutex_destroy(&(*tdb)->flush_lock);
+        _free_column_families(*tdb);
+        sstable_cache_close((*tdb)->table_cache);
+        sync_service_close((*tdb)->sync_service);
+        queue_destroy((*tdb)->flush_queue);
+        pthread_rwlock_destroy(&(*tdb)->column_families_lock);
+        free((*tdb)->config.db_path);
+        free(*tdb);
+        return tidesdb_err_new(1097, "Failed to initialize flush stall condition variable");
+    }
+
     (*tdb)->stop_flush_thread = false; /* set stop_flush_thread to false */
 
-    /* initialize column_families_lock */
-    if (pthread_rwlock_init(&(*tdb)->column_families_lock, NULL) != 0)
+    /* initialize the background compaction state, manual compaction uses it as well */
+    (*tdb)->stop_compaction_threads = false;
+    (*tdb)->compaction_threads = calloc((*tdb)->config.compaction_threads + 1, sizeof(pthread_t));
+    (*tdb)->compaction_jobs =
+        calloc((*tdb)->config.compaction_threads + 1, sizeof(compaction_job_t*));
+    if ((*tdb)->compaction_threads == NULL || (*tdb)->compaction_jobs == NULL ||
+        pthread_mutex_init(&(*tdb)->compaction_lock, NULL) != 0)
     {
+        free((*tdb)->compaction_threads);
+        free((*tdb)->compaction_jobs);
+        pthread_rwlock_destroy(&(*tdb)->column_families_lock);
+        pthread_cond_destroy(&(*tdb)->flush_stall_cond);
         pthread_cond_destroy(&(*tdb)->flush_cond);
         pthread_mutex_destroy(&(*tdb)->flush_lock);
         _free_column_families(*tdb);
+        sstable_cache_close((*tdb)->table_cache);
+        sync_service_close((*tdb)->sync_service);
         queue_destroy((*tdb)->flush_queue);
         free((*tdb)->config.db_path);
         free(*tdb);
-        return tidesdb_err_new(1013, "Failed to initialize column families lock");
+        return tidesdb_err_new(1092, "Failed to initialize compaction lock");
+    }
+
+    if (pthread_cond_init(&(*tdb)->compaction_cond, NULL) != 0)
+    {
+        pthread_mutex_destroy(&(*tdb)->compaction_lock);
+        free((*tdb)->compaction_threads);
+        free((*tdb)->compaction_jobs);
+        pthread_rwlock_destroy(&(*tdb)->column_families_lock);
+        pthread_cond_destroy(&(*tdb)->flush_stall_cond);
+        pthread_cond_destroy(&(*tdb)->flush_cond);
+        pthread_mutex_destroy(&(*tdb)->flush_lock);
+        _free_column_families(*tdb);
+        sstable_cache_close((*tdb)->table_cache);
+        sync_service_close((*tdb)->sync_service);
+        queue_destroy((*tdb)->flush_queue);
+        free((*tdb)->config.db_path);
+        free(*tdb);
+        return tidesdb_err_new(1093, "Failed to initialize compaction condition variable");
     }
 
     /* start the flush thread */
     if (pthread_create(&(*tdb)->flush_thread, NULL, _flush_memtable_thread, *tdb) != 0)
     {
+        pthread_cond_destroy(&(*tdb)->compaction_cond);
+        pthread_mutex_destroy(&(*tdb)->compaction_lock);
+        free((*tdb)->compaction_threads);
+        free((*tdb)->compaction_jobs);
         pthread_rwlock_destroy(&(*tdb)->column_families_lock);
+        pthread_cond_destroy(&(*tdb)->flush_stall_cond);
         pthread_cond_destroy(&(*tdb)->flush_cond);
         pthread_mutex_destroy(&(*tdb)->flush_lock);
         _free_column_families(*tdb);
+        sstable_cache_close((*tdb)->table_cache);
+        sync_service_close((*tdb)->sync_service);
         queue_destroy((*tdb)->flush_queue);
         free((*tdb)->config.db_path);
         free(*tdb);
         return tidesdb_err_new(1014, "Failed to start flush thread");
     }
 
+    /* start the background compaction threads */
+    for (int i = 0; i < config->compaction_threads; i++)
+    {
+        if (pthread_create(&(*tdb)->compaction_threads[i], NULL, _compaction_thread, *tdb) != 0)
+        {
+            /* we stop the threads we started and close again */
+            (*tdb)->config.compaction_threads = i;
+            tidesdb_close(*tdb);
+            *tdb = NULL;
+            return tidesdb_err_new(1094, "Failed to start compaction thread");
+        }
+    }
+
     return NULL;
 }
 
 tidesdb_err_t* tidesdb_create_column_family(tidesdb_t* tdb, const char* name, int flush_threshold,
                                             int max_level, float probability, bool compressed)
+{
+    /* we create a config with the default sstable settings */
+    column_family_config_t config = {0};
+
+    config.name = (char*)name;
+    config.flush_threshold = flush_threshold;
+    config.max_level = max_level;
+    config.probability = probability;
+    config.compressed = compressed;
+
+    return tidesdb_create_column_family_with_config(tdb, &config);
+}
+
+tidesdb_err_t* tidesdb_create_column_family_with_config(tidesdb_t* tdb,
+                                                        const column_family_config_t* config)
 {
     /* we check if the db is NULL */
     if (tdb == NULL) return tidesdb_err_new(1002, "TidesDB is NULL");
 
     /* we check if the name is NULL */
-    if (name == NULL) return tidesdb_err_new(1015, "Column family name is NULL");
+    if (config == NULL || config->name == NULL)
+        return tidesdb_err_new(1015, "Column family name is NULL");
 
     /* we check if the column family name is greater than 2 */
-    if (strlen(name) < 2) return tidesdb_err_new(1016, "Column family name is too short");
+    if (strlen(config->name) < 2) return tidesdb_err_new(1016, "Column family name is too short");
 
     /* we check flush threshold
      * the system expects at least a 1mb threshold */
-    if (flush_threshold < 1048576) return tidesdb_err_new(1017, "Flush threshold is too low");
+    if (config->flush_threshold < 1048576)
+        return tidesdb_err_new(1017, "Flush threshold is too low");
 
     /* we check max level
      * the system expects at least a level of 5 */
-    if (max_level < 5) return tidesdb_err_new(1018, "Max level is too low");
+    if (config->max_level < 5) return tidesdb_err_new(1018, "Max level is too low");
 
     /* we check probability
      * the system expects at least a probability of 0.1 */
-    if (probability < 0.1) return tidesdb_err_new(1019, "Probability is too low");
+    if (config->probability < 0.1) return tidesdb_err_new(1019, "Probability is too low");
+
+    /* we check the sstable block size, 0 means the default */
+    if (config->block_size != 0 && (config->block_size < SSTABLE_MIN_BLOCK_SIZE ||
+                                    config->block_size > SSTABLE_MAX_BLOCK_SIZE))
+        return tidesdb_err_new(1086, "Block size is out of range");
+
+    /* we check the bloom filter bits per key, 0 means the default */
+    if (config->bloom_bits_per_key != 0 &&
+        (config->bloom_bits_per_key < BLOCKED_BLOOMFILTER_MIN_BITS ||
+         config->bloom_bits_per_key > BLOCKED_BLOOMFILTER_MAX_BITS))
+        return tidesdb_err_new(1087, "Bloom filter bits per key is out of range");
+
+    /* we check the level size multiplier, 0 means the default */
+    if (config->level_size_multiplier != 0 &&
+        (config->level_size_multiplier < TIDESDB_MIN_LEVEL_MULTIPLIER ||
+         config->level_size_multiplier > TIDESDB_MAX_LEVEL_MULTIPLIER))
+        return tidesdb_err_new(1088, "Level size multiplier is out of range");
+
+    /* we check the target file size, 0 means the default */
+    if (config->target_file_size != 0 && config->target_file_size < TIDESDB_MIN_TARGET_FILE_SIZE)
+        return tidesdb_err_new(1089, "Target file size is too low");
+
+    /* we check the background compaction ratio triggers, they are percentages */
+    if (config->tombstone_ratio_trigger > 100 || config->expired_ratio_trigger > 100)
+        return tidesdb_err_new(1095, "Compaction trigger ratio is out of range");
 
     column_family_t* cf = NULL;
-    if (_new_column_family(tdb->config.db_path, name, flush_threshold, max_level, probability, &cf,
-                           compressed) == -1)
+    if (_new_column_family(tdb->config.db_path, tdb->config.wal_dir, tdb->sync_service, config,
+                           &cf) == -1)
         return tidesdb_err_new(1020, "Failed to create new column family");
 
+    /* its sstables open their readers through the table cache of the database */
+    cf->table_cache = tdb->table_cache;
+
     /* now we add the column family */
     if (_add_column_family(tdb, cf) == -1)
         return tidesdb_err_new(1021, "Failed to add column family");
@@ -209,35 +364,40 @@ tidesdb_err_t* tidesdb_drop_column_family(tidesdb_t* tdb, const char* name)
     /* free the resources associated with the column family */
     free(tdb->column_families[index].config.name);
 
-    /* check if the column family has sstables */
-    if (tdb->column_families[index].num_sstables > 0)
+    /* lck the sstables lock */
+    if (pthread_rwlock_wrlock(&tdb->column_families[index].sstables_lock) != 0)
     {
-        /* lck the sstables lock */
-        if (pthread_rwlock_wrlock(&tdb->column_families[index].sstables_lock) != 0)
-        {
-            pthread_rwlock_unlock(&tdb->column_families_lock);
-            return tidesdb_err_new(1030, "Failed to acquire sstables lock");
-        }
-
-        /* iterate over the sstables and free the resources */
-        for (int i = 0; i < tdb->column_families[index].num_sstables; i++)
-            _free_sstable(tdb->column_families[index].sstables[i]);
+        pthread_rwlock_unlock(&tdb->column_families_lock);
+        return tidesdb_err_new(1030, "Failed to acquire sstables lock");
+    }
 
-        /* free the sstables array */
-        free(tdb->column_families[index].sstables);
+    /* we release the current version, the memtables and sstables go with the last reader */
+    _release_version(tdb->column_families[index].version);
+    tdb->column_families[index].version = NULL;
+    tdb->column_families[index].memtable = NULL;
 
-        /* unlock the sstables lock */
-        pthread_rwlock_unlock(&tdb->column_families[index].sstables_lock);
-    }
+    /* unlock the sstables lock */
+    pthread_rwlock_unlock(&tdb->column_families[index].sstables_lock);
 
-    skiplist_destroy(tdb->column_families[index].memtable);
     pthread_rwlock_destroy(&tdb->column_families[index].sstables_lock);
-    id_gen_destroy(tdb->column_families[index].id_gen);
+    pthread_rwlock_destroy(&tdb->column_families[index].memtable_lock);
+
+    /* we close the wal, its segments go with the column family directory or with a directory of
+     * their own in the wal directory */
+    char wal_path[PATH_MAX];
+    snprintf(wal_path, sizeof(wal_path), "%s", tdb->column_families[index].wal->path);
+    _close_wal(tdb->column_families[index].wal);
+    tdb->column_families[index].wal = NULL;
+
+    if (tdb->config.wal_dir != NULL) _remove_directory(wal_path);
+
+    /* we close the manifest */
+    manifest_close(tdb->column_families[index].manifest);
+    tdb->column_families[index].manifest = NULL;
 
     /* remove all files in the column family directory */
     _remove_directory(tdb->column_families[index].path);
 
-    free(tdb->column_families[index].sstables);
     free(tdb->column_families[index].path);
 
     /* destroy compaction_or_flush_lock */
@@ -273,45 +433,15 @@ tidesdb_err_t* tidesdb_drop_column_family(tidesdb_t* tdb, const char* name)
     return NULL;
 }
 
-void _compact_sstables_thread(void* arg)
+void* _compact_sstables_thread(void* arg)
 {
-    compact_thread_args_t* args = arg;
-    column_family_t* cf = args->cf;
-    int start = args->start;
-    int end = args->end;
-
-    /* merge the current and ith+1 sstables */
-    sstable_t* new_sstable = _merge_sstables(cf->sstables[start], cf->sstables[end], cf);
-
-    /* we check if the new sstable is NULL */
-    if (new_sstable == NULL)
-    {
-        free(args);
-        return;
-    }
-
-    /* remove old sstable files */
-    char sstable_path1[PATH_MAX];
-    char sstable_path2[PATH_MAX];
-
-    /* get the sstable paths */
-    snprintf(sstable_path1, PATH_MAX, "%s", cf->sstables[start]->pager->filename);
-    snprintf(sstable_path2, PATH_MAX, "%s", cf->sstables[end]->pager->filename);
-
-    /* free the old sstables */
-    _free_sstable(cf->sstables[start]);
-    _free_sstable(cf->sstables[end]);
+    compaction_job_t* job = arg;
 
-    /* remove the sstable files */
-    remove(sstable_path1);
-    remove(sstable_path2);
+    /* we merge the inputs, the job is installed by the thread that started it */
+    job->rc = _merge_sstables(job);
 
-    /* replace the old sstables with the new one */
-    cf->sstables[start] = new_sstable;
-    cf->sstables[end] = NULL;
-
-    sem_post(args->sem); /* signal compaction thread is done */
-    free(args);
+    sem_post(job->sem); /* signal compaction thread is done */
+    return NULL;
 }
 
 tidesdb_err_t* tidesdb_compact_sstables(tidesdb_t* tdb, const char* column_family, int max_threads)
@@ -327,576 +457,1026 @@ tidesdb_err_t* tidesdb_compact_sstables(tidesdb_t* tdb, const char* column_famil
     if (cf == NULL) return tidesdb_err_new(1028, "Column family not found");
     if (max_threads < 1) return tidesdb_err_new(1029, "Max threads is too low");
 
-    if (pthread_rwlock_wrlock(&cf->compaction_or_flush_lock) != 0)
-        return tidesdb_err_new(1068, "Failed to lock compaction or flush lock");
+    /* a manual compaction overrides the background compaction of the column family, we keep the
+     * background threads away from it and wait for their running jobs to finish */
+    pthread_mutex_lock(&tdb->compaction_lock);
+    while (cf->manual_compaction) pthread_cond_wait(&tdb->compaction_cond, &tdb->compaction_lock);
+    cf->manual_compaction = true;
 
-    int num_sstables = cf->num_sstables;
-    if (num_sstables < 2)
+    bool running = true;
+    while (running)
     {
-        pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
-        return tidesdb_err_new(1051, "Not enough sstables to compact");
+        running = false;
+        for (int i = 0; i < tdb->config.compaction_threads; i++)
+            if (tdb->compaction_jobs[i] != NULL && tdb->compaction_jobs[i]->cf == cf)
+                running = true;
+
+        if (running) pthread_cond_wait(&tdb->compaction_cond, &tdb->compaction_lock);
     }
+    pthread_mutex_unlock(&tdb->compaction_lock);
 
-    qsort(cf->sstables, num_sstables, sizeof(sstable_t*), _compare_sstables);
+    tidesdb_err_t* e = _compact_sstables(cf, max_threads);
 
-    sem_t sem;
-    sem_init(&sem, 0, max_threads);
+    pthread_mutex_lock(&tdb->compaction_lock);
+    cf->manual_compaction = false;
+    pthread_cond_broadcast(&tdb->compaction_cond);
+    pthread_mutex_unlock(&tdb->compaction_lock);
+
+    return e;
+}
 
-    for (int i = 0; i < num_sstables - 1; i += 2)
+tidesdb_err_t* _compact_sstables(column_family_t* cf, int max_threads)
+{
+    /* we look at the current version, flushes may publish new ones while we compact but they
+     * only add to level 0 */
+    tidesdb_version_t* version = _pin_version(cf);
+    int num_sstables = version->num_sstables;
+    int num_level0 = version->level_counts[0];
+    _release_version(version);
+
+    if (num_sstables < 2) return tidesdb_err_new(1051, "Not enough sstables to compact");
+
+    /* level 0 sstables overlap each other so all of them are merged into level 1 at once */
+    if (num_level0 > 0 && _compact_level(cf, 0, max_threads) == 0)
+        return tidesdb_err_new(1090, "Failed to compact sstables");
+
+    /* every level over its target size is compacted into the next, the last level has no
+     * target */
+    for (int level = 1; level < TIDESDB_NUM_LEVELS - 1; level++)
     {
-        sem_wait(&sem); /* we wait if the maximum number of threads is reached */
+        while (true)
+        {
+            version = _pin_version(cf);
+            bool over_target = _level_size(version, level) > _level_target_size(cf, level);
+            _release_version(version);
 
-        compact_thread_args_t* args = malloc(sizeof(compact_thread_args_t));
-        args->cf = cf;
-        args->start = i;
-        args->end = i + 1;
-        args->sem = &sem;
+            if (!over_target) break;
 
-        pthread_t thread;
-        pthread_create(&thread, NULL, _compact_sstables_thread, args);
-        pthread_detach(thread);
+            if (_compact_level(cf, level, max_threads) == 0)
+                return tidesdb_err_new(1090, "Failed to compact sstables");
+        }
     }
 
-    /* wait for all compaction threads to finish */
-    for (int i = 0; i < max_threads; i++)
-    {
-        sem_wait(&sem);
-    }
+    return NULL;
+}
 
-    sem_destroy(&sem);
+int _level_start(const tidesdb_version_t* version, int level)
+{
+    /* the deepest level comes first in the sstables array */
+    int start = 0;
+    for (int l = TIDESDB_NUM_LEVELS - 1; l > level; l--) start += version->level_counts[l];
 
-    int j = 0;
-    for (int i = 0; i < num_sstables; i++)
-    {
-        if (cf->sstables[i] != NULL) cf->sstables[j++] = cf->sstables[i];
-    }
+    return start;
+}
 
-    cf->num_sstables = j;
+uint64_t _level_size(const tidesdb_version_t* version, int level)
+{
+    int start = _level_start(version, level);
 
-    pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+    uint64_t size = 0;
+    for (int i = start; i < start + version->level_counts[level]; i++)
+        size += sstable_size(version->sstables[i]);
 
-    return NULL;
+    return size;
 }
 
-sstable_t* _merge_sstables(sstable_t* sst1, sstable_t* sst2, column_family_t* cf)
+uint64_t _level_target_size(const column_family_t* cf, int level)
 {
-    if (cf == NULL || sst1 == NULL || sst2 == NULL)
-    {
-        return NULL;
-    }
+    uint64_t multiplier = cf->config.level_size_multiplier ? cf->config.level_size_multiplier
+                                                           : TIDESDB_DEFAULT_LEVEL_MULTIPLIER;
+    uint64_t file_size = cf->config.target_file_size ? cf->config.target_file_size
+                                                     : TIDESDB_DEFAULT_TARGET_FILE_SIZE;
 
-    /* we used a skiplist to keep things in order */
-    skiplist_t* mergetable = new_skiplist(cf->config.max_level, cf->config.probability);
-    if (mergetable == NULL)
-    {
-        return NULL;
-    }
+    /* level 1 holds multiplier files, every level after that multiplier times the one before */
+    uint64_t target = file_size * multiplier;
+    for (int l = 1; l < level; l++) target *= multiplier;
 
-    /* create a new bloomfilter for the merged sstable */
-    bloomfilter_t* bf = bloomfilter_create(BLOOMFILTER_SIZE);
-    if (bf == NULL)
-    {
-        skiplist_destroy(mergetable);
-        return NULL;
-    }
+    return target;
+}
 
-    pager_cursor_t* cursor1 = NULL;
-    pager_cursor_t* cursor2 = NULL;
+int _find_level_sstable(const tidesdb_version_t* version, int level, const uint8_t* key,
+                        size_t key_size)
+{
+    int low = _level_start(version, level);
+    int high = low + version->level_counts[level];
+    int end = high;
 
-    /* we initialize a new cursor for each sstable */
-    if (pager_cursor_init(sst1->pager, &cursor1) == -1 ||
-        pager_cursor_init(sst2->pager, &cursor2) == -1)
+    /* the sstables of a level are sorted by key and do not overlap, we look for the first one
+     * whose largest key is >= key */
+    while (low < high)
     {
-        skiplist_destroy(mergetable);
-        bloomfilter_destroy(bf);
-        if (cursor1) pager_cursor_free(cursor1);
-        if (cursor2) pager_cursor_free(cursor2);
-        return NULL;
+        int mid = low + (high - low) / 2;
+        sstable_t* sst = version->sstables[mid];
+
+        if (sst->max_key != NULL &&
+            sstable_compare_keys(sst->max_key, sst->max_key_size, key, key_size) < 0)
+            low = mid + 1;
+        else
+            high = mid;
     }
 
-    /* skip bloom filter pages */
-    if (pager_cursor_next(cursor1) == -1 || pager_cursor_next(cursor2) == -1)
+    if (low == end) return -1;
+
+    sstable_t* sst = version->sstables[low];
+    if (sst->min_key != NULL &&
+        sstable_compare_keys(key, key_size, sst->min_key, sst->min_key_size) < 0)
+        return -1;
+
+    return low;
+}
+
+bool _is_bottommost_level(const tidesdb_version_t* version, int level)
+{
+    for (int l = level + 1; l < TIDESDB_NUM_LEVELS; l++)
+        if (version->level_counts[l] > 0) return false;
+
+    return true;
+}
+
+compaction_job_t* _new_compaction_job(column_family_t* cf, tidesdb_version_t* version, int level,
+                                      int first, int count)
+{
+    compaction_job_t* job = calloc(1, sizeof(compaction_job_t));
+    if (job == NULL) return NULL;
+
+    /* the last level has no next level, its sstables are rewritten in place to drop what is
+     * deleted or expired */
+    int output_level = level < TIDESDB_NUM_LEVELS - 1 ? level + 1 : level;
+    int next_start = _level_start(version, output_level);
+    int next_count = output_level > level ? version->level_counts[output_level] : 0;
+
+    job->cf = cf;
+    job->input_level = level;
+    job->output_level = output_level;
+    job->drop_tombstones = _is_bottommost_level(version, output_level);
+    job->inputs = malloc((count + next_count) * sizeof(sstable_t*));
+    if (job->inputs == NULL)
     {
-        skiplist_destroy(mergetable);
-        bloomfilter_destroy(bf);
-        pager_cursor_free(cursor1);
-        pager_cursor_free(cursor2);
+        free(job);
         return NULL;
     }
 
-    unsigned int current_page = 0;
+    /* the inputs stay open while the job reads them, whatever gets published meanwhile */
+    job->version = version;
+    atomic_fetch_add(&version->refs, 1);
 
-    while (pager_cursor_get(cursor1, &current_page) != -1)
-    {
-        uint8_t* buffer = NULL;
-        size_t buffer_len = 0;
+    /* we take the key range covering all the given sstables, an sstable without a known range
+     * (written before the meta block) covers everything */
+    const uint8_t* min_key = NULL;
+    size_t min_key_size = 0;
+    const uint8_t* max_key = NULL;
+    size_t max_key_size = 0;
+    bool unbounded = false;
 
-        if (pager_read(sst1->pager, current_page, &buffer, &buffer_len) == -1)
+    for (int i = first; i < first + count; i++)
+    {
+        sstable_t* sst = version->sstables[i];
+        if (sst->min_key == NULL || sst->max_key == NULL)
         {
-            free(buffer);
+            unbounded = true;
             break;
         }
 
-        key_value_pair_t* kv = NULL;
-
-        if (deserialize_key_value_pair(buffer, buffer_len, &kv, cf->config.compressed) == -1)
+        if (min_key == NULL ||
+            sstable_compare_keys(sst->min_key, sst->min_key_size, min_key, min_key_size) < 0)
         {
-            free(buffer);
-            break;
+            min_key = sst->min_key;
+            min_key_size = sst->min_key_size;
         }
 
-        /* we check if the value is not a tombstone and if ttl is set if it is not expired */
-        if (kv && !_is_tombstone(kv->value, kv->value_size) &&
-            (kv->ttl == -1 || kv->ttl > time(NULL)))
+        if (max_key == NULL ||
+            sstable_compare_keys(sst->max_key, sst->max_key_size, max_key, max_key_size) > 0)
         {
-            skiplist_put(mergetable, kv->key, kv->key_size, kv->value, kv->value_size, kv->ttl);
-            bloomfilter_add(bf, kv->key, kv->key_size);
+            max_key = sst->max_key;
+            max_key_size = sst->max_key_size;
         }
+    }
 
-        free(kv);
+    if (unbounded) min_key = max_key = NULL;
 
-        free(buffer);
+    /* the overlapping sstables of the next level are older, so they go first */
+    for (int i = next_start; i < next_start + next_count; i++)
+        if (sstable_overlaps(version->sstables[i], min_key, min_key_size, max_key, max_key_size))
+            job->inputs[job->num_inputs++] = version->sstables[i];
 
-        if (pager_cursor_next(cursor1) == -1)
-        {
-            break;
-        }
-    }
+    for (int i = first; i < first + count; i++)
+        job->inputs[job->num_inputs++] = version->sstables[i];
+
+    return job;
+}
 
-    pager_cursor_free(cursor1);
+void _free_compaction_job(compaction_job_t* job)
+{
+    if (job == NULL) return;
 
-    while (pager_cursor_get(cursor2, &current_page) != -1)
+    /* outputs that were not installed are removed */
+    for (int i = 0; i < job->num_outputs; i++)
     {
-        uint8_t* buffer = NULL;
-        size_t buffer_len = 0;
+        char path[PATH_MAX];
+        snprintf(path, PATH_MAX, "%s", job->outputs[i]->filename);
 
-        if (pager_read(sst2->pager, current_page, &buffer, &buffer_len) == -1)
-        {
-            free(buffer);
-            break;
-        }
+        sstable_close(job->outputs[i]);
+        remove(path);
+    }
 
-        key_value_pair_t* kv = NULL;
+    _release_version(job->version);
 
-        if (deserialize_key_value_pair(buffer, buffer_len, &kv, cf->config.compressed) == -1)
-        {
-            free(buffer);
-            break;
-        }
+    free(job->outputs);
+    free(job->inputs);
+    free(job);
+}
 
-        /* we check if the value is not a tombstone and if ttl is set if it is not expired */
-        if (kv && !_is_tombstone(kv->value, kv->value_size) &&
-            (kv->ttl == -1 || kv->ttl > time(NULL)))
-        {
-            skiplist_put(mergetable, kv->key, kv->key_size, kv->value, kv->value_size, kv->ttl);
-            bloomfilter_add(bf, kv->key, kv->key_size);
-        }
+int _run_compaction_jobs(column_family_t* cf, compaction_job_t** jobs, int num_jobs,
+                         int max_threads)
+{
+    sem_t sem;
+    sem_init(&sem, 0, max_threads);
 
-        free(kv);
+    for (int i = 0; i < num_jobs; i++)
+    {
+        sem_wait(&sem); /* we wait if the maximum number of threads is reached */
 
-        free(buffer);
+        jobs[i]->sem = &sem;
 
-        if (pager_cursor_next(cursor2) == -1)
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, _compact_sstables_thread, jobs[i]) != 0)
         {
-            break;
+            /* we run the job on this thread instead */
+            _compact_sstables_thread(jobs[i]);
+            continue;
         }
+        pthread_detach(thread);
     }
 
-    free(cursor2);
+    /* wait for all compaction threads to finish */
+    for (int i = 0; i < max_threads; i++)
+    {
+        sem_wait(&sem);
+    }
 
-    pager_t* new_pager = NULL;
-    char new_sstable_name[PATH_MAX];
+    sem_destroy(&sem);
 
-    snprintf(new_sstable_name, PATH_MAX, "%s%ssstable_%lu%s", cf->path, _get_path_seperator(),
-             id_gen_new(cf->id_gen), SSTABLE_EXT);
+    /* we publish the outputs, readers carry on with the version they pinned */
+    int installed = 0;
+    pthread_rwlock_wrlock(&cf->compaction_or_flush_lock);
 
-    if (pager_open(new_sstable_name, &new_pager) == -1)
-    {
-        skiplist_destroy(mergetable);
-        bloomfilter_destroy(bf);
-        return NULL;
-    }
+    for (int i = 0; i < num_jobs; i++)
+        if (jobs[i]->rc == 0 && _install_compaction_job(cf, jobs[i]) == 0) installed++;
 
-    uint8_t* bf_buffer = NULL;
-    size_t bf_buffer_len = 0;
+    pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+
+    for (int i = 0; i < num_jobs; i++) _free_compaction_job(jobs[i]);
+
+    return installed;
+}
 
-    if (serialize_bloomfilter(bf, &bf_buffer, &bf_buffer_len, cf->config.compressed) == -1)
+int _install_compaction_job(column_family_t* cf, compaction_job_t* job)
+{
+    /* only publishers change the current version and they hold the compaction or flush lock */
+    tidesdb_version_t* current = cf->version;
+
+    int num_sstables = current->num_sstables + job->num_outputs;
+    sstable_t** sstables = malloc((num_sstables ? num_sstables : 1) * sizeof(sstable_t*));
+    if (sstables == NULL) return -1;
+
+    /* we keep every sstable that was not an input, flushes may have added some since the job
+     * was picked */
+    int j = 0;
+    int removed = 0;
+    for (int i = 0; i < current->num_sstables; i++)
     {
-        skiplist_destroy(mergetable);
-        bloomfilter_destroy(bf);
-        pager_close(new_pager);
-        return NULL;
-    }
+        bool input = false;
+        for (int k = 0; k < job->num_inputs && !input; k++)
+            input = current->sstables[i] == job->inputs[k];
 
-    unsigned int page_num; /* bf page number */
+        if (input)
+            removed++;
+        else
+            sstables[j++] = current->sstables[i];
+    }
 
-    if (pager_write(new_pager, bf_buffer, bf_buffer_len, &page_num) == -1)
+    /* an input that is gone was compacted by someone else, the outputs would resurrect it */
+    if (removed != job->num_inputs)
     {
-        skiplist_destroy(mergetable);
-        bloomfilter_destroy(bf);
-        pager_close(new_pager);
-        free(bf_buffer);
-        return NULL;
+        free(sstables);
+        return -1;
     }
 
-    /* clean up bf */
-    free(bf_buffer);
-    bloomfilter_destroy(bf);
+    for (int i = 0; i < job->num_outputs; i++) sstables[j++] = job->outputs[i];
 
-    /* check mergetable size */
-    if (mergetable->total_size == 0)
+    tidesdb_version_t* version =
+        _new_version(sstables, j, current->memtables, current->num_memtables);
+    free(sstables);
+    if (version == NULL) return -1;
+
+    /* the outputs take the place of the inputs in the manifest with a single edit, a crash leaves
+     * the manifest with one or the other */
+    manifest_table_t* added = malloc((job->num_outputs ? job->num_outputs : 1) *
+                                     sizeof(manifest_table_t));
+    char** removed_names = malloc(job->num_inputs * sizeof(char*));
+    if (added == NULL || removed_names == NULL)
     {
-        skiplist_destroy(mergetable);
-        pager_close(new_pager);
+        free(added);
+        free(removed_names);
+        _release_version(version);
+        return -1;
+    }
 
-        /* remove the sstable file */
-        remove(new_sstable_name);
-        return NULL;
+    for (int i = 0; i < job->num_outputs; i++) _manifest_table(job->outputs[i], &added[i]);
+    for (int i = 0; i < job->num_inputs; i++)
+    {
+        manifest_table_t input;
+        _manifest_table(job->inputs[i], &input);
+        removed_names[i] = input.name;
     }
 
-    skiplist_cursor_t* sl_cursor = skiplist_cursor_init(mergetable);
+    manifest_edit_t edit = {added, (uint32_t)job->num_outputs, removed_names,
+                            (uint32_t)job->num_inputs, atomic_load(&cf->next_file_number), 0};
+    int rc = manifest_append(cf->manifest, &edit);
+    free(added);
+    free(removed_names);
 
-    bool has_next = true;
-    do
+    if (rc == -1)
     {
-        uint8_t* kv_buffer = NULL;
-        size_t kv_buffer_len = 0;
+        _release_version(version);
+        return -1;
+    }
 
-        key_value_pair_t* kvp = malloc(sizeof(key_value_pair_t));
-        if (kvp == NULL) break;
+    /* the input files are removed once the last version holding them is released, their pairs
+     * live on in the outputs */
+    for (int i = 0; i < job->num_inputs; i++) atomic_store(&job->inputs[i]->obsolete, true);
 
-        kvp->key = sl_cursor->current->key;
-        kvp->key_size = sl_cursor->current->key_size;
-        kvp->value = sl_cursor->current->value;
-        kvp->value_size = sl_cursor->current->value_size;
-        kvp->ttl = sl_cursor->current->ttl;
+    _publish_version(cf, version);
 
-        if (serialize_key_value_pair(kvp, &kv_buffer, &kv_buffer_len, cf->config.compressed) == -1)
-        {
-            free(kvp);
-            break;
-        }
+    /* the outputs belong to the version now */
+    for (int i = 0; i < job->num_outputs; i++) sstable_unref(job->outputs[i]);
 
-        unsigned int page_number;
+    free(job->outputs);
+    job->outputs = NULL;
+    job->num_outputs = 0;
 
-        if (pager_write(new_pager, kv_buffer, kv_buffer_len, &page_number) == -1)
-        {
-            free(kv_buffer);
-            break;
-        }
+    return 0;
+}
 
-        free(kv_buffer);
+int _compact_level(column_family_t* cf, int level, int max_threads)
+{
+    /* the jobs pin the version themselves, we release ours when they are picked */
+    tidesdb_version_t* version = _pin_version(cf);
 
-        has_next = skiplist_cursor_next(sl_cursor) == -1 ? false : true;
+    int start = _level_start(version, level);
+    int count = version->level_counts[level];
+    if (count == 0)
+    {
+        _release_version(version);
+        return 0;
+    }
 
-    } while (has_next);
+    if (level == 0)
+    {
+        compaction_job_t* job = _new_compaction_job(cf, version, 0, start, count);
+        _release_version(version);
+        if (job == NULL) return 0;
 
-    skiplist_destroy(mergetable);
+        return _run_compaction_jobs(cf, &job, 1, 1);
+    }
 
-    sstable_t* new_sstable = malloc(sizeof(sstable_t));
-    if (new_sstable == NULL)
+    compaction_job_t** candidates = malloc(count * sizeof(compaction_job_t*));
+    double* scores = malloc(count * sizeof(double));
+    if (candidates == NULL || scores == NULL)
     {
-        pager_close(new_pager);
-        return NULL;
+        free(candidates);
+        free(scores);
+        _release_version(version);
+        return 0;
     }
 
-    new_sstable->pager = new_pager;
+    /* every sstable of the level is a candidate, a job rewrites its overlap in the next level
+     * so we prefer the sstables with the least overlap for their size */
+    int num_candidates = 0;
+    for (int i = start; i < start + count; i++)
+    {
+        compaction_job_t* job = _new_compaction_job(cf, version, level, i, 1);
+        if (job == NULL) continue;
 
-    return new_sstable;
-}
+        uint64_t overlap = 0;
+        for (int k = 0; k < job->num_inputs - 1; k++) overlap += sstable_size(job->inputs[k]);
 
-tidesdb_err_t* tidesdb_put(tidesdb_t* tdb, const char* column_family_name, const uint8_t* key,
-                           size_t key_size, const uint8_t* value, size_t value_size, time_t ttl)
-{
-    /* we check if the db is NULL */
-    if (tdb == NULL) return tidesdb_err_new(1002, "TidesDB is NULL");
+        uint64_t size = sstable_size(version->sstables[i]);
+        double score = (double)overlap / (double)(size ? size : 1);
 
-    /* we check if the column family name is NULL */
-    if (column_family_name == NULL) return tidesdb_err_new(1015, "Column family name is NULL");
+        /* we insert the candidate in score order */
+        int pos = num_candidates++;
+        while (pos > 0 && scores[pos - 1] > score)
+        {
+            candidates[pos] = candidates[pos - 1];
+            scores[pos] = scores[pos - 1];
+            pos--;
+        }
+        candidates[pos] = job;
+        scores[pos] = score;
+    }
 
-    /* we check if the key is NULL */
-    if (key == NULL) return tidesdb_err_new(1026, "Key is NULL");
+    /* we pick up to max_threads jobs that share no input, the sstables of a level do not overlap
+     * so such jobs write disjoint key ranges and can run at the same time */
+    compaction_job_t** jobs = malloc((num_candidates ? num_candidates : 1) * sizeof(*jobs));
+    int num_jobs = 0;
 
-    /* we check if the value is NULL */
-    if (value == NULL) return tidesdb_err_new(1027, "Value is NULL");
+    for (int c = 0; c < num_candidates; c++)
+    {
+        bool conflict = jobs == NULL || num_jobs >= max_threads;
+        for (int j = 0; j < num_jobs && !conflict; j++)
+            for (int a = 0; a < candidates[c]->num_inputs && !conflict; a++)
+                for (int b = 0; b < jobs[j]->num_inputs && !conflict; b++)
+                    conflict = candidates[c]->inputs[a] == jobs[j]->inputs[b];
+
+        if (conflict)
+            _free_compaction_job(candidates[c]);
+        else
+            jobs[num_jobs++] = candidates[c];
+    }
 
-    /* we get column family */
-    column_family_t* cf = NULL;
+    free(candidates);
+    free(scores);
+    _release_version(version);
 
-    if (_get_column_family(tdb, column_family_name, &cf) == -1)
-        return tidesdb_err_new(1028, "Column family not found");
+    int installed = num_jobs > 0 ? _run_compaction_jobs(cf, jobs, num_jobs, max_threads) : 0;
+    free(jobs);
 
-    /* we append to the wal */
-    if (_append_to_wal(tdb, cf->wal, key, key_size, value, value_size, ttl, OP_PUT,
-                       column_family_name) == -1)
-        return tidesdb_err_new(1049, "Failed to append to wal");
+    return installed;
+}
 
-    /* put in memtable */
-    if (skiplist_put(cf->memtable, key, key_size, value, value_size, ttl) == -1)
-        return tidesdb_err_new(1050, "Failed to put into memtable");
+void* _compaction_thread(void* arg)
+{
+    tidesdb_t* tdb = arg;
 
-    /* we check if the memtable has reached the flush threshold */
-    if ((int)cf->memtable->total_size >= cf->config.flush_threshold)
+    while (true)
     {
-        /* get flush lock and lock it */
-        pthread_mutex_lock(&tdb->flush_lock);
+        /* the column families stay where they are while we pick and run a job */
+        pthread_rwlock_rdlock(&tdb->column_families_lock);
+        pthread_mutex_lock(&tdb->compaction_lock);
 
-        queue_entry_t* entry = malloc(sizeof(queue_entry_t)); /* we allocate a queue entry */
-        if (entry == NULL)
+        if (tdb->stop_compaction_threads)
         {
-            /* unlock the flush mutex */
-            pthread_mutex_unlock(&tdb->flush_lock);
-            return tidesdb_err_new(1045, "Failed to allocate memory for queue entry");
+            pthread_mutex_unlock(&tdb->compaction_lock);
+            pthread_rwlock_unlock(&tdb->column_families_lock);
+            break;
         }
 
-        /* we make a copy of the memtable whilst also setting
-         * the entry memtable to be flushed to disk */
-        entry->memtable = skiplist_copy(cf->memtable);
-        if (entry->memtable == NULL)
+        compaction_job_t* job = _next_compaction_job(tdb);
+        if (job == NULL)
         {
-            /* unlock the flush mutex */
-            pthread_mutex_unlock(&tdb->flush_lock);
-            free(entry);
-            return tidesdb_err_new(1011, "Failed to copy memtable");
-        }
+            pthread_rwlock_unlock(&tdb->column_families_lock);
 
-        entry->cf = cf; /* we set the column family for the entry */
+            /* we wait for a flush or a finished job, ttls expire without either so we look again
+             * after an interval */
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += TIDESDB_COMPACTION_INTERVAL;
 
-        /* we get the wal checkpoint */
-        if (pager_size(cf->wal->pager, &entry->wal_checkpoint) == -1)
-        {
-            pthread_mutex_unlock(&tdb->flush_lock);
-            free(entry);
-            return tidesdb_err_new(1012, "Failed to get wal checkpoint");
+            if (!tdb->stop_compaction_threads)
+                pthread_cond_timedwait(&tdb->compaction_cond, &tdb->compaction_lock, &deadline);
+
+            pthread_mutex_unlock(&tdb->compaction_lock);
+            continue;
         }
 
-        /* enqueue the entry */
-        queue_enqueue(tdb->flush_queue, entry);
+        /* we claim a slot so other threads and manual compactions see the job */
+        int slot = 0;
+        while (tdb->compaction_jobs[slot] != NULL) slot++;
+        tdb->compaction_jobs[slot] = job;
 
-        /* we signal the flush thread */
-        pthread_cond_signal(&tdb->flush_cond);
+        pthread_mutex_unlock(&tdb->compaction_lock);
 
-        /* now we clear the memtable */
-        skiplist_clear(cf->memtable);
+        /* the inputs are only read, reads and flushes carry on while we merge */
+        job->rc = _merge_sstables(job);
 
-        /* unlock the flush mutex */
-        pthread_mutex_unlock(&tdb->flush_lock);
+        column_family_t* cf = job->cf;
+        pthread_rwlock_wrlock(&cf->compaction_or_flush_lock);
+
+        if (job->rc == 0 && _install_compaction_job(cf, job) == -1) job->rc = -1;
+
+        pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+
+        pthread_mutex_lock(&tdb->compaction_lock);
+        tdb->compaction_jobs[slot] = NULL;
+        pthread_cond_broadcast(&tdb->compaction_cond);
+
+        /* a failed job would be picked again right away, we give it an interval */
+        if (job->rc == -1 && !tdb->stop_compaction_threads)
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += TIDESDB_COMPACTION_INTERVAL;
+            pthread_cond_timedwait(&tdb->compaction_cond, &tdb->compaction_lock, &deadline);
+        }
+
+        pthread_mutex_unlock(&tdb->compaction_lock);
+        pthread_rwlock_unlock(&tdb->column_families_lock);
+
+        _free_compaction_job(job);
     }
 
     return NULL;
 }
 
-tidesdb_err_t* tidesdb_get(tidesdb_t* tdb, const char* column_family_name, const uint8_t* key,
-                           size_t key_size, uint8_t** value, size_t* value_size)
+void _stop_compaction_threads(tidesdb_t* tdb)
 {
-    /* we check if the db is NULL */
-    if (tdb == NULL) return tidesdb_err_new(1002, "TidesDB is NULL");
+    pthread_mutex_lock(&tdb->compaction_lock);
+    tdb->stop_compaction_threads = true;
+    pthread_cond_broadcast(&tdb->compaction_cond);
+    pthread_mutex_unlock(&tdb->compaction_lock);
+
+    /* running jobs are finished and installed before the threads exit */
+    for (int i = 0; i < tdb->config.compaction_threads; i++)
+        pthread_join(tdb->compaction_threads[i], NULL);
+
+    free(tdb->compaction_threads);
+    tdb->compaction_threads = NULL;
+    free(tdb->compaction_jobs);
+    tdb->compaction_jobs = NULL;
+    tdb->config.compaction_threads = 0;
+}
 
-    /* we check if the column family name is NULL */
-    if (column_family_name == NULL) return tidesdb_err_new(1015, "Column family name is NULL");
+compaction_job_t* _next_compaction_job(tidesdb_t* tdb)
+{
+    compaction_candidate_t* candidates = NULL;
+    int num_candidates = 0;
+    int cap = 0;
 
-    /* we check if key is NULL */
-    if (key == NULL) return tidesdb_err_new(1026, "Key is NULL");
+    /* we rank the candidates of the version every column family has now, flushes and installs
+     * publish new versions meanwhile without waiting for us */
+    tidesdb_version_t** versions = calloc(tdb->num_column_families + 1, sizeof(*versions));
+    if (versions == NULL) return NULL;
 
-    /* key value cannot be a tombstone */
-    if (_is_tombstone(*value, *value_size))
-        return tidesdb_err_new(1066, "Key's value cannot be a tombstone");
+    for (int i = 0; i < tdb->num_column_families; i++)
+    {
+        column_family_t* cf = &tdb->column_families[i];
+        if (cf->manual_compaction) continue;
 
-    /* we get column family */
-    column_family_t* cf = NULL;
-    if (_get_column_family(tdb, column_family_name, &cf) == -1)
-        return tidesdb_err_new(1028, "Column family not found");
+        versions[i] = _pin_version(cf);
+        if (_compaction_candidates(cf, versions[i], &candidates, &num_candidates, &cap) == -1)
+            break;
+    }
 
-    /* we get compaction_or_flush_lock and read lock it */
-    if (pthread_rwlock_rdlock(&cf->compaction_or_flush_lock) != 0)
-        return tidesdb_err_new(1068, "Failed to lock compaction or flush lock");
+    if (num_candidates > 1)
+        qsort(candidates, num_candidates, sizeof(compaction_candidate_t),
+              _compare_compaction_candidates);
 
-    /* we check if the key exists in the memtable */
-    if (skiplist_get(cf->memtable, key, key_size, value, value_size) != -1)
+    /* we take the most urgent candidate that can run next to the running jobs */
+    compaction_job_t* job = NULL;
+    for (int c = 0; c < num_candidates && job == NULL; c++)
     {
-        /* we found the key in the memtable
-         * we check if the value is a tombstone */
-        if (_is_tombstone(*value, *value_size))
+        job = _new_compaction_job(candidates[c].cf, candidates[c].version, candidates[c].level,
+                                  candidates[c].first, candidates[c].count);
+        if (job == NULL) continue;
+
+        for (int i = 0; i < tdb->config.compaction_threads; i++)
         {
-            /* unlock the compaction_or_flush_lock */
-            pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
-            return tidesdb_err_new(1031, "Key not found");
+            if (tdb->compaction_jobs[i] != NULL &&
+                _compaction_jobs_conflict(job, tdb->compaction_jobs[i]))
+            {
+                _free_compaction_job(job);
+                job = NULL;
+                break;
+            }
         }
+    }
 
-        /* unlock the compaction_or_flush_lock */
-        pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+    for (int i = 0; i < tdb->num_column_families; i++) _release_version(versions[i]);
 
-        return NULL;
-    }
+    free(versions);
+    free(candidates);
 
-    /* we check if the key exists in the sstables */
+    return job;
+}
 
-    for (int i = cf->num_sstables - 1; i >= 0; i--) /* we are iterating from the newest sstable */
+int _compaction_candidates(column_family_t* cf, tidesdb_version_t* version,
+                           compaction_candidate_t** candidates, int* num_candidates, int* cap)
+{
+    double l0_trigger = cf->config.l0_compaction_trigger ? cf->config.l0_compaction_trigger
+                                                         : TIDESDB_DEFAULT_L0_COMPACTION_TRIGGER;
+    double tombstone_trigger = (cf->config.tombstone_ratio_trigger
+                                    ? cf->config.tombstone_ratio_trigger
+                                    : TIDESDB_DEFAULT_TOMBSTONE_RATIO_TRIGGER) /
+                               100.0;
+    double expired_trigger = (cf->config.expired_ratio_trigger
+                                  ? cf->config.expired_ratio_trigger
+                                  : TIDESDB_DEFAULT_EXPIRED_RATIO_TRIGGER) /
+                             100.0;
+    int64_t now = time(NULL);
+
+    /* at most one candidate per sstable plus the level 0 candidate */
+    if (*num_candidates + version->num_sstables + 1 > *cap)
     {
-        if (cf->sstables[i] == NULL) continue;
+        int new_cap = *num_candidates + version->num_sstables + 1;
+        compaction_candidate_t* new_candidates =
+            realloc(*candidates, new_cap * sizeof(compaction_candidate_t));
+        if (new_candidates == NULL) return -1;
+
+        *candidates = new_candidates;
+        *cap = new_cap;
+    }
 
-        /* we read initial pages for bloom filter for the current sstable */
-        uint8_t* bloom_filter_buffer = NULL;
-        size_t bloom_filter_read = 0;
+    /* every read probes every level 0 sstable, merging them into level 1 leaves a single probe
+     * there.  the score grows with the number of sstables a read has to probe */
+    if (version->level_counts[0] >= l0_trigger)
+    {
+        compaction_candidate_t* c = &(*candidates)[(*num_candidates)++];
+        c->cf = cf;
+        c->version = version;
+        c->level = 0;
+        c->first = _level_start(version, 0);
+        c->count = version->level_counts[0];
+        c->score = version->level_counts[0] / l0_trigger;
+        c->cost = 0;
+    }
 
-        if (pager_read(cf->sstables[i]->pager, 0, &bloom_filter_buffer, &bloom_filter_read) == -1)
+    for (int level = 1; level < TIDESDB_NUM_LEVELS; level++)
+    {
+        /* a level over its target holds more sstables than the tree was shaped for, the score is
+         * how far it is over */
+        double size_score = 0;
+        if (level < TIDESDB_NUM_LEVELS - 1)
+            size_score =
+                (double)_level_size(version, level) / (double)_level_target_size(cf, level);
+
+        int start = _level_start(version, level);
+        for (int i = start; i < start + version->level_counts[level]; i++)
         {
-            /* unlock the compaction_or_flush_lock */
-            pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
-            return tidesdb_err_new(1055, "Failed to read bloom filter");
-        }
+            sstable_t* sst = version->sstables[i];
+
+            /* reads of deleted or expired keys walk through the dead entries and the versions
+             * they hide, the score is how far an sstable is over its dead entry ratios */
+            double dead_score = 0;
+            if (sst->num_entries > 0)
+            {
+                double tombstones = (double)sst->num_tombstones / (double)sst->num_entries;
+                double expired =
+                    (double)sstable_expired_entries(sst, now) / (double)sst->num_entries;
 
-        bloomfilter_t* bf = NULL;
+                dead_score = tombstones / tombstone_trigger;
+                if (expired / expired_trigger > dead_score) dead_score = expired / expired_trigger;
+            }
 
-        /* we deserialize the bloom filter */
-        if (deserialize_bloomfilter(bloom_filter_buffer, bloom_filter_read, &bf,
-                                    cf->config.compressed) == -1)
-        {
-            free(bloom_filter_buffer);
-            /* unlock the compaction_or_flush_lock */
-            pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
-            return tidesdb_err_new(1034, "Failed to deserialize bloom filter");
-        }
+            double score = size_score > dead_score ? size_score : dead_score;
+            if (score < 1) continue;
 
-        if (bf == NULL)
-        {
-            bloomfilter_destroy(bf);
-            free(bloom_filter_buffer);
-            continue;
+            uint64_t size = sstable_size(sst);
+
+            compaction_candidate_t* c = &(*candidates)[(*num_candidates)++];
+            c->cf = cf;
+            c->version = version;
+            c->level = level;
+            c->first = i;
+            c->count = 1;
+            c->score = score;
+            c->cost = (double)_next_level_overlap(version, level, i) / (double)(size ? size : 1);
         }
+    }
+
+    return 0;
+}
+
+int _compare_compaction_candidates(const void* a, const void* b)
+{
+    const compaction_candidate_t* c1 = a;
+    const compaction_candidate_t* c2 = b;
+
+    if (c1->score != c2->score) return c1->score > c2->score ? -1 : 1;
+    if (c1->cost != c2->cost) return c1->cost < c2->cost ? -1 : 1;
+
+    return 0;
+}
+
+uint64_t _next_level_overlap(const tidesdb_version_t* version, int level, int index)
+{
+    if (level >= TIDESDB_NUM_LEVELS - 1) return 0;
+
+    sstable_t* sst = version->sstables[index];
+    int start = _level_start(version, level + 1);
+
+    uint64_t overlap = 0;
+    for (int i = start; i < start + version->level_counts[level + 1]; i++)
+        if (sstable_overlaps(version->sstables[i], sst->min_key, sst->min_key_size, sst->max_key,
+                             sst->max_key_size))
+            overlap += sstable_size(version->sstables[i]);
+
+    return overlap;
+}
+
+bool _compaction_jobs_conflict(const compaction_job_t* a, const compaction_job_t* b)
+{
+    if (a->cf != b->cf) return false;
+
+    /* level 0 sstables overlap each other, a second level 0 job could install older pairs over
+     * the outputs of the first */
+    if (a->input_level == 0 && b->input_level == 0) return true;
+
+    for (int i = 0; i < a->num_inputs; i++)
+        for (int j = 0; j < b->num_inputs; j++)
+            if (a->inputs[i] == b->inputs[j]) return true;
+
+    if (a->output_level != b->output_level) return false;
+
+    /* the outputs of both jobs must not overlap within their level */
+    const uint8_t* a_min;
+    const uint8_t* a_max;
+    const uint8_t* b_min;
+    const uint8_t* b_max;
+    size_t a_min_size, a_max_size, b_min_size, b_max_size;
+
+    _compaction_job_range(a, &a_min, &a_min_size, &a_max, &a_max_size);
+    _compaction_job_range(b, &b_min, &b_min_size, &b_max, &b_max_size);
+
+    if (a_max != NULL && b_min != NULL &&
+        sstable_compare_keys(a_max, a_max_size, b_min, b_min_size) < 0)
+        return false;
+
+    if (b_max != NULL && a_min != NULL &&
+        sstable_compare_keys(b_max, b_max_size, a_min, a_min_size) < 0)
+        return false;
 
-        bool key_exists = (bloomfilter_check(bf, key, key_size) == 0);
+    return true;
+}
+
+void _compaction_job_range(const compaction_job_t* job, const uint8_t** min_key,
+                           size_t* min_key_size, const uint8_t** max_key, size_t* max_key_size)
+{
+    *min_key = NULL;
+    *min_key_size = 0;
+    *max_key = NULL;
+    *max_key_size = 0;
 
-        bloomfilter_destroy(bf);
-        free(bloom_filter_buffer);
+    for (int i = 0; i < job->num_inputs; i++)
+    {
+        sstable_t* sst = job->inputs[i];
 
-        if (!key_exists)
+        /* an sstable without a known range covers everything */
+        if (sst->min_key == NULL || sst->max_key == NULL)
         {
-            if (i == 0) break; /* we have reached the end of the sstables */
-            continue;          /* go to the next sstable */
+            *min_key = *max_key = NULL;
+            return;
         }
 
-        pager_cursor_t* cursor = NULL;
-        if (pager_cursor_init(cf->sstables[i]->pager, &cursor) == -1)
+        if (*min_key == NULL ||
+            sstable_compare_keys(sst->min_key, sst->min_key_size, *min_key, *min_key_size) < 0)
         {
-            /* unlock the compaction_or_flush_lock */
-            pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
-            return tidesdb_err_new(1035, "Failed to initialize sstable cursor");
+            *min_key = sst->min_key;
+            *min_key_size = sst->min_key_size;
         }
 
-        /* we skip the bloom filter page(s) */
-        if (pager_cursor_next(cursor) == -1)
+        if (*max_key == NULL ||
+            sstable_compare_keys(sst->max_key, sst->max_key_size, *max_key, *max_key_size) > 0)
         {
-            pager_cursor_free(cursor);
-            if (i == 0) break; /* we have reached the end of the sstables */
-            continue;          /* go to the next sstable */
+            *max_key = sst->max_key;
+            *max_key_size = sst->max_key_size;
         }
+    }
+}
 
-        bool has_next = true; /* we have a next page */
-        while (has_next)
-        {
-            uint8_t* buffer = NULL;
-            size_t buffer_len = 0;
+int _merge_sstables(compaction_job_t* job)
+{
+    column_family_t* cf = job->cf;
 
-            if (pager_read(cf->sstables[i]->pager, cursor->page_number, &buffer, &buffer_len) == -1)
-            {
-                if (buffer != NULL) free(buffer);
-                pager_cursor_free(cursor);
-                /* unlock the compaction_or_flush_lock */
-                pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
-                return tidesdb_err_new(1036, "Failed to read sstable");
-            }
+    /* we stream the inputs through a merge iterator, it holds a single block per input and
+     * returns the newest version of every key, so memory stays constant however large the
+     * sstables are */
+    sstable_merge_iterator_t* it = NULL;
+    if (sstable_merge_iterator_init(job->inputs, (uint32_t)job->num_inputs, &it) == -1)
+    {
+        return -1;
+    }
 
-            key_value_pair_t* kv = NULL;
+    /* the outputs take the place of the newest input so they keep its sequence */
+    uint64_t sequence = 0;
+    for (int i = 0; i < job->num_inputs; i++)
+        if (job->inputs[i]->sequence > sequence) sequence = job->inputs[i]->sequence;
 
-            if (deserialize_key_value_pair(buffer, buffer_len, &kv, cf->config.compressed) == -1)
-            {
-                if (buffer != NULL) free(buffer);
-                pager_cursor_free(cursor);
-                /* unlock the compaction_or_flush_lock */
-                pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
-                return tidesdb_err_new(1037, "Failed to deserialize key value pair");
-            }
+    uint64_t target_file_size = cf->config.target_file_size ? cf->config.target_file_size
+                                                            : TIDESDB_DEFAULT_TARGET_FILE_SIZE;
 
-            if (kv == NULL)
+    sstable_writer_t* writer = NULL;
+    key_value_pair_t kv;
+    time_t now = time(NULL);
+
+    while (sstable_merge_iterator_get(it, &kv) == 0)
+    {
+        /* the newest version decides, a tombstone or an expired pair hides every older version.
+         * it can only be dropped when no deeper level holds a version it still has to hide */
+        bool dead = _is_tombstone(kv.value, kv.value_size) || (kv.ttl != -1 && kv.ttl <= now);
+
+        if (!dead || !job->drop_tombstones)
+        {
+            if (writer == NULL)
             {
-                if (buffer != NULL) free(buffer);
-                pager_cursor_free(cursor);
-                /* unlock the compaction_or_flush_lock */
-                pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
-                _free_key_value_pair(kv);
-                return tidesdb_err_new(1038, "Key value pair is NULL");
+                char new_sstable_name[PATH_MAX];
+                uint64_t file_number = _new_sstable_path(cf, new_sstable_name, PATH_MAX);
+
+                if (sstable_writer_open(new_sstable_name, cf->config.block_size,
+                                        cf->config.compressed, cf->config.bloom_bits_per_key,
+                                        sequence, file_number, (uint32_t)job->output_level,
+                                        &writer) == -1)
+                    goto fail;
             }
 
-            if (_compare_keys((const uint8_t*)kv->key, kv->key_size, key, key_size) == 0)
-            {
-                if (_is_tombstone(kv->value, kv->value_size))
-                {
-                    free(buffer);
-                    _free_key_value_pair(kv);
-                    pager_cursor_free(cursor);
-                    /* unlock the compaction_or_flush_lock */
-                    pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
-                    return tidesdb_err_new(1031, "Key not found");
-                }
+            if (sstable_writer_add(writer, kv.key, kv.key_size, kv.value, kv.value_size, kv.ttl) ==
+                -1)
+                goto fail;
 
-                /* check if ttl is set and has expired */
-                if (kv->ttl != -1 && kv->ttl < time(NULL))
-                {
-                    free(buffer);
-                    _free_key_value_pair(kv);
-                    pager_cursor_free(cursor);
-                    /* unlock the compaction_or_flush_lock */
-                    pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
-                    return tidesdb_err_new(1031, "Key not found");
-                }
+            /* the sstable layer does not know our tombstones, we count them for the background
+             * compaction triggers */
+            if (_is_tombstone(kv.value, kv.value_size)) writer->num_tombstones++;
 
-                /* copy the value */
-                *value = malloc(kv->value_size);
-                if (*value == NULL)
-                {
-                    free(buffer);
-                    _free_key_value_pair(kv);
-                    pager_cursor_free(cursor);
-                    /* unlock the compaction_or_flush_lock */
-                    pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
-                    return tidesdb_err_new(1069, "Failed to allocate memory for value copy");
-                }
+            /* we split the output at the target file size, keys are unique so the split never
+             * separates versions of a key */
+            if (sstable_writer_size(writer) >= target_file_size &&
+                _finish_compaction_output(job, &writer) == -1)
+                goto fail;
+        }
+
+        /* an input we cannot read would drop its pairs from the outputs */
+        int rc = sstable_merge_iterator_next(it);
+        if (rc == -2) goto fail;
+        if (rc == -1) break;
+    }
 
-                /* copy the value size */
-                *value_size = kv->value_size;
+    if (writer != NULL && _finish_compaction_output(job, &writer) == -1) goto fail;
 
-                /* copy the value */
-                memcpy(*value, kv->value, kv->value_size);
+    sstable_merge_iterator_free(it);
+    return 0;
 
-                free(buffer);
-                pager_cursor_free(cursor);
-                _free_key_value_pair(kv);
+fail:
+    sstable_merge_iterator_free(it);
+    sstable_writer_abandon(writer);
+    return -1;
+}
 
-                /* unlock the compaction_or_flush_lock */
-                pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+int _finish_compaction_output(compaction_job_t* job, sstable_writer_t** writer)
+{
+    sstable_t** outputs = realloc(job->outputs, (job->num_outputs + 1) * sizeof(sstable_t*));
+    if (outputs == NULL) return -1;
+    job->outputs = outputs;
 
-                return NULL;
-            }
+    sstable_t* sst = NULL;
+    if (sstable_writer_finish(*writer, &sst) == -1) return -1;
 
-            if (pager_cursor_next(cursor) != -1)
-            {
-                has_next = true;
-            }
-            else
-            {
-                has_next = false;
-            }
+    *writer = NULL;
+    job->outputs[job->num_outputs++] = sst;
+    sstable_set_cache(sst, job->cf->table_cache);
+
+    return 0;
+}
+
+tidesdb_err_t* tidesdb_put(tidesdb_t* tdb, const char* column_family_name, const uint8_t* key,
+                           size_t key_size, const uint8_t* value, size_t value_size, time_t ttl)
+{
+    /* we check if the db is NULL */
+    if (tdb == NULL) return tidesdb_err_new(1002, "TidesDB is NULL");
+
+    /* we check if the column family name is NULL */
+    if (column_family_name == NULL) return tidesdb_err_new(1015, "Column family name is NULL");
+
+    /* we check if the key is NULL */
+    if (key == NULL) return tidesdb_err_new(1026, "Key is NULL");
+
+    /* we check if the value is NULL */
+    if (value == NULL) return tidesdb_err_new(1027, "Value is NULL");
+
+    /* we get column family */
+    column_family_t* cf = NULL;
+
+    if (_get_column_family(tdb, column_family_name, &cf) == -1)
+        return tidesdb_err_new(1028, "Column family not found");
+
+    /* writers share the memtable lock, a rotation waits for us to finish */
+    if (pthread_rwlock_rdlock(&cf->memtable_lock) != 0)
+        return tidesdb_err_new(1096, "Failed to acquire memtable lock");
+
+    /* we append to the wal */
+    if (_append_to_wal(tdb, cf->wal, key, key_size, value, value_size, ttl, OP_PUT,
+                       column_family_name) == -1)
+    {
+        pthread_rwlock_unlock(&cf->memtable_lock);
+        return tidesdb_err_new(1049, "Failed to append to wal");
+    }
+
+    /* put in memtable */
+    if (skiplist_put(cf->memtable, key, key_size, value, value_size, ttl) == -1)
+    {
+        pthread_rwlock_unlock(&cf->memtable_lock);
+        return tidesdb_err_new(1050, "Failed to put into memtable");
+    }
+
+    /* we check if the memtable has reached the flush threshold */
+    bool rotate = (int)cf->memtable->total_size >= cf->config.flush_threshold;
+
+    pthread_rwlock_unlock(&cf->memtable_lock);
+
+    /* the full memtable is swapped for an empty one and queued for flushing */
+    if (rotate && _rotate_memtable(tdb, cf) == -1)
+        return tidesdb_err_new(1011, "Failed to rotate memtable");
+
+    return NULL;
+}
+
+tidesdb_err_t* tidesdb_get(tidesdb_t* tdb, const char* column_family_name, const uint8_t* key,
+                           size_t key_size, uint8_t** value, size_t* value_size)
+{
+    /* we check if the db is NULL */
+    if (tdb == NULL) return tidesdb_err_new(1002, "TidesDB is NULL");
+
+    /* we check if the column family name is NULL */
+    if (column_family_name == NULL) return tidesdb_err_new(1015, "Column family name is NULL");
+
+    /* we check if key is NULL */
+    if (key == NULL) return tidesdb_err_new(1026, "Key is NULL");
+
+    /* key value cannot be a tombstone */
+    if (_is_tombstone(*value, *value_size))
+        return tidesdb_err_new(1066, "Key's value cannot be a tombstone");
+
+    /* we get column family */
+    column_family_t* cf = NULL;
+    if (_get_column_family(tdb, column_family_name, &cf) == -1)
+        return tidesdb_err_new(1028, "Column family not found");
+
+    /* we pin the current version, rotations, flushes and compactions publish new ones without
+     * waiting for us and the memtables and sstables we read stay around until we release it */
+    tidesdb_version_t* version = _pin_version(cf);
+
+    /* we check if the key exists in the memtables, from the active one to the oldest rotated
+     * one that is not flushed yet */
+    for (int i = version->num_memtables - 1; i >= 0; i--)
+    {
+        if (skiplist_get(version->memtables[i]->skiplist, key, key_size, value, value_size) == -1)
+            continue; /* go to the next memtable */
+
+        _release_version(version);
 
-            free(buffer);
-            _free_key_value_pair(kv);
+        /* we found the key in a memtable
+         * we check if the value is a tombstone */
+        if (_is_tombstone(*value, *value_size))
+        {
+            free(*value);
+            *value = NULL;
+            *value_size = 0;
+            return tidesdb_err_new(1031, "Key not found");
         }
 
-        pager_cursor_free(cursor);
+        return NULL;
     }
 
-    /* unlock the compaction_or_flush_lock */
-    pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+    /* we check if the key exists in the sstables.
+     * we hash the key once, every sstable filter is checked with the same hash */
+    uint64_t hash = blocked_bloomfilter_hash(key, key_size);
+
+    /* we are iterating from the newest sstable */
+    for (int i = version->num_sstables - 1; i >= 0; i--)
+    {
+        int sst_index = i;
+
+        /* the sstables of a deeper level do not overlap, so only one of them can hold the key.
+         * we binary search the level for it and skip the rest of the level */
+        int level = (int)version->sstables[i]->level;
+        if (level > 0)
+        {
+            sst_index = _find_level_sstable(version, level, key, key_size);
+            i = _level_start(version, level);
+            if (sst_index == -1) continue; /* go to the next level */
+        }
+
+        uint8_t* sst_value = NULL;
+        size_t sst_value_size = 0;
+        int64_t ttl = -1;
+
+        /* we check the bloom filter, binary search the sparse index and read a single block */
+        int rc = sstable_get(version->sstables[sst_index], key, key_size, hash, &sst_value,
+                             &sst_value_size, &ttl);
+        if (rc == -1) continue; /* go to the next sstable */
+
+        /* an sstable we could not read may hold the key, an older one would give a stale value */
+        if (rc == -2)
+        {
+            _release_version(version);
+            return tidesdb_err_new(1107, "Failed to read sstable");
+        }
+
+        _release_version(version);
+
+        /* we check if the value is a tombstone or if ttl is set and has expired */
+        if (_is_tombstone(sst_value, sst_value_size) || (ttl != -1 && ttl < time(NULL)))
+        {
+            free(sst_value);
+            return tidesdb_err_new(1031, "Key not found");
+        }
+
+        *value = sst_value;
+        *value_size = sst_value_size;
+
+        return NULL;
+    }
+
+    _release_version(version);
     return tidesdb_err_new(1031, "Key not found");
 }
 
@@ -926,27 +1506,33 @@ tidesdb_err_t* tidesdb_delete(tidesdb_t* tdb, const char* column_family_name, co
             return tidesdb_err_new(1070, "Failed to allocate memory for tombstone");
     }
 
+    /* writers share the memtable lock, a rotation waits for us to finish */
+    if (pthread_rwlock_rdlock(&cf->memtable_lock) != 0)
+    {
+        free(tombstone);
+        return tidesdb_err_new(1096, "Failed to acquire memtable lock");
+    }
+
     /* append to wal */
     if (_append_to_wal(tdb, cf->wal, key, key_size, tombstone, 4, 0, OP_DELETE,
                        column_family_name) == -1)
+    {
+        pthread_rwlock_unlock(&cf->memtable_lock);
+        free(tombstone);
         return tidesdb_err_new(1049, "Failed to append to wal");
-
-    /* get compaction_or_flush_lock and lock it */
-    if (pthread_rwlock_rdlock(&cf->compaction_or_flush_lock) != 0)
-        return tidesdb_err_new(1068, "Failed to lock compaction or flush lock");
+    }
 
     /* add to memtable */
     if (skiplist_put(cf->memtable, key, key_size, tombstone, 4, -1) == -1)
     {
-        /* unlock the compaction_or_flush_lock */
-        pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+        pthread_rwlock_unlock(&cf->memtable_lock);
+        free(tombstone);
         return tidesdb_err_new(1050, "Failed to put into memtable");
     }
 
-    free(tombstone);
+    pthread_rwlock_unlock(&cf->memtable_lock);
 
-    /* unlock the compaction_or_flush_lock */
-    pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+    free(tombstone);
 
     return NULL;
 }
@@ -1313,14 +1899,23 @@ tidesdb_err_t* tidesdb_txn_commit(tidesdb_txn_t* transaction)
     if (_get_column_family(transaction->tdb, transaction->column_family, &cf) == -1)
         return tidesdb_err_new(1028, "Column family not found");
 
+    /* we share the memtable lock with the other writers, the active memtable is not rotated
+     * until we are done */
+    if (pthread_rwlock_rdlock(&cf->memtable_lock) != 0)
+        return tidesdb_err_new(1055, "Failed to acquire memtable lock for commit");
+
     /* we lock the memtable */
     if (pthread_rwlock_wrlock(&cf->memtable->lock) != 0)
+    {
+        pthread_rwlock_unlock(&cf->memtable_lock);
         return tidesdb_err_new(1055, "Failed to acquire memtable lock for commit");
+    }
 
     /* we lock the transaction */
     if (pthread_mutex_lock(&transaction->lock) != 0)
     {
         pthread_rwlock_unlock(&cf->memtable->lock);
+        pthread_rwlock_unlock(&cf->memtable_lock);
         return tidesdb_err_new(1074, "Failed to acquire transaction lock");
     }
 
@@ -1338,6 +1933,7 @@ tidesdb_err_t* tidesdb_txn_commit(tidesdb_txn_t* transaction)
                 {
                     /* unlock the memtable */
                     pthread_rwlock_unlock(&cf->memtable->lock);
+                    pthread_rwlock_unlock(&cf->memtable_lock);
 
                     /* we rollback the transaction */
                     return tidesdb_txn_rollback(transaction);
@@ -1358,6 +1954,7 @@ tidesdb_err_t* tidesdb_txn_commit(tidesdb_txn_t* transaction)
                 {
                     /* unlock the memtable */
                     pthread_rwlock_unlock(&cf->memtable->lock);
+                    pthread_rwlock_unlock(&cf->memtable_lock);
 
                     /* we rollback the transaction */
                     return tidesdb_txn_rollback(transaction);
@@ -1371,64 +1968,19 @@ tidesdb_err_t* tidesdb_txn_commit(tidesdb_txn_t* transaction)
         }
     }
 
-    if ((int)cf->memtable->total_size >= cf->config.flush_threshold)
-    {
-        /* get flush mutex */
-        pthread_mutex_lock(&transaction->tdb->flush_lock);
-
-        queue_entry_t* entry = malloc(sizeof(queue_entry_t));
-        if (entry == NULL)
-        {
-            /* unlock the flush mutex */
-            pthread_mutex_unlock(&transaction->tdb->flush_lock);
-            /* unlock the memtable */
-            pthread_rwlock_unlock(&cf->memtable->lock);
-            /* unlock the transaction */
-            pthread_mutex_unlock(&transaction->lock);
-            return tidesdb_err_new(1045, "Failed to allocate memory for queue entry");
-        }
-
-        /* we make a copy of the memtable */
-        entry->memtable = skiplist_copy(cf->memtable);
-        if (entry->memtable == NULL)
-        {
-            /* unlock the flush mutex */
-            pthread_mutex_unlock(&transaction->tdb->flush_lock);
-            free(entry);
-            /* unlock the memtable */
-            pthread_rwlock_unlock(&cf->memtable->lock);
-            /* unlock the transaction */
-            pthread_mutex_unlock(&transaction->lock);
-            return tidesdb_err_new(1011, "Failed to copy memtable");
-        }
-
-        entry->cf = cf;
-
-        if (pager_size(cf->wal->pager, &entry->wal_checkpoint) == -1)
-        {
-            pthread_mutex_unlock(&transaction->tdb->flush_lock);
-            free(entry);
-            /* unlock the memtable */
-            pthread_rwlock_unlock(&cf->memtable->lock);
-            /* unlock the transaction */
-            pthread_mutex_unlock(&transaction->lock);
-            return tidesdb_err_new(1012, "Failed to get wal checkpoint");
-        }
-
-        queue_enqueue(transaction->tdb->flush_queue, entry);
-        pthread_cond_signal(&transaction->tdb->flush_cond);
-
-        /* now we clear the memtable */
-        skiplist_clear(cf->memtable);
-
-        pthread_mutex_unlock(&transaction->tdb->flush_lock);
-    }
+    /* we check if the memtable has reached the flush threshold */
+    bool rotate = (int)cf->memtable->total_size >= cf->config.flush_threshold;
 
     /* unlock the transaction */
     pthread_mutex_unlock(&transaction->lock);
 
     /* unlock the memtable */
     pthread_rwlock_unlock(&cf->memtable->lock);
+    pthread_rwlock_unlock(&cf->memtable_lock);
+
+    /* the full memtable is swapped for an empty one and queued for flushing */
+    if (rotate && _rotate_memtable(transaction->tdb, cf) == -1)
+        return tidesdb_err_new(1011, "Failed to rotate memtable");
 
     return NULL;
 }
@@ -1459,6 +2011,9 @@ tidesdb_err_t* tidesdb_txn_rollback(tidesdb_txn_t* transaction)
                 return tidesdb_err_new(1028, "Column family not found");
             }
 
+            /* the active memtable is not rotated whilst we undo the operation */
+            pthread_rwlock_rdlock(&cf->memtable_lock);
+
             switch (op.op_code)
             {
                 case OP_PUT:
@@ -1473,6 +2028,8 @@ tidesdb_err_t* tidesdb_txn_rollback(tidesdb_txn_t* transaction)
                 default:
                     break;
             }
+
+            pthread_rwlock_unlock(&cf->memtable_lock);
         }
     }
 
@@ -1551,6 +2108,230 @@ tidesdb_err_t* tidesdb_txn_free(tidesdb_txn_t* transaction)
     return NULL;
 }
 
+tidesdb_err_t* tidesdb_batch_new(tidesdb_batch_t** batch)
+{
+    /* we check if the batch pointer is NULL */
+    if (batch == NULL) return tidesdb_err_new(1099, "Batch pointer is NULL");
+
+    *batch = malloc(sizeof(tidesdb_batch_t));
+    if (*batch == NULL) return tidesdb_err_new(1100, "Failed to allocate memory for batch");
+
+    (*batch)->buffer = malloc(TIDESDB_BATCH_INITIAL_SIZE);
+    if ((*batch)->buffer == NULL)
+    {
+        free(*batch);
+        *batch = NULL;
+        return tidesdb_err_new(1100, "Failed to allocate memory for batch");
+    }
+
+    /* the header is written when the batch is, room is kept for it at the start */
+    (*batch)->capacity = TIDESDB_BATCH_INITIAL_SIZE;
+    (*batch)->size = SERIALIZE_BATCH_HEADER_SIZE;
+    (*batch)->count = 0;
+
+    return NULL;
+}
+
+tidesdb_err_t* tidesdb_batch_put(tidesdb_batch_t* batch, const uint8_t* key, size_t key_size,
+                                 const uint8_t* value, size_t value_size, time_t ttl)
+{
+    /* we check if the batch is NULL */
+    if (batch == NULL) return tidesdb_err_new(1101, "Batch is NULL");
+
+    /* we check if the key is NULL */
+    if (key == NULL) return tidesdb_err_new(1026, "Key is NULL");
+
+    /* we check if the value is NULL */
+    if (value == NULL) return tidesdb_err_new(1027, "Value is NULL");
+
+    key_value_pair_t kv = {(uint8_t*)key, key_size, (uint8_t*)value, value_size, ttl};
+
+    if (_batch_add(batch, OP_PUT, &kv) == -1)
+        return tidesdb_err_new(1100, "Failed to allocate memory for batch");
+
+    return NULL;
+}
+
+tidesdb_err_t* tidesdb_batch_delete(tidesdb_batch_t* batch, const uint8_t* key, size_t key_size)
+{
+    /* we check if the batch is NULL */
+    if (batch == NULL) return tidesdb_err_new(1101, "Batch is NULL");
+
+    /* we check if the key is NULL */
+    if (key == NULL) return tidesdb_err_new(1026, "Key is NULL");
+
+    /* a delete is encoded with the tombstone it puts into the memtable */
+    uint32_t tombstone = TOMBSTONE;
+    key_value_pair_t kv = {(uint8_t*)key, key_size, (uint8_t*)&tombstone, sizeof(tombstone), -1};
+
+    if (_batch_add(batch, OP_DELETE, &kv) == -1)
+        return tidesdb_err_new(1100, "Failed to allocate memory for batch");
+
+    return NULL;
+}
+
+tidesdb_err_t* tidesdb_batch_write(tidesdb_t* tdb, const char* column_family_name,
+                                   tidesdb_batch_t* batch)
+{
+    /* we check if the db is NULL */
+    if (tdb == NULL) return tidesdb_err_new(1002, "TidesDB is NULL");
+
+    /* we check if the column family name is NULL */
+    if (column_family_name == NULL) return tidesdb_err_new(1015, "Column family name is NULL");
+
+    /* we check if the batch is NULL */
+    if (batch == NULL) return tidesdb_err_new(1101, "Batch is NULL");
+
+    /* we get column family */
+    column_family_t* cf = NULL;
+    if (_get_column_family(tdb, column_family_name, &cf) == -1)
+        return tidesdb_err_new(1028, "Column family not found");
+
+    if (batch->count == 0) return NULL; /* nothing to write */
+
+    /* writers share the memtable lock, a rotation waits for us to finish */
+    if (pthread_rwlock_rdlock(&cf->memtable_lock) != 0)
+        return tidesdb_err_new(1096, "Failed to acquire memtable lock");
+
+    /* the whole batch is one wal entry, a crash keeps all of it or none of it */
+    if (_append_batch_to_wal(tdb, cf->wal, batch, column_family_name) == -1)
+    {
+        pthread_rwlock_unlock(&cf->memtable_lock);
+        return tidesdb_err_new(1049, "Failed to append to wal");
+    }
+
+    if (_apply_batch(cf->memtable, batch->buffer + SERIALIZE_BATCH_HEADER_SIZE,
+                     batch->size - SERIALIZE_BATCH_HEADER_SIZE, batch->count) == -1)
+    {
+        pthread_rwlock_unlock(&cf->memtable_lock);
+        return tidesdb_err_new(1050, "Failed to put into memtable");
+    }
+
+    /* we check if the memtable has reached the flush threshold */
+    bool rotate = (int)cf->memtable->total_size >= cf->config.flush_threshold;
+
+    pthread_rwlock_unlock(&cf->memtable_lock);
+
+    /* the full memtable is swapped for an empty one and queued for flushing */
+    if (rotate && _rotate_memtable(tdb, cf) == -1)
+        return tidesdb_err_new(1011, "Failed to rotate memtable");
+
+    return NULL;
+}
+
+tidesdb_err_t* tidesdb_batch_clear(tidesdb_batch_t* batch)
+{
+    if (batch == NULL) return tidesdb_err_new(1101, "Batch is NULL");
+
+    batch->size = SERIALIZE_BATCH_HEADER_SIZE;
+    batch->count = 0;
+
+    return NULL;
+}
+
+tidesdb_err_t* tidesdb_batch_free(tidesdb_batch_t* batch)
+{
+    if (batch == NULL) return tidesdb_err_new(1101, "Batch is NULL");
+
+    free(batch->buffer);
+    free(batch);
+
+    return NULL;
+}
+
+int _batch_add(tidesdb_batch_t* batch, OP_CODE op_code, const key_value_pair_t* kv)
+{
+    size_t size = serialize_batch_operation_size(kv);
+
+    /* we double the buffer until the operation fits */
+    if (batch->size + size > batch->capacity)
+    {
+        size_t capacity = batch->capacity;
+        while (batch->size + size > capacity) capacity *= 2;
+
+        uint8_t* buffer = realloc(batch->buffer, capacity);
+        if (buffer == NULL) return -1;
+
+        batch->buffer = buffer;
+        batch->capacity = capacity;
+    }
+
+    if (serialize_batch_operation(op_code, kv, batch->buffer + batch->size) == -1) return -1;
+
+    batch->size += size;
+    batch->count++;
+
+    return 0;
+}
+
+int _apply_batch(skiplist_t* memtable, const uint8_t* operations, size_t operations_size,
+                 uint32_t count)
+{
+    /* readers of a locked memtable see the batch whole or not at all, those of a concurrent one
+     * take no lock and can see it part way */
+    if (pthread_rwlock_wrlock(&memtable->lock) != 0) return -1;
+
+    int result = 0;
+    size_t offset = 0;
+    for (uint32_t i = 0; i < count && result == 0; i++)
+    {
+        OP_CODE op_code;
+        key_value_pair_t kv;
+        size_t encoded_size = 0;
+
+        /* a delete carries its tombstone, both are put the same way */
+        result = deserialize_batch_operation(operations + offset, operations_size - offset,
+                                             &op_code, &kv, &encoded_size);
+        if (result == 0)
+            result = skiplist_put_no_lock(memtable, kv.key, kv.key_size, kv.value, kv.value_size,
+                                          kv.ttl);
+
+        offset += encoded_size;
+    }
+
+    pthread_rwlock_unlock(&memtable->lock);
+
+    return result;
+}
+
+tidesdb_err_t* tidesdb_get_recovery_stats(tidesdb_t* tdb, tidesdb_recovery_stats_t* stats)
+{
+    /* we check if the db is NULL */
+    if (tdb == NULL) return tidesdb_err_new(1002, "TidesDB is NULL");
+
+    /* we check if the stats pointer is NULL */
+    if (stats == NULL) return tidesdb_err_new(1102, "Recovery stats pointer is NULL");
+
+    *stats = tdb->recovery_stats;
+
+    return NULL;
+}
+
+tidesdb_err_t* tidesdb_get_block_cache_stats(tidesdb_t* tdb, tidesdb_block_cache_stats_t* stats)
+{
+    /* we check if the db is NULL */
+    if (tdb == NULL) return tidesdb_err_new(1002, "TidesDB is NULL");
+
+    /* we check if the stats pointer is NULL */
+    if (stats == NULL) return tidesdb_err_new(1106, "Block cache stats pointer is NULL");
+
+    memset(stats, 0, sizeof(*stats));
+
+    /* without a block cache every lookup reads its block, there is nothing to count */
+    block_cache_t* cache = tdb->table_cache->block_cache;
+    if (cache == NULL) return NULL;
+
+    size_t entries = 0;
+    stats->capacity = cache->capacity;
+    stats->usage = block_cache_usage(cache, &entries);
+    stats->entries = entries;
+    stats->hits = atomic_load(&cache->hits);
+    stats->misses = atomic_load(&cache->misses);
+    stats->evictions = atomic_load(&cache->evictions);
+
+    return NULL;
+}
+
 tidesdb_err_t* tidesdb_cursor_init(tidesdb_t* tdb, const char* column_family_name,
                                    tidesdb_cursor_t** cursor)
 {
@@ -1575,56 +2356,57 @@ tidesdb_err_t* tidesdb_cursor_init(tidesdb_t* tdb, const char* column_family_nam
     (*cursor)->sstable_cursor = NULL;
     (*cursor)->memtable_cursor = NULL;
 
-    /* lock sstables to get latest sstable index*/
-
-    if (pthread_rwlock_rdlock(&cf->sstables_lock) != 0)
-    {
-        free(*cursor);
-        return tidesdb_err_new(1024, "Failed to acquire sstables lock");
-    }
-
-    (*cursor)->sstable_index = cf->num_sstables - 1; /* we start at the last sstable */
+    /* the cursor pins the current version, it reads the same memtables and sstables until it is
+     * freed */
+    (*cursor)->version = _pin_version(cf);
 
-    /* we lock create a memtable cursor */
-    (*cursor)->memtable_cursor = skiplist_cursor_init(cf->memtable);
-    if ((*cursor)->memtable_cursor == NULL)
-    {
-        /* unlock sstables */
-        pthread_rwlock_unlock(&cf->sstables_lock);
-
-        free(*cursor);
-        return tidesdb_err_new(1058, "Failed to initialize memtable cursor");
-    }
-
-    /* we get current sstable cursor */
-    (*cursor)->sstable_cursor = NULL;
+    /* we start at the last sstable */
+    (*cursor)->sstable_index = (*cursor)->version->num_sstables - 1;
 
-    if (cf->num_sstables > 0)
+    if ((*cursor)->version->num_sstables > 0)
     {
-        /* we initialize the sstable cursor */
-        if (pager_cursor_init(cf->sstables[(*cursor)->sstable_index]->pager,
-                              &(*cursor)->sstable_cursor) == -1)
+        /* we initialize the sstable cursor, it starts at the first key-value pair */
+        if (sstable_iterator_init((*cursor)->version->sstables[(*cursor)->sstable_index],
+                                  &(*cursor)->sstable_cursor) != 0)
         {
-            /* unlock sstables */
-            pthread_rwlock_unlock(&cf->sstables_lock);
-            skiplist_cursor_free((*cursor)->memtable_cursor);
+            _release_version((*cursor)->version);
             free(*cursor);
             return tidesdb_err_new(1035, "Failed to initialize sstable cursor");
         }
+    }
+
+    /* we start in the active memtable, or the newest memtable that has pairs.  without any the
+     * cursor starts in the sstables */
+    (*cursor)->memtable_index = (*cursor)->version->num_memtables;
+    _cursor_seek_memtable(*cursor, (*cursor)->version->num_memtables - 1, -1);
 
-        /* we skip initial pages as they contain bloom filter */
-        if (pager_cursor_next((*cursor)->sstable_cursor) == -1)
+    return NULL;
+}
+
+int _cursor_seek_memtable(tidesdb_cursor_t* cursor, int index, int step)
+{
+    for (int i = index; i >= 0 && i < cursor->version->num_memtables; i += step)
+    {
+        skiplist_cursor_t* memtable_cursor =
+            skiplist_cursor_init(cursor->version->memtables[i]->skiplist);
+        if (memtable_cursor == NULL) return -1;
+
+        /* empty memtables are skipped */
+        if (memtable_cursor->current == NULL)
         {
-            pager_cursor_free((*cursor)->sstable_cursor);
-            (*cursor)->sstable_cursor = NULL;
-            return tidesdb_err_new(1084, "Failed to skip initial pages");
+            skiplist_cursor_free(memtable_cursor);
+            continue;
         }
-    }
 
-    /* unlock sstables */
-    pthread_rwlock_unlock(&cf->sstables_lock);
+        if (cursor->memtable_cursor != NULL) skiplist_cursor_free(cursor->memtable_cursor);
 
-    return NULL;
+        cursor->memtable_cursor = memtable_cursor;
+        cursor->memtable_index = i;
+
+        return 0;
+    }
+
+    return -1;
 }
 
 tidesdb_err_t* tidesdb_cursor_next(tidesdb_cursor_t* cursor)
@@ -1632,58 +2414,48 @@ tidesdb_err_t* tidesdb_cursor_next(tidesdb_cursor_t* cursor)
     /* check if cursor is NULL */
     if (cursor == NULL) return tidesdb_err_new(1061, "Cursor is NULL");
 
-    /* we move to the next key in the memtable */
-    if (skiplist_cursor_next(cursor->memtable_cursor) == 0)
+    if (cursor->memtable_cursor != NULL)
     {
-        return NULL;
-    }
+        /* we move to the next key in the memtable */
+        if (skiplist_cursor_next(cursor->memtable_cursor) == 0) return NULL;
 
-    /* if we are at the end of the memtable, we move to the sstable */
+        /* if we are at the end of the memtable, we move to the next older memtable */
+        if (_cursor_seek_memtable(cursor, cursor->memtable_index - 1, -1) == 0) return NULL;
 
-    /* we move to the next key in the sstable */
-    if (pager_cursor_next(cursor->sstable_cursor) == 0)
-    {
-        return NULL;
-    }
+        /* past the oldest memtable we move to the first key of the newest sstable */
+        if (cursor->sstable_cursor == NULL) return tidesdb_err_new(1062, "At end of cursor");
 
-    /* if there is no next key in the sstable, we move to the next sstable */
+        skiplist_cursor_free(cursor->memtable_cursor);
+        cursor->memtable_cursor = NULL;
 
-    /* get sstables lock */
-    if (pthread_rwlock_rdlock(&cursor->cf->sstables_lock) != 0)
-        return tidesdb_err_new(1024, "Failed to acquire sstables lock");
+        return NULL;
+    }
 
-    if (cursor->cf->num_sstables > 0)
+    /* we move to the next key in the sstable, a block we cannot read does not end it */
+    if (cursor->sstable_cursor != NULL)
     {
-        if (cursor->sstable_index > 0)
-        {
-            cursor->sstable_index--;
+        int rc = sstable_iterator_next(cursor->sstable_cursor);
+        if (rc == 0) return NULL;
+        if (rc == -2) return tidesdb_err_new(1107, "Failed to read sstable");
+    }
 
-            /* we free the current sstable cursor */
-            pager_cursor_free(cursor->sstable_cursor);
+    /* if there is no next key in the sstable, we move to the next sstable of the pinned version */
+    if (cursor->version->num_sstables > 0 && cursor->sstable_index > 0)
+    {
+        cursor->sstable_index--;
 
-            /* we initialize the sstable cursor */
-            if (pager_cursor_init(cursor->cf->sstables[cursor->sstable_index]->pager,
-                                  &cursor->sstable_cursor) == -1)
-            {
-                pthread_rwlock_unlock(&cursor->cf->sstables_lock);
-                return tidesdb_err_new(1035, "Failed to initialize sstable cursor");
-            }
+        /* we free the current sstable cursor */
+        sstable_iterator_free(cursor->sstable_cursor);
+        cursor->sstable_cursor = NULL;
 
-            /* we skip initial pages as they contain bloom filter */
-            if (pager_cursor_next(cursor->sstable_cursor) == -1)
-            {
-                pager_cursor_free(cursor->sstable_cursor);
-                cursor->sstable_cursor = NULL;
-                pthread_rwlock_unlock(&cursor->cf->sstables_lock);
-                return tidesdb_err_new(1084, "Failed to skip initial pages");
-            }
+        /* we initialize the sstable cursor */
+        if (sstable_iterator_init(cursor->version->sstables[cursor->sstable_index],
+                                  &cursor->sstable_cursor) != 0)
+            return tidesdb_err_new(1035, "Failed to initialize sstable cursor");
 
-            pthread_rwlock_unlock(&cursor->cf->sstables_lock);
-            return NULL;
-        }
+        return NULL;
     }
 
-    pthread_rwlock_unlock(&cursor->cf->sstables_lock);
     return tidesdb_err_new(1062, "At end of cursor");
 }
 
@@ -1692,58 +2464,46 @@ tidesdb_err_t* tidesdb_cursor_prev(tidesdb_cursor_t* cursor)
     /* check if cursor is NULL */
     if (cursor == NULL) return tidesdb_err_new(1061, "Cursor is NULL");
 
-    /* we move to the previous key in the memtable */
-    if (skiplist_cursor_prev(cursor->memtable_cursor) == 0)
+    if (cursor->memtable_cursor != NULL)
     {
-        return NULL;
-    }
+        /* we move to the previous key in the memtable */
+        if (skiplist_cursor_prev(cursor->memtable_cursor) == 0) return NULL;
 
-    /* if we are at the beginning of the memtable, we move to the sstable */
+        /* if we are at the beginning of the memtable, we move to the next newer memtable */
+        if (_cursor_seek_memtable(cursor, cursor->memtable_index + 1, 1) == 0) return NULL;
 
-    /* we move to the previous key in the sstable */
-    if (pager_cursor_prev(cursor->sstable_cursor) == 0)
-    {
-        return NULL;
+        return tidesdb_err_new(1085, "At beginning of cursor");
     }
 
-    /* we lock the sstables */
-    if (pthread_rwlock_rdlock(&cursor->cf->sstables_lock) != 0)
-        return tidesdb_err_new(1024, "Failed to acquire sstables lock");
-
-    if (cursor->cf->num_sstables > 0)
+    /* we move to the previous key in the sstable, a block we cannot read does not end it */
+    if (cursor->sstable_cursor != NULL)
     {
-        /* if there is no previous key in the sstable, we move to the previous sstable */
-        if (cursor->sstable_index < cursor->cf->num_sstables - 1)
-        {
-            cursor->sstable_index++;
+        int rc = sstable_iterator_prev(cursor->sstable_cursor);
+        if (rc == 0) return NULL;
+        if (rc == -2) return tidesdb_err_new(1107, "Failed to read sstable");
+    }
 
-            /* we free the current sstable cursor */
-            pager_cursor_free(cursor->sstable_cursor);
+    /* if there is no previous key in the sstable, we move to the previous sstable of the pinned
+     * version */
+    if (cursor->version->num_sstables > 0 &&
+        cursor->sstable_index < (size_t)cursor->version->num_sstables - 1)
+    {
+        cursor->sstable_index++;
 
-            /* we initialize the sstable cursor */
-            if (pager_cursor_init(cursor->cf->sstables[cursor->sstable_index]->pager,
-                                  &cursor->sstable_cursor) == -1)
-            {
-                pthread_rwlock_unlock(&cursor->cf->sstables_lock);
-                return tidesdb_err_new(1035, "Failed to initialize sstable cursor");
-            }
+        /* we free the current sstable cursor */
+        sstable_iterator_free(cursor->sstable_cursor);
+        cursor->sstable_cursor = NULL;
 
-            /* we skip initial pages as they contain bloom filter */
-            if (pager_cursor_next(cursor->sstable_cursor) == -1)
-            {
-                pager_cursor_free(cursor->sstable_cursor);
-                cursor->sstable_cursor = NULL;
-                pthread_rwlock_unlock(&cursor->cf->sstables_lock);
-                return tidesdb_err_new(1084, "Failed to skip initial pages");
-            }
+        /* we initialize the sstable cursor */
+        if (sstable_iterator_init(cursor->version->sstables[cursor->sstable_index],
+                                  &cursor->sstable_cursor) != 0)
+            return tidesdb_err_new(1035, "Failed to initialize sstable cursor");
 
-            pthread_rwlock_unlock(&cursor->cf->sstables_lock);
-            return NULL;
-        }
+        return NULL;
     }
 
-    /* we unlock the sstables */
-    pthread_rwlock_unlock(&cursor->cf->sstables_lock);
+    /* before the newest sstable we move back to the oldest memtable that has pairs */
+    if (_cursor_seek_memtable(cursor, 0, 1) == 0) return NULL;
 
     return tidesdb_err_new(1085, "At beginning of cursor");
 }
@@ -1754,11 +2514,14 @@ tidesdb_err_t* tidesdb_cursor_get(tidesdb_cursor_t* cursor, key_value_pair_t* kv
     if (cursor == NULL) return tidesdb_err_new(1061, "Cursor is NULL");
 
     /* check if current key in memtable cursor is not NULL */
-    if (cursor->memtable_cursor->current != NULL)
+    if (cursor->memtable_cursor != NULL && cursor->memtable_cursor->current != NULL)
     {
-        /* check if tombstone */
+        /* check if tombstone or expired, a concurrent memtable does not turn expired pairs into
+         * tombstones */
+        time_t ttl = cursor->memtable_cursor->current->ttl;
         if (_is_tombstone(cursor->memtable_cursor->current->value,
-                          cursor->memtable_cursor->current->value_size))
+                          cursor->memtable_cursor->current->value_size) ||
+            (ttl != -1 && ttl < time(NULL)))
         {
             /* get next */
             tidesdb_err_t* err = tidesdb_cursor_next(cursor);
@@ -1788,67 +2551,33 @@ tidesdb_err_t* tidesdb_cursor_get(tidesdb_cursor_t* cursor, key_value_pair_t* kv
     /* get from the sstable */
     if (cursor->sstable_cursor != NULL)
     {
-        unsigned int pg_num;
-        if (pager_cursor_get(cursor->sstable_cursor, &pg_num) == -1)
-        {
-            tidesdb_cursor_free(cursor);
-            return tidesdb_err_new(1062, "At end of cursor");
-        }
-
-        uint8_t* kv_buffer;    /* buffer to hold key-value pair from page */
-        size_t kv_buffer_size; /* size of buffer */
-
-        /* read the key and value */
-        if (pager_read(cursor->cf->sstables[cursor->sstable_index]->pager, pg_num, &kv_buffer,
-                       &kv_buffer_size) == -1)
-        {
-            tidesdb_cursor_free(cursor);
-            return tidesdb_err_new(1060, "Failed to get key value pair from cursor");
-        }
-
-        /* deserialize the key-value pair */
-        key_value_pair_t* dkv = NULL;
-        if (deserialize_key_value_pair(kv_buffer, kv_buffer_size, &dkv,
-                                       cursor->cf->config.compressed) == -1)
-        {
-            tidesdb_cursor_free(cursor);
+        key_value_pair_t skv; /* points into the sstable cursor's current block */
+        if (sstable_iterator_get(cursor->sstable_cursor, &skv) == -1)
             return tidesdb_err_new(1060, "Failed to get key value pair from cursor");
-        }
 
         /* check if tombstone */
-        if (_is_tombstone(dkv->value, dkv->value_size))
+        if (_is_tombstone(skv.value, skv.value_size))
         {
             /* get next */
             tidesdb_err_t* err = tidesdb_cursor_next(cursor);
-            if (err != NULL)
-            {
-                _free_key_value_pair(dkv);
-                return err;
-            }
+            if (err != NULL) return err;
             return tidesdb_cursor_get(cursor, kv);
         }
 
         /* copy over the key and value, so the user can free it */
-        kv->key_size = dkv->key_size;
+        kv->key_size = skv.key_size;
         kv->key = malloc(kv->key_size);
-        if (kv->key == NULL)
-        {
-            _free_key_value_pair(dkv);
-            return tidesdb_err_new(1077, "Failed to allocate memory for key");
-        }
-        memcpy(kv->key, dkv->key, kv->key_size);
+        if (kv->key == NULL) return tidesdb_err_new(1077, "Failed to allocate memory for key");
+        memcpy(kv->key, skv.key, kv->key_size);
 
-        kv->value_size = dkv->value_size;
+        kv->value_size = skv.value_size;
         kv->value = malloc(kv->value_size);
         if (kv->value == NULL)
         {
             free(kv->key);
-            _free_key_value_pair(dkv);
             return tidesdb_err_new(1078, "Failed to allocate memory for value");
         }
-        memcpy(kv->value, dkv->value, kv->value_size);
-
-        _free_key_value_pair(dkv);
+        memcpy(kv->value, skv.value, kv->value_size);
 
         return NULL;
     }
@@ -1862,11 +2591,14 @@ tidesdb_err_t* tidesdb_cursor_free(tidesdb_cursor_t* cursor)
     if (cursor == NULL) return tidesdb_err_new(1061, "Cursor is NULL");
 
     /* we free the sstable cursor */
-    if (cursor->sstable_cursor != NULL) pager_cursor_free(cursor->sstable_cursor);
+    if (cursor->sstable_cursor != NULL) sstable_iterator_free(cursor->sstable_cursor);
 
     /* we free the memtable cursor */
     if (cursor->memtable_cursor != NULL) skiplist_cursor_free(cursor->memtable_cursor);
 
+    /* the sstables of the version may close now */
+    _release_version(cursor->version);
+
     free(cursor);
 
     cursor = NULL;
@@ -1874,9 +2606,11 @@ tidesdb_err_t* tidesdb_cursor_free(tidesdb_cursor_t* cursor)
     return NULL;
 }
 
-int _new_column_family(const char* db_path, const char* name, int flush_threshold, int max_level,
-                       float probability, column_family_t** cf, bool compressed)
+int _new_column_family(const char* db_path, const char* wal_dir, sync_service_t* sync_service,
+                       const column_family_config_t* config, column_family_t** cf)
 {
+    const char* name = config->name;
+
     /* we allocate memory for the column family */
     *cf = malloc(sizeof(column_family_t));
 
@@ -1894,25 +2628,40 @@ int _new_column_family(const char* db_path, const char* name, int flush_threshol
     }
 
     /* we set the flush threshold */
-    (*cf)->config.flush_threshold = flush_threshold;
+    (*cf)->config.flush_threshold = config->flush_threshold;
 
     /* we set the max level */
-    (*cf)->config.max_level = max_level;
+    (*cf)->config.max_level = config->max_level;
 
     /* we set the probability */
-    (*cf)->config.probability = probability;
+    (*cf)->config.probability = config->probability;
 
-    /* we initialize the id generator */
-    (*cf)->id_gen = id_gen_init((uint64_t)time(NULL));
-    if ((*cf)->id_gen == NULL)
-    {
-        free((*cf)->config.name);
-        free(*cf);
-        return -1;
-    }
+    /* we set the sstable data block size */
+    (*cf)->config.block_size = config->block_size;
+
+    /* we set the sstable bloom filter bits per key */
+    (*cf)->config.bloom_bits_per_key = config->bloom_bits_per_key;
+
+    /* we set the leveled compaction settings */
+    (*cf)->config.level_size_multiplier = config->level_size_multiplier;
+    (*cf)->config.target_file_size = config->target_file_size;
 
-    /* set compressed to false */
-    (*cf)->config.compressed = compressed;
+    /* we set the background compaction triggers */
+    (*cf)->config.l0_compaction_trigger = config->l0_compaction_trigger;
+    (*cf)->config.tombstone_ratio_trigger = config->tombstone_ratio_trigger;
+    (*cf)->config.expired_ratio_trigger = config->expired_ratio_trigger;
+
+    /* we set whether the memtable is concurrent */
+    (*cf)->config.concurrent_memtable = config->concurrent_memtable;
+
+    /* sstable files are numbered from 1 */
+    atomic_init(&(*cf)->next_file_number, 1);
+
+    /* the table cache is the database's, it is set once the column family is added to one */
+    (*cf)->table_cache = NULL;
+
+    /* we set whether sstable data is compressed */
+    (*cf)->config.compressed = config->compressed;
 
     /* create compaction_or_flush_lock */
     if (pthread_rwlock_init(&(*cf)->compaction_or_flush_lock, NULL) != 0)
@@ -1996,9 +2745,27 @@ int _new_column_family(const char* db_path, const char* name, int flush_threshol
         return -1;
     }
 
-    /* we init sstables array and len */
-    (*cf)->num_sstables = 0;
-    (*cf)->sstables = NULL;
+    /* we create memtable */
+    tidesdb_memtable_t* memtable = _new_memtable(*cf);
+
+    /* a new column family starts with a version of just the empty memtable */
+    (*cf)->version = memtable != NULL ? _new_version(NULL, 0, &memtable, 1) : NULL;
+    _unref_memtable(memtable); /* the version holds the memtable now */
+
+    if ((*cf)->version == NULL)
+    {
+        free((*cf)->config.name);
+        free((*cf)->path);
+        free(*cf);
+        free(serialized_cf);
+        fclose(config_file);
+        return -1;
+    }
+
+    (*cf)->memtable = memtable->skiplist;
+
+    (*cf)->sstable_sequence = 1;
+    (*cf)->manual_compaction = false;
 
     /* we initialize sstables lock */
     if (pthread_rwlock_init(&(*cf)->sstables_lock, NULL) != 0)
@@ -2011,12 +2778,10 @@ int _new_column_family(const char* db_path, const char* name, int flush_threshol
         return -1;
     }
 
-    /* we create memtable */
-    (*cf)->memtable = new_skiplist((*cf)->config.max_level, (*cf)->config.probability);
-
-    /* we check if the memtable was created */
-    if ((*cf)->memtable == NULL)
+    /* we initialize memtable lock */
+    if (pthread_rwlock_init(&(*cf)->memtable_lock, NULL) != 0)
     {
+        _release_version((*cf)->version);
         free((*cf)->config.name);
         free((*cf)->path);
         pthread_rwlock_destroy(&(*cf)->sstables_lock);
@@ -2041,8 +2806,19 @@ int _new_column_family(const char* db_path, const char* name, int flush_threshol
     }
 
     /* create wal */
-    if (_open_wal(cf_path, &(*cf)->wal) == -1)
+    if (_open_wal(cf_path, wal_dir, (*cf)->config.name, sync_service, &(*cf)->wal) == -1)
+    {
+        free((*cf)->config.name);
+        free((*cf)->path);
+        pthread_rwlock_destroy(&(*cf)->sstables_lock);
+        free(*cf);
+        return -1;
+    }
+
+    /* a new column family starts with an empty manifest */
+    if (manifest_open(cf_path, &(*cf)->manifest) == -1)
     {
+        _close_wal((*cf)->wal);
         free((*cf)->config.name);
         free((*cf)->path);
         pthread_rwlock_destroy(&(*cf)->sstables_lock);
@@ -2137,6 +2913,9 @@ int _load_column_families(tidesdb_t* tdb)
     /* check if tdb is NULL */
     if (tdb == NULL) return -1;
 
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
     /* open the db directory */
     DIR* tdb_dir = opendir(tdb->config.db_path);
     if (tdb_dir == NULL)
@@ -2144,10 +2923,14 @@ int _load_column_families(tidesdb_t* tdb)
         return -1;
     }
 
+    column_family_load_t* loads = NULL;
+    int num_loads = 0;
+    int rc = 0;
+
     struct dirent* tdb_entry; /* create a dirent struct for the db directory */
 
-    /* we iterate over the db directory */
-    while ((tdb_entry = readdir(tdb_dir)) != NULL)
+    /* we find every column family first so each can be given its slot up front */
+    while (rc == 0 && (tdb_entry = readdir(tdb_dir)) != NULL)
     {
         /* we skip the . and .. directories */
         if (strcmp(tdb_entry->d_name, ".") == 0 || strcmp(tdb_entry->d_name, "..") == 0) continue;
@@ -2166,666 +2949,1357 @@ int _load_column_families(tidesdb_t* tdb)
         /* we iterate over the column family directory */
         while ((cf_entry = readdir(cf_dir)) != NULL)
         {
-            if (strstr(cf_entry->d_name, COLUMN_FAMILY_CONFIG_FILE_EXT) != NULL)
-            { /* if the file is a column family config file */
-
-                char config_file_path[PATH_MAX];
-                if (snprintf(config_file_path, sizeof(config_file_path), "%s%s%s", cf_path,
-                             _get_path_seperator(),
-                             cf_entry->d_name) >= (long)sizeof(config_file_path))
-                {
-                    closedir(cf_dir);
-                    closedir(tdb_dir);
-                    return -1;
-                }
+            /* we look for the column family config file */
+            if (strstr(cf_entry->d_name, COLUMN_FAMILY_CONFIG_FILE_EXT) == NULL) continue;
 
-                /* load the config file into memory */
-                FILE* config_file = fopen(config_file_path, "rb");
-                if (config_file == NULL)
-                {
-                    closedir(cf_dir);
-                    closedir(tdb_dir);
-                    return -1;
-                }
+            char config_file_path[PATH_MAX];
+            if (snprintf(config_file_path, sizeof(config_file_path), "%s%s%s", cf_path,
+                         _get_path_seperator(),
+                         cf_entry->d_name) >= (long)sizeof(config_file_path))
+            {
+                rc = -1;
+                break;
+            }
 
-                fseek(config_file, 0, SEEK_END);         /* seek to end of file */
-                size_t config_size = ftell(config_file); /* get size of file */
-                fseek(config_file, 0, SEEK_SET);         /* seek back to beginning of file */
+            column_family_load_t* temp_loads =
+                realloc(loads, sizeof(column_family_load_t) * (num_loads + 1));
+            if (temp_loads == NULL)
+            {
+                rc = -1;
+                break;
+            }
 
-                uint8_t* buffer = malloc(config_size);
-                if (fread(buffer, 1, config_size, config_file) != config_size)
-                {
-                    free(buffer);
-                    fclose(config_file);
-                    closedir(cf_dir);
-                    closedir(tdb_dir);
-                    return -1;
-                }
+            loads = temp_loads;
+            memset(&loads[num_loads], 0, sizeof(column_family_load_t));
+            loads[num_loads].path = strdup(cf_path);
+            loads[num_loads].config_path = strdup(config_file_path);
+            num_loads++;
 
-                fclose(config_file);
+            if (loads[num_loads - 1].path == NULL || loads[num_loads - 1].config_path == NULL)
+            {
+                rc = -1;
+                break;
+            }
+        }
 
-                /* deserialize the cf config */
-                column_family_config_t* config;
+        /* we free up resources */
+        closedir(cf_dir);
+    }
 
-                if (deserialize_column_family_config(buffer, config_size, &config) == -1)
-                {
-                    free(buffer);
-                    closedir(cf_dir);
-                    closedir(tdb_dir);
-                    return -1;
-                }
+    /* we free up resources */
+    closedir(tdb_dir);
 
-                free(buffer);
+    /* the column families are loaded straight into their slots, nothing is moved once loaded */
+    if (rc == 0 && num_loads > 0)
+    {
+        tdb->column_families = calloc(num_loads, sizeof(column_family_t));
+        if (tdb->column_families == NULL) rc = -1;
+    }
 
-                /* initialize the column family and add it to tidesdb */
-                column_family_t* cf = (column_family_t*)malloc(sizeof(column_family_t));
+    if (rc == 0 && num_loads > 0)
+    {
+        sem_t sem;
+        sem_init(&sem, 0, TIDESDB_MAX_LOAD_THREADS);
 
-                if (cf == NULL)
-                {
-                    closedir(cf_dir);
-                    closedir(tdb_dir);
-                    return -1;
-                }
+        pthread_mutex_t progress_lock;
+        pthread_mutex_init(&progress_lock, NULL);
+        int loaded = 0;
 
-                cf->config = *config;
-                cf->path = strdup(cf_path);
-                cf->sstables = NULL;
-                cf->num_sstables = 0;
-                cf->memtable = new_skiplist(cf->config.max_level, cf->config.probability);
-                cf->id_gen = id_gen_init((uint64_t)time(NULL));
+        /* every column family is loaded side by side with the others */
+        for (int i = 0; i < num_loads; i++)
+        {
+            sem_wait(&sem); /* we wait if the maximum number of threads is reached */
 
-                cf->wal = malloc(sizeof(wal_t));
-                if (cf->wal == NULL) /* could not allocate memory for wal */
-                {
-                    free(cf->path);
-                    free(cf);
-                    return -1;
-                }
+            loads[i].tdb = tdb;
+            loads[i].cf = &tdb->column_families[i];
+            loads[i].sem = &sem;
+            loads[i].progress_lock = &progress_lock;
+            loads[i].loaded = &loaded;
+            loads[i].total = num_loads;
 
-                /* now we open the wal */
-                if (_open_wal(cf->path, &cf->wal) == -1)
-                {
-                    free(cf->path);
-                    free(cf);
-                    return -1;
-                }
+            pthread_t thread;
+            if (pthread_create(&thread, NULL, _load_column_family_thread, &loads[i]) != 0)
+            {
+                /* we load the column family on this thread instead */
+                _load_column_family_thread(&loads[i]);
+                continue;
+            }
+            pthread_detach(thread);
+        }
 
-                /* initialize compaction_or_flush_lock */
-                if (pthread_rwlock_init(&cf->compaction_or_flush_lock, NULL) != 0)
-                {
-                    _close_wal(cf->wal);
-                    free(cf->config.name);
-                    free(cf);
-                    closedir(cf_dir);
-                    closedir(tdb_dir);
-                    return -1;
-                }
+        /* wait for all load threads to finish */
+        for (int i = 0; i < TIDESDB_MAX_LOAD_THREADS; i++) sem_wait(&sem);
 
-                /* we check if the memtable was created */
-                if (cf->memtable == NULL)
-                {
-                    _close_wal(cf->wal);
-                    free(cf->config.name);
-                    free(cf);
-                    closedir(cf_dir);
-                    closedir(tdb_dir);
-                    return -1;
-                }
+        sem_destroy(&sem);
+        pthread_mutex_destroy(&progress_lock);
 
-                /* we initialize sstables lock */
-                if (pthread_rwlock_init(&cf->sstables_lock, NULL) != 0)
-                {
-                    _close_wal(cf->wal);
-                    free(cf->config.name);
-                    free(cf);
-                    closedir(cf_dir);
-                    closedir(tdb_dir);
-                    return -1;
-                }
+        for (int i = 0; i < num_loads; i++)
+        {
+            if (loads[i].rc == -1) rc = -1;
 
-                /* we add the column family yo db */
-                if (_add_column_family(tdb, cf) == -1)
-                {
-                    _close_wal(cf->wal);
-                    free(cf->config.name);
-                    free(cf);
-                    closedir(cf_dir);
-                    closedir(tdb_dir);
-                    return -1;
-                }
+            tdb->recovery_stats.entries += loads[i].entries;
+            tdb->recovery_stats.bytes += loads[i].bytes;
+        }
 
-                /* now we replay from the wal and populate column family memtable */
-                if (_replay_from_wal(tdb, cf->wal) == -1)
-                {
-                    _close_wal(cf->wal);
-                    free(cf->config.name);
-                    free(cf);
-                    closedir(cf_dir);
-                    closedir(tdb_dir);
-                    return -1;
-                }
-            }
+        if (rc == 0)
+        {
+            tdb->num_column_families = num_loads;
         }
+        else
+        {
+            /* we do not open with some of the column families, the ones loaded are freed */
+            for (int i = 0; i < num_loads; i++)
+                if (loads[i].rc == 0) _free_column_family(&tdb->column_families[i]);
 
-        /* we free up resources */
-        closedir(cf_dir);
+            free(tdb->column_families);
+            tdb->column_families = NULL;
+        }
     }
 
-    /* we free up resources */
-    closedir(tdb_dir);
+    for (int i = 0; i < num_loads; i++)
+    {
+        free(loads[i].path);
+        free(loads[i].config_path);
+    }
+    free(loads);
 
-    return 0;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    tdb->recovery_stats.column_families = (uint64_t)tdb->num_column_families;
+    tdb->recovery_stats.duration_us = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000 +
+                                      (uint64_t)((end.tv_nsec - start.tv_nsec) / 1000);
+
+    return rc;
 }
 
-const char* _get_path_seperator()
+void* _load_column_family_thread(void* arg)
 {
-#ifdef _WIN32
-    return "\\";
-#else
-    return "/";
-#endif
+    column_family_load_t* load = arg;
+
+    load->rc = _load_column_family(load);
+
+    sem_post(load->sem);
+
+    return NULL;
 }
 
-int _append_to_wal(tidesdb_t* tdb, wal_t* wal, const uint8_t* key, size_t key_size,
-                   const uint8_t* value, size_t value_size, time_t ttl, OP_CODE op_code,
-                   const char* cf)
+int _load_column_family(column_family_load_t* load)
 {
-    if (tdb == NULL || wal == NULL || key == NULL) return -1;
+    if (load == NULL || load->tdb == NULL || load->cf == NULL) return -1;
 
-    column_family_t* column_family = NULL;
-    if (_get_column_family(tdb, cf, &column_family) == -1) return -1;
+    column_family_t* cf = load->cf;
 
-    operation_t* op = malloc(sizeof(operation_t));
-    if (op == NULL) return -1;
+    /* load the config file into memory */
+    FILE* config_file = fopen(load->config_path, "rb");
+    if (config_file == NULL) return -1;
 
-    op->op_code = op_code;
-    op->column_family = strdup(cf);
+    fseek(config_file, 0, SEEK_END);         /* seek to end of file */
+    size_t config_size = ftell(config_file); /* get size of file */
+    fseek(config_file, 0, SEEK_SET);         /* seek back to beginning of file */
 
-    if (op->column_family == NULL)
+    uint8_t* buffer = malloc(config_size);
+    if (buffer == NULL || fread(buffer, 1, config_size, config_file) != config_size)
     {
-        free(op);
+        free(buffer);
+        fclose(config_file);
         return -1;
     }
 
-    op->kv = (key_value_pair_t*)malloc(sizeof(key_value_pair_t));
-    if (op->kv == NULL)
+    fclose(config_file);
+
+    /* deserialize the cf config */
+    column_family_config_t* config;
+
+    if (deserialize_column_family_config(buffer, config_size, &config) == -1)
     {
-        free(op->column_family);
-        free(op);
+        free(buffer);
         return -1;
     }
 
-    op->kv->key = (uint8_t*)malloc(key_size);
-    if (op->kv->key == NULL)
+    free(buffer);
+
+    /* we initialize the locks first, a column family that fails after is freed whole */
+    if (pthread_rwlock_init(&cf->compaction_or_flush_lock, NULL) != 0)
     {
-        free(op->column_family);
-        free(op->kv);
-        free(op);
+        free(config->name);
+        free(config);
         return -1;
     }
 
-    memcpy(op->kv->key, key, key_size);
-    op->kv->key_size = key_size;
-
-    op->kv->value = (uint8_t*)malloc(value_size);
-    if (op->kv->value == NULL)
+    if (pthread_rwlock_init(&cf->sstables_lock, NULL) != 0)
     {
-        free(op->column_family);
-        free(op->kv->key);
-        free(op->kv);
-        free(op);
+        pthread_rwlock_destroy(&cf->compaction_or_flush_lock);
+        free(config->name);
+        free(config);
         return -1;
     }
 
-    /* could be a delete */
-    if (value != NULL)
+    if (pthread_rwlock_init(&cf->memtable_lock, NULL) != 0)
     {
-        memcpy(op->kv->value, value, value_size);
-        op->kv->value_size = value_size;
+        pthread_rwlock_destroy(&cf->sstables_lock);
+        pthread_rwlock_destroy(&cf->compaction_or_flush_lock);
+        free(config->name);
+        free(config);
+        return -1;
     }
 
-    op->kv->ttl = ttl;
-
-    uint8_t* serialized_op_buffer = NULL;
-    size_t serialized_op_buffer_size = 0;
-
-    if (serialize_operation(op, &serialized_op_buffer, &serialized_op_buffer_size,
-                            tdb->config.compressed_wal) == -1)
+    cf->config = *config;
+    free(config);
+    cf->path = strdup(load->path);
+    cf->sstable_sequence = 1;
+    cf->manual_compaction = false;
+    atomic_init(&cf->next_file_number, 1);
+    cf->table_cache = load->tdb->table_cache;
+
+    /* the version starts with just the empty memtable, the sstables are loaded after */
+    tidesdb_memtable_t* memtable = _new_memtable(cf);
+    cf->version = memtable != NULL ? _new_version(NULL, 0, &memtable, 1) : NULL;
+    cf->memtable = cf->version != NULL ? memtable->skiplist : NULL;
+    if (memtable != NULL) _unref_memtable(memtable); /* the version holds the memtable now */
+
+    if (cf->path == NULL || cf->version == NULL)
     {
-        free(op->column_family);
-        free(op->kv->key);
-        free(op->kv->value);
-        free(op->kv);
-        free(op);
+        _free_column_family(cf);
         return -1;
     }
 
-    unsigned int pg_num = 0;
-    if (pager_write(wal->pager, serialized_op_buffer, serialized_op_buffer_size, &pg_num) == -1)
+    /* now we open the wal */
+    cf->wal = malloc(sizeof(wal_t));
+    if (cf->wal == NULL ||
+        _open_wal(cf->path, load->tdb->config.wal_dir, cf->config.name, load->tdb->sync_service,
+                  &cf->wal) == -1)
     {
-        free(op->column_family);
-        free(op->kv->key);
-        free(op->kv->value);
-        free(op->kv);
-        free(op);
-        free(serialized_op_buffer);
+        cf->wal = NULL; /* _open_wal frees the wal it could not open */
+        _free_column_family(cf);
         return -1;
     }
 
-    free(op->column_family);
-    free(op->kv->key);
-    free(op->kv->value);
-    free(op->kv);
-    free(op);
-    free(serialized_op_buffer);
-
-    return 0;
-}
-
-int _open_wal(const char* db_path, wal_t** w)
-{
-    /* we check if the db path is NULL */
-    if (db_path == NULL) return -1;
-
-    /* we check if wal is NULL */
-    if (w == NULL) return -1;
-
-    char wal_path[PATH_MAX];
-    snprintf(wal_path, sizeof(wal_path), "%s%s%s", db_path, _get_path_seperator(), WAL_EXT);
+    /* we load the sstables the manifest lists into a sorted version, there could be none */
+    if (_load_sstables(cf) == -1)
+    {
+        _free_column_family(cf);
+        return -1;
+    }
 
-    pager_t* p = NULL;
-    if (pager_open(wal_path, &p) == -1) return -1;
+    /* now we replay the wal and populate the memtable */
+    wal_replay_t replay = {0};
+    replay.tdb = load->tdb;
+    replay.cf = cf;
 
-    (*w)->pager = p;
-    if (pthread_rwlock_init(&(*w)->lock, NULL) != 0)
+    if (_replay_from_wal(&replay) == -1)
     {
-        free(*w);
-        pager_close(p);
+        _free_column_family(cf);
         return -1;
     }
 
+    load->entries = replay.entries;
+    load->bytes = replay.bytes;
+
+    /* we report the progress one column family at a time */
+    pthread_mutex_lock(load->progress_lock);
+    (*load->loaded)++;
+    if (load->tdb->config.open_progress != NULL)
+        load->tdb->config.open_progress(cf->config.name, *load->loaded, load->total,
+                                        load->tdb->config.open_progress_arg);
+    pthread_mutex_unlock(load->progress_lock);
+
     return 0;
 }
 
-void _close_wal(wal_t* wal)
+const char* _get_path_seperator()
 {
-    /* we check if the wal is NULL */
-    if (wal == NULL) return;
+#ifdef _WIN32
+    return "\\";
+#else
+    return "/";
+#endif
+}
 
-    /* we close the pager */
-    pager_close(wal->pager);
+int _append_to_wal(tidesdb_t* tdb, wal_t* wal, const uint8_t* key, size_t key_size,
+                   const uint8_t* value, size_t value_size, time_t ttl, OP_CODE op_code,
+                   const char* cf)
+{
+    if (tdb == NULL || wal == NULL || key == NULL || value == NULL || cf == NULL) return -1;
 
-    /* we destroy the lock */
-    pthread_rwlock_destroy(&wal->lock);
+    /* the operation points at the caller's key, value and column family name, nothing is copied */
+    key_value_pair_t kv = {(uint8_t*)key, key_size, (uint8_t*)value, value_size, ttl};
+    operation_t op = {op_code, &kv, (char*)cf};
 
-    /* we free the wal */
-    free(wal);
+    /* the log gathers the operation from its parts, only the fixed size fields are encoded on
+     * our stack */
+    uint8_t scratch[SERIALIZE_OPERATION_SCRATCH_SIZE];
+    struct iovec parts[SERIALIZE_OPERATION_PARTS];
+    size_t encoded_size = 0;
 
-    wal = NULL;
-}
+    if (serialize_operation_parts(&op, scratch, parts, &encoded_size) == -1) return -1;
 
-int _truncate_wal(wal_t* wal, int checkpoint)
-{
-    if (wal == NULL) return -1;
+    /* a compressed operation is compressed from its parts into a buffer of its own */
+    if (tdb->config.compressed_wal)
+    {
+        uint8_t* compressed = NULL;
+        size_t compressed_size = 0;
 
-    /* lock wal */
-    pthread_rwlock_wrlock(&wal->lock);
+        if (serialize_compress_parts(parts, SERIALIZE_OPERATION_PARTS, &compressed,
+                                     &compressed_size) == -1)
+            return -1;
 
-    /* truncate the wal to provided checkpoint */
-    if (pager_truncate(wal->pager, checkpoint) == -1)
-    {
-        /* unlock wal */
-        pthread_rwlock_unlock(&wal->lock);
-        return -1;
-    }
+        struct iovec part = {compressed, compressed_size};
+        int result = _commit_to_wal(tdb, wal, &part, 1, compressed_size);
 
-    /* unlock wal */
-    pthread_rwlock_unlock(&wal->lock);
+        free(compressed);
 
-    return 0;
+        return result;
+    }
+
+    /* we join the commit queue, our entry is written together with those of concurrent writers */
+    return _commit_to_wal(tdb, wal, parts, SERIALIZE_OPERATION_PARTS, encoded_size);
 }
 
-int _replay_from_wal(tidesdb_t* tdb, wal_t* wal)
+int _append_batch_to_wal(tidesdb_t* tdb, wal_t* wal, tidesdb_batch_t* batch, const char* cf)
 {
-    if (wal == NULL || tdb == NULL) return -1;
-
-    /* we check if the wal is empty */
-    size_t pages_count = 0;
-    if (pager_pages_count(wal->pager, &pages_count) == -1)
-        return -1; /* failed to get pages count */
+    if (tdb == NULL || wal == NULL || batch == NULL || cf == NULL) return -1;
 
-    if (pages_count == 0) return 0; /* wal is empty */
+    if (serialize_batch_header(batch->count, batch->buffer) == -1) return -1;
 
-    pager_cursor_t* pc = NULL;
+    /* the batch is followed by the column family name like a single operation is */
+    struct iovec parts[2] = {{batch->buffer, batch->size}, {(char*)cf, strlen(cf) + 1}};
 
-    if (pager_cursor_init(wal->pager, &pc) == 0)
+    if (tdb->config.compressed_wal)
     {
-        do
-        {
-            unsigned int pg_num;
-            if (pager_cursor_get(pc, &pg_num) == -1) break;
+        uint8_t* compressed = NULL;
+        size_t compressed_size = 0;
 
-            operation_t* op = NULL;
+        if (serialize_compress_parts(parts, 2, &compressed, &compressed_size) == -1) return -1;
 
-            uint8_t* op_buffer = NULL;
-            size_t op_buffer_size = 0;
+        struct iovec part = {compressed, compressed_size};
+        int result = _commit_to_wal(tdb, wal, &part, 1, compressed_size);
 
-            if (pager_read(wal->pager, pg_num, &op_buffer, &op_buffer_size) == -1)
-            {
-                free(op_buffer);
-                break;
-            }
+        free(compressed);
 
-            if (deserialize_operation(op_buffer, op_buffer_size, &op, tdb->config.compressed_wal) ==
-                -1)
-            {
-                free(op_buffer);
-                break;
-            }
+        return result;
+    }
 
-            column_family_t* cf = NULL;
+    return _commit_to_wal(tdb, wal, parts, 2, parts[0].iov_len + parts[1].iov_len);
+}
 
-            if (_get_column_family(tdb, op->column_family, &cf) == -1)
-            {
-                free(op_buffer);
-                free(op);
-                break;
-            }
+int _commit_to_wal(tidesdb_t* tdb, wal_t* wal, const struct iovec* parts, size_t parts_count,
+                   size_t data_size)
+{
+    if (tdb == NULL || wal == NULL || parts == NULL) return -1;
 
-            switch (op->op_code)
-            {
-                case OP_PUT:
-                    skiplist_put(cf->memtable, op->kv->key, op->kv->key_size, op->kv->value,
-                                 op->kv->value_size, op->kv->ttl);
-                    break;
+    wal_commit_t commit = {parts, parts_count, data_size, -1, false, NULL};
 
-                case OP_DELETE:
-                    uint8_t* tombstone = (uint8_t*)malloc(4);
-                    if (tombstone != NULL)
-                    {
-                        uint32_t tombstone_value = TOMBSTONE;
-                        memcpy(tombstone, &tombstone_value, sizeof(uint32_t));
-                    }
-
-                    /* add to memtable */
-                    if (skiplist_put(cf->memtable, op->kv->key, op->kv->key_size, tombstone, 4,
-                                     -1) == -1)
-                    {
-                        free(tombstone);
-                        break;
-                    }
-
-                    free(tombstone);
-                    break;
+    pthread_mutex_lock(&wal->commit_lock);
 
-                default:
-                    break;
-            }
+    /* we queue behind the writers already waiting */
+    if (wal->commit_tail == NULL)
+        wal->commit_head = &commit;
+    else
+        wal->commit_tail->next = &commit;
+    wal->commit_tail = &commit;
 
-            free(op->kv->value);
-            free(op->kv->key);
-            free(op->kv);
-            free(op);
-            free(op_buffer);
+    /* we wait until a leader has written our entry or we are first in line to lead */
+    while (!commit.done && (wal->committing || wal->commit_head != &commit))
+        pthread_cond_wait(&wal->commit_cond, &wal->commit_lock);
 
-        } while (pager_cursor_next(pc) == 0);
+    if (commit.done)
+    {
+        pthread_mutex_unlock(&wal->commit_lock);
+        return commit.result;
     }
 
-    pager_cursor_free(pc);
+    /* we lead, the writers queued behind us join our group up to the group size */
+    wal->committing = true;
 
-    return 0;
-}
+    size_t count = 1;
+    size_t group_size = commit.data_size;
+    size_t group_parts_count = commit.parts_count;
+    wal_commit_t* last = &commit;
+    while (last->next != NULL && group_size + last->next->data_size <= TIDESDB_WAL_GROUP_MAX_SIZE)
+    {
+        last = last->next;
+        group_size += last->data_size;
+        group_parts_count += last->parts_count;
+        count++;
+    }
 
-int _free_sstable(sstable_t* sst)
-{
-    /* we check if the sstable is NULL */
-    if (sst == NULL) return -1;
+    /* the writers after the group wait for the next leader */
+    wal->commit_head = last->next;
+    if (wal->commit_head == NULL) wal->commit_tail = NULL;
+    last->next = NULL;
 
-    /* we close the pager */
-    pager_close(sst->pager);
+    pthread_mutex_unlock(&wal->commit_lock);
 
-    /* we free the sstable */
-    free(sst);
+    /* we write the group without holding the queue so more writers can line up behind it, a
+     * group of one is written from its own parts */
+    int result = -1;
+    const struct iovec* group_parts = commit.parts;
+    size_t* group_parts_counts = &commit.parts_count;
+    struct iovec* gathered_parts = NULL;
 
-    sst = NULL;
+    if (count > 1)
+    {
+        gathered_parts = malloc(group_parts_count * sizeof(struct iovec));
+        group_parts_counts = malloc(count * sizeof(size_t));
+        group_parts = gathered_parts;
+
+        size_t i = 0;
+        struct iovec* p = gathered_parts;
+        for (wal_commit_t* c = &commit; c != NULL && gathered_parts != NULL &&
+                                        group_parts_counts != NULL;
+             c = c->next, i++)
+        {
+            memcpy(p, c->parts, c->parts_count * sizeof(struct iovec));
+            p += c->parts_count;
+            group_parts_counts[i] = c->parts_count;
+        }
+    }
 
-    return 0;
-}
+    if (group_parts != NULL && group_parts_counts != NULL)
+    {
+        pthread_rwlock_wrlock(&wal->lock);
 
-int _compare_sstables(const void* a, const void* b)
-{
-    if (a == NULL || b == NULL) return 0;
+        /* a full segment is closed and the group starts the next one */
+        size_t size = 0;
+        result = log_size(wal->log, &size);
+        if (result == 0 && size >= TIDESDB_WAL_SEGMENT_SIZE) result = _roll_wal(wal);
 
-    sstable_t* s1 = (sstable_t*)a;
-    sstable_t* s2 = (sstable_t*)b;
+        if (result == 0)
+            result = log_append_batchv(wal->log, group_parts, group_parts_counts, count,
+                                       tdb->config.sync_wal);
 
-    time_t last_modified_s1 = get_last_modified(s1->pager->filename);
-    time_t last_modified_s2 = get_last_modified(s2->pager->filename);
+        pthread_rwlock_unlock(&wal->lock);
+    }
 
-    switch ((last_modified_s1 < last_modified_s2) - (last_modified_s1 > last_modified_s2))
+    if (count > 1)
     {
-        case -1:
-            return -1;
-        case 1:
-            return 1;
-        default:
-            return 0;
+        free(gathered_parts);
+        free(group_parts_counts);
     }
-}
 
-int _flush_memtable(tidesdb_t* tdb, column_family_t* cf, skiplist_t* memtable, int wal_checkpoint)
-{
-    /* we check if the tidesdb is NULL */
-    if (tdb == NULL) return -1;
+    pthread_mutex_lock(&wal->commit_lock);
 
-    /* we check if the column family is NULL */
-    if (cf == NULL) return -1;
+    /* we release every writer of the group, a follower's entry lives on its own stack so we read
+     * next before marking it done */
+    wal_commit_t* c = &commit;
+    while (c != NULL)
+    {
+        wal_commit_t* next = c->next;
+        c->result = result;
+        c->done = true;
+        c = next;
+    }
 
-    /* we check if the memtable is NULL */
-    if (memtable == NULL) return -1;
+    wal->committing = false;
+    pthread_cond_broadcast(&wal->commit_cond);
 
-    /* we lock compaction_or_flush_lock */
-    if (pthread_rwlock_wrlock(&cf->compaction_or_flush_lock) != 0) return -1;
+    pthread_mutex_unlock(&wal->commit_lock);
 
-    /* we lock the sstables for the column family */
-    pthread_rwlock_wrlock(&cf->sstables_lock);
+    return result;
+}
 
-    char filename[1024];
+int _open_wal(const char* cf_path, const char* wal_dir, const char* name,
+              sync_service_t* sync_service, wal_t** w)
+{
+    /* we check if the column family path or name is NULL */
+    if (cf_path == NULL || name == NULL) return -1;
 
-    /* we create the filename for the sstable */
-    snprintf(filename, sizeof(filename), "%s%ssstable_%lu%s", cf->path, _get_path_seperator(),
-             id_gen_new(cf->id_gen), SSTABLE_EXT);
+    /* we check if wal is NULL */
+    if (w == NULL) return -1;
 
-    pager_t* p = NULL;
+    /* the segments live with the sstables unless a wal directory is configured */
+    char wal_path[PATH_MAX];
+    if (wal_dir == NULL)
+        snprintf(wal_path, sizeof(wal_path), "%s", cf_path);
+    else
+        snprintf(wal_path, sizeof(wal_path), "%s%s%s", wal_dir, _get_path_seperator(), name);
 
-    /* we open a new pager for the sstable */
-    if (pager_open(filename, &p) == -1)
+    if (access(wal_path, F_OK) == -1 && mkdir(wal_path, 0777) == -1)
     {
-        pthread_rwlock_unlock(&cf->sstables_lock);
-        pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+        free(*w);
         return -1;
     }
 
-    sstable_t* sst = malloc(sizeof(sstable_t)); /* allocate memory for sstable */
-    if (sst == NULL)
+    (*w)->path = strdup(wal_path);
+    if ((*w)->path == NULL)
     {
-        pthread_rwlock_unlock(&cf->sstables_lock);
-        pager_close(p);
-        remove(filename); /* remove the sstable file */
-        pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+        free(*w);
         return -1;
     }
 
-    sst->pager = p; /* set pager for sstable */
+    (*w)->log = NULL;
+    (*w)->num_recycled = 0;
+    (*w)->sync_service = sync_service;
 
-    /* we create a bloom filter.
-     * the bloom filter is used to determine if a key is within an sstable before a scan.
-     * A bloomfilter can span multiple initial pages */
-    bloomfilter_t* bf = bloomfilter_create(BLOOMFILTER_SIZE);
-    if (bf == NULL)
+    if (pthread_rwlock_init(&(*w)->lock, NULL) != 0)
     {
-        pthread_rwlock_unlock(&cf->sstables_lock);
-        free(sst);
-        pager_close(p);
-        pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+        free((*w)->path);
+        free(*w);
         return -1;
     }
 
-    /* create new cursor for the provided memtable */
-    skiplist_cursor_t* cursor = skiplist_cursor_init(memtable);
-    if (cursor == NULL)
+    /* we initialize the commit queue */
+    if (pthread_mutex_init(&(*w)->commit_lock, NULL) != 0)
     {
-        pthread_rwlock_unlock(&cf->sstables_lock);
-        bloomfilter_destroy(bf);
-        free(sst);
-        pager_close(p);
-        remove(filename); /* remove the sstable file */
-        pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+        pthread_rwlock_destroy(&(*w)->lock);
+        free((*w)->path);
+        free(*w);
         return -1;
     }
 
-    /* iterate over the memtable */
-    do
-    {
-        if (cursor->current == NULL) continue;
-
-        /* check if value is tombstone */
-        if (_is_tombstone(cursor->current->value, cursor->current->value_size)) continue;
-
-        /* check if ttl is set and if so if it has expired */
-        if (cursor->current->ttl != -1 && cursor->current->ttl < time(NULL)) continue;
-
-        /* we add the key to the bloom filter */
-        bloomfilter_add(bf, cursor->current->key, cursor->current->key_size);
-    } while (skiplist_cursor_next(cursor) != -1);
-
-    /* we free cursor and create a new one */
-    skiplist_cursor_free(cursor);
-
-    if (bf->size == 0) /* no keys in memtable */
+    if (pthread_cond_init(&(*w)->commit_cond, NULL) != 0)
     {
-        pthread_rwlock_unlock(&cf->sstables_lock);
-        bloomfilter_destroy(bf);
-        free(sst);
-        pager_close(p);
-        remove(filename); /* remove the sstable file */
-        pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+        pthread_mutex_destroy(&(*w)->commit_lock);
+        pthread_rwlock_destroy(&(*w)->lock);
+        free((*w)->path);
+        free(*w);
         return -1;
     }
 
-    /* we serialize the bloom filter */
-    uint8_t* bf_buffer = NULL;
-    size_t bf_buffer_len = 0;
+    (*w)->commit_head = NULL;
+    (*w)->commit_tail = NULL;
+    (*w)->committing = false;
 
-    if (serialize_bloomfilter(bf, &bf_buffer, &bf_buffer_len, cf->config.compressed) == -1)
+    /* we find the segments written before and the ones kept for reuse */
+    DIR* dir = opendir(wal_path);
+    if (dir == NULL)
     {
-        pthread_rwlock_unlock(&cf->sstables_lock);
-        bloomfilter_destroy(bf);
-        free(sst);
-        pager_close(p);
-        remove(filename); /* remove the sstable file */
-        pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+        _close_wal(*w);
         return -1;
     }
 
-    /* we write the bloom filter to the sstable */
-    unsigned int pg_num = 0;
+    uint64_t first_number = 0;
+    uint64_t last_number = 0;
 
-    if (pager_write(p, bf_buffer, bf_buffer_len, &pg_num) == -1)
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
     {
-        pthread_rwlock_unlock(&cf->sstables_lock);
-        bloomfilter_destroy(bf);
-        free(bf_buffer);
-        free(sst);
-        pager_close(p);
-        pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
-        return -1;
-    }
+        unsigned long long number = 0;
+        int length = 0;
+        if (sscanf(entry->d_name, "%llu%n", &number, &length) != 1) continue;
 
-    /* we free the bloom filter */
-    bloomfilter_destroy(bf);
-    free(bf_buffer);
+        if (strcmp(entry->d_name + length, WAL_EXT) == 0)
+        {
+            if (first_number == 0 || number < first_number) first_number = number;
+            if (number > last_number) last_number = number;
+        }
+        else if (strcmp(entry->d_name + length, WAL_RECYCLE_EXT) == 0)
+        {
+            if ((*w)->num_recycled < TIDESDB_WAL_MAX_RECYCLED)
+            {
+                (*w)->recycled[(*w)->num_recycled++] = number;
+                continue;
+            }
 
-    cursor = skiplist_cursor_init(memtable);
-    if (cursor == NULL)
-    {
-        pthread_rwlock_unlock(&cf->sstables_lock);
-        free(sst);
-        pager_close(p);
-        remove(filename); /* remove the sstable file */
-        pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+            /* we keep no more recycled segments than we reuse */
+            char recycled_path[PATH_MAX];
+            _wal_segment_path(*w, number, WAL_RECYCLE_EXT, recycled_path, sizeof(recycled_path));
+            remove(recycled_path);
+        }
+    }
+
+    closedir(dir);
+
+    /* segment numbers start at 1, the segments from first to last are replayed */
+    (*w)->first_number = first_number != 0 ? first_number : last_number + 1;
+    (*w)->log_number = last_number;
+
+    /* a wal left in the paged format becomes a segment of its own */
+    if (_migrate_legacy_wal(*w, cf_path) == -1)
+    {
+        _close_wal(*w);
         return -1;
     }
 
-    /* we iterate over the memtable and write the key-value pairs to the sstable */
-    do
+    /* we append to a new segment, the ones before it are only replayed */
+    if (_roll_wal(*w) == -1)
     {
-        if (cursor->current == NULL) continue;
+        _close_wal(*w);
+        return -1;
+    }
 
-        /* check if value is tombstone */
-        if (_is_tombstone(cursor->current->value, cursor->current->value_size)) continue;
+    return 0;
+}
+
+void _close_wal(wal_t* wal)
+{
+    /* we check if the wal is NULL */
+    if (wal == NULL) return;
 
-        /* check if ttl is set and if so if it has expired */
-        if (cursor->current->ttl != -1 && cursor->current->ttl < time(NULL)) continue;
+    /* we close the active segment, it is synced first */
+    if (wal->log != NULL) log_close(wal->log);
 
-        /* we serialize the key-value pair */
-        size_t encoded_size;
-        key_value_pair_t kvp = {cursor->current->key, cursor->current->key_size,
-                                cursor->current->value, cursor->current->value_size, -1};
-        uint8_t* serialized_buffer = NULL;
-        if (serialize_key_value_pair(&kvp, &serialized_buffer, &encoded_size,
-                                     cf->config.compressed) == -1)
-            continue;
+    /* we destroy the lock */
+    pthread_rwlock_destroy(&wal->lock);
+
+    /* we destroy the commit queue */
+    pthread_mutex_destroy(&wal->commit_lock);
+    pthread_cond_destroy(&wal->commit_cond);
+
+    /* we free the wal */
+    free(wal->path);
+    free(wal);
+
+    wal = NULL;
+}
+
+void _wal_segment_path(const wal_t* wal, uint64_t number, const char* ext, char* path,
+                       size_t path_size)
+{
+    snprintf(path, path_size, "%s%s%06llu%s", wal->path, _get_path_seperator(),
+             (unsigned long long)number, ext);
+}
+
+int _roll_wal(wal_t* wal)
+{
+    if (wal == NULL) return -1;
+
+    uint64_t number = wal->log_number + 1;
+
+    char path[PATH_MAX];
+    _wal_segment_path(wal, number, WAL_EXT, path, sizeof(path));
+
+    /* a recycled segment is renamed into place, its space is allocated already */
+    if (wal->num_recycled > 0)
+    {
+        char recycled_path[PATH_MAX];
+        _wal_segment_path(wal, wal->recycled[--wal->num_recycled], WAL_RECYCLE_EXT, recycled_path,
+                          sizeof(recycled_path));
+        rename(recycled_path, path);
+    }
+
+    log_t* log = NULL;
+    if (log_create(path, number, TIDESDB_WAL_SEGMENT_SIZE, &log) == -1) return -1;
+
+    /* writes that do not sync themselves leave the segment to the sync service */
+    log_set_sync_service(log, wal->sync_service);
+
+    /* the segment we leave is synced as it is closed */
+    int result = 0;
+    if (wal->log != NULL && log_close(wal->log) == -1) result = -1;
+
+    wal->log = log;
+    wal->log_number = number;
+
+    return result;
+}
+
+int _checkpoint_wal(wal_t* wal, uint64_t* checkpoint)
+{
+    if (wal == NULL || checkpoint == NULL) return -1;
 
-        if (serialized_buffer == NULL)
+    pthread_rwlock_wrlock(&wal->lock);
+
+    /* an empty active segment holds nothing of the rotated memtable, it can stay */
+    size_t size = 0;
+    int result = log_size(wal->log, &size);
+    if (result == 0 && size > 0) result = _roll_wal(wal);
+
+    *checkpoint = wal->log_number;
+
+    pthread_rwlock_unlock(&wal->lock);
+
+    return result;
+}
+
+int _retire_wal(wal_t* wal, uint64_t checkpoint)
+{
+    if (wal == NULL) return -1;
+
+    /* lock wal */
+    pthread_rwlock_wrlock(&wal->lock);
+
+    int result = 0;
+    for (; wal->first_number < checkpoint; wal->first_number++)
+    {
+        char path[PATH_MAX];
+        _wal_segment_path(wal, wal->first_number, WAL_EXT, path, sizeof(path));
+
+        /* a retired segment is kept for a later segment to reuse if there is room, otherwise it
+         * is removed */
+        if (wal->num_recycled < TIDESDB_WAL_MAX_RECYCLED)
         {
-            pthread_rwlock_unlock(&cf->sstables_lock);
-            skiplist_cursor_free(cursor);
-            free(sst);
-            pager_close(p);
-            remove(filename); /* remove the sstable file */
-            pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+            char recycled_path[PATH_MAX];
+            _wal_segment_path(wal, wal->first_number, WAL_RECYCLE_EXT, recycled_path,
+                              sizeof(recycled_path));
+
+            if (rename(path, recycled_path) == 0)
+            {
+                wal->recycled[wal->num_recycled++] = wal->first_number;
+                continue;
+            }
+        }
+
+        if (remove(path) == -1 && errno != ENOENT) result = -1;
+    }
+
+    /* unlock wal */
+    pthread_rwlock_unlock(&wal->lock);
+
+    return result;
+}
+
+int _replay_from_wal(wal_replay_t* replay)
+{
+    if (replay == NULL || replay->tdb == NULL || replay->cf == NULL) return -1;
+
+    column_family_t* cf = replay->cf;
+    wal_t* wal = cf->wal;
+
+    /* the replay fills the memtable with about as much as the log holds, we give it the memory
+     * up front.  the segments are preallocated so this is an upper bound, the pages of a
+     * reservation that is not used are never touched */
+    size_t wal_size = 0;
+    for (uint64_t number = wal->first_number; number < wal->log_number; number++)
+    {
+        char path[PATH_MAX];
+        _wal_segment_path(wal, number, WAL_EXT, path, sizeof(path));
+
+        struct stat segment_stat;
+        if (stat(path, &segment_stat) == 0) wal_size += (size_t)segment_stat.st_size;
+    }
+
+    if (wal_size > 0)
+        skiplist_arena_reserve(cf->memtable, wal_size < (size_t)cf->config.flush_threshold
+                                                 ? wal_size
+                                                 : (size_t)cf->config.flush_threshold);
+
+    replay->head = NULL;
+    replay->tail = NULL;
+    replay->num_chunks = 0;
+    replay->reading = true;
+    replay->entries = 0;
+    replay->bytes = 0;
+    replay->rc = 0;
+
+    if (pthread_mutex_init(&replay->lock, NULL) != 0) return -1;
+    if (pthread_cond_init(&replay->cond, NULL) != 0)
+    {
+        pthread_mutex_destroy(&replay->lock);
+        return -1;
+    }
+
+    /* the log is read and decompressed on a thread of its own whilst we fill the memtable */
+    pthread_t reader;
+    if (pthread_create(&reader, NULL, _wal_replay_reader_thread, replay) != 0)
+    {
+        pthread_cond_destroy(&replay->cond);
+        pthread_mutex_destroy(&replay->lock);
+        return -1;
+    }
+
+    /* an entry that cannot be replayed ends its segment like a torn record does */
+    uint64_t failed_segment = 0;
+    bool failed = false;
+
+    while (true)
+    {
+        pthread_mutex_lock(&replay->lock);
+
+        while (replay->head == NULL && replay->reading)
+            pthread_cond_wait(&replay->cond, &replay->lock);
+
+        wal_replay_chunk_t* chunk = replay->head;
+        if (chunk != NULL)
+        {
+            replay->head = chunk->next;
+            if (replay->head == NULL) replay->tail = NULL;
+            replay->num_chunks--;
+
+            /* the reader may be waiting for room */
+            pthread_cond_broadcast(&replay->cond);
+        }
+
+        pthread_mutex_unlock(&replay->lock);
+
+        if (chunk == NULL) break; /* the reader is done */
+
+        size_t offset = 0;
+        while (offset < chunk->size)
+        {
+            uint64_t segment;
+            uint64_t size;
+            memcpy(&segment, chunk->data + offset, sizeof(segment));
+            memcpy(&size, chunk->data + offset + sizeof(segment), sizeof(size));
+            offset += sizeof(segment) + sizeof(size);
+
+            if (!failed || segment != failed_segment)
+            {
+                if (_replay_operation(replay->tdb, cf, chunk->data + offset, size) == -1)
+                {
+                    failed = true;
+                    failed_segment = segment;
+                }
+            }
+
+            offset += size;
+        }
+
+        free(chunk->data);
+        free(chunk);
+    }
+
+    pthread_join(reader, NULL);
+
+    pthread_cond_destroy(&replay->cond);
+    pthread_mutex_destroy(&replay->lock);
+
+    return replay->rc;
+}
+
+void* _wal_replay_reader_thread(void* arg)
+{
+    wal_replay_t* replay = arg;
+    wal_t* wal = replay->cf->wal;
+    bool decompress = replay->tdb->config.compressed_wal;
+
+    wal_replay_chunk_t* chunk = NULL;
+    int rc = 0;
+
+    /* the segments before the active one were written before the wal was opened */
+    for (uint64_t number = wal->first_number; number < wal->log_number && rc == 0; number++)
+    {
+        char path[PATH_MAX];
+        _wal_segment_path(wal, number, WAL_EXT, path, sizeof(path));
+
+        /* a retirement or migration cut short may have left a gap */
+        if (access(path, F_OK) == -1) continue;
+
+        log_t* log = NULL;
+        if (log_open(path, number, &log) == -1)
+        {
+            rc = -1;
+            break;
+        }
+
+        log_reader_t* reader = NULL;
+        if (log_reader_open(log, &reader) == -1)
+        {
+            log_close(log);
+            rc = -1;
+            break;
+        }
+
+        uint8_t* op_buffer = NULL;
+        size_t op_buffer_size = 0;
+
+        /* the reader stops at the end of the segment or at a record torn by a crash, nothing is
+         * appended to the segment again so a torn tail is left in place */
+        while (log_reader_next(reader, &op_buffer, &op_buffer_size) == 0)
+        {
+            const uint8_t* entry = op_buffer;
+            size_t entry_size = op_buffer_size;
+            uint8_t* decompressed = NULL;
+
+            /* an entry that does not decompress ends the segment like a torn record */
+            if (decompress)
+            {
+                if (deserialize_decompress(op_buffer, op_buffer_size, &decompressed,
+                                           &entry_size) == -1)
+                    break;
+                entry = decompressed;
+            }
+
+            uint64_t segment = number;
+            uint64_t size = entry_size;
+            size_t needed = sizeof(segment) + sizeof(size) + entry_size;
+
+            /* a full chunk is handed over and the entry starts a new one */
+            if (chunk != NULL && chunk->size + needed > chunk->capacity)
+            {
+                _push_replay_chunk(replay, chunk);
+                chunk = NULL;
+            }
+
+            if (chunk == NULL)
+            {
+                chunk = malloc(sizeof(wal_replay_chunk_t));
+                size_t capacity =
+                    needed > TIDESDB_REPLAY_CHUNK_SIZE ? needed : TIDESDB_REPLAY_CHUNK_SIZE;
+                if (chunk != NULL) chunk->data = malloc(capacity);
+
+                if (chunk == NULL || chunk->data == NULL)
+                {
+                    free(chunk);
+                    chunk = NULL;
+                    rc = -1;
+                }
+                else
+                {
+                    chunk->size = 0;
+                    chunk->capacity = capacity;
+                    chunk->next = NULL;
+                }
+            }
+
+            if (rc == -1)
+            {
+                free(decompressed);
+                break;
+            }
+
+            memcpy(chunk->data + chunk->size, &segment, sizeof(segment));
+            memcpy(chunk->data + chunk->size + sizeof(segment), &size, sizeof(size));
+            memcpy(chunk->data + chunk->size + sizeof(segment) + sizeof(size), entry, entry_size);
+            chunk->size += needed;
+
+            free(decompressed);
+            replay->entries++;
+        }
+
+        replay->bytes += reader->end_offset;
+
+        log_reader_free(reader);
+        log_close(log);
+    }
+
+    /* what was read before a failure is still replayed */
+    if (chunk != NULL) _push_replay_chunk(replay, chunk);
+
+    pthread_mutex_lock(&replay->lock);
+
+    /* a log that could not be read fails the replay */
+    if (rc == -1) replay->rc = -1;
+    replay->reading = false;
+    pthread_cond_broadcast(&replay->cond);
+
+    pthread_mutex_unlock(&replay->lock);
+
+    return NULL;
+}
+
+void _push_replay_chunk(wal_replay_t* replay, wal_replay_chunk_t* chunk)
+{
+    pthread_mutex_lock(&replay->lock);
+
+    while (replay->num_chunks >= TIDESDB_REPLAY_MAX_CHUNKS)
+        pthread_cond_wait(&replay->cond, &replay->lock);
+
+    if (replay->tail != NULL)
+        replay->tail->next = chunk;
+    else
+        replay->head = chunk;
+    replay->tail = chunk;
+    replay->num_chunks++;
+
+    pthread_cond_broadcast(&replay->cond);
+    pthread_mutex_unlock(&replay->lock);
+}
+
+int _replay_operation(tidesdb_t* tdb, column_family_t* cf, const uint8_t* buffer,
+                      size_t buffer_size)
+{
+    /* a batch is replayed whole, anything else is a single operation */
+    uint32_t count = 0;
+    if (deserialize_batch_header(buffer, buffer_size, &count) == 0)
+        return _replay_batch(tdb, cf, buffer, buffer_size);
+
+    /* an operation is laid out like an operation of a batch followed by the column family name,
+     * we decode it in place */
+    OP_CODE op_code;
+    key_value_pair_t kv;
+    size_t encoded_size = 0;
+    if (deserialize_batch_operation(buffer, buffer_size, &op_code, &kv, &encoded_size) == -1)
+        return -1;
+
+    column_family_t* target = _replay_column_family(tdb, cf, (const char*)buffer + encoded_size,
+                                                    buffer_size - encoded_size);
+    if (target == NULL) return -1;
+
+    switch (op_code)
+    {
+        case OP_PUT:
+            skiplist_put(target->memtable, kv.key, kv.key_size, kv.value, kv.value_size, kv.ttl);
+            break;
+
+        case OP_DELETE:
+        {
+            uint32_t tombstone = TOMBSTONE;
+
+            /* add to memtable */
+            skiplist_put(target->memtable, kv.key, kv.key_size, (uint8_t*)&tombstone,
+                         sizeof(tombstone), -1);
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+int _replay_batch(tidesdb_t* tdb, column_family_t* cf, const uint8_t* buffer, size_t buffer_size)
+{
+    uint32_t count = 0;
+    if (deserialize_batch_header(buffer, buffer_size, &count) == -1) return -1;
+
+    /* we walk the operations to find the column family name that follows them */
+    const uint8_t* operations = buffer + SERIALIZE_BATCH_HEADER_SIZE;
+    size_t operations_size = 0;
+    size_t remaining = buffer_size - SERIALIZE_BATCH_HEADER_SIZE;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        OP_CODE op_code;
+        key_value_pair_t kv;
+        size_t encoded_size = 0;
+
+        if (deserialize_batch_operation(operations + operations_size,
+                                        remaining - operations_size, &op_code, &kv,
+                                        &encoded_size) == -1)
             return -1;
+
+        operations_size += encoded_size;
+    }
+
+    column_family_t* target = _replay_column_family(
+        tdb, cf, (const char*)operations + operations_size, remaining - operations_size);
+    if (target == NULL) return -1;
+
+    return _apply_batch(target->memtable, operations, operations_size, count);
+}
+
+column_family_t* _replay_column_family(tidesdb_t* tdb, column_family_t* cf, const char* name,
+                                       size_t name_size)
+{
+    if (name_size == 0 || memchr(name, '\0', name_size) == NULL) return NULL;
+
+    /* the operations of a wal are all for its own column family, the others are still being loaded
+     * alongside it and cannot be looked up until every one is */
+    if (strcmp(name, cf->config.name) == 0) return cf;
+
+    column_family_t* other = NULL;
+    if (_get_column_family(tdb, name, &other) == -1) return NULL;
+
+    return other;
+}
+
+int _migrate_legacy_wal(wal_t* wal, const char* cf_path)
+{
+    char legacy_path[PATH_MAX];
+    snprintf(legacy_path, sizeof(legacy_path), "%s%s%s", cf_path, _get_path_seperator(),
+             LEGACY_WAL_EXT);
+
+    if (access(legacy_path, F_OK) == -1) return 0; /* nothing to migrate */
+
+    /* segments next to a legacy wal are what a migration that was cut short left, we start it
+     * over */
+    for (uint64_t number = wal->first_number; number <= wal->log_number; number++)
+    {
+        char path[PATH_MAX];
+        _wal_segment_path(wal, number, WAL_EXT, path, sizeof(path));
+        remove(path);
+    }
+
+    wal->first_number = wal->log_number + 1;
+
+    pager_t* pager = NULL;
+    if (pager_open_immutable(legacy_path, &pager) == -1) return -1;
+
+    /* the operations go into a segment of their own */
+    if (_roll_wal(wal) == -1)
+    {
+        pager_close(pager);
+        return -1;
+    }
+
+    size_t pages_count = 0;
+    pager_cursor_t* pc = NULL;
+    if (pager_pages_count(pager, &pages_count) == 0 && pages_count > 0 &&
+        pager_cursor_init(pager, &pc) == 0)
+    {
+        do
+        {
+            unsigned int pg_num;
+            if (pager_cursor_get(pc, &pg_num) == -1) break;
+
+            uint8_t* op_buffer = NULL;
+            size_t op_buffer_size = 0;
+
+            if (pager_read(pager, pg_num, &op_buffer, &op_buffer_size) == -1)
+            {
+                free(op_buffer);
+                break;
+            }
+
+            /* the serialized operation is copied over as is */
+            int result = log_append(wal->log, op_buffer, op_buffer_size, false);
+            free(op_buffer);
+
+            if (result == -1)
+            {
+                pager_cursor_free(pc);
+                pager_close(pager);
+                return -1;
+            }
+        } while (pager_cursor_next(pc) == 0);
+
+        pager_cursor_free(pc);
+    }
+
+    pager_close(pager);
+
+    /* the legacy file goes once its operations are durable in the segment */
+    if (log_sync(wal->log) == -1) return -1;
+
+    return remove(legacy_path) == 0 ? 0 : -1;
+}
+
+int _compare_sstables(const void* a, const void* b)
+{
+    if (a == NULL || b == NULL) return 0;
+
+    /* qsort hands us pointers to the elements of an sstable_t* array */
+    sstable_t* s1 = *(sstable_t**)a;
+    sstable_t* s2 = *(sstable_t**)b;
+
+    /* the deepest level comes first so reads walking the sstables from the end see level 0
+     * before the levels its pairs are compacted into */
+    if (s1->level != s2->level) return s1->level > s2->level ? -1 : 1;
+
+    /* the sstables of a deeper level do not overlap, we sort them by their smallest key so a
+     * level can be binary searched */
+    if (s1->level > 0)
+    {
+        if (s1->min_key == NULL || s2->min_key == NULL)
+            return (s1->min_key != NULL) - (s2->min_key != NULL);
+
+        return sstable_compare_keys(s1->min_key, s1->min_key_size, s2->min_key, s2->min_key_size);
+    }
+
+    /* level 0 is sorted oldest first.  flushes get increasing sequence numbers, the file number
+     * breaks a tie so the order never depends on how qsort leaves equal sstables */
+    if (s1->sequence != s2->sequence) return s1->sequence < s2->sequence ? -1 : 1;
+    if (s1->file_number != s2->file_number) return s1->file_number < s2->file_number ? -1 : 1;
+
+    return 0;
+}
+
+int _compare_scanned_sstables(const void* a, const void* b)
+{
+    if (a == NULL || b == NULL) return 0;
+
+    sstable_t* s1 = *(sstable_t**)a;
+    sstable_t* s2 = *(sstable_t**)b;
+
+    /* level 0 sstables written before sequence numbers (legacy and version 1) all carry 0, the
+     * last modified time is all there is to order them by.  we only get here once, when a column
+     * family without a manifest is scanned */
+    if (s1->level == 0 && s2->level == 0 && s1->sequence == s2->sequence)
+    {
+        time_t last_modified_s1 = get_last_modified(s1->filename);
+        time_t last_modified_s2 = get_last_modified(s2->filename);
+        if (last_modified_s1 != last_modified_s2)
+            return last_modified_s1 < last_modified_s2 ? -1 : 1;
+    }
+
+    return _compare_sstables(a, b);
+}
+
+uint64_t _new_sstable_path(column_family_t* cf, char* path, size_t path_size)
+{
+    /* numbers are never handed out twice, flushes and compactions can ask at the same time */
+    uint64_t file_number = atomic_fetch_add(&cf->next_file_number, 1);
+
+    snprintf(path, path_size, "%s%ssstable_%lu%s", cf->path, _get_path_seperator(), file_number,
+             SSTABLE_EXT);
+
+    return file_number;
+}
+
+int _parse_sstable_file_number(const char* name, uint64_t* file_number)
+{
+    unsigned long number = 0;
+    char ext[16];
+
+    if (sscanf(name, "sstable_%lu%15s", &number, ext) != 2 || strcmp(ext, SSTABLE_EXT) != 0)
+        return -1;
+
+    *file_number = (uint64_t)number;
+    return 0;
+}
+
+int _flush_memtable(tidesdb_t* tdb, column_family_t* cf, tidesdb_memtable_t* memtable,
+                    uint64_t wal_checkpoint)
+{
+    /* we check if the tidesdb is NULL */
+    if (tdb == NULL) return -1;
+
+    /* we check if the column family is NULL */
+    if (cf == NULL) return -1;
+
+    /* we check if the memtable is NULL */
+    if (memtable == NULL) return -1;
+
+    char filename[1024];
+
+    /* we create the filename for the sstable */
+    uint64_t file_number = _new_sstable_path(cf, filename, sizeof(filename));
+
+    /* we build the sstable without holding any lock, readers and compactions carry on.
+     * there is a single flush thread so the sequence number is ours until we publish */
+    tidesdb_version_t* version = _pin_version(cf);
+    bool has_sstables = version->num_sstables > 0;
+
+    /* an older memtable whose flush failed still holds pairs our tombstones hide */
+    if (version->num_memtables > 0 && version->memtables[0] != memtable) has_sstables = true;
+    _release_version(version);
+
+    /* we open a writer for the sstable.
+     * the writer packs the key-value pairs into data blocks and writes the filter block, the
+     * index block, the meta block and the footer when finished.  every flush gets the next
+     * sequence number so newer sstables always sort after older ones */
+    sstable_writer_t* writer = NULL;
+    if (sstable_writer_open(filename, cf->config.block_size, cf->config.compressed,
+                            cf->config.bloom_bits_per_key, cf->sstable_sequence, file_number, 0,
+                            &writer) == -1)
+        return -1;
+
+    /* create new cursor for the provided memtable */
+    skiplist_cursor_t* cursor = skiplist_cursor_init(memtable->skiplist);
+    if (cursor == NULL)
+    {
+        sstable_writer_abandon(writer); /* remove the sstable file */
+        return -1;
+    }
+
+    /* we iterate over the memtable and add the key-value pairs to the sstable in order */
+    do
+    {
+        if (cursor->current == NULL) continue;
+
+        /* tombstones and expired pairs still hide older versions in the sstables, they are only
+         * left out when there are no sstables.  compaction drops them at the bottommost level */
+        if (!has_sstables)
+        {
+            /* check if value is tombstone */
+            if (_is_tombstone(cursor->current->value, cursor->current->value_size)) continue;
+
+            /* check if ttl is set and if so if it has expired */
+            if (cursor->current->ttl != -1 && cursor->current->ttl < time(NULL)) continue;
         }
 
-        /* we write the key-value pair to the sstable */
-        if (pager_write(p, serialized_buffer, encoded_size, &pg_num) == -1)
+        if (sstable_writer_add(writer, cursor->current->key, cursor->current->key_size,
+                               cursor->current->value, cursor->current->value_size,
+                               cursor->current->ttl) == -1)
         {
-            free(serialized_buffer);
-            continue;
+            skiplist_cursor_free(cursor);
+            sstable_writer_abandon(writer); /* remove the sstable file */
+            return -1;
         }
 
-        /* we free the serialized key-value pair */
-        free(serialized_buffer);
+        /* we count the tombstones for the background compaction triggers */
+        if (_is_tombstone(cursor->current->value, cursor->current->value_size))
+            writer->num_tombstones++;
     } while (skiplist_cursor_next(cursor) != -1);
 
     /* we free the cursor */
     skiplist_cursor_free(cursor);
 
-    /* we now add the sstable to the column family */
-    sstable_t** new_sstables = realloc(cf->sstables, (cf->num_sstables + 1) * sizeof(sstable_t*));
-    if (new_sstables == NULL)
+    sstable_t* sst = NULL;
+
+    if (writer->num_entries == 0)
     {
-        free(sst);
-        pager_close(p);
-        pthread_rwlock_unlock(&cf->sstables_lock);
-        pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+        /* nothing left to flush, everything was deleted or expired */
+        sstable_writer_abandon(writer);
+    }
+    else if (sstable_writer_finish(writer, &sst) == -1)
+    {
+        sstable_writer_abandon(writer); /* remove the sstable file */
         return -1;
     }
+    else
+    {
+        /* the reader the writer leaves open goes into the table cache */
+        sstable_set_cache(sst, cf->table_cache);
+    }
 
-    cf->sstables = new_sstables;
-    cf->sstables[cf->num_sstables] = sst;
-    cf->num_sstables++;
-    pthread_rwlock_unlock(&cf->sstables_lock);
+    /* we publish a version with the new sstable in level 0 in place of the memtable, readers
+     * find the pairs in one or the other.  compactions and rotations publish under the same lock
+     * so none loses the others' changes */
+    if (pthread_rwlock_wrlock(&cf->compaction_or_flush_lock) != 0)
+    {
+        if (sst != NULL)
+        {
+            sstable_unref(sst);
+            remove(filename);
+        }
+        return -1;
+    }
 
-    skiplist_clear(memtable);
-    skiplist_destroy(memtable);
+    tidesdb_version_t* current = cf->version;
+    version = NULL;
 
-    /* truncate the wal at the entries provided checkpoint */
-    if (_truncate_wal(cf->wal, wal_checkpoint) == -1) return -1;
+    sstable_t** sstables = malloc((current->num_sstables + 1) * sizeof(sstable_t*));
+    tidesdb_memtable_t** memtables = malloc(current->num_memtables * sizeof(tidesdb_memtable_t*));
+    if (sstables != NULL && memtables != NULL)
+    {
+        int num_sstables = current->num_sstables;
+        if (num_sstables > 0)
+            memcpy(sstables, current->sstables, num_sstables * sizeof(sstable_t*));
+        if (sst != NULL) sstables[num_sstables++] = sst;
+
+        /* we keep every memtable but the flushed one */
+        int num_memtables = 0;
+        for (int i = 0; i < current->num_memtables; i++)
+            if (current->memtables[i] != memtable)
+                memtables[num_memtables++] = current->memtables[i];
+
+        version = _new_version(sstables, num_sstables, memtables, num_memtables);
+    }
+
+    free(sstables);
+    free(memtables);
+
+    /* the sstable is recorded in the manifest before readers can see it */
+    if (version != NULL && sst != NULL)
+    {
+        manifest_table_t table;
+        _manifest_table(sst, &table);
+
+        /* the counters go with it, so neither is handed out again after a reopen */
+        manifest_edit_t edit = {&table, 1, NULL, 0, atomic_load(&cf->next_file_number),
+                                cf->sstable_sequence + 1};
+        if (manifest_append(cf->manifest, &edit) == -1)
+        {
+            _release_version(version);
+            version = NULL;
+        }
+    }
+
+    if (version == NULL)
+    {
+        pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+        if (sst != NULL)
+        {
+            sstable_unref(sst);
+            remove(filename); /* remove the sstable file */
+        }
+        return -1;
+    }
+
+    /* the wal segments covered by the memtable are not needed anymore, unless a memtable still
+     * in the version has pairs in them.  that is an older memtable whose flush failed */
+    uint64_t retire = wal_checkpoint;
+    for (int i = 0; i < version->num_memtables; i++)
+        if (version->memtables[i]->wal_first < retire) retire = version->memtables[i]->wal_first;
+
+    _publish_version(cf, version);
+    if (sst != NULL) cf->sstable_sequence++;
 
     pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
 
+    if (sst != NULL) sstable_unref(sst); /* the version holds the sstable now */
+
+    if (_retire_wal(cf->wal, retire) == -1) return -1;
+
+    /* a new level 0 sstable may fire a background compaction trigger */
+    pthread_mutex_lock(&tdb->compaction_lock);
+    pthread_cond_broadcast(&tdb->compaction_cond);
+    pthread_mutex_unlock(&tdb->compaction_lock);
+
     return 0;
 }
 
@@ -2834,6 +4308,9 @@ void* _flush_memtable_thread(void* arg)
     /* we set tidesdb */
     tidesdb_t* tdb = arg;
 
+    /* the milliseconds we wait before retrying a failed flush */
+    long backoff = TIDESDB_FLUSH_RETRY_BACKOFF;
+
     while (true)
     {
         pthread_mutex_lock(&tdb->flush_lock);
@@ -2857,25 +4334,74 @@ void* _flush_memtable_thread(void* arg)
             continue;
         }
 
+        /* a writer stalled on a full queue can rotate again */
+        pthread_cond_broadcast(&tdb->flush_stall_cond);
+
         pthread_mutex_unlock(&tdb->flush_lock);
 
         /* flush the memtable to disk sstable */
-        _flush_memtable(tdb, qe->cf, qe->memtable, (int)qe->wal_checkpoint);
+        if (_flush_memtable(tdb, qe->cf, qe->memtable, qe->wal_checkpoint) == -1)
+        {
+            /* the memtable stays in the version and its wal segments are kept.  it goes back to
+             * the front of the queue so nothing newer is flushed before it, and we retry after a
+             * backoff */
+            if (_requeue_flush(tdb, qe, &backoff) == 0) continue;
+        }
+        else
+        {
+            backoff = TIDESDB_FLUSH_RETRY_BACKOFF;
+        }
+
+        _unref_memtable(qe->memtable);
         free(qe);
     }
 
-    /* escalate what's left in queue */
+    /* escalate what's left in queue, a memtable that fails to flush now is replayed from its wal
+     * segments on the next open */
     while (tdb->flush_queue->size > 0)
     {
-        queue_entry_t* qe = queue_dequeue(tdb->flush_queue);
-        if (qe != NULL)
-        {
-            _flush_memtable(tdb, qe->cf, qe->memtable, (int)qe->wal_checkpoint);
-            free(qe);
-        }
+        queue_entry_t* qe = queue_dequeue(tdb->flush_queue);
+        if (qe != NULL)
+        {
+            _flush_memtable(tdb, qe->cf, qe->memtable, qe->wal_checkpoint);
+            _unref_memtable(qe->memtable);
+            free(qe);
+        }
+    }
+
+    return NULL;
+}
+
+int _requeue_flush(tidesdb_t* tdb, queue_entry_t* qe, long* backoff)
+{
+    pthread_mutex_lock(&tdb->flush_lock);
+
+    if (tdb->stop_flush_thread || queue_enqueue_front(tdb->flush_queue, qe) == -1)
+    {
+        pthread_mutex_unlock(&tdb->flush_lock);
+        return -1;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += *backoff / 1000;
+    deadline.tv_nsec += (*backoff % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
     }
 
-    return NULL;
+    /* rotations signal the flush thread too, we sleep out the backoff unless we are stopped */
+    while (!tdb->stop_flush_thread &&
+           pthread_cond_timedwait(&tdb->flush_cond, &tdb->flush_lock, &deadline) != ETIMEDOUT)
+        ;
+
+    pthread_mutex_unlock(&tdb->flush_lock);
+
+    *backoff = *backoff * 2 < TIDESDB_FLUSH_RETRY_MAX ? *backoff * 2 : TIDESDB_FLUSH_RETRY_MAX;
+
+    return 0;
 }
 
 int _is_tombstone(const uint8_t* value, size_t value_size)
@@ -2883,49 +4409,49 @@ int _is_tombstone(const uint8_t* value, size_t value_size)
     return value_size == 4 && *(uint32_t*)value == TOMBSTONE;
 }
 
-void _free_column_families(tidesdb_t* tdb)
+void _free_column_family(column_family_t* cf)
 {
-    /* we check if we have column families */
-    if (tdb->num_column_families > 0)
-    {
-        /* we iterate over the column families and free them */
-        for (int i = 0; i < tdb->num_column_families; i++)
-        {
-            if (tdb->column_families[i].config.name != NULL)
-                free(tdb->column_families[i].config.name);
-
-            if (tdb->column_families[i].path != NULL) free(tdb->column_families[i].path);
+    if (cf->config.name != NULL) free(cf->config.name);
 
-            if (tdb->column_families[i].memtable != NULL)
-            {
-                skiplist_destroy(tdb->column_families[i].memtable);
-                tdb->column_families[i].memtable = NULL;
-            }
+    if (cf->path != NULL) free(cf->path);
 
-            id_gen_destroy(tdb->column_families[i].id_gen);
+    pthread_rwlock_destroy(&cf->sstables_lock);
+    pthread_rwlock_destroy(&cf->memtable_lock);
 
-            pthread_rwlock_destroy(&tdb->column_families[i].sstables_lock);
+    /* we free the compaction_or_flush_lock */
+    pthread_rwlock_destroy(&cf->compaction_or_flush_lock);
 
-            /* we free the compaction_or_flush_lock */
-            pthread_rwlock_destroy(&tdb->column_families[i].compaction_or_flush_lock);
+    /* we release the memtables and sstables */
+    if (cf->version != NULL)
+    {
+        _release_version(cf->version);
+        cf->version = NULL;
+        cf->memtable = NULL;
+    }
 
-            /* we free the sstables */
-            if (tdb->column_families[i].sstables != NULL)
-            {
-                for (int j = 0; j < tdb->column_families[i].num_sstables; j++)
-                    _free_sstable(tdb->column_families[i].sstables[j]);
+    /* we close the wal */
+    if (cf->wal != NULL)
+    {
+        _close_wal(cf->wal);
+        cf->wal = NULL;
+    }
 
-                free(tdb->column_families[i].sstables);
-                tdb->column_families[i].sstables = NULL;
-            }
+    /* we close the manifest */
+    if (cf->manifest != NULL)
+    {
+        manifest_close(cf->manifest);
+        cf->manifest = NULL;
+    }
+}
 
-            /* we close the wal */
-            if (tdb->column_families[i].wal != NULL)
-            {
-                _close_wal(tdb->column_families[i].wal);
-                tdb->column_families[i].wal = NULL;
-            }
-        }
+void _free_column_families(tidesdb_t* tdb)
+{
+    /* we check if we have column families */
+    if (tdb->num_column_families > 0)
+    {
+        /* we iterate over the column families and free them */
+        for (int i = 0; i < tdb->num_column_families; i++)
+            _free_column_family(&tdb->column_families[i]);
 
         /* we free the column families */
         free(tdb->column_families);
@@ -2937,16 +4463,11 @@ tidesdb_err_t* tidesdb_close(tidesdb_t* tdb)
 {
     if (tdb == NULL) return tidesdb_err_new(1002, "TidesDB is NULL");
 
-    /* we lock the column families lock */
-    if (pthread_rwlock_wrlock(&tdb->column_families_lock) != 0)
-        return tidesdb_err_new(1022, "Failed to lock column families lock");
-
-    _free_column_families(tdb);
-
-    /* we unlock the column families lock */
-    pthread_rwlock_unlock(&tdb->column_families_lock);
+    /* we stop the background compaction threads, they finish the job they are running */
+    _stop_compaction_threads(tdb);
 
-    /* we stop the flush thread */
+    /* we stop the flush thread next, it flushes what is left in the queue
+     * and needs the column families to do so */
     tdb->stop_flush_thread = true;
 
     /* we get flush lock */
@@ -2957,6 +4478,9 @@ tidesdb_err_t* tidesdb_close(tidesdb_t* tdb)
     if (pthread_cond_signal(&tdb->flush_cond) != 0)
         return tidesdb_err_new(1040, "Failed to signal flush condition");
 
+    /* writers stalled on the flush queue stop waiting */
+    pthread_cond_broadcast(&tdb->flush_stall_cond);
+
     /* we unlock the flush lock */
     if (pthread_mutex_unlock(&tdb->flush_lock) != 0)
         return tidesdb_err_new(1005, "Failed to unlock flush lock");
@@ -2965,6 +4489,21 @@ tidesdb_err_t* tidesdb_close(tidesdb_t* tdb)
     if (pthread_join(tdb->flush_thread, NULL) != 0)
         return tidesdb_err_new(1006, "Failed to join flush thread");
 
+    /* we lock the column families lock */
+    if (pthread_rwlock_wrlock(&tdb->column_families_lock) != 0)
+        return tidesdb_err_new(1022, "Failed to lock column families lock");
+
+    _free_column_families(tdb);
+
+    /* we unlock the column families lock */
+    pthread_rwlock_unlock(&tdb->column_families_lock);
+
+    /* every sstable is closed with its column family, the table cache is empty now */
+    sstable_cache_close(tdb->table_cache);
+
+    /* the wals were synced as they were closed, the sync service has nothing left to sync */
+    sync_service_close(tdb->sync_service);
+
     /* now we clean up flush lock and condition */
     if (pthread_mutex_destroy(&tdb->flush_lock) != 0)
         return tidesdb_err_new(1007, "Failed to destroy flush lock");
@@ -2972,9 +4511,15 @@ tidesdb_err_t* tidesdb_close(tidesdb_t* tdb)
     if (pthread_cond_destroy(&tdb->flush_cond) != 0)
         return tidesdb_err_new(1043, "Failed to destroy flush condition");
 
+    pthread_cond_destroy(&tdb->flush_stall_cond);
+
     /* we destroy the flush queue */
     queue_destroy(tdb->flush_queue);
 
+    /* we clean up the compaction lock and condition */
+    pthread_mutex_destroy(&tdb->compaction_lock);
+    pthread_cond_destroy(&tdb->compaction_cond);
+
     /* we destroy the column families lock */
     if (pthread_rwlock_destroy(&tdb->column_families_lock) != 0)
         return tidesdb_err_new(1044, "Failed to destroy column families lock");
@@ -2992,6 +4537,224 @@ int _load_sstables(column_family_t* cf)
     /* we check if cf is NULL */
     if (cf == NULL) return -1;
 
+    sstable_t** sstables = NULL;
+    int num_sstables = 0;
+
+    if (manifest_exists(cf->path))
+    {
+        /* the manifest lists the live sstables, the directory is not scanned */
+        if (manifest_open(cf->path, &cf->manifest) == -1) return -1;
+        if (_open_manifest_sstables(cf, &sstables, &num_sstables) == -1) return -1;
+    }
+    else
+    {
+        /* a column family written before the manifest has its sstables found once */
+        if (_scan_sstables(cf, &sstables, &num_sstables) == -1) return -1;
+
+        /* they are numbered in the order they have always been sorted in, so level 0 keeps its
+         * order without the modification times from now on */
+        if (num_sstables > 1)
+            qsort(sstables, num_sstables, sizeof(sstable_t*), _compare_scanned_sstables);
+        for (int i = 0; i < num_sstables; i++) sstables[i]->sequence = (uint64_t)i + 1;
+
+        /* new files are numbered past the names the old id generator handed out */
+        for (int i = 0; i < num_sstables; i++)
+        {
+            manifest_table_t table;
+            _manifest_table(sstables[i], &table);
+
+            uint64_t file_number = 0;
+            if (_parse_sstable_file_number(table.name, &file_number) == 0 &&
+                file_number >= atomic_load(&cf->next_file_number))
+                atomic_store(&cf->next_file_number, file_number + 1);
+        }
+
+        manifest_table_t* tables = malloc((num_sstables ? num_sstables : 1) *
+                                          sizeof(manifest_table_t));
+        if (tables != NULL)
+            for (int i = 0; i < num_sstables; i++) _manifest_table(sstables[i], &tables[i]);
+
+        manifest_edit_t edit = {tables, (uint32_t)num_sstables, NULL, 0,
+                                atomic_load(&cf->next_file_number), (uint64_t)num_sstables + 1};
+        if (tables == NULL || manifest_open(cf->path, &cf->manifest) == -1 ||
+            (num_sstables > 0 && manifest_append(cf->manifest, &edit) == -1))
+        {
+            free(tables);
+            for (int i = 0; i < num_sstables; i++) sstable_unref(sstables[i]);
+            free(sstables);
+            return -1;
+        }
+
+        free(tables);
+    }
+
+    /* new flushes must sort after every sstable we already have and new files must not take the
+     * name of one, the manifest remembers the counters past sstables that are gone */
+    if (cf->manifest->next_sequence > cf->sstable_sequence)
+        cf->sstable_sequence = cf->manifest->next_sequence;
+    if (cf->manifest->next_file_number > atomic_load(&cf->next_file_number))
+        atomic_store(&cf->next_file_number, cf->manifest->next_file_number);
+
+    for (int i = 0; i < num_sstables; i++)
+    {
+        if (sstables[i]->sequence >= cf->sstable_sequence)
+            cf->sstable_sequence = sstables[i]->sequence + 1;
+        if (sstables[i]->file_number >= atomic_load(&cf->next_file_number))
+            atomic_store(&cf->next_file_number, sstables[i]->file_number + 1);
+    }
+
+    if (num_sstables == 0)
+    {
+        free(sstables);
+        return 0;
+    }
+
+    /* the sstables are not in a version yet, so their levels can still change */
+    if (_demote_overlapping_levels(cf, sstables, num_sstables) == -1)
+    {
+        for (int i = 0; i < num_sstables; i++) sstable_unref(sstables[i]);
+        free(sstables);
+        return -1;
+    }
+
+    /* the loaded sstables become the current version, it holds the only references to them */
+    tidesdb_version_t* version = _new_version(sstables, num_sstables, cf->version->memtables,
+                                              cf->version->num_memtables);
+    for (int i = 0; i < num_sstables; i++) sstable_unref(sstables[i]);
+    free(sstables);
+
+    if (version == NULL) return -1;
+
+    _publish_version(cf, version);
+
+    return 0;
+}
+
+int _demote_overlapping_levels(column_family_t* cf, sstable_t** sstables, int num_sstables)
+{
+    if (num_sstables > 1)
+        qsort(sstables, num_sstables, sizeof(sstable_t*), _compare_sstables);
+
+    /* a level deeper than 0 must not overlap itself.  a column family written before the
+     * manifest can have one that does if a compaction was interrupted before its inputs were
+     * removed, we put such a level back into level 0 where the sequence numbers order its
+     * sstables */
+    bool demote[TIDESDB_NUM_LEVELS] = {false};
+    uint32_t num_demoted = 0;
+    for (int i = 1; i < num_sstables; i++)
+    {
+        sstable_t* prev = sstables[i - 1];
+        sstable_t* sst = sstables[i];
+        if (sst->level == 0 || sst->level != prev->level || demote[sst->level]) continue;
+
+        if (prev->max_key == NULL || sst->min_key == NULL ||
+            sstable_compare_keys(prev->max_key, prev->max_key_size, sst->min_key,
+                                 sst->min_key_size) >= 0)
+        {
+            for (int j = 0; j < num_sstables; j++)
+                if (sstables[j]->level == sst->level) num_demoted++;
+
+            demote[sst->level] = true;
+        }
+    }
+
+    if (num_demoted == 0) return 0;
+
+    /* the manifest moves the sstables with an edit that removes them and adds them back at level
+     * 0, so the demotion is done once and not again on every open */
+    manifest_table_t* added = malloc(num_demoted * sizeof(manifest_table_t));
+    char** removed = malloc(num_demoted * sizeof(char*));
+    if (added == NULL || removed == NULL)
+    {
+        free(added);
+        free(removed);
+        return -1;
+    }
+
+    uint32_t n = 0;
+    for (int i = 0; i < num_sstables; i++)
+    {
+        if (!demote[sstables[i]->level]) continue;
+
+        _manifest_table(sstables[i], &added[n]);
+        added[n].level = 0;
+        removed[n] = added[n].name;
+        n++;
+    }
+
+    manifest_edit_t edit = {.added = added,
+                            .num_added = num_demoted,
+                            .removed = removed,
+                            .num_removed = num_demoted};
+
+    int rc = manifest_append(cf->manifest, &edit);
+
+    free(added);
+    free(removed);
+
+    if (rc == -1) return -1;
+
+    for (int i = 0; i < num_sstables; i++)
+        if (demote[sstables[i]->level]) sstables[i]->level = 0;
+
+    return 0;
+}
+
+int _open_manifest_sstables(column_family_t* cf, sstable_t*** sstables, int* num_sstables)
+{
+    manifest_t* manifest = cf->manifest;
+
+    *sstables = malloc((manifest->num_tables ? manifest->num_tables : 1) * sizeof(sstable_t*));
+    if (*sstables == NULL) return -1;
+
+    *num_sstables = 0;
+
+    for (uint32_t i = 0; i < manifest->num_tables; i++)
+    {
+        manifest_table_t* table = &manifest->tables[i];
+
+        char sstable_path[PATH_MAX];
+        snprintf(sstable_path, sizeof(sstable_path), "%s%s%s", cf->path, _get_path_seperator(),
+                 table->name);
+
+        /* the manifest describes the sstable, we leave its file be until it is read from */
+        sstable_t* sst = NULL;
+        if (sstable_open_lazy(sstable_path, cf->config.compressed, cf->table_cache, &sst) == -1)
+        {
+            for (int j = 0; j < *num_sstables; j++) sstable_unref((*sstables)[j]);
+            free(*sstables);
+            *sstables = NULL;
+            return -1;
+        }
+
+        /* the manifest is the record of where the sstable belongs */
+        sst->level = table->level < TIDESDB_NUM_LEVELS ? table->level : 0;
+        sst->sequence = table->sequence;
+        sst->file_number = table->file_number;
+        sst->num_entries = table->num_entries;
+        sst->size = table->size;
+        sst->num_tombstones = table->num_tombstones;
+        sst->num_ttl = table->num_ttl;
+        sst->min_ttl = table->min_ttl;
+        sst->max_ttl = table->max_ttl;
+
+        (*sstables)[(*num_sstables)++] = sst;
+
+        if (sstable_set_key_range(sst, table->min_key, table->min_key_size, table->max_key,
+                                  table->max_key_size) == -1)
+        {
+            for (int j = 0; j < *num_sstables; j++) sstable_unref((*sstables)[j]);
+            free(*sstables);
+            *sstables = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int _scan_sstables(column_family_t* cf, sstable_t*** sstables, int* num_sstables)
+{
     /* we open the column family directory */
     DIR* cf_dir = opendir(cf->path);
     if (cf_dir == NULL)
@@ -3000,6 +4763,8 @@ int _load_sstables(column_family_t* cf)
     }
 
     struct dirent* entry;
+    *sstables = NULL;
+    *num_sstables = 0;
 
     /* we iterate over the column family directory */
     while ((entry = readdir(cf_dir)) != NULL)
@@ -3015,67 +4780,304 @@ int _load_sstables(column_family_t* cf)
         snprintf(sstable_path, sizeof(sstable_path), "%s%s%s", cf->path, _get_path_seperator(),
                  entry->d_name);
 
-        /* we open the sstable */
-        pager_t* sstable_pager = NULL;
-
-        if (pager_open(sstable_path, &sstable_pager) == -1)
+        /* we open the sstable, this reads the footer and the sparse index.
+         * sstables written before the block format have no footer and are opened as legacy */
+        sstable_t* sst = NULL;
+        if (sstable_open(sstable_path, cf->config.compressed, &sst) == -1)
         {
             /* free up resources */
+            for (int i = 0; i < *num_sstables; i++) sstable_unref((*sstables)[i]);
+            free(*sstables);
+            *sstables = NULL;
             closedir(cf_dir);
 
             return -1;
         }
 
-        /* we create/alloc the sstable struct */
-        sstable_t* sst = malloc(sizeof(sstable_t));
-        if (sst == NULL) return -1;
+        /* we don't know levels past the last one, their sstables go back into level 0 */
+        if (sst->level >= TIDESDB_NUM_LEVELS) sst->level = 0;
 
-        /* we set the pager */
-        sst->pager = sstable_pager;
+        /* its reader stays open until the table cache needs the room */
+        sstable_set_cache(sst, cf->table_cache);
 
-        /* check if sstables is NULL */
-        if (cf->sstables == NULL)
+        /* we add the sstable to the ones we have loaded */
+        sstable_t** temp_sstables = realloc(*sstables, sizeof(sstable_t*) * (*num_sstables + 1));
+        if (temp_sstables == NULL)
         {
-            cf->sstables = malloc(sizeof(sstable_t));
-            if (cf->sstables == NULL) return -1;
+            sstable_close(sst);
+            for (int i = 0; i < *num_sstables; i++) sstable_unref((*sstables)[i]);
+            free(*sstables);
+            *sstables = NULL;
+            closedir(cf_dir);
+            return -1;
         }
-        else
+
+        *sstables = temp_sstables;
+        (*sstables)[*num_sstables] = sst;
+
+        /* we increment the number of sstables */
+        (*num_sstables)++;
+    }
+
+    /* we free up resources */
+    closedir(cf_dir);
+
+    return 0;
+}
+
+void _manifest_table(sstable_t* sst, manifest_table_t* table)
+{
+    /* the manifest records the file name, the sstables live in the column family directory */
+    const char* name = strrchr(sst->filename, _get_path_seperator()[0]);
+
+    table->name = (char*)(name != NULL ? name + 1 : sst->filename);
+    table->level = sst->level;
+    table->sequence = sst->sequence;
+    table->file_number = sst->file_number;
+    table->num_entries = sst->num_entries;
+    table->size = sstable_size(sst);
+    table->num_tombstones = sst->num_tombstones;
+    table->num_ttl = sst->num_ttl;
+    table->min_ttl = sst->min_ttl;
+    table->max_ttl = sst->max_ttl;
+    table->min_key = sst->min_key;
+    table->min_key_size = sst->min_key_size;
+    table->max_key = sst->max_key;
+    table->max_key_size = sst->max_key_size;
+}
+
+int _sort_sstables(tidesdb_version_t* version)
+{
+    /* we check if the version is NULL */
+    if (version == NULL) return -1;
+
+    if (version->num_sstables > 1)
+        qsort(version->sstables, version->num_sstables, sizeof(sstable_t*), _compare_sstables);
+
+    /* we recount the sstables in each level */
+    memset(version->level_counts, 0, sizeof(version->level_counts));
+    for (int i = 0; i < version->num_sstables; i++)
+        version->level_counts[version->sstables[i]->level]++;
+
+    return 0;
+}
+
+tidesdb_version_t* _new_version(sstable_t** sstables, int num_sstables,
+                                tidesdb_memtable_t** memtables, int num_memtables)
+{
+    tidesdb_version_t* version = calloc(1, sizeof(tidesdb_version_t));
+    if (version == NULL) return NULL;
+
+    if (num_memtables > 0)
+    {
+        version->memtables = malloc(num_memtables * sizeof(tidesdb_memtable_t*));
+        if (version->memtables == NULL)
         {
-            /* we add the sstable to the column family */
-            sstable_t** temp_sstables =
-                realloc(cf->sstables, sizeof(sstable_t) * (cf->num_sstables + 1));
-            if (temp_sstables == NULL) return -1;
+            free(version);
+            return NULL;
+        }
 
-            cf->sstables = temp_sstables;
+        memcpy(version->memtables, memtables, num_memtables * sizeof(tidesdb_memtable_t*));
+        version->num_memtables = num_memtables;
+    }
+
+    if (num_sstables > 0)
+    {
+        version->sstables = malloc(num_sstables * sizeof(sstable_t*));
+        if (version->sstables == NULL)
+        {
+            free(version->memtables);
+            free(version);
+            return NULL;
         }
 
-        cf->sstables[cf->num_sstables] = sst;
+        memcpy(version->sstables, sstables, num_sstables * sizeof(sstable_t*));
+        version->num_sstables = num_sstables;
 
-        /* we increment the number of sstables */
-        cf->num_sstables++;
+        for (int i = 0; i < num_sstables; i++) sstable_ref(sstables[i]);
+    }
 
-        /* we free up resources */
-        closedir(cf_dir);
+    for (int i = 0; i < num_memtables; i++) _ref_memtable(memtables[i]);
 
-        return 0;
+    atomic_init(&version->refs, 1);
+
+    _sort_sstables(version);
+
+    return version;
+}
+
+tidesdb_version_t* _pin_version(column_family_t* cf)
+{
+    /* the lock is only held to read the pointer and take the reference, a version being
+     * published waits at most for that */
+    pthread_rwlock_rdlock(&cf->sstables_lock);
+
+    tidesdb_version_t* version = cf->version;
+    atomic_fetch_add(&version->refs, 1);
+
+    pthread_rwlock_unlock(&cf->sstables_lock);
+
+    return version;
+}
+
+void _release_version(tidesdb_version_t* version)
+{
+    if (version == NULL || atomic_fetch_sub(&version->refs, 1) != 1) return;
+
+    /* nobody reads the version anymore, sstables no other version holds are closed here and
+     * removed if a compaction replaced them.  flushed memtables are destroyed the same way */
+    for (int i = 0; i < version->num_sstables; i++) sstable_unref(version->sstables[i]);
+    for (int i = 0; i < version->num_memtables; i++) _unref_memtable(version->memtables[i]);
+
+    free(version->sstables);
+    free(version->memtables);
+    free(version);
+}
+
+void _publish_version(column_family_t* cf, tidesdb_version_t* version)
+{
+    pthread_rwlock_wrlock(&cf->sstables_lock);
+
+    tidesdb_version_t* old = cf->version;
+    cf->version = version;
+
+    pthread_rwlock_unlock(&cf->sstables_lock);
+
+    /* readers that pinned the old version keep it until they are done */
+    _release_version(old);
+}
+
+tidesdb_memtable_t* _new_memtable(column_family_t* cf)
+{
+    tidesdb_memtable_t* memtable = malloc(sizeof(tidesdb_memtable_t));
+    if (memtable == NULL) return NULL;
+
+    /* a concurrent memtable takes puts from many writers at once */
+    memtable->skiplist = cf->config.concurrent_memtable
+                             ? new_concurrent_skiplist(cf->config.max_level, cf->config.probability)
+                             : new_skiplist(cf->config.max_level, cf->config.probability);
+    if (memtable->skiplist == NULL)
+    {
+        free(memtable);
+        return NULL;
     }
 
-    return -1;
+    atomic_init(&memtable->refs, 1);
+
+    /* until it is rotated out behind a checkpoint, every segment can hold its pairs */
+    memtable->wal_first = 0;
+
+    return memtable;
 }
 
-int _sort_sstables(const column_family_t* cf)
+void _ref_memtable(tidesdb_memtable_t* memtable)
 {
-    /* we check if the column family is NULL */
-    if (cf == NULL) return -1;
+    atomic_fetch_add(&memtable->refs, 1);
+}
+
+void _unref_memtable(tidesdb_memtable_t* memtable)
+{
+    if (memtable == NULL || atomic_fetch_sub(&memtable->refs, 1) != 1) return;
+
+    skiplist_destroy(memtable->skiplist);
+    free(memtable);
+}
 
-    /* if we have more than 1 sstable we sort them by last modified time */
-    if (cf->num_sstables > 1)
+int _rotate_memtable(tidesdb_t* tdb, column_family_t* cf)
+{
+    /* writers outrunning the flush thread stall here, otherwise rotated memtables pile up in
+     * memory without bound */
+    pthread_mutex_lock(&tdb->flush_lock);
+    while (tdb->flush_queue->size >= TIDESDB_MAX_PENDING_FLUSHES && !tdb->stop_flush_thread)
+        pthread_cond_wait(&tdb->flush_stall_cond, &tdb->flush_lock);
+    pthread_mutex_unlock(&tdb->flush_lock);
+
+    /* writers hold the memtable lock shared, once we hold it nobody writes to the active
+     * memtable anymore */
+    if (pthread_rwlock_wrlock(&cf->memtable_lock) != 0) return -1;
+
+    /* another writer may have rotated the memtable whilst we waited */
+    if ((int)cf->memtable->total_size < cf->config.flush_threshold)
     {
-        qsort(cf->sstables, cf->num_sstables, sizeof(sstable_t), _compare_sstables);
+        pthread_rwlock_unlock(&cf->memtable_lock);
         return 0;
     }
 
-    return -1;
+    tidesdb_memtable_t* memtable = _new_memtable(cf);
+    if (memtable == NULL)
+    {
+        pthread_rwlock_unlock(&cf->memtable_lock);
+        return -1;
+    }
+
+    queue_entry_t* entry = malloc(sizeof(queue_entry_t));
+    if (entry == NULL)
+    {
+        _unref_memtable(memtable);
+        pthread_rwlock_unlock(&cf->memtable_lock);
+        return -1;
+    }
+
+    /* the wal segments up to here are covered by the rotated memtable */
+    if (_checkpoint_wal(cf->wal, &entry->wal_checkpoint) == -1)
+    {
+        free(entry);
+        _unref_memtable(memtable);
+        pthread_rwlock_unlock(&cf->memtable_lock);
+        return -1;
+    }
+
+    /* the new memtable takes writes from the segment after the checkpoint on */
+    memtable->wal_first = entry->wal_checkpoint;
+
+    /* we publish a version with the new memtable after the ones already there, readers keep
+     * finding the rotated memtable in it until its sstable is published */
+    pthread_rwlock_wrlock(&cf->compaction_or_flush_lock);
+
+    tidesdb_version_t* current = cf->version;
+    tidesdb_memtable_t** memtables =
+        malloc((current->num_memtables + 1) * sizeof(tidesdb_memtable_t*));
+    tidesdb_version_t* version = NULL;
+    if (memtables != NULL)
+    {
+        memcpy(memtables, current->memtables, current->num_memtables * sizeof(tidesdb_memtable_t*));
+        memtables[current->num_memtables] = memtable;
+
+        version = _new_version(current->sstables, current->num_sstables, memtables,
+                               current->num_memtables + 1);
+        free(memtables);
+    }
+
+    if (version == NULL)
+    {
+        pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+        free(entry);
+        _unref_memtable(memtable);
+        pthread_rwlock_unlock(&cf->memtable_lock);
+        return -1;
+    }
+
+    /* the rotated memtable is the last one of the current version */
+    entry->memtable = current->memtables[current->num_memtables - 1];
+    entry->cf = cf;
+    _ref_memtable(entry->memtable); /* the queue holds a reference until the flush is done */
+
+    _publish_version(cf, version);
+    cf->memtable = memtable->skiplist;
+
+    pthread_rwlock_unlock(&cf->compaction_or_flush_lock);
+
+    _unref_memtable(memtable); /* the version holds the new memtable now */
+
+    /* we enqueue the rotated memtable and signal the flush thread */
+    pthread_mutex_lock(&tdb->flush_lock);
+    queue_enqueue(tdb->flush_queue, entry);
+    pthread_cond_signal(&tdb->flush_cond);
+    pthread_mutex_unlock(&tdb->flush_lock);
+
+    pthread_rwlock_unlock(&cf->memtable_lock);
+
+    return 0;
 }
 
 int _remove_directory(const char* path)
@@ -22,6 +22,7 @@
 #include <limits.h>
 #include <pthread.h>
 #include <semaphore.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -31,83 +32,276 @@
 
 #include "bloomfilter.h"
 #include "err.h"
-#include "id_gen.h"
+#include "log.h"
+#include "manifest.h"
 #include "pager.h"
 #include "queue.h"
 #include "serialize.h"
 #include "skiplist.h"
+#include "sstable.h"
+#include "sync_service.h"
 
 /* ** * @TODO windows support */
 
-#define BLOOMFILTER_SIZE                                                                      \
-    1000 /* size of each bloom filter.  Bloom filters are linked once they reach this size in \
-            occupied capacity */
-#define WAL_EXT                       ".wal"     /* extension for the write-ahead log file */
+#define WAL_EXT                       ".log"     /* extension for a write-ahead log segment */
+#define WAL_RECYCLE_EXT               ".recycle" /* extension for a segment kept for reuse */
+#define LEGACY_WAL_EXT                ".wal"     /* extension for a paged write-ahead log file */
 #define SSTABLE_EXT                   ".sst"     /* extension for the SSTable file */
 #define COLUMN_FAMILY_CONFIG_FILE_EXT ".cfc"     /* configuration file for the column family */
 #define TOMBSTONE                     0xDEADBEEF /* tombstone value for deleted keys */
 
+#define TIDESDB_NUM_LEVELS               7                 /* level 0 holds flushed sstables */
+#define TIDESDB_DEFAULT_LEVEL_MULTIPLIER 10                /* default size ratio between levels */
+#define TIDESDB_MIN_LEVEL_MULTIPLIER     2                 /* smallest level size multiplier */
+#define TIDESDB_MAX_LEVEL_MULTIPLIER     100               /* largest level size multiplier */
+#define TIDESDB_DEFAULT_TARGET_FILE_SIZE (2 * 1024 * 1024) /* default compaction output file size */
+#define TIDESDB_MIN_TARGET_FILE_SIZE     (64 * 1024)       /* smallest target file size */
+
+#define TIDESDB_DEFAULT_L0_COMPACTION_TRIGGER   4  /* level 0 sstables that trigger compaction */
+#define TIDESDB_DEFAULT_TOMBSTONE_RATIO_TRIGGER 50 /* tombstone percent that triggers compaction */
+#define TIDESDB_DEFAULT_EXPIRED_RATIO_TRIGGER   50 /* expired percent that triggers compaction */
+#define TIDESDB_MAX_COMPACTION_THREADS          64 /* most background compaction threads */
+#define TIDESDB_COMPACTION_INTERVAL             1  /* seconds between background trigger checks */
+
+#define TIDESDB_WAL_GROUP_MAX_SIZE     (1024 * 1024)     /* most bytes a wal commit group writes */
+#define TIDESDB_WAL_SEGMENT_SIZE       (4 * 1024 * 1024) /* bytes preallocated for a wal segment */
+#define TIDESDB_WAL_MAX_RECYCLED       4                 /* retired wal segments kept for reuse */
+#define TIDESDB_MAX_PENDING_FLUSHES    4                 /* queued flushes before writers stall */
+#define TIDESDB_FLUSH_RETRY_BACKOFF    100               /* ms before a failed flush is retried */
+#define TIDESDB_FLUSH_RETRY_MAX        10000             /* most ms between flush retries */
+#define TIDESDB_BATCH_INITIAL_SIZE     4096              /* bytes a write batch is first given */
+#define TIDESDB_MAX_LOAD_THREADS       8                 /* most column families loaded at once */
+#define TIDESDB_REPLAY_CHUNK_SIZE      (1024 * 1024)     /* wal bytes handed to a replay at once */
+#define TIDESDB_REPLAY_MAX_CHUNKS      4                 /* chunks a wal reader gets ahead by */
+#define TIDESDB_DEFAULT_MAX_OPEN_FILES 256               /* sstables kept open at once by default */
+
+/*
+ * tidesdb_open_progress_t
+ * called as each column family is loaded when TidesDB is opened.  column families are loaded on
+ * several threads so the calls come from whichever thread loaded one, one call at a time
+ * @param column_family the name of the column family that was loaded
+ * @param loaded the number of column families loaded so far
+ * @param total the number of column families being loaded
+ * @param arg the argument given in the config
+ */
+typedef void (*tidesdb_open_progress_t)(const char* column_family, int loaded, int total,
+                                        void* arg);
+
 /*
  * tidesdb_config_t
  * create a new TidesDB config
  * @param db_path the path for/to TidesDB
  * @param compressed_wal whether the wal should be compressed
+ * @param compaction_threads the number of background compaction threads, 0 disables background
+ * compaction
+ * @param sync_wal whether a write returns only once its wal entry is synced to disk
+ * @param wal_dir the directory the write-ahead logs are kept in, NULL keeps each one in its column
+ * family's directory
+ * @param open_progress called as each column family is loaded when TidesDB is opened, can be NULL
+ * @param open_progress_arg the argument open_progress is called with
+ * @param max_open_files the most sstables kept open at once across every column family, 0 for
+ * TIDESDB_DEFAULT_MAX_OPEN_FILES
+ * @param mmap_reads whether sstables are memory mapped and read from the page cache without copies
+ * through read buffers
+ * @param block_cache_size the bytes of decoded sstable blocks kept in memory across every column
+ * family, 0 disables the block cache
  */
 typedef struct
 {
-    char* db_path;       /* the path for/to TidesDB.  This is where column families are stored */
-    bool compressed_wal; /* whether the wal entries should be compressed */
+    char* db_path;                         /* the path for/to TidesDB */
+    bool compressed_wal;                   /* whether the wal entries should be compressed */
+    int compaction_threads;                /* background compaction threads, 0 for none */
+    bool sync_wal;                         /* whether writes wait for their wal sync */
+    char* wal_dir;                         /* the wal directory, NULL for the db path */
+    tidesdb_open_progress_t open_progress; /* called as each column family is loaded on open */
+    void* open_progress_arg;               /* the argument open_progress is called with */
+    int max_open_files;                    /* the most sstables kept open at once, 0 for default */
+    bool mmap_reads;                       /* whether sstables are read through memory maps */
+    size_t block_cache_size;               /* the block cache budget in bytes, 0 for none */
 } tidesdb_config_t;
 
+typedef struct wal_commit_t wal_commit_t;
+
 /*
- * sstable_t
- * struct for the SSTable
- * @param pager the pager for the SSTable
+ * wal_commit_t
+ * a writer waiting in the commit queue of the write-ahead log
+ * @param parts the parts the serialized operation is gathered from
+ * @param parts_count the number of parts
+ * @param data_size the size of the serialized operation
+ * @param result 0 if the operation was written, -1 if not
+ * @param done whether the operation was written by a commit group
+ * @param next the writer queued after this one
  */
-typedef struct
+struct wal_commit_t
 {
-    pager_t* pager; /* the pager for the SSTable */
-} sstable_t;
+    const struct iovec* parts; /* the parts the serialized operation is gathered from */
+    size_t parts_count;        /* the number of parts */
+    size_t data_size;          /* the size of the serialized operation */
+    int result;                /* 0 if the operation was written, -1 if not */
+    bool done;                 /* whether the operation was written by a commit group */
+    wal_commit_t* next;        /* the writer queued after this one */
+};
 
 /*
  * wal_t
- * struct for the write-ahead log
- * @param pager the pager for the WAL
- * @param lock the read-write lock for the WAL
+ * struct for the write-ahead log.  the log is split into numbered segments, entries are appended
+ * to the last one and a segment is retired whole once the memtables it covers are flushed
+ * @param log the active segment the WAL entries are appended to
+ * @param path the directory of the segments
+ * @param log_number the number of the active segment
+ * @param first_number the number of the oldest segment that is not retired
+ * @param recycled the numbers of retired segments kept for reuse
+ * @param num_recycled the number of retired segments kept for reuse
+ * @param lock the read-write lock for the WAL, held exclusively to change segments
+ * @param commit_lock the lock for the commit queue
+ * @param commit_cond the condition variable writers wait on until their group is written
+ * @param commit_head the first writer in the commit queue
+ * @param commit_tail the last writer in the commit queue
+ * @param committing whether a leader is writing a commit group
+ * @param sync_service the service that syncs the segments when writes do not sync them
  */
 typedef struct
 {
-    pager_t* pager;        /* the pager for the WAL */
-    pthread_rwlock_t lock; /* Read-write lock for the SSTable */
+    log_t* log;                                  /* the active segment */
+    char* path;                                  /* the directory of the segments */
+    uint64_t log_number;                         /* the number of the active segment */
+    uint64_t first_number;                       /* the oldest segment not retired */
+    uint64_t recycled[TIDESDB_WAL_MAX_RECYCLED]; /* retired segments kept for reuse */
+    int num_recycled;                            /* the number of recycled segments */
+    pthread_rwlock_t lock;                       /* Read-write lock for the WAL */
+    pthread_mutex_t commit_lock;                 /* lock for the commit queue */
+    pthread_cond_t commit_cond;                  /* writers wait here for their group */
+    wal_commit_t* commit_head;                   /* the first writer in the commit queue */
+    wal_commit_t* commit_tail;                   /* the last writer in the commit queue */
+    bool committing;                             /* whether a leader is writing a group */
+    sync_service_t* sync_service;                /* syncs the segments writes do not sync */
 } wal_t;
 
+/*
+ * tidesdb_memtable_t
+ * a reference counted memtable.  the active memtable takes writes, once it reaches the flush
+ * threshold it is rotated out and stays readable until its sstable is published
+ * @param skiplist the skiplist holding the key-value pairs
+ * @param refs the number of references to the memtable
+ * @param wal_first the first wal segment that can hold pairs of the memtable, the segments from
+ * it on are kept until the memtable is flushed
+ */
+typedef struct
+{
+    skiplist_t* skiplist; /* the skiplist holding the key-value pairs */
+    atomic_int refs;      /* the number of references to the memtable */
+    uint64_t wal_first;   /* the first wal segment that can hold pairs of the memtable */
+} tidesdb_memtable_t;
+
+/*
+ * tidesdb_version_t
+ * an immutable set of memtables and sstables of a column family.  readers pin the current version,
+ * rotations, flushes and compactions publish a new one.  every version holds a reference to each
+ * of its memtables and sstables
+ * @param memtables the memtables, oldest first and the active memtable last
+ * @param num_memtables the number of memtables
+ * @param sstables the sstables, deepest level first and level 0 last
+ * @param num_sstables the number of sstables
+ * @param level_counts the number of sstables in each level
+ * @param refs the number of references to the version
+ */
+typedef struct
+{
+    tidesdb_memtable_t** memtables;       /* the memtables, oldest first and the active last */
+    int num_memtables;                    /* the number of memtables */
+    sstable_t** sstables;                 /* the sstables, deepest level first and level 0 last */
+    int num_sstables;                     /* the number of sstables */
+    int level_counts[TIDESDB_NUM_LEVELS]; /* the number of sstables in each level */
+    atomic_int refs;                      /* the number of references to the version */
+} tidesdb_version_t;
+
 /*
  * column_family_t
  * struct for a column family
  * @param config the configuration for the column family
  * @param path the path to the column family
- * @param sstables the sstables for the column family
- * @param num_sstables the number of sstables for the column family
- * @param sstables_lock Read-write lock for SSTables mainly for when adding a new sstable
- * @param memtable the memtable for the column family
- * @param id_gen id generator for the column family; mainly used for sstable filenames
- * @param compaction_or_flush_lock lock for compaction or flush
+ * @param version the current version of the memtables and sstables for the column family
+ * @param sstables_lock Read-write lock for the current version, held only to pin or swap it
+ * @param memtable the active memtable for the column family, the last memtable of the version
+ * @param memtable_lock Read-write lock for the active memtable, writers share it and a rotation
+ * holds it exclusively
+ * @param next_file_number the number the next sstable file is named with
+ * @param compaction_or_flush_lock lock for compaction or flush, held while a new version is built
  * @param wal the write-ahead log for column family
+ * @param sstable_sequence the sequence number for the next flushed sstable
+ * @param manual_compaction whether a manual compaction is running, background compaction waits
+ * @param manifest the manifest of the live sstables, edited under the compaction or flush lock
+ * @param table_cache the table cache of the database the sstables keep their readers in
  */
 typedef struct
 {
-    column_family_config_t config; /* the configuration for the column family */
-    char* path;                    /* the path to the column family */
-    sstable_t** sstables;          /* the sstables for the column family */
-    int num_sstables;              /* the number of sstables for the column family */
-    pthread_rwlock_t
-        sstables_lock;    /* Read-write lock for SSTables mainly for when adding a new sstable */
-    skiplist_t* memtable; /* the memtable for the column family */
-    id_gen_t* id_gen; /* id generator for the column family; mainly used for sstable filenames */
+    column_family_config_t config;  /* the configuration for the column family */
+    char* path;                     /* the path to the column family */
+    tidesdb_version_t* version;     /* the current version of the memtables and sstables */
+    pthread_rwlock_t sstables_lock; /* Read-write lock for the current version */
+    skiplist_t* memtable;           /* the active memtable for the column family */
+    pthread_rwlock_t memtable_lock; /* Read-write lock for the active memtable */
+    atomic_uint_fast64_t next_file_number;     /* the number the next sstable file is named with */
     pthread_rwlock_t compaction_or_flush_lock; /* lock for compaction or flush */
     wal_t* wal;                                /* the write-ahead log for column family */
+    uint64_t sstable_sequence;    /* the sequence number for the next flushed sstable */
+    bool manual_compaction;       /* whether a manual compaction is running */
+    manifest_t* manifest;         /* the manifest of the live sstables */
+    sstable_cache_t* table_cache; /* the table cache the sstables keep their readers in */
 } column_family_t;
 
+/*
+ * compaction_job_t
+ * struct for a compaction job, the inputs are merged into new sstables for the output level
+ * @param cf the column family
+ * @param version the version the inputs were picked from, pinned until the job is freed
+ * @param inputs the input sstables, oldest first
+ * @param num_inputs the number of input sstables
+ * @param input_level the level the job compacts
+ * @param output_level the level the output sstables are written for
+ * @param drop_tombstones whether tombstones and expired pairs are dropped from the output
+ * @param outputs the output sstables
+ * @param num_outputs the number of output sstables
+ * @param rc 0 if the job succeeded, -1 if not
+ * @param sem semaphore to limit concurrent threads
+ */
+typedef struct
+{
+    column_family_t* cf;        /* the column family */
+    tidesdb_version_t* version; /* the version the inputs were picked from */
+    sstable_t** inputs;         /* the input sstables, oldest first */
+    int num_inputs;             /* the number of input sstables */
+    int input_level;            /* the level the job compacts */
+    int output_level;           /* the level the output sstables are written for */
+    bool drop_tombstones;       /* whether tombstones and expired pairs are dropped */
+    sstable_t** outputs;        /* the output sstables */
+    int num_outputs;            /* the number of output sstables */
+    int rc;                     /* 0 if the job succeeded, -1 if not */
+    sem_t* sem;                 /* semaphore to limit concurrent threads */
+} compaction_job_t;
+
+/*
+ * compaction_candidate_t
+ * struct for a background compaction candidate
+ * @param cf the column family
+ * @param version the pinned version the candidate was found in
+ * @param level the level of the sstables to compact
+ * @param first the index of the first sstable to compact
+ * @param count the number of sstables to compact
+ * @param score how far past its trigger the candidate is, higher saves more read amplification
+ * @param cost the bytes of the next level rewritten per byte compacted
+ */
+typedef struct
+{
+    column_family_t* cf;        /* the column family */
+    tidesdb_version_t* version; /* the pinned version the candidate was found in */
+    int level;                  /* the level of the sstables to compact */
+    int first;                  /* the index of the first sstable to compact */
+    int count;                  /* the number of sstables to compact */
+    double score;               /* how far past its trigger the candidate is */
+    double cost;                /* the bytes of the next level rewritten per byte compacted */
+} compaction_candidate_t;
+
 /*
  * tidesdb_txn_op_t
  * struct for a transaction operation
@@ -122,6 +316,43 @@ typedef struct
     bool committed;           /* whether the transaction op has been committed */
 } tidesdb_txn_op_t;
 
+/*
+ * tidesdb_recovery_stats_t
+ * what loading the column families and replaying their write-ahead logs took when TidesDB was
+ * opened
+ * @param duration_us the time the load took in microseconds
+ * @param column_families the number of column families loaded
+ * @param entries the number of log entries replayed
+ * @param bytes the number of bytes of log replayed
+ */
+typedef struct
+{
+    uint64_t duration_us;     /* the time the load took in microseconds */
+    uint64_t column_families; /* the number of column families loaded */
+    uint64_t entries;         /* the number of log entries replayed */
+    uint64_t bytes;           /* the number of bytes of log replayed */
+} tidesdb_recovery_stats_t;
+
+/*
+ * tidesdb_block_cache_stats_t
+ * how the block cache shared by every column family is doing, everything is 0 without one
+ * @param capacity the byte budget of the cache
+ * @param usage the bytes the cached blocks take
+ * @param entries the number of cached blocks
+ * @param hits the number of lookups that found their block in the cache
+ * @param misses the number of lookups that read their block from the sstable
+ * @param evictions the number of blocks evicted to stay within the budget
+ */
+typedef struct
+{
+    uint64_t capacity;  /* the byte budget of the cache */
+    uint64_t usage;     /* the bytes the cached blocks take */
+    uint64_t entries;   /* the number of cached blocks */
+    uint64_t hits;      /* the lookups that found their block in the cache */
+    uint64_t misses;    /* the lookups that read their block from the sstable */
+    uint64_t evictions; /* the blocks evicted to stay within the budget */
+} tidesdb_block_cache_stats_t;
+
 /*
  * tidesdb_t
  * struct for TidesDB
@@ -134,22 +365,120 @@ typedef struct
  * @param flush_lock the flush lock
  * @param compaction_lock the compaction lock
  * @param flush_cond the condition variable for flush thread
+ * @param flush_stall_cond the condition variable writers stall on whilst the flush queue is full
  * @param compaction_cond the condition variable for compaction
  * @param stop_flush_thread flag to stop the flush thread
+ * @param compaction_threads the background compaction threads
+ * @param compaction_jobs the running background compaction jobs, one slot per thread
+ * @param stop_compaction_threads flag to stop the background compaction threads
+ * @param recovery_stats what replaying the write-ahead logs took when TidesDB was opened
+ * @param table_cache the table cache shared by the sstables of every column family
+ * @param sync_service the service that syncs the write-ahead logs of every column family
  */
 typedef struct
 {
-    tidesdb_config_t config;               /* the configuration for tidesdb */
-    column_family_t* column_families;      /* the column families currently */
-    pthread_rwlock_t column_families_lock; /* Read-write lock for column families */
-    int num_column_families;               /* the number of column families currently */
-    pthread_t flush_thread;                /* the thread for flushing memtables */
-    queue_t* flush_queue;                  /* the queue for flushing memtables */
-    pthread_mutex_t flush_lock;            /* flush lock */
-    pthread_cond_t flush_cond;             /* condition variable for flush thread */
-    bool stop_flush_thread;                /* flag to stop the flush thread */
+    tidesdb_config_t config;                 /* the configuration for tidesdb */
+    column_family_t* column_families;        /* the column families currently */
+    pthread_rwlock_t column_families_lock;   /* Read-write lock for column families */
+    int num_column_families;                 /* the number of column families currently */
+    pthread_t flush_thread;                  /* the thread for flushing memtables */
+    queue_t* flush_queue;                    /* the queue for flushing memtables */
+    pthread_mutex_t flush_lock;              /* flush lock */
+    pthread_cond_t flush_cond;               /* condition variable for flush thread */
+    pthread_cond_t flush_stall_cond;         /* writers stall here whilst the flush queue is full */
+    bool stop_flush_thread;                  /* flag to stop the flush thread */
+    pthread_t* compaction_threads;           /* the background compaction threads */
+    compaction_job_t** compaction_jobs;      /* the running background compaction jobs */
+    pthread_mutex_t compaction_lock;         /* lock for the background compaction state */
+    pthread_cond_t compaction_cond;          /* condition variable for background compaction */
+    bool stop_compaction_threads;            /* flag to stop the background compaction threads */
+    tidesdb_recovery_stats_t recovery_stats; /* what replaying the wals took on open */
+    sstable_cache_t* table_cache;            /* the table cache shared by every column family */
+    sync_service_t* sync_service;            /* syncs the wals of every column family */
 } tidesdb_t;
 
+typedef struct wal_replay_chunk_t wal_replay_chunk_t;
+
+/*
+ * wal_replay_chunk_t
+ * entries read from a write-ahead log, handed from the thread reading the log to the thread putting
+ * them into the memtable
+ * @param data the entries, each prefixed with the number of its segment and its size
+ * @param size the number of bytes in the chunk
+ * @param capacity the capacity of the chunk
+ * @param next the chunk read after this one
+ */
+struct wal_replay_chunk_t
+{
+    uint8_t* data;            /* the entries, each prefixed with its segment and size */
+    size_t size;              /* the number of bytes in the chunk */
+    size_t capacity;          /* the capacity of the chunk */
+    wal_replay_chunk_t* next; /* the chunk read after this one */
+};
+
+/*
+ * wal_replay_t
+ * the replay of the write-ahead log of a column family.  a reader thread reads the segments with
+ * large sequential reads and decompresses their entries ahead of the thread putting them into the
+ * memtable
+ * @param tdb the TidesDB instance
+ * @param cf the column family
+ * @param head the oldest chunk read and not replayed yet
+ * @param tail the newest chunk read
+ * @param num_chunks the number of chunks read and not replayed yet
+ * @param reading whether the reader thread is still reading
+ * @param lock the lock for the chunks
+ * @param cond the condition variable the reader and the replay wait on for each other
+ * @param entries the number of entries read
+ * @param bytes the number of bytes of log read
+ * @param rc 0 if the log was replayed, -1 if it could not be read
+ */
+typedef struct
+{
+    tidesdb_t* tdb;           /* the TidesDB instance */
+    column_family_t* cf;      /* the column family */
+    wal_replay_chunk_t* head; /* the oldest chunk read and not replayed yet */
+    wal_replay_chunk_t* tail; /* the newest chunk read */
+    int num_chunks;           /* the number of chunks read and not replayed yet */
+    bool reading;             /* whether the reader thread is still reading */
+    pthread_mutex_t lock;     /* the lock for the chunks */
+    pthread_cond_t cond;      /* the reader and the replay wait here for each other */
+    uint64_t entries;         /* the number of entries read */
+    uint64_t bytes;           /* the number of bytes of log read */
+    int rc;                   /* 0 if the log was replayed, -1 if it could not be read */
+} wal_replay_t;
+
+/*
+ * column_family_load_t
+ * the load of a column family when TidesDB is opened, column families are loaded side by side on a
+ * bounded pool of threads
+ * @param tdb the TidesDB instance
+ * @param path the path of the column family directory
+ * @param config_path the path of the column family config file
+ * @param cf the slot in the column families the column family is loaded into
+ * @param entries the number of wal entries replayed
+ * @param bytes the number of bytes of wal replayed
+ * @param sem the semaphore bounding the loads run at once
+ * @param progress_lock the lock the open progress is reported under
+ * @param loaded the number of column families loaded so far
+ * @param total the number of column families being loaded
+ * @param rc 0 if the column family was loaded, -1 if not
+ */
+typedef struct
+{
+    tidesdb_t* tdb;                 /* the TidesDB instance */
+    char* path;                     /* the path of the column family directory */
+    char* config_path;              /* the path of the column family config file */
+    column_family_t* cf;            /* the slot the column family is loaded into */
+    uint64_t entries;               /* the number of wal entries replayed */
+    uint64_t bytes;                 /* the number of bytes of wal replayed */
+    sem_t* sem;                     /* the semaphore bounding the loads run at once */
+    pthread_mutex_t* progress_lock; /* the lock the open progress is reported under */
+    int* loaded;                    /* the number of column families loaded so far */
+    int total;                      /* the number of column families being loaded */
+    int rc;                         /* 0 if the column family was loaded, -1 if not */
+} column_family_load_t;
+
 /*
  * tidesdb_txn_t
  * struct for a transaction
@@ -168,12 +497,31 @@ typedef struct
     pthread_mutex_t lock;  /* lock for the transaction */
 } tidesdb_txn_t;
 
+/*
+ * tidesdb_batch_t
+ * struct for a write batch.  its operations are encoded into one buffer as they are added and the
+ * buffer is written to a column family as a single write-ahead log entry
+ * @param buffer the batch header followed by the encoded operations
+ * @param size the number of bytes in the buffer
+ * @param capacity the capacity of the buffer
+ * @param count the number of operations in the batch
+ */
+typedef struct
+{
+    uint8_t* buffer; /* the batch header followed by the encoded operations */
+    size_t size;     /* the number of bytes in the buffer */
+    size_t capacity; /* the capacity of the buffer */
+    uint32_t count;  /* the number of operations in the batch */
+} tidesdb_batch_t;
+
 /*
  * tidesdb_cursor_t
  * struct for a TidesDB cursor
  * @param tidesdb the tidesdb instance
  * @param cf the column family
- * @param memtable_cursor the cursor for the memtable
+ * @param memtable_cursor the cursor for the memtable, NULL once the cursor is in the sstables
+ * @param memtable_index the index of the memtable
+ * @param version the version the cursor reads the memtables and sstables of
  * @param sstable_index the index of the sstable
  * @param sstable_cursor the cursor for the sstable
  * @param current the current key-value pair
@@ -184,41 +532,28 @@ typedef struct
     tidesdb_t* tidesdb;                 /* tidesdb instance */
     column_family_t* cf;                /* the column family */
     skiplist_cursor_t* memtable_cursor; /* the cursor for the memtable */
+    int memtable_index;                 /* the index of the memtable */
+    tidesdb_version_t* version;         /* the version the cursor reads */
     size_t sstable_index;               /* the index of the sstable */
-    pager_cursor_t* sstable_cursor;     /* the cursor for the sstable */
+    sstable_iterator_t* sstable_cursor; /* the cursor for the sstable */
     key_value_pair_t* current;          /* the current key-value pair */
 } tidesdb_cursor_t;
 
 /*
  * queue_entry
  * struct for a queue entry
- * @param memtable the memtable
+ * @param memtable the rotated memtable, the queue holds a reference to it
  * @param cf the column family
- * @param wal_checkpoint the point in the wal to truncate after flush
+ * @param wal_checkpoint the first wal segment not covered by the memtable, the ones before it are
+ * retired after flush
  */
 typedef struct
 {
-    skiplist_t* memtable;  /* the memtable */
-    column_family_t* cf;   /* the column family */
-    size_t wal_checkpoint; /* the point in the wal to truncate after flush */
+    tidesdb_memtable_t* memtable; /* the rotated memtable */
+    column_family_t* cf;          /* the column family */
+    uint64_t wal_checkpoint;      /* the first wal segment not covered by the memtable */
 } queue_entry_t;
 
-/*
- * compact_thread_args
- * struct for the arguments for a compact thread
- * @param cf the column family
- * @param start the start index for the sstables
- * @param end the end index for the sstables
- * @param sem semaphore to limit concurrent threads
- */
-typedef struct
-{
-    column_family_t* cf; /* the column family */
-    int start;           /* the start index for the sstables */
-    int end;             /* the end index for the sstables */
-    sem_t* sem;          /* semaphore to limit concurrent threads */
-} compact_thread_args_t;
-
 /* TidesDB function prototypes */
 
 /* functions prefixed with _ are internal functions */
@@ -249,11 +584,22 @@ tidesdb_err_t* tidesdb_close(tidesdb_t* tdb);
  * @param flush_threshold the threshold at which the memtable should be flushed to disk
  * @param max_level the maximum level for the memtable(skiplist)
  * @param probability the probability for skip list
+ * @param compressed whether sstable data is compressed
  * @return error or NULL
  */
 tidesdb_err_t* tidesdb_create_column_family(tidesdb_t* tdb, const char* name, int flush_threshold,
                                             int max_level, float probability, bool compressed);
 
+/*
+ * tidesdb_create_column_family_with_config
+ * create a new column family from a full column family configuration
+ * @param tdb the TidesDB instance
+ * @param config the column family configuration, fields left 0 use their defaults
+ * @return error or NULL
+ */
+tidesdb_err_t* tidesdb_create_column_family_with_config(tidesdb_t* tdb,
+                                                        const column_family_config_t* config);
+
 /*
  * tidesdb_drop_column_family
  * drops a column family and all associated data
@@ -275,14 +621,25 @@ int _get_column_family(tidesdb_t* tdb, const char* name, column_family_t** cf);
 
 /*
  * tidesdb_compact_sstables
- * compact the sstables for a column family
+ * compact the sstables for a column family.  level 0 is merged into level 1 and then every level
+ * over its target size is compacted into the next until all levels are within their targets.
+ * background compaction of the column family waits until the manual compaction is done
  * @param tdb the TidesDB instance
  * @param column_family the column family name
- * @param max_threads the maximum number of threads to use
+ * @param max_threads the maximum number of compaction jobs to run at once
  * @return error or NULL
  */
 tidesdb_err_t* tidesdb_compact_sstables(tidesdb_t* tdb, const char* column_family, int max_threads);
 
+/*
+ * _compact_sstables
+ * compacts level 0 into level 1 and every level over its target size into the next
+ * @param cf the column family
+ * @param max_threads the maximum number of compaction jobs to run at once
+ * @return error or NULL
+ */
+tidesdb_err_t* _compact_sstables(column_family_t* cf, int max_threads);
+
 /*
  * tidesdb_put
  * put a key-value pair into TidesDB
@@ -383,6 +740,87 @@ tidesdb_err_t* tidesdb_txn_rollback(tidesdb_txn_t* transaction);
  */
 tidesdb_err_t* tidesdb_txn_free(tidesdb_txn_t* transaction);
 
+/*
+ * tidesdb_batch_new
+ * create an empty write batch.  a batch is not bound to a column family until it is written and
+ * can be written, cleared and reused.  a batch is not safe to add to from several threads at once
+ * @param batch the batch
+ * @return error or NULL
+ */
+tidesdb_err_t* tidesdb_batch_new(tidesdb_batch_t** batch);
+
+/*
+ * tidesdb_batch_put
+ * add a put of a key-value pair to a batch, the key and value are copied into the batch
+ * @param batch the batch
+ * @param key the key
+ * @param key_size the size of the key
+ * @param value the value
+ * @param value_size the size of the value
+ * @param ttl the time-to-live for the key-value pair
+ * @return error or NULL
+ */
+tidesdb_err_t* tidesdb_batch_put(tidesdb_batch_t* batch, const uint8_t* key, size_t key_size,
+                                 const uint8_t* value, size_t value_size, time_t ttl);
+
+/*
+ * tidesdb_batch_delete
+ * add a delete of a key to a batch
+ * @param batch the batch
+ * @param key the key
+ * @param key_size the size of the key
+ * @return error or NULL
+ */
+tidesdb_err_t* tidesdb_batch_delete(tidesdb_batch_t* batch, const uint8_t* key, size_t key_size);
+
+/*
+ * tidesdb_batch_write
+ * write the operations of a batch to a column family, in the order they were added.  the batch is
+ * logged as one write-ahead log entry and applied to the memtable under a single lock, it is
+ * replayed whole or not at all after a crash
+ * @param tdb the TidesDB instance
+ * @param column_family_name the name of the column family
+ * @param batch the batch
+ * @return error or NULL
+ */
+tidesdb_err_t* tidesdb_batch_write(tidesdb_t* tdb, const char* column_family_name,
+                                   tidesdb_batch_t* batch);
+
+/*
+ * tidesdb_batch_clear
+ * remove every operation from a batch, its buffer is kept for reuse
+ * @param batch the batch
+ * @return error or NULL
+ */
+tidesdb_err_t* tidesdb_batch_clear(tidesdb_batch_t* batch);
+
+/*
+ * tidesdb_batch_free
+ * free a batch
+ * @param batch the batch
+ * @return error or NULL
+ */
+tidesdb_err_t* tidesdb_batch_free(tidesdb_batch_t* batch);
+
+/*
+ * tidesdb_get_recovery_stats
+ * get what loading the column families and replaying their write-ahead logs took when TidesDB was
+ * opened
+ * @param tdb the TidesDB instance
+ * @param stats the recovery stats
+ * @return error or NULL
+ */
+tidesdb_err_t* tidesdb_get_recovery_stats(tidesdb_t* tdb, tidesdb_recovery_stats_t* stats);
+
+/*
+ * tidesdb_get_block_cache_stats
+ * get the size and hit and miss counts of the block cache, to size it by
+ * @param tdb the TidesDB instance
+ * @param stats the block cache stats
+ * @return error or NULL
+ */
+tidesdb_err_t* tidesdb_get_block_cache_stats(tidesdb_t* tdb, tidesdb_block_cache_stats_t* stats);
+
 /*
  * tidesdb_cursor_init
  * initialize a new TidesDB cursor
@@ -431,15 +869,14 @@ tidesdb_err_t* tidesdb_cursor_free(tidesdb_cursor_t* cursor);
  * _new_column_family
  * create a new column family
  * @param db_path the path for/to TidesDB
- * @param name the name of the column family
- * @param flush_threshold the threshold at which the memtable should be flushed to disk
- * @param max_level the maximum level for the memtable(skiplist)
- * @param probability the probability for skip list
+ * @param wal_dir the directory for the write-ahead logs, NULL for the column family's directory
+ * @param sync_service the service that syncs the write-ahead log
+ * @param config the configuration for the column family
  * @param cf the column family
  * @return 0 if the column family was created, -1 if not
  */
-int _new_column_family(const char* db_path, const char* name, int flush_threshold, int max_level,
-                       float probability, column_family_t** cf, bool compressed);
+int _new_column_family(const char* db_path, const char* wal_dir, sync_service_t* sync_service,
+                       const column_family_config_t* config, column_family_t** cf);
 
 /*
  * _add_column_family
@@ -452,12 +889,30 @@ int _add_column_family(tidesdb_t* tdb, column_family_t* cf);
 
 /*
  * _load_column_families
- * load the column families for TidesDB
+ * load the column families for TidesDB.  every column family is given its slot up front and they
+ * are loaded side by side on up to TIDESDB_MAX_LOAD_THREADS threads, so opening takes about as long
+ * as the largest one.  the time it took is kept in the recovery stats
  * @param tdb the TidesDB instance
  * @return 0 if the column families were loaded, -1 if not
  */
 int _load_column_families(tidesdb_t* tdb);
 
+/*
+ * _load_column_family_thread
+ * loads a column family and releases its slot in the load semaphore
+ * @param arg the load
+ */
+void* _load_column_family_thread(void* arg);
+
+/*
+ * _load_column_family
+ * load a column family into its slot, we read its config, open its wal and sstables and replay
+ * its wal into the memtable.  the open progress is reported once it is loaded
+ * @param load the load of the column family
+ * @return 0 if the column family was loaded, -1 if not
+ */
+int _load_column_family(column_family_load_t* load);
+
 /*
  * _get_path_seperator
  * get the path separator for the current OS
@@ -467,7 +922,8 @@ const char* _get_path_seperator();
 
 /*
  * _append_to_wal
- * append an operation to the write-ahead log
+ * append an operation to the write-ahead log.  an uncompressed operation is written straight from
+ * the key and value without copying them
  * @param tdb the TidesDB instance
  * @param wal the write-ahead log
  * @param key the key
@@ -483,14 +939,77 @@ int _append_to_wal(tidesdb_t* tdb, wal_t* wal, const uint8_t* key, size_t key_si
                    const uint8_t* value, size_t value_size, time_t ttl, OP_CODE op_code,
                    const char* cf);
 
+/*
+ * _append_batch_to_wal
+ * append a batch to the write-ahead log as a single entry, an uncompressed batch is written
+ * straight from its buffer
+ * @param tdb the TidesDB instance
+ * @param wal the write-ahead log
+ * @param batch the batch
+ * @param cf the column family name
+ * @return 0 if the batch was appended, -1 if not
+ */
+int _append_batch_to_wal(tidesdb_t* tdb, wal_t* wal, tidesdb_batch_t* batch, const char* cf);
+
+/*
+ * _commit_to_wal
+ * queue a serialized operation for the write-ahead log and wait until it is written.  the first
+ * writer in the queue leads, it writes every queued operation with one vectored write and one sync
+ * and releases the writers it wrote for
+ * @param tdb the TidesDB instance
+ * @param wal the write-ahead log
+ * @param parts the parts the serialized operation is gathered from, they are not copied
+ * @param parts_count the number of parts
+ * @param data_size the size of the serialized operation
+ * @return 0 if the operation was written (and synced if sync_wal is set), -1 if not
+ */
+int _commit_to_wal(tidesdb_t* tdb, wal_t* wal, const struct iovec* parts, size_t parts_count,
+                   size_t data_size);
+
 /*
  * _open_wal
- * open the write-ahead log
- * @param db_path the path for/to TidesDB
+ * open the write-ahead log of a column family.  the segments already there are kept for replay, a
+ * legacy wal is migrated into a segment of its own and appends go to a new segment
+ * @param cf_path the path to the column family
+ * @param wal_dir the directory for the write-ahead logs, NULL for the column family's directory
+ * @param name the name of the column family
+ * @param sync_service the service that syncs the segments, NULL to sync them only as they close
  * @param w the write-ahead log
  * @return 0 if the wal was opened, -1 if not
  */
-int _open_wal(const char* db_path, wal_t** w);
+int _open_wal(const char* cf_path, const char* wal_dir, const char* name,
+              sync_service_t* sync_service, wal_t** w);
+
+/*
+ * _wal_segment_path
+ * format the path of a write-ahead log segment
+ * @param wal the write-ahead log
+ * @param number the number of the segment
+ * @param ext the extension, WAL_EXT for a segment or WAL_RECYCLE_EXT for a recycled one
+ * @param path the path
+ * @param path_size the size of the path buffer
+ */
+void _wal_segment_path(const wal_t* wal, uint64_t number, const char* ext, char* path,
+                       size_t path_size);
+
+/*
+ * _roll_wal
+ * close the active segment of the write-ahead log and start the next one, reusing a recycled
+ * segment if there is one.  the caller holds the wal lock exclusively
+ * @param wal the write-ahead log
+ * @return 0 if the next segment was started, -1 if not
+ */
+int _roll_wal(wal_t* wal);
+
+/*
+ * _checkpoint_wal
+ * start a new segment of the write-ahead log unless the active one is empty, the memtable being
+ * rotated covers every segment before it
+ * @param wal the write-ahead log
+ * @param checkpoint the number of the segment the new memtable starts in
+ * @return 0 if the checkpoint was taken, -1 if not
+ */
+int _checkpoint_wal(wal_t* wal, uint64_t* checkpoint);
 
 /*
  * _close_wal
@@ -500,50 +1019,203 @@ int _open_wal(const char* db_path, wal_t** w);
 void _close_wal(wal_t* wal);
 
 /*
- * _truncate_wal
- * truncate the write-ahead log
+ * _retire_wal
+ * retire the write-ahead log segments before a checkpoint once the memtables they cover are
+ * flushed, up to TIDESDB_WAL_MAX_RECYCLED of them are kept for reuse and the rest are removed
  * @param wal the write-ahead log
- * @param checkpoint the point in the wal to truncate
- * @return 0 if the wal was truncated, -1 if not
+ * @param checkpoint the first segment that is still needed
+ * @return 0 if the segments were retired, -1 if not
  */
-int _truncate_wal(wal_t* wal, int checkpoint);
+int _retire_wal(wal_t* wal, uint64_t checkpoint);
 
 /*
  * _replay_from_wal
- * replay the write-ahead log
+ * replay the segments of the write-ahead log of a column family that were written before it was
+ * opened.  a reader thread reads and decompresses the entries whilst we put them into the memtable,
+ * which is presized from the length of the log up to its flush threshold
+ * @param replay the replay of the column family
+ * @return 0 if the log was replayed, -1 if it could not be read
+ */
+int _replay_from_wal(wal_replay_t* replay);
+
+/*
+ * _wal_replay_reader_thread
+ * reads the entries of the segments of a write-ahead log into chunks for its replay, no more than
+ * TIDESDB_REPLAY_MAX_CHUNKS ahead of it
+ * @param arg the replay
+ */
+void* _wal_replay_reader_thread(void* arg);
+
+/*
+ * _push_replay_chunk
+ * hands a chunk of entries to a replay, waiting whilst the replay is too far behind
+ * @param replay the replay
+ * @param chunk the chunk, the replay frees it
+ */
+void _push_replay_chunk(wal_replay_t* replay, wal_replay_chunk_t* chunk);
+
+/*
+ * _replay_operation
+ * replay an uncompressed operation or batch read from the write-ahead log of a column family into
+ * the memtable, it is decoded in place
  * @param tdb the TidesDB instance
- * @param wal the write-ahead log
- * @return 0 if the wal was replayed, -1 if not
+ * @param cf the column family of the log
+ * @param buffer the operation
+ * @param buffer_size the size of the operation
+ * @return 0 if the operation was replayed, -1 if it is malformed or its column family is gone
  */
-int _replay_from_wal(tidesdb_t* tdb, wal_t* wal);
+int _replay_operation(tidesdb_t* tdb, column_family_t* cf, const uint8_t* buffer,
+                      size_t buffer_size);
 
 /*
- * _free_sstable
- * free the memory for an SSTable
- * @param sst the SSTable
- * @return 0 if the SSTable was freed, -1 if not
+ * _replay_batch
+ * replay a batch read from the write-ahead log of a column family into the memtable
+ * @param tdb the TidesDB instance
+ * @param cf the column family of the log
+ * @param buffer the uncompressed batch
+ * @param buffer_size the size of the batch
+ * @return 0 if the batch was replayed, -1 if it is malformed or its column family is gone
+ */
+int _replay_batch(tidesdb_t* tdb, column_family_t* cf, const uint8_t* buffer, size_t buffer_size);
+
+/*
+ * _replay_column_family
+ * find the column family an operation read from the write-ahead log of another is for
+ * @param tdb the TidesDB instance
+ * @param cf the column family of the log
+ * @param name the name the operation carries, it may run to the end of the operation
+ * @param name_size the number of bytes left in the operation for the name
+ * @return the column family, NULL if the name is malformed or the column family is gone
+ */
+column_family_t* _replay_column_family(tidesdb_t* tdb, column_family_t* cf, const char* name,
+                                       size_t name_size);
+
+/*
+ * _batch_add
+ * encode an operation at the end of a batch, growing its buffer as needed
+ * @param batch the batch
+ * @param op_code the operation code
+ * @param kv the key value pair of the operation
+ * @return 0 if the operation was added, -1 if not
+ */
+int _batch_add(tidesdb_batch_t* batch, OP_CODE op_code, const key_value_pair_t* kv);
+
+/*
+ * _apply_batch
+ * put the operations of a batch into a memtable under a single acquisition of its lock
+ * @param memtable the memtable
+ * @param operations the encoded operations of the batch
+ * @param operations_size the size of the encoded operations
+ * @param count the number of operations
+ * @return 0 if every operation was applied, -1 if not
  */
-int _free_sstable(sstable_t* sst);
+int _apply_batch(skiplist_t* memtable, const uint8_t* operations, size_t operations_size,
+                 uint32_t count);
+
+/*
+ * _migrate_legacy_wal
+ * copy the operations of a write-ahead log in the paged format of older versions into a segment
+ * of the column family's log and remove the paged file
+ * @param wal the write-ahead log, being opened
+ * @param cf_path the path to the column family
+ * @return 0 if there was nothing to migrate or the wal was migrated, -1 if not
+ */
+int _migrate_legacy_wal(wal_t* wal, const char* cf_path);
 
 /*
  * _compare_sstables
- * compare two sstables
+ * compare two sstables by their level, smallest key, sequence number and file number, all of
+ * which are in memory
  * @param a the first sstable
  * @param b the second sstable
  * @return the comparison
  */
 int _compare_sstables(const void* a, const void* b);
 
+/*
+ * _compare_scanned_sstables
+ * compare two sstables found by a directory scan, level 0 sstables written before sequence
+ * numbers are ordered by their last modified time
+ * @param a the first sstable
+ * @param b the second sstable
+ * @return the comparison
+ */
+int _compare_scanned_sstables(const void* a, const void* b);
+
+/*
+ * _new_sstable_path
+ * hand out the next file number of a column family and build the path of an sstable named with it
+ * @param cf the column family
+ * @param path the path of the sstable
+ * @param path_size the size of the path buffer
+ * @return the file number
+ */
+uint64_t _new_sstable_path(column_family_t* cf, char* path, size_t path_size);
+
+/*
+ * _parse_sstable_file_number
+ * parse the number an sstable file is named with
+ * @param name the file name of the sstable
+ * @param file_number the number
+ * @return 0 if the name holds a number, -1 if not
+ */
+int _parse_sstable_file_number(const char* name, uint64_t* file_number);
+
 /*
  * _flush_memtable
- * flushes a memtable to disk
+ * flushes a rotated memtable to disk and publishes a version with its sstable in place of it
  * @param tdb the TidesDB instance
  * @param cf the column family
- * @param memtable a memtable
- * @param wal_checkpoint the point in the wal to truncate after flush
+ * @param memtable a rotated memtable
+ * @param wal_checkpoint the first wal segment not covered by the memtable
  * @return 0 if the memtable was flushed, -1 if not
  */
-int _flush_memtable(tidesdb_t* tdb, column_family_t* cf, skiplist_t* memtable, int wal_checkpoint);
+int _flush_memtable(tidesdb_t* tdb, column_family_t* cf, tidesdb_memtable_t* memtable,
+                    uint64_t wal_checkpoint);
+
+/*
+ * _rotate_memtable
+ * makes the active memtable of a column family immutable, publishes a version with a new empty
+ * active memtable and queues the rotated one for flushing.  nothing is copied, the rotated
+ * memtable stays readable until its sstable is published
+ * @param tdb the TidesDB instance
+ * @param cf the column family
+ * @return 0 if the memtable was rotated or no longer needs to be, -1 if not
+ */
+int _rotate_memtable(tidesdb_t* tdb, column_family_t* cf);
+
+/*
+ * _cursor_seek_memtable
+ * moves a cursor to the first key-value pair of the first memtable with pairs, starting at a
+ * memtable of its version and stepping towards older or newer ones
+ * @param cursor the cursor
+ * @param index the index of the memtable to start at
+ * @param step -1 to step towards older memtables, 1 towards newer ones
+ * @return 0 if the cursor was moved, -1 if no memtable in that direction has pairs
+ */
+int _cursor_seek_memtable(tidesdb_cursor_t* cursor, int index, int step);
+
+/*
+ * _new_memtable
+ * creates an empty memtable for a column family
+ * @param cf the column family
+ * @return the memtable with a single reference, NULL on failure
+ */
+tidesdb_memtable_t* _new_memtable(column_family_t* cf);
+
+/*
+ * _ref_memtable
+ * takes a reference to a memtable
+ * @param memtable the memtable
+ */
+void _ref_memtable(tidesdb_memtable_t* memtable);
+
+/*
+ * _unref_memtable
+ * releases a reference to a memtable, the last one destroys it
+ * @param memtable the memtable
+ */
+void _unref_memtable(tidesdb_memtable_t* memtable);
 
 /*
  * _flush_memtable_thread
@@ -552,6 +1224,17 @@ int _flush_memtable(tidesdb_t* tdb, column_family_t* cf, skiplist_t* memtable, i
  */
 void* _flush_memtable_thread(void* arg);
 
+/*
+ * _requeue_flush
+ * puts the entry of a failed flush back at the front of the flush queue and waits out the
+ * backoff, which doubles up to TIDESDB_FLUSH_RETRY_MAX for the next failure
+ * @param tdb the tidesdb instance
+ * @param qe the queue entry of the failed flush
+ * @param backoff the milliseconds to wait
+ * @return 0 if the entry was requeued, -1 if the flush thread is stopping or it could not be
+ */
+int _requeue_flush(tidesdb_t* tdb, queue_entry_t* qe, long* backoff);
+
 /*
  * _is_tombstone
  * checks if value is a tombstone
@@ -563,19 +1246,282 @@ int _is_tombstone(const uint8_t* value, size_t value_size);
 
 /*
  * _load_sstables
- * load the sstables for a column family
+ * load the sstables for a column family into its current version.  the sstables its manifest
+ * lists are opened, a column family without a manifest has its directory scanned once and the
+ * manifest is written from what was found.  the next file number and sequence number pick up
+ * past every one handed out before
  * @param cf the column family
- * @return 0 if the sstables were loaded, -1 if not
+ * @return 0 if the sstables were loaded or there are none, -1 if not
  */
 int _load_sstables(column_family_t* cf);
 
 /*
- * _sort_sstables
- * sort the sstables for a column family by last modified being last
+ * _demote_overlapping_levels
+ * put every level deeper than 0 whose sstables overlap each other back into level 0 and record
+ * the move in the manifest.  the sstables must not be in a version yet
+ * @param cf the column family
+ * @param sstables the loaded sstables
+ * @param num_sstables the number of sstables
+ * @return 0 if no level overlaps or the overlapping ones were demoted, -1 if not
+ */
+int _demote_overlapping_levels(column_family_t* cf, sstable_t** sstables, int num_sstables);
+
+/*
+ * _open_manifest_sstables
+ * open the sstables the manifest of a column family lists, their levels, sequence numbers and file
+ * numbers are the ones the manifest records
  * @param cf the column family
+ * @param sstables the sstables opened
+ * @param num_sstables the number of sstables opened
+ * @return 0 if every sstable was opened, -1 if not
+ */
+int _open_manifest_sstables(column_family_t* cf, sstable_t*** sstables, int* num_sstables);
+
+/*
+ * _scan_sstables
+ * open every sstable file in the directory of a column family that has no manifest yet
+ * @param cf the column family
+ * @param sstables the sstables opened
+ * @param num_sstables the number of sstables opened
+ * @return 0 if every sstable was opened, -1 if not
+ */
+int _scan_sstables(column_family_t* cf, sstable_t*** sstables, int* num_sstables);
+
+/*
+ * _manifest_table
+ * describe an sstable as the manifest records it, the name and keys point into the sstable
+ * @param sst the sstable
+ * @param table the manifest table
+ */
+void _manifest_table(sstable_t* sst, manifest_table_t* table);
+
+/*
+ * _sort_sstables
+ * sort the sstables of a version, deepest level first and level 0 last with its newest sstable
+ * at the end, and recount the sstables in each level
+ * @param version the version, not yet published
  * @return 0 if the sstables were sorted, -1 if not
  */
-int _sort_sstables(const column_family_t* cf);
+int _sort_sstables(tidesdb_version_t* version);
+
+/*
+ * _new_version
+ * creates a version holding the given memtables and sstables, it takes a reference to each of
+ * them
+ * @param sstables the sstables in any order
+ * @param num_sstables the number of sstables
+ * @param memtables the memtables, oldest first and the active memtable last
+ * @param num_memtables the number of memtables
+ * @return the sorted version with a single reference, NULL on failure
+ */
+tidesdb_version_t* _new_version(sstable_t** sstables, int num_sstables,
+                                tidesdb_memtable_t** memtables, int num_memtables);
+
+/*
+ * _pin_version
+ * takes a reference to the current version of a column family, its sstables stay open until it
+ * is released
+ * @param cf the column family
+ * @return the current version
+ */
+tidesdb_version_t* _pin_version(column_family_t* cf);
+
+/*
+ * _release_version
+ * releases a reference to a version, the last one releases its memtables and sstables
+ * @param version the version
+ */
+void _release_version(tidesdb_version_t* version);
+
+/*
+ * _publish_version
+ * makes a version the current version of a column family and releases the previous one.  called
+ * with the compaction or flush lock held
+ * @param cf the column family
+ * @param version the new version, the column family takes over its reference
+ */
+void _publish_version(column_family_t* cf, tidesdb_version_t* version);
+
+/*
+ * _level_start
+ * gets the index in the sstables array of the first sstable in a level
+ * @param version the version
+ * @param level the level
+ * @return the index of the first sstable in the level
+ */
+int _level_start(const tidesdb_version_t* version, int level);
+
+/*
+ * _level_size
+ * gets the total size of the sstables in a level
+ * @param version the version
+ * @param level the level
+ * @return the size in bytes
+ */
+uint64_t _level_size(const tidesdb_version_t* version, int level);
+
+/*
+ * _level_target_size
+ * gets the size a level may grow to before it is compacted into the next level
+ * @param cf the column family
+ * @param level the level, 1 or deeper
+ * @return the target size in bytes
+ */
+uint64_t _level_target_size(const column_family_t* cf, int level);
+
+/*
+ * _find_level_sstable
+ * binary searches a level for the only sstable whose key range may hold a key
+ * @param version the version
+ * @param level the level, 1 or deeper
+ * @param key the key
+ * @param key_size the size of the key
+ * @return the index of the sstable, -1 if no sstable in the level can hold the key
+ */
+int _find_level_sstable(const tidesdb_version_t* version, int level, const uint8_t* key,
+                        size_t key_size);
+
+/*
+ * _is_bottommost_level
+ * checks if no deeper level holds any sstables, tombstones written to such a level hide nothing
+ * @param version the version
+ * @param level the level
+ * @return true if the level is the bottommost level with data
+ */
+bool _is_bottommost_level(const tidesdb_version_t* version, int level);
+
+/*
+ * _new_compaction_job
+ * creates a compaction job that merges the given sstables with the overlapping sstables of the
+ * next level, the job pins the version until it is freed
+ * @param cf the column family
+ * @param version the version the sstables are picked from
+ * @param level the level of the given sstables
+ * @param first the index of the first given sstable
+ * @param count the number of given sstables, they must be next to each other in the array
+ * @return the new compaction job, NULL on failure
+ */
+compaction_job_t* _new_compaction_job(column_family_t* cf, tidesdb_version_t* version, int level,
+                                      int first, int count);
+
+/*
+ * _free_compaction_job
+ * frees a compaction job and releases its version, outputs that were not installed are abandoned
+ * @param job the compaction job
+ */
+void _free_compaction_job(compaction_job_t* job);
+
+/*
+ * _run_compaction_jobs
+ * runs compaction jobs, at most max_threads at a time, and installs the jobs that succeeded
+ * @param cf the column family
+ * @param jobs the compaction jobs
+ * @param num_jobs the number of compaction jobs
+ * @param max_threads the maximum number of jobs to run at once
+ * @return the number of jobs that succeeded
+ */
+int _run_compaction_jobs(column_family_t* cf, compaction_job_t** jobs, int num_jobs,
+                         int max_threads);
+
+/*
+ * _install_compaction_job
+ * publishes a version of the column family with the inputs of a finished compaction job replaced by
+ * its outputs.  the input files are removed once no version holds them.  called with the
+ * compaction or flush lock held
+ * @param cf the column family
+ * @param job the compaction job
+ * @return 0 if the job was installed, -1 if not
+ */
+int _install_compaction_job(column_family_t* cf, compaction_job_t* job);
+
+/*
+ * _compact_level
+ * compacts a level into the next level.  all of level 0 is merged at once, for deeper levels we
+ * pick up to max_threads sstables with the least overlap in the next level and disjoint ranges
+ * @param cf the column family
+ * @param level the level to compact
+ * @param max_threads the maximum number of jobs to run at once
+ * @return the number of jobs that succeeded
+ */
+int _compact_level(column_family_t* cf, int level, int max_threads);
+
+/*
+ * _compaction_thread
+ * a background compaction thread, it runs the most urgent compaction job of all column families
+ * until it is stopped
+ * @param arg the arguments for the thread in this case a tidesdb instance
+ */
+void* _compaction_thread(void* arg);
+
+/*
+ * _stop_compaction_threads
+ * stops the background compaction threads, running jobs are finished first
+ * @param tdb the TidesDB instance
+ */
+void _stop_compaction_threads(tidesdb_t* tdb);
+
+/*
+ * _next_compaction_job
+ * picks the highest scored compaction candidate of all column families that does not conflict
+ * with a running job.  called with the compaction lock held
+ * @param tdb the TidesDB instance
+ * @return the compaction job, NULL if no trigger fired
+ */
+compaction_job_t* _next_compaction_job(tidesdb_t* tdb);
+
+/*
+ * _compaction_candidates
+ * collects the compaction candidates of a column family whose trigger fired
+ * @param cf the column family
+ * @param version the pinned version of the column family, the candidates refer to it
+ * @param candidates the candidates array, grown as needed
+ * @param num_candidates the number of candidates in the array
+ * @param cap the capacity of the candidates array
+ * @return 0 if the candidates were collected, -1 if not
+ */
+int _compaction_candidates(column_family_t* cf, tidesdb_version_t* version,
+                           compaction_candidate_t** candidates, int* num_candidates, int* cap);
+
+/*
+ * _compare_compaction_candidates
+ * compares compaction candidates, highest score first and cheapest first among equal scores
+ * @param a the first candidate
+ * @param b the second candidate
+ * @return the comparison result
+ */
+int _compare_compaction_candidates(const void* a, const void* b);
+
+/*
+ * _next_level_overlap
+ * gets the size of the sstables in the next level that overlap an sstable
+ * @param version the version
+ * @param level the level of the sstable
+ * @param index the index of the sstable
+ * @return the size in bytes
+ */
+uint64_t _next_level_overlap(const tidesdb_version_t* version, int level, int index);
+
+/*
+ * _compaction_jobs_conflict
+ * checks if two compaction jobs may not run at the same time, they conflict if they share an
+ * input, both compact level 0 or write overlapping key ranges into the same level
+ * @param a the first compaction job
+ * @param b the second compaction job
+ * @return true if the jobs conflict
+ */
+bool _compaction_jobs_conflict(const compaction_job_t* a, const compaction_job_t* b);
+
+/*
+ * _compaction_job_range
+ * gets the key range covered by the inputs of a compaction job
+ * @param job the compaction job
+ * @param min_key the smallest key, NULL if unbounded
+ * @param min_key_size the size of the smallest key
+ * @param max_key the largest key, NULL if unbounded
+ * @param max_key_size the size of the largest key
+ */
+void _compaction_job_range(const compaction_job_t* job, const uint8_t** min_key,
+                           size_t* min_key_size, const uint8_t** max_key, size_t* max_key_size);
 
 /*
  * remove_directory
@@ -587,20 +1533,35 @@ int _remove_directory(const char* path);
 
 /*
  * _compact_sstables_thread
- * a thread for compacting sstable pairs
- * @param arg the arguments for the thread in this case a compact_thread_args struct
+ * a thread for running a compaction job
+ * @param arg the arguments for the thread in this case a compaction_job_t struct
  */
-void _compact_sstables_thread(void* arg);
+void* _compact_sstables_thread(void* arg);
 
 /*
  * _merge_sstables
- * merges two sstables into a new sstable
- * @param sst1 the first sstable
- * @param sst2 the second sstable
+ * merges the inputs of a compaction job in a single sequential pass, output is split into new
+ * sstables at the target file size
+ * @param job the compaction job
+ * @return 0 if the inputs were merged, -1 if not
+ */
+int _merge_sstables(compaction_job_t* job);
+
+/*
+ * _finish_compaction_output
+ * finishes the current output of a compaction job and adds it to the job's outputs
+ * @param job the compaction job
+ * @param writer the writer of the output, set to NULL once finished
+ * @return 0 if the output was finished, -1 if not
+ */
+int _finish_compaction_output(compaction_job_t* job, sstable_writer_t** writer);
+
+/*
+ * _free_column_family
+ * free the memory for a column family, its slot in the column families is left alone
  * @param cf the column family
- * @return the new sstable
  */
-sstable_t* _merge_sstables(sstable_t* sst1, sstable_t* sst2, column_family_t* cf);
+void _free_column_family(column_family_t* cf);
 
 /*
  * _free_column_families
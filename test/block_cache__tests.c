@@ -0,0 +1,187 @@
+/*
+ *
+ * Copyright (C) TidesDB
+ *
+ * Original Author: Alex Gaetano Padula
+ *
+ * Licensed under the Mozilla Public License, v. 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.mozilla.org/en-US/MPL/2.0/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+#include <stdio.h>
+
+#include "../src/block_cache.h"
+#include "test_macros.h"
+
+#define BLOCK_SIZE     4096
+#define NUM_THREADS    8
+#define NUM_ITERATIONS 20000
+
+/* helper that makes a block whose bytes tell which sstable and page it belongs to */
+uint8_t* test_block(uint64_t id, uint64_t page)
+{
+    uint8_t* block = malloc(BLOCK_SIZE);
+    assert(block != NULL);
+    memset(block, (int)((id * 31 + page) % 251), BLOCK_SIZE);
+    memcpy(block, &id, sizeof(id));
+    memcpy(block + sizeof(id), &page, sizeof(page));
+    return block;
+}
+
+/* helper that checks a block is the one of its sstable and page */
+void check_test_block(block_cache_entry_t* entry, uint64_t id, uint64_t page)
+{
+    assert(entry->len == BLOCK_SIZE);
+    assert(memcmp(entry->data, &id, sizeof(id)) == 0);
+    assert(memcmp(entry->data + sizeof(id), &page, sizeof(page)) == 0);
+    assert(entry->data[BLOCK_SIZE - 1] == (uint8_t)((id * 31 + page) % 251));
+}
+
+void test_block_cache_insert_lookup()
+{
+    block_cache_t* cache = NULL;
+    assert(block_cache_open(1024 * 1024, &cache) == 0);
+
+    uint64_t id = block_cache_new_id(cache);
+    uint64_t other = block_cache_new_id(cache);
+    assert(id != 0 && other != id);
+
+    assert(block_cache_lookup(cache, id, 0) == NULL);
+    assert(atomic_load(&cache->misses) == 1);
+
+    block_cache_entry_t* entry = block_cache_insert(cache, id, 0, test_block(id, 0), BLOCK_SIZE);
+    assert(entry != NULL && entry->in_cache);
+    block_cache_release(cache, entry);
+
+    /* the same page of another sstable is another block */
+    assert(block_cache_lookup(cache, other, 0) == NULL);
+
+    entry = block_cache_lookup(cache, id, 0);
+    assert(entry != NULL);
+    check_test_block(entry, id, 0);
+    block_cache_release(cache, entry);
+
+    assert(atomic_load(&cache->hits) == 1);
+    assert(atomic_load(&cache->misses) == 2);
+
+    /* a block cached twice replaces the first, a reader of the first still has it */
+    block_cache_entry_t* first = block_cache_lookup(cache, id, 0);
+    entry = block_cache_insert(cache, id, 0, test_block(id, 0), BLOCK_SIZE);
+    assert(!first->in_cache && entry->in_cache);
+    check_test_block(first, id, 0);
+    block_cache_release(cache, first);
+    block_cache_release(cache, entry);
+
+    size_t entries = 0;
+    assert(block_cache_usage(cache, &entries) == BLOCK_SIZE + BLOCK_CACHE_ENTRY_CHARGE);
+    assert(entries == 1);
+
+    block_cache_close(cache);
+
+    printf(GREEN "test_block_cache_insert_lookup passed\n" RESET);
+}
+
+void test_block_cache_eviction()
+{
+    /* every shard fits four blocks */
+    size_t capacity = BLOCK_CACHE_SHARDS * 4 * (BLOCK_SIZE + BLOCK_CACHE_ENTRY_CHARGE);
+    block_cache_t* cache = NULL;
+    assert(block_cache_open(capacity, &cache) == 0);
+
+    uint64_t id = block_cache_new_id(cache);
+
+    /* a block being read is taken out of the cache by an eviction but is not freed under us */
+    block_cache_entry_t* held = block_cache_insert(cache, id, 0, test_block(id, 0), BLOCK_SIZE);
+
+    for (uint64_t page = 1; page < 1000; page++)
+    {
+        block_cache_release(cache,
+                            block_cache_insert(cache, id, page, test_block(id, page), BLOCK_SIZE));
+
+        /* the first page we cached is read all the time and stays */
+        block_cache_entry_t* hot = block_cache_lookup(cache, id, 1);
+        assert(hot != NULL);
+        block_cache_release(cache, hot);
+    }
+
+    assert(!held->in_cache);
+    check_test_block(held, id, 0);
+    block_cache_release(cache, held);
+
+    size_t entries = 0;
+    assert(block_cache_usage(cache, &entries) <= capacity);
+    assert(entries <= BLOCK_CACHE_SHARDS * 4);
+    assert(atomic_load(&cache->evictions) > 0);
+
+    /* a block larger than a shard is handed back without being cached */
+    block_cache_entry_t* large = block_cache_insert(cache, id, 5000, malloc(capacity), capacity);
+    assert(large != NULL && !large->in_cache);
+    block_cache_release(cache, large);
+    assert(block_cache_lookup(cache, id, 5000) == NULL);
+
+    block_cache_close(cache);
+
+    printf(GREEN "test_block_cache_eviction passed\n" RESET);
+}
+
+/* helper that reads blocks through the cache the way an sstable lookup does */
+void* block_cache_reader(void* arg)
+{
+    block_cache_t* cache = arg;
+
+    unsigned int seed = (unsigned int)(uintptr_t)pthread_self();
+    for (int i = 0; i < NUM_ITERATIONS; i++)
+    {
+        uint64_t id = 1 + (uint64_t)(rand_r(&seed) % 4);
+        uint64_t page = (uint64_t)(rand_r(&seed) % 512);
+
+        block_cache_entry_t* entry = block_cache_lookup(cache, id, page);
+        if (entry == NULL)
+            entry = block_cache_insert(cache, id, page, test_block(id, page), BLOCK_SIZE);
+
+        assert(entry != NULL);
+        check_test_block(entry, id, page);
+        block_cache_release(cache, entry);
+    }
+
+    return NULL;
+}
+
+void test_block_cache_concurrent()
+{
+    /* the cache holds about a quarter of the blocks read */
+    size_t capacity = 512 * (BLOCK_SIZE + BLOCK_CACHE_ENTRY_CHARGE);
+    block_cache_t* cache = NULL;
+    assert(block_cache_open(capacity, &cache) == 0);
+
+    pthread_t threads[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; i++)
+        assert(pthread_create(&threads[i], NULL, block_cache_reader, cache) == 0);
+    for (int i = 0; i < NUM_THREADS; i++) pthread_join(threads[i], NULL);
+
+    assert(atomic_load(&cache->hits) + atomic_load(&cache->misses) ==
+           (uint64_t)NUM_THREADS * NUM_ITERATIONS);
+    assert(atomic_load(&cache->hits) > 0);
+    assert(block_cache_usage(cache, NULL) <= capacity);
+
+    block_cache_close(cache);
+
+    printf(GREEN "test_block_cache_concurrent passed\n" RESET);
+}
+
+int main(void)
+{
+    test_block_cache_insert_lookup();
+    test_block_cache_eviction();
+    test_block_cache_concurrent();
+    return 0;
+}
@@ -121,6 +121,74 @@ void test_bloomfilter_chaining()
     printf(GREEN "test_bloomfilter_chaining passed\n" RESET);
 }
 
+void test_blocked_bloomfilter_add_check()
+{
+    /* 10 bits per key for 1000 keys is 10000 bits, rounded up to whole 512 bit blocks */
+    blocked_bloomfilter_t *bf = blocked_bloomfilter_create(1000, 10);
+    assert(bf != NULL);
+    assert(bf->num_blocks == 20);
+    assert(bf->num_probes == 7);
+    assert(((uintptr_t)bf->blocks % 64) == 0);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        char key[16];
+        snprintf(key, sizeof(key), "key%d", i);
+        blocked_bloomfilter_add(bf, blocked_bloomfilter_hash((uint8_t *)key, strlen(key)));
+    }
+
+    /* there are no false negatives */
+    for (int i = 0; i < 1000; i++)
+    {
+        char key[16];
+        snprintf(key, sizeof(key), "key%d", i);
+        assert(blocked_bloomfilter_check(bf, blocked_bloomfilter_hash((uint8_t *)key,
+                                                                      strlen(key))) == 0);
+    }
+
+    /* and the false positive rate stays close to 1% */
+    int false_positives = 0;
+    for (int i = 0; i < 10000; i++)
+    {
+        char key[16];
+        snprintf(key, sizeof(key), "other%d", i);
+        if (blocked_bloomfilter_check(bf, blocked_bloomfilter_hash((uint8_t *)key, strlen(key))) ==
+            0)
+            false_positives++;
+    }
+    assert(false_positives < 300);
+
+    blocked_bloomfilter_destroy(bf);
+
+    printf(GREEN "test_blocked_bloomfilter_add_check passed\n" RESET);
+}
+
+void test_blocked_bloomfilter_probes_one_block()
+{
+    blocked_bloomfilter_t *bf = blocked_bloomfilter_create(10000, 10);
+    assert(bf != NULL);
+
+    /* every bit a key sets lands in the single block picked by its hash */
+    uint64_t hash = blocked_bloomfilter_hash((const uint8_t *)"test", 4);
+    blocked_bloomfilter_add(bf, hash);
+
+    uint64_t mask[BLOCKED_BLOOMFILTER_BLOCK_WORDS];
+    uint32_t block = blocked_bloomfilter_mask(bf, hash, mask);
+
+    for (uint32_t b = 0; b < bf->num_blocks; b++)
+    {
+        for (int w = 0; w < BLOCKED_BLOOMFILTER_BLOCK_WORDS; w++)
+        {
+            uint64_t word = bf->blocks[(size_t)b * BLOCKED_BLOOMFILTER_BLOCK_WORDS + w];
+            assert(word == (b == block ? mask[w] : 0));
+        }
+    }
+
+    blocked_bloomfilter_destroy(bf);
+
+    printf(GREEN "test_blocked_bloomfilter_probes_one_block passed\n" RESET);
+}
+
 /** OR cc -g3 -fsanitize=address,undefined src/*.c external/*.c test/bloomfilter__tests.c -lzstd **/
 int main(void)
 {
@@ -128,5 +196,7 @@ int main(void)
     test_bloomfilter_add_check();
     test_bloomfilter_is_full();
     test_bloomfilter_chaining();
+    test_blocked_bloomfilter_add_check();
+    test_blocked_bloomfilter_probes_one_block();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,395 @@
+/*
+ *
+ * Copyright (C) TidesDB
+ *
+ * Original Author: Alex Gaetano Padula
+ *
+ * Licensed under the Mozilla Public License, v. 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.mozilla.org/en-US/MPL/2.0/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+
+#include "../src/log.h"
+#include "test_macros.h"
+
+#define FILE_NAME "test.log"
+
+void test_log_open_close()
+{
+    log_t* log = NULL;
+
+    assert(log_open(FILE_NAME, 1, &log) == 0);
+    assert(log != NULL);
+
+    size_t size = 1;
+    assert(log_size(log, &size) == 0);
+    assert(size == 0);
+
+    assert(log_close(log) == 0);
+
+    remove(FILE_NAME);
+
+    printf(GREEN "test_log_open_close passed\n" RESET);
+}
+
+void test_log_append_read()
+{
+    log_t* log = NULL;
+    assert(log_open(FILE_NAME, 1, &log) == 0);
+
+    /* a small entry takes its size plus a header */
+    uint8_t entry[] = "a small entry";
+    assert(log_append(log, entry, sizeof(entry), false) == 0);
+
+    size_t size = 0;
+    assert(log_size(log, &size) == 0);
+    assert(size == sizeof(entry) + LOG_HEADER_SIZE);
+
+    uint8_t* data[] = {entry, entry, entry};
+    size_t data_len[] = {sizeof(entry), sizeof(entry), sizeof(entry)};
+    assert(log_append_batch(log, data, data_len, 3, true) == 0);
+
+    assert(log_size(log, &size) == 0);
+    assert(size == 4 * (sizeof(entry) + LOG_HEADER_SIZE));
+
+    log_reader_t* reader = NULL;
+    assert(log_reader_open(log, &reader) == 0);
+
+    uint8_t* read_data = NULL;
+    size_t read_data_len = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        assert(log_reader_next(reader, &read_data, &read_data_len) == 0);
+        assert(read_data_len == sizeof(entry));
+        assert(memcmp(read_data, entry, sizeof(entry)) == 0);
+    }
+
+    assert(log_reader_next(reader, &read_data, &read_data_len) == -1);
+    assert(reader->end_offset == size);
+
+    log_reader_free(reader);
+    assert(log_close(log) == 0);
+
+    /* a reopened log appends after what is there */
+    assert(log_open(FILE_NAME, 1, &log) == 0);
+    assert(log_size(log, &size) == 0);
+    assert(size == 4 * (sizeof(entry) + LOG_HEADER_SIZE));
+
+    assert(log_append(log, entry, sizeof(entry), false) == 0);
+
+    assert(log_reader_open(log, &reader) == 0);
+
+    int count = 0;
+    while (log_reader_next(reader, &read_data, &read_data_len) == 0) count++;
+    assert(count == 5);
+
+    log_reader_free(reader);
+    assert(log_close(log) == 0);
+
+    remove(FILE_NAME);
+
+    printf(GREEN "test_log_append_read passed\n" RESET);
+}
+
+void test_log_fragments()
+{
+    log_t* log = NULL;
+    assert(log_open(FILE_NAME, 1, &log) == 0);
+
+    /* the entries cross block boundaries and leave a block tail too small for a header */
+    size_t small_len = LOG_BLOCK_SIZE - 3 * LOG_HEADER_SIZE;
+    size_t large_len = LOG_BLOCK_SIZE * 3 + 100;
+    uint8_t* small = malloc(small_len);
+    uint8_t* large = malloc(large_len);
+    assert(small != NULL && large != NULL);
+
+    for (size_t i = 0; i < small_len; i++) small[i] = (uint8_t)i;
+    for (size_t i = 0; i < large_len; i++) large[i] = (uint8_t)(i * 7);
+
+    uint8_t tiny[] = "tiny";
+    uint8_t* data[] = {small, tiny, large, tiny};
+    size_t data_len[] = {small_len, sizeof(tiny), large_len, sizeof(tiny)};
+
+    size_t expected_size = 0;
+    for (int i = 0; i < 4; i++) expected_size += log_encoded_size(expected_size, data_len[i]);
+
+    assert(log_append_batch(log, data, data_len, 4, false) == 0);
+
+    size_t size = 0;
+    assert(log_size(log, &size) == 0);
+    assert(size == expected_size);
+
+    log_reader_t* reader = NULL;
+    assert(log_reader_open(log, &reader) == 0);
+
+    uint8_t* read_data = NULL;
+    size_t read_data_len = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        assert(log_reader_next(reader, &read_data, &read_data_len) == 0);
+        assert(read_data_len == data_len[i]);
+        assert(memcmp(read_data, data[i], data_len[i]) == 0);
+    }
+
+    assert(log_reader_next(reader, &read_data, &read_data_len) == -1);
+
+    log_reader_free(reader);
+    assert(log_close(log) == 0);
+
+    free(small);
+    free(large);
+
+    remove(FILE_NAME);
+
+    printf(GREEN "test_log_fragments passed\n" RESET);
+}
+
+void test_log_append_batchv()
+{
+    log_t* log = NULL;
+    assert(log_open(FILE_NAME, 1, &log) == 0);
+
+    /* the entries are gathered from parts, the second one crosses block boundaries */
+    size_t large_len = LOG_BLOCK_SIZE * 2 + 50;
+    uint8_t* large = malloc(large_len);
+    assert(large != NULL);
+    for (size_t i = 0; i < large_len; i++) large[i] = (uint8_t)(i * 3);
+
+    uint8_t head[] = "head";
+    uint8_t tail[] = "tail";
+    struct iovec parts[] = {{head, sizeof(head)}, {tail, sizeof(tail)}, {head, sizeof(head)},
+                            {large, large_len},   {tail, sizeof(tail)}, {tail, 0}};
+    size_t parts_count[] = {2, 4};
+
+    size_t first_len = sizeof(head) + sizeof(tail);
+    size_t second_len = sizeof(head) + large_len + sizeof(tail);
+
+    assert(log_append_batchv(log, parts, parts_count, 2, false) == 0);
+
+    size_t size = 0;
+    assert(log_size(log, &size) == 0);
+    assert(size == log_encoded_size(0, first_len) +
+                       log_encoded_size(log_encoded_size(0, first_len), second_len));
+
+    log_reader_t* reader = NULL;
+    assert(log_reader_open(log, &reader) == 0);
+
+    uint8_t* read_data = NULL;
+    size_t read_data_len = 0;
+    assert(log_reader_next(reader, &read_data, &read_data_len) == 0);
+    assert(read_data_len == first_len);
+    assert(memcmp(read_data, head, sizeof(head)) == 0);
+    assert(memcmp(read_data + sizeof(head), tail, sizeof(tail)) == 0);
+
+    assert(log_reader_next(reader, &read_data, &read_data_len) == 0);
+    assert(read_data_len == second_len);
+    assert(memcmp(read_data, head, sizeof(head)) == 0);
+    assert(memcmp(read_data + sizeof(head), large, large_len) == 0);
+    assert(memcmp(read_data + sizeof(head) + large_len, tail, sizeof(tail)) == 0);
+
+    assert(log_reader_next(reader, &read_data, &read_data_len) == -1);
+
+    log_reader_free(reader);
+    assert(log_close(log) == 0);
+
+    free(large);
+
+    remove(FILE_NAME);
+
+    printf(GREEN "test_log_append_batchv passed\n" RESET);
+}
+
+void test_log_read_buffers()
+{
+    log_t* log = NULL;
+    assert(log_open(FILE_NAME, 1, &log) == 0);
+
+    /* the entries fill several reader buffers, some of them are split across two */
+    uint8_t entry[1000];
+    size_t count = 0;
+    size_t size = 0;
+    while (size < LOG_READ_SIZE * 3)
+    {
+        size_t entry_len = 1 + (count * 37) % sizeof(entry);
+        memset(entry, (int)(count & 0xff), entry_len);
+        assert(log_append(log, entry, entry_len, false) == 0);
+        assert(log_size(log, &size) == 0);
+        count++;
+    }
+
+    log_reader_t* reader = NULL;
+    assert(log_reader_open(log, &reader) == 0);
+
+    uint8_t* read_data = NULL;
+    size_t read_data_len = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        assert(log_reader_next(reader, &read_data, &read_data_len) == 0);
+        assert(read_data_len == 1 + (i * 37) % sizeof(entry));
+        assert(read_data[0] == (uint8_t)(i & 0xff));
+        assert(read_data[read_data_len - 1] == (uint8_t)(i & 0xff));
+    }
+
+    assert(log_reader_next(reader, &read_data, &read_data_len) == -1);
+    assert(reader->end_offset == size);
+
+    log_reader_free(reader);
+    assert(log_close(log) == 0);
+
+    remove(FILE_NAME);
+
+    printf(GREEN "test_log_read_buffers passed\n" RESET);
+}
+
+void test_log_torn_tail()
+{
+    log_t* log = NULL;
+    assert(log_open(FILE_NAME, 1, &log) == 0);
+
+    uint8_t entry[] = "an entry";
+    size_t large_len = LOG_BLOCK_SIZE * 2;
+    uint8_t* large = malloc(large_len);
+    assert(large != NULL);
+    memset(large, 'l', large_len);
+
+    assert(log_append(log, entry, sizeof(entry), false) == 0);
+    assert(log_append(log, entry, sizeof(entry), false) == 0);
+
+    size_t whole_size = 0;
+    assert(log_size(log, &whole_size) == 0);
+
+    /* the large entry is cut off in its last fragment as if a crash tore the write */
+    assert(log_append(log, large, large_len, false) == 0);
+
+    size_t size = 0;
+    assert(log_size(log, &size) == 0);
+    assert(log_truncate(log, size - 10) == 0);
+
+    log_reader_t* reader = NULL;
+    assert(log_reader_open(log, &reader) == 0);
+
+    uint8_t* read_data = NULL;
+    size_t read_data_len = 0;
+    assert(log_reader_next(reader, &read_data, &read_data_len) == 0);
+    assert(log_reader_next(reader, &read_data, &read_data_len) == 0);
+    assert(log_reader_next(reader, &read_data, &read_data_len) == -1);
+
+    /* the log is whole up to the torn entry */
+    assert(reader->end_offset == whole_size);
+    log_reader_free(reader);
+
+    /* a flipped byte fails the checksum of the second entry */
+    assert(log_truncate(log, whole_size) == 0);
+
+    int fd = open(FILE_NAME, O_RDWR);
+    assert(fd != -1);
+    uint8_t flipped = 'X';
+    assert(pwrite(fd, &flipped, 1, LOG_HEADER_SIZE + sizeof(entry) + LOG_HEADER_SIZE) == 1);
+    close(fd);
+
+    assert(log_reader_open(log, &reader) == 0);
+    assert(log_reader_next(reader, &read_data, &read_data_len) == 0);
+    assert(log_reader_next(reader, &read_data, &read_data_len) == -1);
+    assert(reader->end_offset == LOG_HEADER_SIZE + sizeof(entry));
+    log_reader_free(reader);
+
+    /* zeros past the end, like space that was never written, end the log */
+    assert(log_truncate(log, LOG_HEADER_SIZE + sizeof(entry)) == 0);
+    assert(log_truncate(log, LOG_BLOCK_SIZE) == 0);
+
+    assert(log_reader_open(log, &reader) == 0);
+    assert(log_reader_next(reader, &read_data, &read_data_len) == 0);
+    assert(log_reader_next(reader, &read_data, &read_data_len) == -1);
+    log_reader_free(reader);
+
+    assert(log_close(log) == 0);
+
+    free(large);
+
+    remove(FILE_NAME);
+
+    printf(GREEN "test_log_torn_tail passed\n" RESET);
+}
+
+void test_log_create_recycle()
+{
+    log_t* log = NULL;
+    assert(log_create(FILE_NAME, 1, LOG_BLOCK_SIZE * 4, &log) == 0);
+
+    /* a preallocated log starts empty and reads as empty */
+    size_t size = 1;
+    assert(log_size(log, &size) == 0);
+    assert(size == 0);
+
+    struct stat log_stat;
+    assert(stat(FILE_NAME, &log_stat) == 0);
+    assert(log_stat.st_size == LOG_BLOCK_SIZE * 4);
+
+    uint8_t old_entry[] = "an entry of the old log";
+    for (int i = 0; i < 3; i++) assert(log_append(log, old_entry, sizeof(old_entry), false) == 0);
+
+    /* appends fill the preallocated space instead of growing the file */
+    assert(stat(FILE_NAME, &log_stat) == 0);
+    assert(log_stat.st_size == LOG_BLOCK_SIZE * 4);
+
+    log_reader_t* reader = NULL;
+    assert(log_reader_open(log, &reader) == 0);
+
+    uint8_t* read_data = NULL;
+    size_t read_data_len = 0;
+    int count = 0;
+    while (log_reader_next(reader, &read_data, &read_data_len) == 0) count++;
+    assert(count == 3);
+
+    log_reader_free(reader);
+    assert(log_close(log) == 0);
+
+    /* the file is recycled for a log with another number, the entries it held are not read */
+    assert(log_create(FILE_NAME, 2, LOG_BLOCK_SIZE * 4, &log) == 0);
+
+    uint8_t entry[] = "new";
+    assert(log_append(log, entry, sizeof(entry), false) == 0);
+
+    assert(log_reader_open(log, &reader) == 0);
+    assert(log_reader_next(reader, &read_data, &read_data_len) == 0);
+    assert(read_data_len == sizeof(entry));
+    assert(memcmp(read_data, entry, sizeof(entry)) == 0);
+    assert(log_reader_next(reader, &read_data, &read_data_len) == -1);
+    log_reader_free(reader);
+
+    assert(log_close(log) == 0);
+
+    /* a log opened with the wrong number has no entries */
+    assert(log_open(FILE_NAME, 1, &log) == 0);
+    assert(log_reader_open(log, &reader) == 0);
+    assert(log_reader_next(reader, &read_data, &read_data_len) == -1);
+    log_reader_free(reader);
+    assert(log_close(log) == 0);
+
+    remove(FILE_NAME);
+
+    printf(GREEN "test_log_create_recycle passed\n" RESET);
+}
+
+/** OR cc -g3 -fsanitize=address,undefined src/*.c external/*.c test/log__tests.c -lzstd **/
+int main(void)
+{
+    remove(FILE_NAME);
+    test_log_open_close();
+    test_log_append_read();
+    test_log_fragments();
+    test_log_append_batchv();
+    test_log_read_buffers();
+    test_log_torn_tail();
+    test_log_create_recycle();
+    return 0;
+}
@@ -0,0 +1,369 @@
+/*
+ *
+ * Copyright (C) TidesDB
+ *
+ * Original Author: Alex Gaetano Padula
+ *
+ * Licensed under the Mozilla Public License, v. 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.mozilla.org/en-US/MPL/2.0/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+
+#include "../src/manifest.h"
+#include "test_macros.h"
+#include "test_utils.h"
+
+#define TEST_DIR "testmanifest"
+
+/* helper that fills in an sstable as the manifest records it */
+manifest_table_t test_manifest_table(char* name, uint32_t level, uint64_t sequence)
+{
+    manifest_table_t table = {0};
+    table.name = name;
+    table.level = level;
+    table.sequence = sequence;
+    table.file_number = sequence + 100;
+    table.num_entries = sequence * 10;
+    table.size = sequence * 4096;
+    table.num_tombstones = sequence * 2;
+    table.num_ttl = sequence * 3;
+    table.min_ttl = (int64_t)sequence * 1000;
+    table.max_ttl = (int64_t)sequence * 2000;
+    table.min_key = (uint8_t*)"aaa";
+    table.min_key_size = 3;
+    table.max_key = (uint8_t*)"zzzz";
+    table.max_key_size = 4;
+    return table;
+}
+
+/* helper that creates an empty file in the test directory */
+void touch_test_file(const char* name)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", TEST_DIR, name);
+
+    FILE* file = fopen(path, "w");
+    assert(file != NULL);
+    fclose(file);
+}
+
+/* helper that checks whether a file is in the test directory */
+bool test_file_exists(const char* name)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", TEST_DIR, name);
+    return access(path, F_OK) == 0;
+}
+
+void test_manifest_encode_decode_edit()
+{
+    manifest_table_t added[2];
+    added[0] = test_manifest_table("sstable_1.sst", 0, 1);
+    added[1] = test_manifest_table("sstable_2.sst", 2, 7);
+
+    /* an sstable whose keys are not known */
+    added[1].min_key = NULL;
+    added[1].max_key = NULL;
+
+    char* removed[] = {"sstable_0.sst"};
+    manifest_edit_t edit = {added, 2, removed, 1, 103, 8};
+
+    size_t size = manifest_edit_size(&edit);
+    uint8_t* buffer = malloc(size);
+    assert(buffer != NULL);
+    manifest_encode_edit(&edit, buffer);
+
+    manifest_edit_t* decoded = NULL;
+    assert(manifest_decode_edit(buffer, size, &decoded) == 0);
+    assert(decoded->num_added == 2);
+    assert(decoded->num_removed == 1);
+    assert(decoded->next_file_number == 103);
+    assert(decoded->next_sequence == 8);
+
+    assert(strcmp(decoded->added[0].name, "sstable_1.sst") == 0);
+    assert(decoded->added[0].level == 0);
+    assert(decoded->added[0].sequence == 1);
+    assert(decoded->added[0].file_number == 101);
+    assert(decoded->added[0].num_entries == 10);
+    assert(decoded->added[0].size == 4096);
+    assert(decoded->added[0].num_tombstones == 2);
+    assert(decoded->added[0].num_ttl == 3);
+    assert(decoded->added[0].min_ttl == 1000);
+    assert(decoded->added[0].max_ttl == 2000);
+    assert(decoded->added[0].min_key_size == 3);
+    assert(memcmp(decoded->added[0].min_key, "aaa", 3) == 0);
+    assert(decoded->added[0].max_key_size == 4);
+    assert(memcmp(decoded->added[0].max_key, "zzzz", 4) == 0);
+
+    assert(strcmp(decoded->added[1].name, "sstable_2.sst") == 0);
+    assert(decoded->added[1].level == 2);
+    assert(decoded->added[1].sequence == 7);
+    assert(decoded->added[1].file_number == 107);
+    assert(decoded->added[1].min_key == NULL);
+    assert(decoded->added[1].max_key == NULL);
+
+    assert(strcmp(decoded->removed[0], "sstable_0.sst") == 0);
+
+    manifest_free_edit(decoded);
+
+    /* an edit cut short or with bytes left over is malformed */
+    for (size_t cut = 0; cut < size; cut++)
+        assert(manifest_decode_edit(buffer, cut, &decoded) == -1);
+
+    uint8_t* longer = malloc(size + 1);
+    assert(longer != NULL);
+    memcpy(longer, buffer, size);
+    longer[size] = 0;
+    assert(manifest_decode_edit(longer, size + 1, &decoded) == -1);
+
+    free(longer);
+    free(buffer);
+
+    printf(GREEN "test_manifest_encode_decode_edit passed\n" RESET);
+}
+
+void test_manifest_open_append_reopen()
+{
+    mkdir(TEST_DIR, 0777);
+
+    /* a directory without a manifest gets an empty one */
+    assert(!manifest_exists(TEST_DIR));
+
+    manifest_t* manifest = NULL;
+    assert(manifest_open(TEST_DIR, &manifest) == 0);
+    assert(manifest->num_tables == 0);
+    assert(manifest_exists(TEST_DIR));
+
+    manifest_table_t added[3];
+    added[0] = test_manifest_table("sstable_a.sst", 0, 1);
+    added[1] = test_manifest_table("sstable_b.sst", 0, 2);
+    added[2] = test_manifest_table("sstable_c.sst", 1, 2);
+
+    manifest_edit_t flush = {added, 2, NULL, 0, 104, 3};
+    assert(manifest_append(manifest, &flush) == 0);
+    assert(manifest->num_tables == 2);
+    assert(manifest->next_file_number == 104);
+    assert(manifest->next_sequence == 3);
+
+    /* a compaction replaces its inputs with its outputs in one edit, it leaves the sequence be and
+     * a counter from a compaction that finished late does not go back */
+    char* removed[] = {"sstable_a.sst", "sstable_b.sst"};
+    manifest_edit_t compaction = {&added[2], 1, removed, 2, 103, 0};
+    assert(manifest_append(manifest, &compaction) == 0);
+    assert(manifest->num_tables == 1);
+    assert(manifest->next_file_number == 104);
+    assert(manifest->next_sequence == 3);
+    assert(manifest_find(manifest, "sstable_c.sst") == 0);
+    assert(manifest_find(manifest, "sstable_a.sst") == -1);
+
+    assert(manifest_close(manifest) == 0);
+
+    /* the file of a removed sstable outlived a crash, the reopen removes it */
+    touch_test_file("sstable_a.sst");
+    touch_test_file("sstable_c.sst");
+
+    assert(manifest_open(TEST_DIR, &manifest) == 0);
+    assert(manifest->num_tables == 1);
+    assert(strcmp(manifest->tables[0].name, "sstable_c.sst") == 0);
+    assert(manifest->tables[0].level == 1);
+    assert(manifest->tables[0].sequence == 2);
+    assert(manifest->tables[0].file_number == 102);
+    assert(manifest->tables[0].num_entries == 20);
+    assert(manifest->tables[0].size == 8192);
+    assert(manifest->tables[0].num_tombstones == 4);
+    assert(manifest->tables[0].max_ttl == 4000);
+    assert(memcmp(manifest->tables[0].max_key, "zzzz", 4) == 0);
+
+    /* the counters outlive the rewrite on open */
+    assert(manifest->next_file_number == 104);
+    assert(manifest->next_sequence == 3);
+
+    assert(!test_file_exists("sstable_a.sst"));
+    assert(test_file_exists("sstable_c.sst"));
+    assert(!test_file_exists(MANIFEST_FILE MANIFEST_TMP_EXT));
+
+    assert(manifest_close(manifest) == 0);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_manifest_open_append_reopen passed\n" RESET);
+}
+
+void test_manifest_torn_tail()
+{
+    mkdir(TEST_DIR, 0777);
+
+    manifest_t* manifest = NULL;
+    assert(manifest_open(TEST_DIR, &manifest) == 0);
+
+    manifest_table_t first = test_manifest_table("sstable_1.sst", 0, 1);
+    manifest_edit_t edit = {.added = &first, .num_added = 1};
+    assert(manifest_append(manifest, &edit) == 0);
+
+    size_t size = 0;
+    assert(log_size(manifest->log, &size) == 0);
+
+    manifest_table_t second = test_manifest_table("sstable_2.sst", 0, 2);
+    edit.added = &second;
+    assert(manifest_append(manifest, &edit) == 0);
+
+    assert(manifest_close(manifest) == 0);
+
+    /* a crash tears the second edit */
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", TEST_DIR, MANIFEST_FILE);
+    assert(truncate(path, size + 10) == 0);
+
+    assert(manifest_open(TEST_DIR, &manifest) == 0);
+    assert(manifest->num_tables == 1);
+    assert(strcmp(manifest->tables[0].name, "sstable_1.sst") == 0);
+
+    /* the torn tail is gone, what is appended now is found again */
+    manifest_table_t third = test_manifest_table("sstable_3.sst", 0, 3);
+    edit.added = &third;
+    assert(manifest_append(manifest, &edit) == 0);
+    assert(manifest_close(manifest) == 0);
+
+    assert(manifest_open(TEST_DIR, &manifest) == 0);
+    assert(manifest->num_tables == 2);
+    assert(strcmp(manifest->tables[0].name, "sstable_1.sst") == 0);
+    assert(strcmp(manifest->tables[1].name, "sstable_3.sst") == 0);
+    assert(manifest_close(manifest) == 0);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_manifest_torn_tail passed\n" RESET);
+}
+
+void test_manifest_rewrite_on_growth()
+{
+    mkdir(TEST_DIR, 0777);
+
+    manifest_t* manifest = NULL;
+    assert(manifest_open(TEST_DIR, &manifest) == 0);
+
+    /* a long running column family adds and removes far more sstables than it keeps, large keys
+     * make every edit take a few kilobytes */
+    uint8_t key[4096];
+    memset(key, 'k', sizeof(key));
+
+    char name[64];
+    char previous[64] = "";
+    size_t largest = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        snprintf(name, sizeof(name), "sstable_%d.sst", i);
+        manifest_table_t table = test_manifest_table(name, 0, (uint64_t)i + 1);
+        table.min_key = key;
+        table.min_key_size = sizeof(key);
+
+        char* removed[] = {previous};
+        manifest_edit_t edit = {.added = &table,
+                                .num_added = 1,
+                                .removed = removed,
+                                .num_removed = previous[0] != '\0' ? 1 : 0};
+        assert(manifest_append(manifest, &edit) == 0);
+
+        size_t size = 0;
+        assert(log_size(manifest->log, &size) == 0);
+        if (size > largest) largest = size;
+
+        snprintf(previous, sizeof(previous), "%s", name);
+    }
+
+    assert(largest <= MANIFEST_MAX_SIZE + LOG_BLOCK_SIZE);
+    assert(manifest->num_tables == 1);
+    assert(manifest_close(manifest) == 0);
+
+    assert(manifest_open(TEST_DIR, &manifest) == 0);
+    assert(manifest->num_tables == 1);
+    assert(strcmp(manifest->tables[0].name, "sstable_999.sst") == 0);
+    assert(manifest_close(manifest) == 0);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_manifest_rewrite_on_growth passed\n" RESET);
+}
+
+void test_manifest_rewrite_fails()
+{
+    mkdir(TEST_DIR, 0777);
+
+    manifest_t* manifest = NULL;
+    assert(manifest_open(TEST_DIR, &manifest) == 0);
+
+    /* a directory in place of the new manifest makes every rewrite fail, it is not empty so the
+     * rewrite cannot remove it */
+    char tmp_path[PATH_MAX];
+    snprintf(tmp_path, sizeof(tmp_path), "%s/%s%s", TEST_DIR, MANIFEST_FILE, MANIFEST_TMP_EXT);
+    assert(mkdir(tmp_path, 0777) == 0);
+
+    char blocker_path[PATH_MAX];
+    snprintf(blocker_path, sizeof(blocker_path), "%s/blocker", tmp_path);
+    FILE* blocker = fopen(blocker_path, "w");
+    assert(blocker != NULL);
+    fclose(blocker);
+
+    uint8_t key[4096];
+    memset(key, 'k', sizeof(key));
+
+    /* the edits are durable, so every append succeeds though the manifest is not folded */
+    char name[64];
+    for (int i = 0; i < 1200; i++)
+    {
+        snprintf(name, sizeof(name), "sstable_%d.sst", i);
+        manifest_table_t table = test_manifest_table(name, 0, (uint64_t)i + 1);
+        table.min_key = key;
+        table.min_key_size = sizeof(key);
+
+        manifest_edit_t edit = {.added = &table, .num_added = 1};
+        assert(manifest_append(manifest, &edit) == 0);
+    }
+
+    size_t size = 0;
+    assert(log_size(manifest->log, &size) == 0);
+    assert(size > MANIFEST_MAX_SIZE);
+    assert(manifest->num_tables == 1200);
+
+    /* once the rewrite can go through again the next append folds the manifest */
+    assert(remove(blocker_path) == 0);
+    assert(rmdir(tmp_path) == 0);
+
+    manifest_table_t last = test_manifest_table("sstable_1200.sst", 0, 1201);
+    manifest_edit_t edit = {.added = &last, .num_added = 1};
+    assert(manifest_append(manifest, &edit) == 0);
+
+    size_t rewritten = 0;
+    assert(log_size(manifest->log, &rewritten) == 0);
+    assert(rewritten < size);
+    assert(manifest_close(manifest) == 0);
+
+    assert(manifest_open(TEST_DIR, &manifest) == 0);
+    assert(manifest->num_tables == 1201);
+    assert(strcmp(manifest->tables[1200].name, "sstable_1200.sst") == 0);
+    assert(manifest_close(manifest) == 0);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_manifest_rewrite_fails passed\n" RESET);
+}
+
+int main(void)
+{
+    remove_directory(TEST_DIR);
+    test_manifest_encode_decode_edit();
+    test_manifest_open_append_reopen();
+    test_manifest_torn_tail();
+    test_manifest_rewrite_on_growth();
+    test_manifest_rewrite_fails();
+    return 0;
+}
@@ -454,7 +454,352 @@ void test_pager_concurrent_write_read()
     printf(GREEN "test_pager_concurrent_write_read passed\n" RESET);
 }
 
+void test_pager_write_batch()
+{
+    pager_t* p = NULL;
+
+    assert(pager_open(FILE_NAME, &p) == 0);
+    assert(p != NULL);
+
+    /* a page written on its own comes before the batch */
+    uint8_t first[] = "first";
+    unsigned int first_page_num = 0;
+    assert(pager_write(p, first, sizeof(first), &first_page_num) == 0);
+
+    /* the second entry overflows into more pages */
+    uint8_t small[] = "small";
+    uint8_t large[PAGE_BODY * 2 + 100];
+    memset(large, 'l', sizeof(large));
+    uint8_t last[] = "last";
+
+    uint8_t* data[] = {small, large, last};
+    size_t data_len[] = {sizeof(small), sizeof(large), sizeof(last)};
+    unsigned int page_nums[3] = {0};
+
+    assert(pager_write_batch(p, data, data_len, 3, page_nums, true) == 0);
+    assert(page_nums[0] == first_page_num + 1);
+    assert(page_nums[1] == page_nums[0] + 1);
+    assert(page_nums[2] == page_nums[1] + 3);
+
+    size_t num_pages = 0;
+    assert(pager_pages_count(p, &num_pages) == 0);
+    assert(num_pages == 6);
+
+    for (int i = 0; i < 3; i++)
+    {
+        uint8_t* read_data = NULL;
+        size_t read_data_len = 0;
+
+        assert(pager_read(p, page_nums[i], &read_data, &read_data_len) == 0);
+        assert(read_data_len == data_len[i]);
+        assert(memcmp(read_data, data[i], data_len[i]) == 0);
+
+        free(read_data);
+    }
+
+    /* a cursor stops once per entry of the batch */
+    pager_cursor_t* cursor = NULL;
+    assert(pager_cursor_init(p, &cursor) == 0);
+
+    for (int i = 0; i < 3; i++) assert(pager_cursor_next(cursor) == 0);
+
+    assert(pager_cursor_next(cursor) == -1);
+    pager_cursor_free(cursor);
+
+    assert(pager_close(p) == 0);
+
+    remove(FILE_NAME);
+
+    printf(GREEN "test_pager_write_batch passed\n" RESET);
+}
+
 /** OR cc -g3 -fsanitize=address,undefined src/*.c external/*.c test/pager__tests.c -lzstd **/
+void test_pager_immutable_read()
+{
+    pager_t* p = NULL;
+    assert(pager_open(FILE_NAME, &p) == 0);
+
+    /* the large entry overflows past the pages read at once */
+    uint8_t small[] = "small";
+    uint8_t large[PAGE_BODY * (PAGER_READ_PAGES + 2) + 7];
+    for (size_t i = 0; i < sizeof(large); i++) large[i] = (uint8_t)(i % 251);
+    uint8_t last[] = "last";
+
+    uint8_t* data[] = {small, large, last};
+    size_t data_len[] = {sizeof(small), sizeof(large), sizeof(last)};
+    unsigned int page_nums[3] = {0};
+
+    assert(pager_write(p, small, sizeof(small), &page_nums[0]) == 0);
+    assert(pager_write_batch(p, &data[1], &data_len[1], 2, &page_nums[1], false) == 0);
+
+    /* a sealed pager reads what it wrote */
+    assert(pager_seal(p) == 0);
+    assert(p->immutable);
+    assert(p->page_locks == NULL);
+
+    unsigned int page_num = 0;
+    assert(pager_write(p, small, sizeof(small), &page_num) == -1);
+    assert(pager_truncate(p, 0) == -1);
+
+    for (int i = 0; i < 3; i++)
+    {
+        uint8_t* read_data = NULL;
+        size_t read_data_len = 0;
+        assert(pager_read(p, page_nums[i], &read_data, &read_data_len) == 0);
+        assert(read_data_len == data_len[i]);
+        assert(memcmp(read_data, data[i], data_len[i]) == 0);
+        free(read_data);
+    }
+
+    assert(pager_close(p) == 0);
+
+    /* the file opened immutable reads the same, past the last page is an error */
+    assert(pager_open_immutable(FILE_NAME, &p) == 0);
+    assert(p->immutable);
+    assert(p->num_pages == page_nums[2] + 1);
+
+    for (int i = 2; i >= 0; i--)
+    {
+        uint8_t* read_data = NULL;
+        size_t read_data_len = 0;
+        assert(pager_read(p, page_nums[i], &read_data, &read_data_len) == 0);
+        assert(read_data_len == data_len[i]);
+        assert(memcmp(read_data, data[i], data_len[i]) == 0);
+        free(read_data);
+    }
+
+    uint8_t* read_data = NULL;
+    size_t read_data_len = 0;
+    assert(pager_read(p, page_nums[2] + 1, &read_data, &read_data_len) == -1);
+    free(read_data);
+
+    assert(pager_write(p, small, sizeof(small), &page_num) == -1);
+
+    /* the cursor stops once per entry either way */
+    pager_cursor_t* cursor = NULL;
+    assert(pager_cursor_init(p, &cursor) == 0);
+    for (int i = 1; i < 3; i++) assert(pager_cursor_next(cursor) == 0);
+    assert(pager_cursor_next(cursor) == -1);
+    assert(pager_cursor_get(cursor, &page_num) == 0);
+    assert(page_num == page_nums[2]);
+
+    /* going back skips the pages the large entry overflowed into */
+    assert(pager_cursor_prev(cursor) == 0);
+    assert(pager_cursor_prev(cursor) == 0);
+    assert(pager_cursor_get(cursor, &page_num) == 0);
+    assert(page_num == page_nums[0]);
+    pager_cursor_free(cursor);
+
+    assert(pager_close(p) == 0);
+
+    /* a file that is not there is not created */
+    remove(FILE_NAME);
+    assert(pager_open_immutable(FILE_NAME, &p) == -1);
+
+    printf(GREEN "test_pager_immutable_read passed\n" RESET);
+}
+
+void* read_immutable_pages(void* arg)
+{
+    thread_data_t* data = (thread_data_t*)arg;
+    pager_t* p = data->pager;
+
+    /* every thread reads every page, starting at a different one */
+    for (int i = 0; i < NUM_ITERATIONS; i++)
+    {
+        int page = (i + data->thread_id * 7) % NUM_ITERATIONS;
+
+        uint8_t expected[PAGE_BODY + 64];
+        memset(expected, 'a' + page % 26, sizeof(expected));
+        memcpy(expected, &page, sizeof(page));
+
+        uint8_t* read_value = NULL;
+        size_t read_value_size = 0;
+        assert(pager_read(p, page * 2, &read_value, &read_value_size) == 0);
+        assert(read_value_size == sizeof(expected));
+        assert(memcmp(read_value, expected, sizeof(expected)) == 0);
+        free(read_value);
+    }
+
+    return NULL;
+}
+
+void test_pager_concurrent_immutable_read()
+{
+    pager_t* p = NULL;
+    assert(pager_open(FILE_NAME, &p) == 0);
+
+    /* every entry overflows into a second page */
+    for (int i = 0; i < NUM_ITERATIONS; i++)
+    {
+        uint8_t value[PAGE_BODY + 64];
+        memset(value, 'a' + i % 26, sizeof(value));
+        memcpy(value, &i, sizeof(i));
+
+        unsigned int page_num = 0;
+        assert(pager_write(p, value, sizeof(value), &page_num) == 0);
+        assert(page_num == (unsigned int)i * 2);
+    }
+    assert(pager_close(p) == 0);
+
+    assert(pager_open_immutable(FILE_NAME, &p) == 0);
+
+    pthread_t threads[NUM_THREADS];
+    thread_data_t thread_data[NUM_THREADS];
+
+    for (int i = 0; i < NUM_THREADS; i++)
+    {
+        thread_data[i].pager = p;
+        thread_data[i].thread_id = i;
+        pthread_create(&threads[i], NULL, read_immutable_pages, &thread_data[i]);
+    }
+
+    for (int i = 0; i < NUM_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    assert(pager_close(p) == 0);
+    remove(FILE_NAME);
+
+    printf(GREEN "test_pager_concurrent_immutable_read passed\n" RESET);
+}
+
+void test_pager_lock_stripes()
+{
+    remove(FILE_NAME);
+
+    pager_t* p = NULL;
+    assert(pager_open(FILE_NAME, &p) == 0);
+
+    /* a file many times the stripes long keeps the same locks */
+    pthread_rwlock_t* locks = p->page_locks;
+    for (int i = 0; i < PAGER_LOCK_STRIPES * 3; i++)
+    {
+        unsigned int page_num = 0;
+        assert(pager_write(p, (uint8_t*)&i, sizeof(i), &page_num) == 0);
+        assert(page_num == (unsigned int)i);
+    }
+    assert(p->page_locks == locks);
+    assert(pager_page_lock(p, 1) == pager_page_lock(p, 1 + PAGER_LOCK_STRIPES));
+    assert(pager_page_lock(p, 1) != pager_page_lock(p, 2));
+    assert(pager_close(p) == 0);
+
+    /* opening it again takes the same number of locks */
+    assert(pager_open(FILE_NAME, &p) == 0);
+    assert(p->num_pages == PAGER_LOCK_STRIPES * 3);
+
+    for (int i = 0; i < PAGER_LOCK_STRIPES * 3; i++)
+    {
+        uint8_t* read_data = NULL;
+        size_t read_data_len = 0;
+        assert(pager_read(p, i, &read_data, &read_data_len) == 0);
+        assert(read_data_len == sizeof(i));
+        assert(memcmp(read_data, &i, sizeof(i)) == 0);
+        free(read_data);
+    }
+
+    /* pages written after a truncate reuse the stripes */
+    assert(pager_truncate(p, PAGE_SIZE) == 0);
+    assert(p->num_pages == 1);
+
+    int value = 42;
+    unsigned int page_num = 0;
+    assert(pager_write(p, (uint8_t*)&value, sizeof(value), &page_num) == 0);
+    assert(page_num == 1);
+
+    uint8_t* read_data = NULL;
+    size_t read_data_len = 0;
+    assert(pager_read(p, page_num, &read_data, &read_data_len) == 0);
+    assert(memcmp(read_data, &value, sizeof(value)) == 0);
+    free(read_data);
+
+    assert(pager_close(p) == 0);
+    remove(FILE_NAME);
+
+    printf(GREEN "test_pager_lock_stripes passed\n" RESET);
+}
+
+void test_pager_map()
+{
+    remove(FILE_NAME);
+
+    pager_t* p = NULL;
+    assert(pager_open(FILE_NAME, &p) == 0);
+
+    /* only an immutable file is mapped, an empty one has nothing to map */
+    assert(pager_map(p) == -1);
+    assert(pager_seal(p) == 0);
+    assert(pager_map(p) == -1);
+    assert(pager_close(p) == 0);
+
+    assert(pager_open(FILE_NAME, &p) == 0);
+
+    uint8_t small[] = "small";
+    uint8_t large[PAGE_BODY * 3 + 10];
+    for (size_t i = 0; i < sizeof(large); i++) large[i] = (uint8_t)(i % 253);
+
+    unsigned int small_page = 0;
+    unsigned int large_page = 0;
+    assert(pager_write(p, small, sizeof(small), &small_page) == 0);
+    assert(pager_write(p, large, sizeof(large), &large_page) == 0);
+    assert(pager_seal(p) == 0);
+
+    /* a sealed pager maps what it wrote */
+    assert(pager_map(p) == 0);
+    assert(p->map != NULL);
+    assert(p->map_size == p->num_pages * PAGE_SIZE);
+    assert(pager_advise(p, MADV_SEQUENTIAL) == 0);
+    assert(pager_advise(p, MADV_RANDOM) == 0);
+
+    pager_view_t view;
+    assert(pager_view(p, small_page, &view) == 0);
+    assert(view.len == sizeof(small));
+    assert(memcmp(pager_view_ptr(&view, 0, view.len), small, sizeof(small)) == 0);
+
+    /* bytes split by a page header are copied, nothing else is */
+    assert(pager_view(p, large_page, &view) == 0);
+    assert(view.len == sizeof(large));
+    assert(pager_view_ptr(&view, PAGE_BODY - 4, 8) == NULL);
+    assert(memcmp(pager_view_ptr(&view, PAGE_BODY, 8), large + PAGE_BODY, 8) == 0);
+
+    uint8_t copy[sizeof(large)];
+    pager_view_copy(&view, 0, copy, sizeof(copy));
+    assert(memcmp(copy, large, sizeof(large)) == 0);
+    pager_view_copy(&view, PAGE_BODY - 4, copy, 8);
+    assert(memcmp(copy, large + PAGE_BODY - 4, 8) == 0);
+
+    /* reads and cursors go through the mapping */
+    uint8_t* read_data = NULL;
+    size_t read_data_len = 0;
+    assert(pager_read(p, large_page, &read_data, &read_data_len) == 0);
+    assert(read_data_len == sizeof(large));
+    assert(memcmp(read_data, large, sizeof(large)) == 0);
+    free(read_data);
+
+    pager_cursor_t* cursor = NULL;
+    assert(pager_cursor_init(p, &cursor) == 0);
+    assert(pager_cursor_next(cursor) == 0);
+    assert(pager_cursor_next(cursor) == -1);
+    pager_cursor_free(cursor);
+
+    /* a page outside the mapping is not an entry */
+    assert(pager_view(p, (unsigned int)p->num_pages, &view) == -1);
+
+    assert(pager_close(p) == 0);
+
+    /* a file opened immutable maps the same */
+    assert(pager_open_immutable(FILE_NAME, &p) == 0);
+    assert(pager_map(p) == 0);
+    assert(pager_view(p, large_page, &view) == 0);
+    assert(view.len == sizeof(large));
+    assert(pager_close(p) == 0);
+
+    remove(FILE_NAME);
+
+    printf(GREEN "test_pager_map passed\n" RESET);
+}
+
 int main(void)
 {
     remove(FILE_NAME);
@@ -468,6 +813,11 @@ int main(void)
     test_pager_pager_size();
     test_pager_truncate();
     test_pager_concurrent_write_read();
+    test_pager_write_batch();
+    test_pager_immutable_read();
+    test_pager_concurrent_immutable_read();
+    test_pager_lock_stripes();
+    test_pager_map();
     remove(FILE_NAME);
     return 0;
 }
\ No newline at end of file
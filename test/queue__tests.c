@@ -63,6 +63,38 @@ void test_queue_enqueue_dequeue()
     printf(GREEN "test_queue_enqueue_dequeue passed\n" RESET);
 }
 
+void test_queue_enqueue_front()
+{
+    queue_t *q = queue_new();
+    int data1 = 1, data2 = 2, data3 = 3;
+
+    /* the front of an empty queue is also its back */
+    assert(queue_enqueue_front(q, &data2) == 0);
+    assert(q->head == q->tail);
+
+    assert(queue_enqueue(q, &data3) == 0);
+    assert(queue_enqueue_front(q, &data1) == 0);
+
+    assert(queue_size(q) == 3);
+
+    int *dequeued_data;
+    dequeued_data = (int *)queue_dequeue(q);
+    assert(dequeued_data != NULL && *dequeued_data == data1);
+
+    dequeued_data = (int *)queue_dequeue(q);
+    assert(dequeued_data != NULL && *dequeued_data == data2);
+
+    dequeued_data = (int *)queue_dequeue(q);
+    assert(dequeued_data != NULL && *dequeued_data == data3);
+
+    assert(queue_size(q) == 0);
+    assert(q->head == NULL && q->tail == NULL);
+
+    queue_destroy(q);
+
+    printf(GREEN "test_queue_enqueue_front passed\n" RESET);
+}
+
 void test_queue_size()
 {
     queue_t *q = queue_new();
@@ -114,6 +146,7 @@ int main(void)
 {
     test_queue_new();
     test_queue_enqueue_dequeue();
+    test_queue_enqueue_front();
     test_queue_size();
     test_queue_destroy();
     test_dequeue_no_entries();
@@ -194,7 +194,8 @@ void test_deserialize_column_family_config_no_compression()
                                      .flush_threshold = 100,
                                      .max_level = 5,
                                      .probability = 0.01f,
-                                     .compressed = true};
+                                     .compressed = true,
+                                     .concurrent_memtable = true};
     uint8_t *buffer = NULL;
     size_t encoded_size = 0;
 
@@ -207,6 +208,7 @@ void test_deserialize_column_family_config_no_compression()
     assert(deserialized_config->max_level == config.max_level);
     assert(deserialized_config->probability == config.probability);
     assert(deserialized_config->compressed == config.compressed);
+    assert(deserialized_config->concurrent_memtable == config.concurrent_memtable);
 
     free(buffer);
     free(deserialized_config->name);
@@ -266,6 +268,152 @@ void test_deserialize_operation_no_compression()
     printf(GREEN "test_deserialize_operation_no_compression passed\n" RESET);
 }
 
+void test_serialize_operation_parts()
+{
+    key_value_pair_t kvp = {.key = (uint8_t *)"key",
+                            .key_size = 3,
+                            .value = (uint8_t *)"value",
+                            .value_size = 5,
+                            .ttl = 12345};
+    operation_t op = {.op_code = 1, .kv = &kvp, .column_family = "test_cf"};
+    uint8_t *buffer = NULL;
+    size_t encoded_size = 0;
+
+    assert(serialize_operation(&op, &buffer, &encoded_size, false) == 0);
+
+    uint8_t scratch[SERIALIZE_OPERATION_SCRATCH_SIZE];
+    struct iovec parts[SERIALIZE_OPERATION_PARTS];
+    size_t parts_size = 0;
+
+    assert(serialize_operation_parts(&op, scratch, parts, &parts_size) == 0);
+    assert(parts_size == encoded_size);
+
+    /* the key and value are pointed at, not copied */
+    assert(parts[1].iov_base == kvp.key);
+    assert(parts[3].iov_base == kvp.value);
+
+    /* gathered together the parts are the bytes serialize_operation encodes */
+    uint8_t *gathered = malloc(parts_size);
+    assert(gathered != NULL);
+
+    size_t offset = 0;
+    for (int i = 0; i < SERIALIZE_OPERATION_PARTS; i++)
+    {
+        memcpy(gathered + offset, parts[i].iov_base, parts[i].iov_len);
+        offset += parts[i].iov_len;
+    }
+
+    assert(memcmp(gathered, buffer, encoded_size) == 0);
+
+    free(gathered);
+    free(buffer);
+
+    printf(GREEN "test_serialize_operation_parts passed\n" RESET);
+}
+
+void test_serialize_compress_parts()
+{
+    key_value_pair_t kvp = {.key = (uint8_t *)"key",
+                            .key_size = 3,
+                            .value = (uint8_t *)"value",
+                            .value_size = 5,
+                            .ttl = 12345};
+    operation_t op = {.op_code = 1, .kv = &kvp, .column_family = "test_cf"};
+
+    uint8_t scratch[SERIALIZE_OPERATION_SCRATCH_SIZE];
+    struct iovec parts[SERIALIZE_OPERATION_PARTS];
+    size_t parts_size = 0;
+    assert(serialize_operation_parts(&op, scratch, parts, &parts_size) == 0);
+
+    uint8_t *buffer = NULL;
+    size_t encoded_size = 0;
+    assert(serialize_compress_parts(parts, SERIALIZE_OPERATION_PARTS, &buffer, &encoded_size) == 0);
+
+    /* the frame decompresses to the parts joined together */
+    uint8_t *data = NULL;
+    size_t data_size = 0;
+    assert(deserialize_decompress(buffer, encoded_size, &data, &data_size) == 0);
+    assert(data_size == parts_size);
+
+    /* and reads back as the operation */
+    operation_t *deserialized_op = NULL;
+    assert(deserialize_operation(buffer, encoded_size, &deserialized_op, true) == 0);
+    assert(deserialized_op->kv->key_size == 3);
+    assert(memcmp(deserialized_op->kv->value, "value", 5) == 0);
+    assert(strcmp(deserialized_op->column_family, "test_cf") == 0);
+
+    free(deserialized_op->column_family);
+    free(deserialized_op->kv->key);
+    free(deserialized_op->kv->value);
+    free(deserialized_op->kv);
+    free(deserialized_op);
+    free(data);
+    free(buffer);
+
+    printf(GREEN "test_serialize_compress_parts passed\n" RESET);
+}
+
+void test_serialize_deserialize_batch()
+{
+    key_value_pair_t put = {.key = (uint8_t *)"key",
+                            .key_size = 3,
+                            .value = (uint8_t *)"value",
+                            .value_size = 5,
+                            .ttl = 12345};
+    key_value_pair_t del = {.key = (uint8_t *)"other_key",
+                            .key_size = 9,
+                            .value = (uint8_t *)"tomb",
+                            .value_size = 4,
+                            .ttl = -1};
+
+    size_t put_size = serialize_batch_operation_size(&put);
+    size_t del_size = serialize_batch_operation_size(&del);
+    size_t size = SERIALIZE_BATCH_HEADER_SIZE + put_size + del_size;
+
+    uint8_t *buffer = malloc(size);
+    assert(buffer != NULL);
+
+    assert(serialize_batch_header(2, buffer) == 0);
+    assert(serialize_batch_operation(OP_PUT, &put, buffer + SERIALIZE_BATCH_HEADER_SIZE) == 0);
+    assert(serialize_batch_operation(OP_DELETE, &del,
+                                     buffer + SERIALIZE_BATCH_HEADER_SIZE + put_size) == 0);
+
+    uint32_t count = 0;
+    assert(deserialize_batch_header(buffer, size, &count) == 0);
+    assert(count == 2);
+
+    /* the operations point into the buffer */
+    OP_CODE op_code;
+    key_value_pair_t kv;
+    size_t encoded_size = 0;
+    uint8_t *ptr = buffer + SERIALIZE_BATCH_HEADER_SIZE;
+
+    assert(deserialize_batch_operation(ptr, put_size + del_size, &op_code, &kv, &encoded_size) ==
+           0);
+    assert(op_code == OP_PUT);
+    assert(encoded_size == put_size);
+    assert(kv.key == ptr + sizeof(OP_CODE) + sizeof(uint32_t));
+    assert(kv.key_size == 3 && memcmp(kv.key, "key", 3) == 0);
+    assert(kv.value_size == 5 && memcmp(kv.value, "value", 5) == 0);
+    assert(kv.ttl == 12345);
+
+    ptr += encoded_size;
+    assert(deserialize_batch_operation(ptr, del_size, &op_code, &kv, &encoded_size) == 0);
+    assert(op_code == OP_DELETE);
+    assert(kv.key_size == 9 && memcmp(kv.key, "other_key", 9) == 0);
+    assert(kv.ttl == -1);
+
+    /* a cut short operation is rejected */
+    assert(deserialize_batch_operation(ptr, del_size - 1, &op_code, &kv, &encoded_size) == -1);
+
+    /* a single operation is not a batch */
+    assert(deserialize_batch_header(ptr, del_size, &count) == -1);
+
+    free(buffer);
+
+    printf(GREEN "test_serialize_deserialize_batch passed\n" RESET);
+}
+
 void test_serialize_deserialize_full_bloomfilter_no_compression()
 {
     /* create a bloom filter with an initial size of 8 */
@@ -394,6 +542,56 @@ void test_serialize_deserialize_full_bloomfilter_compression()
     printf(GREEN "test_serialize_deserialize_full_bloomfilter_compression passed\n" RESET);
 }
 
+void test_serialize_deserialize_blocked_bloomfilter()
+{
+    blocked_bloomfilter_t *bf = blocked_bloomfilter_create(256, 10);
+    assert(bf != NULL);
+
+    for (int i = 0; i < 256; i++)
+    {
+        uint8_t data[2] = {(uint8_t)i, '\0'};
+        blocked_bloomfilter_add(bf, blocked_bloomfilter_hash(data, 1));
+    }
+
+    for (int compress = 0; compress < 2; compress++)
+    {
+        uint8_t *buffer = NULL;
+        size_t encoded_size;
+        assert(serialize_blocked_bloomfilter(bf, &buffer, &encoded_size, compress) == 0);
+        assert(buffer != NULL);
+
+        blocked_bloomfilter_t *deserialized_bf = NULL;
+        assert(deserialize_blocked_bloomfilter(buffer, encoded_size, &deserialized_bf, compress) ==
+               0);
+        assert(deserialized_bf->num_blocks == bf->num_blocks);
+        assert(deserialized_bf->num_probes == bf->num_probes);
+        assert(memcmp(deserialized_bf->blocks, bf->blocks, bf->num_blocks * 64) == 0);
+
+        for (int i = 0; i < 256; i++)
+        {
+            uint8_t data[2] = {(uint8_t)i, '\0'};
+            assert(blocked_bloomfilter_check(deserialized_bf, blocked_bloomfilter_hash(data, 1)) ==
+                   0);
+        }
+
+        /* a truncated filter is rejected */
+        if (!compress)
+        {
+            blocked_bloomfilter_t *truncated_bf = NULL;
+            assert(deserialize_blocked_bloomfilter(buffer, encoded_size - 1, &truncated_bf,
+                                                   false) == -1);
+            assert(truncated_bf == NULL);
+        }
+
+        free(buffer);
+        blocked_bloomfilter_destroy(deserialized_bf);
+    }
+
+    blocked_bloomfilter_destroy(bf);
+
+    printf(GREEN "test_serialize_deserialize_blocked_bloomfilter passed\n" RESET);
+}
+
 /* cc -g3 -fsanitize=address,undefined src/*.c external/*.c test/serialize__tests.c -lzstd */
 int main(void)
 {
@@ -405,6 +603,9 @@ int main(void)
 
     test_serialize_operation_no_compression();
     test_deserialize_operation_no_compression();
+    test_serialize_operation_parts();
+    test_serialize_compress_parts();
+    test_serialize_deserialize_batch();
     test_serialize_operation_compression();
     test_deserialize_operation_compression();
 
@@ -413,6 +614,7 @@ int main(void)
 
     test_serialize_deserialize_full_bloomfilter_no_compression();
     test_serialize_deserialize_full_bloomfilter_compression();
+    test_serialize_deserialize_blocked_bloomfilter();
 
     return 0;
 }
\ No newline at end of file
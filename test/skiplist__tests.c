@@ -244,6 +244,218 @@ void test_skiplist_copy()
     printf(GREEN "test_skiplist_copy passed\n" RESET);
 }
 
+void *concurrent_put_thread_func(void *arg)
+{
+    thread_data_t *data = arg;
+    skiplist_t *list = data->list;
+    int thread_id = data->thread_id;
+
+    for (int i = 0; i < CONCURRENT_NUM_OPERATIONS; i++)
+    {
+        uint8_t key[16];
+        uint8_t value[16];
+
+        /* every thread puts its own keys and overwrites the shared ones */
+        snprintf((char *)key, sizeof(key), "key%d_%d", thread_id, i);
+        snprintf((char *)value, sizeof(value), "value%d_%d", thread_id, i);
+        assert(skiplist_put(list, key, strlen((char *)key) + 1, value, strlen((char *)value) + 1,
+                            -1) == 0);
+
+        snprintf((char *)key, sizeof(key), "shared_%d", i);
+        assert(skiplist_put(list, key, strlen((char *)key) + 1, value, strlen((char *)value) + 1,
+                            -1) == 0);
+
+        /* our own key is visible to us right after the put */
+        snprintf((char *)key, sizeof(key), "key%d_%d", thread_id, i);
+
+        uint8_t *retrieved_value;
+        size_t retrieved_value_size;
+        assert(skiplist_get(list, key, strlen((char *)key) + 1, &retrieved_value,
+                            &retrieved_value_size) == 0);
+        assert(memcmp(retrieved_value, value, retrieved_value_size) == 0);
+        free(retrieved_value);
+    }
+
+    pthread_exit(NULL);
+}
+
+void test_concurrent_skiplist()
+{
+    skiplist_t *list = new_concurrent_skiplist(12, 0.24f);
+    assert(list != NULL);
+    assert(list->concurrent);
+
+    pthread_t threads[CONCURRENT_NUM_THREADS];
+    thread_data_t thread_data[CONCURRENT_NUM_THREADS];
+
+    for (int i = 0; i < CONCURRENT_NUM_THREADS; i++)
+    {
+        thread_data[i].list = list;
+        thread_data[i].thread_id = i;
+        pthread_create(&threads[i], NULL, concurrent_put_thread_func, (void *)&thread_data[i]);
+    }
+
+    for (int i = 0; i < CONCURRENT_NUM_THREADS; i++) pthread_join(threads[i], NULL);
+
+    /* the cursor sees every key once and in order, overwritten keys only with their newest
+     * value */
+    skiplist_cursor_t *cursor = skiplist_cursor_init(list);
+    assert(cursor != NULL);
+
+    int count = 0;
+    skiplist_node_t *prev = NULL;
+    do
+    {
+        assert(cursor->current != NULL);
+        if (prev != NULL)
+            assert(skiplist_compare_keys(prev->key, prev->key_size, cursor->current->key,
+                                         cursor->current->key_size) < 0);
+        prev = cursor->current;
+        count++;
+    } while (skiplist_cursor_next(cursor) == 0);
+
+    assert(count == (CONCURRENT_NUM_THREADS + 1) * CONCURRENT_NUM_OPERATIONS);
+
+    /* the cursor walks back to the first key */
+    while (skiplist_cursor_prev(cursor) == 0) count--;
+    assert(count == 1);
+
+    skiplist_cursor_free(cursor);
+
+    /* a deleted key is gone, a put brings it back */
+    uint8_t key[] = "key0_0";
+    uint8_t value[] = "value";
+    uint8_t *retrieved_value;
+    size_t retrieved_value_size;
+
+    assert(skiplist_delete(list, key, sizeof(key)) == 0);
+    assert(skiplist_get(list, key, sizeof(key), &retrieved_value, &retrieved_value_size) == -1);
+    assert(skiplist_delete(list, key, sizeof(key)) == -1);
+
+    assert(skiplist_put(list, key, sizeof(key), value, sizeof(value), -1) == 0);
+    assert(skiplist_get(list, key, sizeof(key), &retrieved_value, &retrieved_value_size) == 0);
+    assert(retrieved_value_size == sizeof(value));
+    assert(memcmp(retrieved_value, value, sizeof(value)) == 0);
+    free(retrieved_value);
+
+    /* a copy holds the newest value of every key */
+    skiplist_t *copied_list = skiplist_copy(list);
+    assert(copied_list != NULL);
+    assert(skiplist_get(copied_list, key, sizeof(key), &retrieved_value, &retrieved_value_size) ==
+           0);
+    assert(memcmp(retrieved_value, value, sizeof(value)) == 0);
+    free(retrieved_value);
+
+    skiplist_destroy(copied_list);
+    skiplist_destroy(list);
+
+    printf(GREEN "test_concurrent_skiplist passed\n" RESET);
+}
+
+void test_skiplist_arena()
+{
+    skiplist_t *list = new_skiplist(12, 0.24f);
+    assert(list != NULL);
+
+    /* nothing is allocated until the first put */
+    assert(list->total_size == 0);
+    assert(list->arena.chunks == NULL);
+
+    uint8_t key[] = "key";
+    uint8_t value[] = "value";
+    assert(skiplist_put(list, key, sizeof(key), value, sizeof(value), -1) == 0);
+
+    /* the node, its tower, value and key are one allocation in the first chunk */
+    skiplist_node_t *node = list->header->forward[0];
+    assert(node != NULL);
+    assert(list->arena.chunks != NULL && list->arena.chunks->next == NULL);
+    assert((uint8_t *)node == list->arena.chunks->data);
+    assert(node->value > (uint8_t *)node && node->key > node->value);
+    assert(node->key + node->key_size <= list->arena.chunks->data + list->total_size);
+
+    /* the total size is what the arena handed out */
+    assert(list->total_size == atomic_load(&list->arena.chunks->used));
+
+    /* an overwrite and a delete leave the old value and node in the arena */
+    size_t size = list->total_size;
+    uint8_t new_value[] = "new value";
+    assert(skiplist_put(list, key, sizeof(key), new_value, sizeof(new_value), -1) == 0);
+    assert(list->total_size > size);
+
+    size = list->total_size;
+    assert(skiplist_delete(list, key, sizeof(key)) == 0);
+    assert(list->total_size == size);
+
+    /* enough puts fill more than one chunk, a large value gets a chunk of its own */
+    for (int i = 0; i < 10000; i++)
+    {
+        uint8_t k[32];
+        snprintf((char *)k, sizeof(k), "key%d", i);
+        assert(skiplist_put(list, k, strlen((char *)k), value, sizeof(value), -1) == 0);
+    }
+
+    size_t large_size = SKIPLIST_ARENA_CHUNK_SIZE;
+    uint8_t *large_value = malloc(large_size);
+    assert(large_value != NULL);
+    memset(large_value, 'v', large_size);
+    assert(skiplist_put(list, key, sizeof(key), large_value, large_size, -1) == 0);
+    free(large_value);
+
+    int chunks = 0;
+    for (skiplist_arena_chunk_t *chunk = list->arena.chunks; chunk != NULL; chunk = chunk->next)
+        chunks++;
+    assert(chunks > 2);
+    assert(list->arena.chunks->size > SKIPLIST_ARENA_CHUNK_SIZE);
+
+    uint8_t *retrieved_value;
+    size_t retrieved_value_size;
+    assert(skiplist_get(list, key, sizeof(key), &retrieved_value, &retrieved_value_size) == 0);
+    assert(retrieved_value_size == large_size);
+    free(retrieved_value);
+
+    /* clearing releases every chunk */
+    assert(skiplist_clear(list) == 0);
+    assert(list->total_size == 0);
+    assert(list->arena.chunks == NULL);
+
+    skiplist_destroy(list);
+
+    printf(GREEN "test_skiplist_arena passed\n" RESET);
+}
+
+void test_skiplist_arena_reserve()
+{
+    skiplist_t *list = new_skiplist(12, 0.24f);
+    assert(list != NULL);
+
+    /* a reservation no larger than a chunk is left to the first put */
+    assert(skiplist_arena_reserve(list, SKIPLIST_ARENA_CHUNK_SIZE) == 0);
+    assert(list->arena.chunks == NULL);
+
+    size_t reserved = SKIPLIST_ARENA_CHUNK_SIZE * 8;
+    assert(skiplist_arena_reserve(list, reserved) == 0);
+    assert(list->arena.chunks != NULL && list->arena.chunks->size == reserved);
+
+    /* reserved bytes count once they are handed out */
+    assert(list->total_size == 0);
+
+    uint8_t value[] = "value";
+    for (int i = 0; i < 1000; i++)
+    {
+        uint8_t k[32];
+        snprintf((char *)k, sizeof(k), "key%d", i);
+        assert(skiplist_put(list, k, strlen((char *)k), value, sizeof(value), -1) == 0);
+    }
+
+    /* the puts were all bumped from the reserved chunk */
+    assert(list->arena.chunks->next == NULL);
+    assert(list->total_size == atomic_load(&list->arena.chunks->used));
+
+    skiplist_destroy(list);
+
+    printf(GREEN "test_skiplist_arena_reserve passed\n" RESET);
+}
+
 /** OR cc -g3 -fsanitize=address,undefined src/*.c external/*.c test/skiplist__tests.c -lzstd **/
 int main(void)
 {
@@ -256,5 +468,8 @@ int main(void)
     test_skiplist_ttl();
     test_skiplist_concurrency();
     test_skiplist_copy();
+    test_concurrent_skiplist();
+    test_skiplist_arena();
+    test_skiplist_arena_reserve();
     return 0;
 }
\ No newline at end of file
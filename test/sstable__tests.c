@@ -0,0 +1,927 @@
+/*
+ *
+ * Copyright (C) TidesDB
+ *
+ * Original Author: Alex Gaetano Padula
+ *
+ * Licensed under the Mozilla Public License, v. 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.mozilla.org/en-US/MPL/2.0/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+
+#include "../src/sstable.h"
+#include "test_macros.h"
+
+#define FILE_NAME   "test.sst"
+#define NUM_ENTRIES 1000
+#define NUM_THREADS 4
+
+/* helper */
+int get_test_key(sstable_t* sst, const char* key, size_t key_size, uint8_t** value,
+                 size_t* value_size, int64_t* ttl)
+{
+    uint64_t hash = blocked_bloomfilter_hash((const uint8_t*)key, key_size);
+    return sstable_get(sst, (const uint8_t*)key, key_size, hash, value, value_size, ttl);
+}
+
+/* helper */
+void write_test_sstable(bool compressed, sstable_t** sst)
+{
+    sstable_writer_t* writer = NULL;
+    assert(sstable_writer_open(FILE_NAME, SSTABLE_DEFAULT_BLOCK_SIZE, compressed, 0, 7, 3, 2,
+                               &writer) == 0);
+
+    for (int i = 0; i < NUM_ENTRIES; i++)
+    {
+        char key[32];
+        char value[32];
+        snprintf(key, sizeof(key), "key%05d", i);
+        snprintf(value, sizeof(value), "value%05d", i);
+
+        assert(sstable_writer_add(writer, (uint8_t*)key, strlen(key), (uint8_t*)value,
+                                  strlen(value), i % 2 == 0 ? -1 : i) == 0);
+    }
+
+    assert(sstable_writer_finish(writer, sst) == 0);
+    assert(*sst != NULL);
+}
+
+/* helper */
+void check_test_sstable(sstable_t* sst)
+{
+    for (int i = 0; i < NUM_ENTRIES; i++)
+    {
+        char key[32];
+        char expected[32];
+        snprintf(key, sizeof(key), "key%05d", i);
+        snprintf(expected, sizeof(expected), "value%05d", i);
+
+        uint8_t* value = NULL;
+        size_t value_size = 0;
+        int64_t ttl = 0;
+
+        assert(get_test_key(sst, key, strlen(key), &value, &value_size, &ttl) == 0);
+        assert(value_size == strlen(expected));
+        assert(memcmp(value, expected, value_size) == 0);
+        assert(ttl == (i % 2 == 0 ? -1 : i));
+
+        free(value);
+    }
+
+    /* keys that are not in the sstable */
+    uint8_t* value = NULL;
+    size_t value_size = 0;
+    int64_t ttl = 0;
+
+    assert(get_test_key(sst, "key99999", 8, &value, &value_size, &ttl) == -1);
+    assert(get_test_key(sst, "a", 1, &value, &value_size, &ttl) == -1);
+    assert(get_test_key(sst, "key00010x", 9, &value, &value_size, &ttl) == -1);
+}
+
+void test_sstable_write_read()
+{
+    remove(FILE_NAME);
+
+    sstable_t* sst = NULL;
+    write_test_sstable(false, &sst);
+
+    assert(sst->version == SSTABLE_FORMAT_VERSION);
+    assert(sst->num_entries == NUM_ENTRIES);
+    assert(sst->num_blocks > 1);
+
+    /* small pairs are packed into blocks instead of a page each */
+    assert(sst->pager->num_pages < NUM_ENTRIES / 10);
+
+    check_test_sstable(sst);
+
+    sstable_close(sst);
+    remove(FILE_NAME);
+
+    printf(GREEN "test_sstable_write_read passed\n" RESET);
+}
+
+void test_sstable_write_reopen_read()
+{
+    remove(FILE_NAME);
+
+    sstable_t* sst = NULL;
+    write_test_sstable(true, &sst);
+    uint32_t num_blocks = sst->num_blocks;
+    sstable_close(sst);
+
+    /* the footer records the compression, so the hint is ignored */
+    sst = NULL;
+    assert(sstable_open(FILE_NAME, false, &sst) == 0);
+    assert(sst->version == SSTABLE_FORMAT_VERSION);
+    assert(sst->compressed == true);
+    assert(sst->num_entries == NUM_ENTRIES);
+    assert(sst->num_blocks == num_blocks);
+
+    check_test_sstable(sst);
+
+    sstable_close(sst);
+    remove(FILE_NAME);
+
+    printf(GREEN "test_sstable_write_reopen_read passed\n" RESET);
+}
+
+/* helper */
+void check_test_sstable_meta(sstable_t* sst)
+{
+    assert(sst->filter != NULL && sst->bf == NULL);
+    assert(sst->sequence == 7);
+    assert(sst->file_number == 3);
+    assert(sst->level == 2);
+
+    assert(sst->min_key != NULL);
+    assert(sst->min_key_size == 8);
+    assert(memcmp(sst->min_key, "key00000", 8) == 0);
+
+    assert(sst->max_key != NULL);
+    assert(sst->max_key_size == 8);
+    assert(memcmp(sst->max_key, "key00999", 8) == 0);
+
+    /* ranges are compared inclusively, NULL bounds are open */
+    assert(sstable_overlaps(sst, (uint8_t*)"key00999", 8, NULL, 0));
+    assert(!sstable_overlaps(sst, (uint8_t*)"key01000", 8, NULL, 0));
+    assert(sstable_overlaps(sst, NULL, 0, (uint8_t*)"key00000", 8));
+    assert(!sstable_overlaps(sst, (uint8_t*)"a", 1, (uint8_t*)"b", 1));
+
+    /* keys outside the range are rejected without reading a block */
+    uint64_t hash = blocked_bloomfilter_hash((uint8_t*)"a", 1);
+    assert(sstable_may_contain(sst, (uint8_t*)"a", 1, hash) == -1);
+    hash = blocked_bloomfilter_hash((uint8_t*)"key01000", 8);
+    assert(sstable_may_contain(sst, (uint8_t*)"key01000", 8, hash) == -1);
+    hash = blocked_bloomfilter_hash((uint8_t*)"key00500", 8);
+    assert(sstable_may_contain(sst, (uint8_t*)"key00500", 8, hash) == 0);
+}
+
+void test_sstable_resident_meta()
+{
+    remove(FILE_NAME);
+
+    /* the writer hands its filter and key range to the new sstable */
+    sstable_t* sst = NULL;
+    write_test_sstable(false, &sst);
+    check_test_sstable_meta(sst);
+    sstable_close(sst);
+
+    /* and they are loaded once when the sstable is opened again */
+    sst = NULL;
+    assert(sstable_open(FILE_NAME, false, &sst) == 0);
+    assert(sst->meta_page < sst->pager->num_pages);
+    check_test_sstable_meta(sst);
+    check_test_sstable(sst);
+
+    sstable_close(sst);
+    remove(FILE_NAME);
+
+    printf(GREEN "test_sstable_resident_meta passed\n" RESET);
+}
+
+void test_sstable_iterator()
+{
+    remove(FILE_NAME);
+
+    sstable_t* sst = NULL;
+    write_test_sstable(false, &sst);
+
+    sstable_iterator_t* it = NULL;
+    assert(sstable_iterator_init(sst, &it) == 0);
+
+    /* forward */
+    int count = 0;
+    do
+    {
+        char key[32];
+        snprintf(key, sizeof(key), "key%05d", count);
+
+        key_value_pair_t kv;
+        assert(sstable_iterator_get(it, &kv) == 0);
+        assert(kv.key_size == strlen(key));
+        assert(memcmp(kv.key, key, kv.key_size) == 0);
+        count++;
+    } while (sstable_iterator_next(it) == 0);
+
+    assert(count == NUM_ENTRIES);
+
+    /* backward */
+    do
+    {
+        count--;
+        char key[32];
+        snprintf(key, sizeof(key), "key%05d", count);
+
+        key_value_pair_t kv;
+        assert(sstable_iterator_get(it, &kv) == 0);
+        assert(memcmp(kv.key, key, kv.key_size) == 0);
+    } while (sstable_iterator_prev(it) == 0);
+
+    assert(count == 0);
+
+    sstable_iterator_free(it);
+    sstable_close(sst);
+    remove(FILE_NAME);
+
+    printf(GREEN "test_sstable_iterator passed\n" RESET);
+}
+
+void test_sstable_large_value()
+{
+    remove(FILE_NAME);
+
+    sstable_writer_t* writer = NULL;
+    assert(sstable_writer_open(FILE_NAME, SSTABLE_DEFAULT_BLOCK_SIZE, false, 0, 1, 1, 0,
+                               &writer) == 0);
+
+    /* a value larger than the block size gets a block of its own */
+    size_t large_size = SSTABLE_DEFAULT_BLOCK_SIZE * 4;
+    uint8_t* large = malloc(large_size);
+    assert(large != NULL);
+    memset(large, 'x', large_size);
+
+    assert(sstable_writer_add(writer, (uint8_t*)"a", 1, (uint8_t*)"small", 5, -1) == 0);
+    assert(sstable_writer_add(writer, (uint8_t*)"b", 1, large, large_size, -1) == 0);
+    assert(sstable_writer_add(writer, (uint8_t*)"c", 1, (uint8_t*)"small", 5, -1) == 0);
+
+    sstable_t* sst = NULL;
+    assert(sstable_writer_finish(writer, &sst) == 0);
+    assert(sst->num_blocks == 2);
+
+    uint8_t* value = NULL;
+    size_t value_size = 0;
+    int64_t ttl = 0;
+
+    assert(get_test_key(sst, "b", 1, &value, &value_size, &ttl) == 0);
+    assert(value_size == large_size);
+    assert(memcmp(value, large, large_size) == 0);
+    free(value);
+
+    assert(get_test_key(sst, "c", 1, &value, &value_size, &ttl) == 0);
+    assert(value_size == 5);
+    free(value);
+
+    free(large);
+    sstable_close(sst);
+    remove(FILE_NAME);
+
+    printf(GREEN "test_sstable_large_value passed\n" RESET);
+}
+
+void test_sstable_legacy_read()
+{
+    remove(FILE_NAME);
+
+    /* we write an sstable the way it was written before the block format,
+     * a bloom filter in the initial page(s) and then a key-value pair per page */
+    pager_t* p = NULL;
+    assert(pager_open(FILE_NAME, &p) == 0);
+
+    bloomfilter_t* bf = bloomfilter_create(BLOOMFILTER_SIZE);
+    assert(bf != NULL);
+
+    char* keys[] = {"apple", "banana", "cherry"};
+    size_t big_size = PAGE_BODY * 2; /* banana overflows onto more pages */
+    uint8_t* big = malloc(big_size);
+    assert(big != NULL);
+    memset(big, 'b', big_size);
+
+    for (int i = 0; i < 3; i++) bloomfilter_add(bf, (uint8_t*)keys[i], strlen(keys[i]));
+
+    uint8_t* buffer = NULL;
+    size_t buffer_len = 0;
+    unsigned int page;
+    assert(serialize_bloomfilter(bf, &buffer, &buffer_len, false) == 0);
+    assert(pager_write(p, buffer, buffer_len, &page) == 0);
+    free(buffer);
+    bloomfilter_destroy(bf);
+
+    for (int i = 0; i < 3; i++)
+    {
+        key_value_pair_t kv = {(uint8_t*)keys[i], strlen(keys[i]), (uint8_t*)keys[i],
+                               strlen(keys[i]), -1};
+        if (i == 1)
+        {
+            kv.value = big;
+            kv.value_size = big_size;
+        }
+        assert(serialize_key_value_pair(&kv, &buffer, &buffer_len, false) == 0);
+        assert(pager_write(p, buffer, buffer_len, &page) == 0);
+        free(buffer);
+    }
+
+    assert(pager_close(p) == 0);
+
+    sstable_t* sst = NULL;
+    assert(sstable_open(FILE_NAME, false, &sst) == 0);
+    assert(sst->version == SSTABLE_FORMAT_LEGACY);
+
+    /* a legacy sstable keeps its filter resident but has no key range */
+    assert(sst->bf != NULL);
+    assert(sst->min_key == NULL && sst->max_key == NULL);
+
+    uint8_t* value = NULL;
+    size_t value_size = 0;
+    int64_t ttl = 0;
+
+    assert(get_test_key(sst, "banana", 6, &value, &value_size, &ttl) == 0);
+    assert(value_size == big_size);
+    assert(memcmp(value, big, big_size) == 0);
+    free(value);
+
+    assert(get_test_key(sst, "cherry", 6, &value, &value_size, &ttl) == 0);
+    assert(value_size == 6);
+    assert(memcmp(value, "cherry", 6) == 0);
+    free(value);
+
+    assert(get_test_key(sst, "durian", 6, &value, &value_size, &ttl) == -1);
+
+    /* we iterate forward and back over the legacy pairs */
+    sstable_iterator_t* it = NULL;
+    assert(sstable_iterator_init(sst, &it) == 0);
+
+    int count = 0;
+    do
+    {
+        key_value_pair_t kv;
+        assert(sstable_iterator_get(it, &kv) == 0);
+        assert(kv.key_size == strlen(keys[count]));
+        assert(memcmp(kv.key, keys[count], kv.key_size) == 0);
+        count++;
+    } while (sstable_iterator_next(it) == 0);
+
+    assert(count == 3);
+
+    do
+    {
+        count--;
+        key_value_pair_t kv;
+        assert(sstable_iterator_get(it, &kv) == 0);
+        assert(memcmp(kv.key, keys[count], kv.key_size) == 0);
+    } while (sstable_iterator_prev(it) == 0);
+
+    assert(count == 0);
+
+    sstable_iterator_free(it);
+    sstable_close(sst);
+    free(big);
+    remove(FILE_NAME);
+
+    printf(GREEN "test_sstable_legacy_read passed\n" RESET);
+}
+
+void test_sstable_writer_abandon()
+{
+    remove(FILE_NAME);
+
+    sstable_writer_t* writer = NULL;
+    assert(sstable_writer_open(FILE_NAME, SSTABLE_DEFAULT_BLOCK_SIZE, false, 0, 1, 1, 0,
+                               &writer) == 0);
+    assert(sstable_writer_add(writer, (uint8_t*)"key", 3, (uint8_t*)"value", 5, -1) == 0);
+
+    sstable_writer_abandon(writer);
+
+    /* the partially written file is removed */
+    assert(access(FILE_NAME, F_OK) == -1);
+
+    printf(GREEN "test_sstable_writer_abandon passed\n" RESET);
+}
+
+void test_sstable_writer_replaces_stale_file()
+{
+    /* a crash left a file under the name before its table was recorded anywhere */
+    FILE* stale = fopen(FILE_NAME, "wb");
+    assert(stale != NULL);
+    fputs("left behind by a crash", stale);
+    fclose(stale);
+
+    sstable_t* sst = NULL;
+    write_test_sstable(false, &sst);
+    sstable_close(sst);
+
+    sst = NULL;
+    assert(sstable_open(FILE_NAME, false, &sst) == 0);
+    assert(sst->version == SSTABLE_FORMAT_VERSION);
+    check_test_sstable(sst);
+
+    sstable_close(sst);
+    remove(FILE_NAME);
+
+    printf(GREEN "test_sstable_writer_replaces_stale_file passed\n" RESET);
+}
+
+void test_sstable_decode_older_footers()
+{
+    sstable_t written = {0};
+    written.filter_page = 3;
+    written.index_page = 4;
+    written.meta_page = 5;
+    written.num_entries = 100;
+    written.num_blocks = 2;
+    written.level = 1;
+    written.sequence = 9;
+    written.file_number = 12;
+
+    uint8_t footer[SSTABLE_FOOTER_SIZE];
+    sstable_encode_footer(&written, footer);
+
+    sstable_t decoded = {0};
+    assert(sstable_decode_footer(footer, SSTABLE_FOOTER_SIZE, &decoded) == 0);
+    assert(decoded.version == SSTABLE_FORMAT_VERSION);
+    assert(decoded.sequence == 9);
+    assert(decoded.file_number == 12);
+
+    /* a version 2 footer ends before the file number */
+    uint32_t version = SSTABLE_FORMAT_V2;
+    memcpy(footer + 8, &version, sizeof(uint32_t));
+
+    memset(&decoded, 0, sizeof(decoded));
+    assert(sstable_decode_footer(footer, SSTABLE_FOOTER_V2_SIZE, &decoded) == 0);
+    assert(decoded.version == SSTABLE_FORMAT_V2);
+    assert(decoded.sequence == 9);
+    assert(decoded.file_number == 0);
+    assert(sstable_decode_footer(footer, SSTABLE_FOOTER_SIZE, &decoded) == -1);
+
+    /* a version 1 footer ends before the meta block */
+    version = SSTABLE_FORMAT_V1;
+    memcpy(footer + 8, &version, sizeof(uint32_t));
+
+    memset(&decoded, 0, sizeof(decoded));
+    assert(sstable_decode_footer(footer, SSTABLE_FOOTER_V1_SIZE, &decoded) == 0);
+    assert(decoded.version == SSTABLE_FORMAT_V1);
+    assert(decoded.sequence == 0);
+    assert(decoded.meta_page == 0);
+    assert(sstable_decode_footer(footer, SSTABLE_FOOTER_V2_SIZE, &decoded) == -1);
+
+    printf(GREEN "test_sstable_decode_older_footers passed\n" RESET);
+}
+
+void test_sstable_merge_iterator()
+{
+    /* three sstables, oldest first, a newer sstable overwrites every third key of the older one */
+    const char* files[] = {"test_merge0.sst", "test_merge1.sst", "test_merge2.sst"};
+    sstable_t* ssts[3];
+
+    for (int t = 0; t < 3; t++)
+    {
+        remove(files[t]);
+
+        sstable_writer_t* writer = NULL;
+        assert(sstable_writer_open(files[t], SSTABLE_DEFAULT_BLOCK_SIZE, false, 0, t + 1, t + 1,
+                                   0, &writer) == 0);
+
+        /* the last sstable is empty */
+        for (int i = 0; t < 2 && i < NUM_ENTRIES; i += (t == 0 ? 1 : 3))
+        {
+            char key[32];
+            char value[32];
+            snprintf(key, sizeof(key), "key%05d", i);
+            snprintf(value, sizeof(value), "value%d_%05d", t, i);
+
+            assert(sstable_writer_add(writer, (uint8_t*)key, strlen(key), (uint8_t*)value,
+                                      strlen(value), -1) == 0);
+        }
+
+        assert(sstable_writer_finish(writer, &ssts[t]) == 0);
+    }
+
+    sstable_merge_iterator_t* it = NULL;
+    assert(sstable_merge_iterator_init(ssts, 3, &it) == 0);
+
+    int count = 0;
+    key_value_pair_t kv;
+    while (sstable_merge_iterator_get(it, &kv) == 0)
+    {
+        char key[32];
+        char value[32];
+        snprintf(key, sizeof(key), "key%05d", count);
+        snprintf(value, sizeof(value), "value%d_%05d", count % 3 == 0 ? 1 : 0, count);
+
+        /* every key once, in order, with the newest value */
+        assert(kv.key_size == strlen(key));
+        assert(memcmp(kv.key, key, kv.key_size) == 0);
+        assert(kv.value_size == strlen(value));
+        assert(memcmp(kv.value, value, kv.value_size) == 0);
+
+        count++;
+        if (sstable_merge_iterator_next(it) == -1) break;
+    }
+
+    assert(count == NUM_ENTRIES);
+    assert(sstable_merge_iterator_get(it, &kv) == -1);
+
+    sstable_merge_iterator_free(it);
+
+    for (int t = 0; t < 3; t++)
+    {
+        sstable_close(ssts[t]);
+        remove(files[t]);
+    }
+
+    printf(GREEN "test_sstable_merge_iterator passed\n" RESET);
+}
+
+void check_sstable_entry_stats(sstable_t* sst)
+{
+    assert(sst->num_tombstones == 25);
+    assert(sst->num_ttl == 50);
+    assert(sst->min_ttl == 1000);
+    assert(sst->max_ttl == 1980);
+
+    /* the ttls are spread evenly between 1000 and 1980, so half of them expired at 1490 */
+    assert(sstable_expired_entries(sst, 999) == 0);
+    assert(sstable_expired_entries(sst, 1490) == 25);
+    assert(sstable_expired_entries(sst, 1980) == 50);
+}
+
+void test_sstable_entry_stats()
+{
+    remove(FILE_NAME);
+
+    sstable_writer_t* writer = NULL;
+    assert(sstable_writer_open(FILE_NAME, SSTABLE_DEFAULT_BLOCK_SIZE, false, 0, 1, 1, 0,
+                               &writer) == 0);
+
+    /* half of the pairs have a ttl, the caller marks a quarter of them as tombstones */
+    for (int i = 0; i < 100; i++)
+    {
+        char key[32];
+        snprintf(key, sizeof(key), "key%05d", i);
+
+        int64_t ttl = i % 2 == 0 ? 1000 + i * 10 : -1;
+        assert(sstable_writer_add(writer, (uint8_t*)key, strlen(key), (uint8_t*)"value", 5, ttl) ==
+               0);
+        if (i % 4 == 1) writer->num_tombstones++;
+    }
+
+    sstable_t* sst = NULL;
+    assert(sstable_writer_finish(writer, &sst) == 0);
+    check_sstable_entry_stats(sst);
+    sstable_close(sst);
+
+    /* the statistics are read back from the meta block */
+    assert(sstable_open(FILE_NAME, false, &sst) == 0);
+    check_sstable_entry_stats(sst);
+    sstable_close(sst);
+
+    remove(FILE_NAME);
+
+    printf(GREEN "test_sstable_entry_stats passed\n" RESET);
+}
+
+void test_sstable_ref_unref()
+{
+    remove(FILE_NAME);
+
+    sstable_writer_t* writer = NULL;
+    assert(sstable_writer_open(FILE_NAME, SSTABLE_DEFAULT_BLOCK_SIZE, false, 0, 1, 1, 0,
+                               &writer) == 0);
+    assert(sstable_writer_add(writer, (uint8_t*)"key", 3, (uint8_t*)"value", 5, -1) == 0);
+
+    sstable_t* sst = NULL;
+    assert(sstable_writer_finish(writer, &sst) == 0);
+    assert(atomic_load(&sst->refs) == 1);
+
+    /* a second holder keeps the table open after the first lets go */
+    sstable_ref(sst);
+    atomic_store(&sst->obsolete, true);
+    sstable_unref(sst);
+    assert(access(FILE_NAME, F_OK) == 0);
+
+    uint8_t* value = NULL;
+    size_t value_size = 0;
+    int64_t ttl = 0;
+    assert(sstable_get(sst, (uint8_t*)"key", 3, blocked_bloomfilter_hash((uint8_t*)"key", 3),
+                       &value, &value_size, &ttl) == 0);
+    assert(value_size == 5);
+    free(value);
+
+    /* the last reference closes the table and removes the obsolete file */
+    sstable_unref(sst);
+    assert(access(FILE_NAME, F_OK) == -1);
+
+    printf(GREEN "test_sstable_ref_unref passed\n" RESET);
+}
+
+void test_sstable_lazy_open()
+{
+    remove(FILE_NAME);
+
+    sstable_t* sst = NULL;
+    write_test_sstable(false, &sst);
+    sstable_close(sst);
+
+    /* the handle is described by its caller, the file is left be until the first read */
+    sst = NULL;
+    assert(sstable_open_lazy(FILE_NAME, false, NULL, &sst) == 0);
+    assert(sst->pager == NULL);
+    assert(sstable_set_key_range(sst, (uint8_t*)"key00000", 8, (uint8_t*)"key00999", 8) == 0);
+    sst->num_entries = NUM_ENTRIES;
+    sst->level = 2;
+
+    /* a key outside the range is answered without opening the reader */
+    uint8_t* value = NULL;
+    size_t value_size = 0;
+    int64_t ttl = 0;
+    assert(get_test_key(sst, "a", 1, &value, &value_size, &ttl) == -1);
+    assert(sst->pager == NULL);
+
+    check_test_sstable(sst);
+    assert(sst->pager != NULL);
+    assert(sst->version == SSTABLE_FORMAT_VERSION);
+    assert(sst->sequence == 0); /* what the caller described wins over the footer */
+
+    sstable_close(sst);
+
+    /* a table whose file is gone fails on first access, that is an error and not a miss */
+    remove(FILE_NAME);
+    assert(sstable_open_lazy(FILE_NAME, false, NULL, &sst) == 0);
+    assert(get_test_key(sst, "key00001", 8, &value, &value_size, &ttl) == -2);
+
+    sstable_iterator_t* it = NULL;
+    assert(sstable_iterator_init(sst, &it) == -2);
+    sstable_close(sst);
+
+    printf(GREEN "test_sstable_lazy_open passed\n" RESET);
+}
+
+void test_sstable_read_errors()
+{
+    remove(FILE_NAME);
+
+    sstable_t* sst = NULL;
+    write_test_sstable(false, &sst);
+    sstable_close(sst);
+
+    /* the footer and index are read on open, the data blocks after */
+    assert(sstable_open(FILE_NAME, false, &sst) == 0);
+    assert(sst->num_blocks > 2);
+
+    /* the file loses its last data blocks under the open reader */
+    uint64_t page = sst->index[sst->num_blocks - 1].page;
+    assert(truncate(FILE_NAME, (off_t)(page * PAGE_SIZE)) == 0);
+
+    uint8_t* value = NULL;
+    size_t value_size = 0;
+    int64_t ttl = 0;
+    assert(get_test_key(sst, "key00000", 8, &value, &value_size, &ttl) == 0);
+    free(value);
+
+    /* a key in a block we cannot read may be there, it is not reported missing */
+    char key[32];
+    snprintf(key, sizeof(key), "key%05d", NUM_ENTRIES - 1);
+    assert(get_test_key(sst, key, strlen(key), &value, &value_size, &ttl) == -2);
+
+    /* an iterator stops with an error at the block instead of ending early */
+    sstable_iterator_t* it = NULL;
+    assert(sstable_iterator_init(sst, &it) == 0);
+
+    int rc;
+    while ((rc = sstable_iterator_next(it)) == 0)
+        ;
+    assert(rc == -2);
+    assert(it->block_index == sst->num_blocks - 2);
+
+    sstable_iterator_free(it);
+    sstable_close(sst);
+    remove(FILE_NAME);
+
+    printf(GREEN "test_sstable_read_errors passed\n" RESET);
+}
+
+void test_sstable_cache()
+{
+    sstable_cache_t* cache = NULL;
+    assert(sstable_cache_open(2, false, 0, &cache) == 0);
+
+    /* five tables share a cache that keeps two readers open */
+    sstable_t* tables[5];
+    char names[5][32];
+    for (int i = 0; i < 5; i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "test_cache_%d.sst", i);
+
+        sstable_writer_t* writer = NULL;
+        assert(sstable_writer_open(names[i], SSTABLE_DEFAULT_BLOCK_SIZE, false, 0, i + 1, i + 1, 0,
+                                   &writer) == 0);
+        assert(sstable_writer_add(writer, (uint8_t*)names[i], strlen(names[i]), (uint8_t*)"value",
+                                  5, -1) == 0);
+        assert(sstable_writer_finish(writer, &tables[i]) == 0);
+
+        sstable_set_cache(tables[i], cache);
+        assert(cache->num_open <= 2);
+    }
+
+    /* the readers of the least recently used tables were closed */
+    assert(cache->evictions == 3);
+    for (int i = 0; i < 3; i++) assert(tables[i]->pager == NULL);
+    assert(tables[3]->pager != NULL && tables[4]->pager != NULL);
+
+    /* reading from every table reopens what was closed and keeps the bound */
+    for (int round = 0; round < 2; round++)
+    {
+        for (int i = 0; i < 5; i++)
+        {
+            uint8_t* value = NULL;
+            size_t value_size = 0;
+            int64_t ttl = 0;
+            assert(get_test_key(tables[i], names[i], strlen(names[i]), &value, &value_size,
+                                &ttl) == 0);
+            assert(value_size == 5 && memcmp(value, "value", 5) == 0);
+            free(value);
+            assert(cache->num_open <= 2);
+        }
+    }
+    assert(atomic_load(&cache->opens) == 10);
+
+    /* an iterator pins its table, the bound is exceeded rather than the reader closed under it */
+    sstable_iterator_t* its[3];
+    for (int i = 0; i < 3; i++) assert(sstable_iterator_init(tables[i], &its[i]) == 0);
+    assert(cache->num_open == 3);
+    for (int i = 0; i < 3; i++) assert(tables[i]->pager != NULL);
+    for (int i = 0; i < 3; i++) sstable_iterator_free(its[i]);
+
+    /* the next use closes the unpinned readers */
+    uint8_t* value = NULL;
+    size_t value_size = 0;
+    int64_t ttl = 0;
+    assert(get_test_key(tables[4], names[4], strlen(names[4]), &value, &value_size, &ttl) == 0);
+    free(value);
+    assert(cache->num_open == 2);
+
+    for (int i = 0; i < 5; i++)
+    {
+        sstable_close(tables[i]);
+        remove(names[i]);
+    }
+    assert(cache->num_open == 0);
+    assert(cache->head == NULL && cache->tail == NULL);
+
+    sstable_cache_close(cache);
+
+    printf(GREEN "test_sstable_cache passed\n" RESET);
+}
+
+/** OR cc -g3 -fsanitize=address,undefined src/*.c external/*.c test/sstable__tests.c -lzstd **/
+/* helper */
+void* check_test_sstable_thread(void* arg)
+{
+    check_test_sstable((sstable_t*)arg);
+    return NULL;
+}
+
+void test_sstable_concurrent_get()
+{
+    remove(FILE_NAME);
+
+    /* the table we just wrote and the table opened again both read without page locks */
+    sstable_t* sst = NULL;
+    write_test_sstable(true, &sst);
+    assert(sst->pager->immutable);
+
+    for (int round = 0; round < 2; round++)
+    {
+        pthread_t threads[NUM_THREADS];
+        for (int i = 0; i < NUM_THREADS; i++)
+            assert(pthread_create(&threads[i], NULL, check_test_sstable_thread, sst) == 0);
+        for (int i = 0; i < NUM_THREADS; i++) pthread_join(threads[i], NULL);
+
+        sstable_close(sst);
+        if (round == 1) break;
+
+        sst = NULL;
+        assert(sstable_open(FILE_NAME, false, &sst) == 0);
+        assert(sst->pager->immutable);
+        assert(sst->pager->page_locks == NULL);
+    }
+
+    remove(FILE_NAME);
+
+    printf(GREEN "test_sstable_concurrent_get passed\n" RESET);
+}
+
+void test_sstable_mmap_reads()
+{
+    sstable_cache_t* cache = NULL;
+    assert(sstable_cache_open(4, true, 0, &cache) == 0);
+    assert(cache->mmap_reads);
+
+    for (int compressed = 0; compressed < 2; compressed++)
+    {
+        remove(FILE_NAME);
+
+        /* a table we just wrote is mapped as it joins the cache */
+        sstable_t* sst = NULL;
+        write_test_sstable(compressed, &sst);
+        assert(sst->pager->map == NULL);
+        sstable_set_cache(sst, cache);
+        assert(sst->pager->map != NULL);
+
+        check_test_sstable(sst);
+
+        /* an iterator reads the mapping in order while it is around */
+        sstable_iterator_t* it = NULL;
+        assert(sstable_iterator_init(sst, &it) == 0);
+        assert(sst->scans == 1);
+
+        int count = 0;
+        do
+        {
+            key_value_pair_t kv;
+            assert(sstable_iterator_get(it, &kv) == 0);
+            count++;
+        } while (sstable_iterator_next(it) == 0);
+        assert(count == NUM_ENTRIES);
+
+        sstable_iterator_free(it);
+        assert(sst->scans == 0);
+
+        sstable_close(sst);
+
+        /* a table opened lazily is mapped on first access */
+        assert(sstable_open_lazy(FILE_NAME, false, cache, &sst) == 0);
+        sst->num_entries = NUM_ENTRIES;
+        check_test_sstable(sst);
+        assert(sst->pager->map != NULL);
+        assert(sst->compressed == (compressed == 1));
+        sstable_close(sst);
+    }
+
+    sstable_cache_close(cache);
+    remove(FILE_NAME);
+
+    printf(GREEN "test_sstable_mmap_reads passed\n" RESET);
+}
+
+void test_sstable_block_cache()
+{
+    sstable_cache_t* cache = NULL;
+    assert(sstable_cache_open(4, false, 1024 * 1024, &cache) == 0);
+    assert(cache->block_cache != NULL);
+
+    remove(FILE_NAME);
+
+    sstable_t* sst = NULL;
+    write_test_sstable(true, &sst);
+    assert(sst->block_cache_id == 0);
+    sstable_set_cache(sst, cache);
+    assert(sst->block_cache_id != 0);
+
+    /* the first pass reads and decompresses every block once, the second is served from memory */
+    check_test_sstable(sst);
+    uint64_t misses = atomic_load(&cache->block_cache->misses);
+    assert(misses > 0);
+    assert(misses <= sst->num_blocks);
+
+    check_test_sstable(sst);
+    assert(atomic_load(&cache->block_cache->misses) == misses);
+    assert(atomic_load(&cache->block_cache->hits) >= NUM_ENTRIES);
+
+    size_t entries = 0;
+    block_cache_usage(cache->block_cache, &entries);
+    assert(entries == misses);
+
+    /* a table opened again is another table to the cache */
+    sstable_close(sst);
+    assert(sstable_open_lazy(FILE_NAME, false, cache, &sst) == 0);
+    check_test_sstable(sst);
+    assert(atomic_load(&cache->block_cache->misses) > misses);
+    sstable_close(sst);
+
+    sstable_cache_close(cache);
+    remove(FILE_NAME);
+
+    printf(GREEN "test_sstable_block_cache passed\n" RESET);
+}
+
+int main(void)
+{
+    test_sstable_write_read();
+    test_sstable_write_reopen_read();
+    test_sstable_resident_meta();
+    test_sstable_iterator();
+    test_sstable_large_value();
+    test_sstable_legacy_read();
+    test_sstable_writer_abandon();
+    test_sstable_writer_replaces_stale_file();
+    test_sstable_decode_older_footers();
+    test_sstable_merge_iterator();
+    test_sstable_entry_stats();
+    test_sstable_ref_unref();
+    test_sstable_lazy_open();
+    test_sstable_read_errors();
+    test_sstable_cache();
+    test_sstable_concurrent_get();
+    test_sstable_mmap_reads();
+    test_sstable_block_cache();
+    return 0;
+}
@@ -0,0 +1,218 @@
+/*
+ *
+ * Copyright (C) TidesDB
+ *
+ * Original Author: Alex Gaetano Padula
+ *
+ * Licensed under the Mozilla Public License, v. 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.mozilla.org/en-US/MPL/2.0/
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+#include <fcntl.h>
+
+#include "../src/log.h"
+#include "../src/sync_service.h"
+#include "test_macros.h"
+
+#define FILE_NAME "test_sync.log"
+#define NUM_FILES 3
+
+/* helper that reads the number of syncs the service has done */
+uint64_t test_sync_count(sync_service_t* service)
+{
+    pthread_mutex_lock(&service->lock);
+    uint64_t syncs = service->syncs;
+    pthread_mutex_unlock(&service->lock);
+    return syncs;
+}
+
+/* helper that waits up to two seconds for the service to have done a number of syncs */
+bool wait_for_syncs(sync_service_t* service, uint64_t syncs)
+{
+    for (int i = 0; i < 200; i++)
+    {
+        if (test_sync_count(service) >= syncs) return true;
+        usleep(10000);
+    }
+    return false;
+}
+
+/* helper that opens the test files */
+void open_test_files(int* fds)
+{
+    for (int i = 0; i < NUM_FILES; i++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "test_sync_%d.dat", i);
+        fds[i] = open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        assert(fds[i] != -1);
+        assert(write(fds[i], "data", 4) == 4);
+    }
+}
+
+/* helper that closes and removes the test files */
+void close_test_files(int* fds)
+{
+    for (int i = 0; i < NUM_FILES; i++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "test_sync_%d.dat", i);
+        close(fds[i]);
+        remove(name);
+    }
+}
+
+void test_sync_service_mark()
+{
+    sync_service_t* service = NULL;
+    assert(sync_service_open(0.05, &service) == 0);
+
+    int fds[NUM_FILES];
+    open_test_files(fds);
+
+    /* a file marked more than once before the service gets to it is synced once */
+    sync_file_t files[NUM_FILES];
+    for (int i = 0; i < NUM_FILES; i++)
+    {
+        sync_file_init(&files[i], fds[i]);
+        sync_service_mark(service, &files[i], 1);
+        sync_service_mark(service, &files[i], 1);
+    }
+
+    assert(wait_for_syncs(service, NUM_FILES));
+    usleep(100000);
+    assert(test_sync_count(service) == NUM_FILES);
+
+    for (int i = 0; i < NUM_FILES; i++)
+    {
+        assert(!files[i].queued);
+        assert(files[i].pending == 0);
+    }
+    assert(service->head == NULL && service->tail == NULL);
+
+    /* with nothing dirty the service does not sync again */
+    usleep(200000);
+    assert(test_sync_count(service) == NUM_FILES);
+
+    for (int i = 0; i < NUM_FILES; i++) sync_service_remove(service, &files[i]);
+    assert(sync_service_close(service) == 0);
+    close_test_files(fds);
+
+    printf(GREEN "test_sync_service_mark passed\n" RESET);
+}
+
+void test_sync_service_urgent()
+{
+    /* an interval far longer than the test */
+    sync_service_t* service = NULL;
+    assert(sync_service_open(60.0, &service) == 0);
+
+    int fds[NUM_FILES];
+    open_test_files(fds);
+
+    sync_file_t files[NUM_FILES];
+    for (int i = 0; i < NUM_FILES; i++) sync_file_init(&files[i], fds[i]);
+
+    sync_service_mark(service, &files[0], 1);
+    usleep(100000);
+    assert(test_sync_count(service) == 0);
+
+    /* a file with enough writes pending does not wait out the interval, the queue goes with it */
+    sync_service_mark(service, &files[1], SYNC_INTERVAL);
+    assert(wait_for_syncs(service, 2));
+    assert(!files[0].queued && !files[1].queued);
+
+    for (int i = 0; i < NUM_FILES; i++) sync_service_remove(service, &files[i]);
+    assert(sync_service_close(service) == 0);
+    close_test_files(fds);
+
+    printf(GREEN "test_sync_service_urgent passed\n" RESET);
+}
+
+void test_sync_service_remove_close()
+{
+    sync_service_t* service = NULL;
+    assert(sync_service_open(60.0, &service) == 0);
+
+    int fds[NUM_FILES];
+    open_test_files(fds);
+
+    sync_file_t files[NUM_FILES];
+    for (int i = 0; i < NUM_FILES; i++)
+    {
+        sync_file_init(&files[i], fds[i]);
+        sync_service_mark(service, &files[i], 1);
+    }
+
+    /* a removed file leaves the queue wherever it is in it */
+    sync_service_remove(service, &files[1]);
+    assert(!files[1].queued);
+    assert(service->head == &files[0] && service->tail == &files[2]);
+    assert(files[0].next == &files[2] && files[2].prev == &files[0]);
+
+    sync_service_remove(service, &files[0]);
+    sync_service_remove(service, &files[2]);
+    assert(service->head == NULL && service->tail == NULL);
+    assert(test_sync_count(service) == 0);
+
+    /* closing the service syncs what is still queued */
+    sync_service_mark(service, &files[2], 1);
+    assert(sync_service_close(service) == 0);
+    assert(!files[2].queued);
+    assert(files[2].pending == 0);
+
+    close_test_files(fds);
+
+    printf(GREEN "test_sync_service_remove_close passed\n" RESET);
+}
+
+void test_sync_service_log()
+{
+    remove(FILE_NAME);
+
+    sync_service_t* service = NULL;
+    assert(sync_service_open(60.0, &service) == 0);
+
+    log_t* log = NULL;
+    assert(log_open(FILE_NAME, 1, &log) == 0);
+    log_set_sync_service(log, service);
+
+    /* an append that syncs itself leaves the service nothing to do */
+    uint8_t entry[] = "an entry";
+    assert(log_append(log, entry, sizeof(entry), true) == 0);
+    assert(!log->sync_file.queued);
+
+    assert(log_append(log, entry, sizeof(entry), false) == 0);
+    assert(log_append(log, entry, sizeof(entry), false) == 0);
+    assert(log->sync_file.queued);
+    assert(log->sync_file.pending == 2);
+    assert(service->head == &log->sync_file);
+
+    /* the log lets go of the service as it is closed */
+    assert(log_close(log) == 0);
+    assert(service->head == NULL);
+    assert(test_sync_count(service) == 0);
+
+    assert(sync_service_close(service) == 0);
+    remove(FILE_NAME);
+
+    printf(GREEN "test_sync_service_log passed\n" RESET);
+}
+
+int main(void)
+{
+    test_sync_service_mark();
+    test_sync_service_urgent();
+    test_sync_service_remove_close();
+    test_sync_service_log();
+    return 0;
+}
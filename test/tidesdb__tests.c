@@ -23,6 +23,7 @@
 #include "test_utils.h"
 
 #define TEST_DIR           "testdb"
+#define TEST_WAL_DIR       "testwal"
 #define TEST_COLUMN_FAMILY "cf"
 
 void test_open_close()
@@ -36,6 +37,14 @@ void test_open_close()
 
     tdb_config->db_path = TEST_DIR;
     tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
 
     tidesdb_t* tdb = NULL;
 
@@ -76,6 +85,14 @@ void test_create_column_family()
 
     tdb_config->db_path = TEST_DIR;
     tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
 
     tidesdb_t* tdb = NULL;
 
@@ -124,6 +141,14 @@ void test_drop_column_family()
 
     tdb_config->db_path = TEST_DIR;
     tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
 
     tidesdb_t* tdb = NULL;
 
@@ -183,6 +208,14 @@ void test_put()
 
     tdb_config->db_path = TEST_DIR;
     tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
 
     tidesdb_t* tdb = NULL;
 
@@ -250,6 +283,14 @@ void test_put_get()
 
     tdb_config->db_path = TEST_DIR;
     tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
 
     tidesdb_t* tdb = NULL;
 
@@ -336,6 +377,14 @@ void test_put_flush_get()
 
     tdb_config->db_path = TEST_DIR;
     tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
 
     tidesdb_t* tdb = NULL;
 
@@ -425,6 +474,14 @@ void test_put_reopen_get()
 
     tdb_config->db_path = TEST_DIR;
     tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
 
     tidesdb_t* tdb = NULL;
 
@@ -544,6 +601,14 @@ void test_put_get_delete()
 
     tdb_config->db_path = TEST_DIR;
     tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
 
     tidesdb_t* tdb = NULL;
 
@@ -644,6 +709,14 @@ void test_txn_put_delete_get()
 
     tdb_config->db_path = TEST_DIR;
     tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
 
     tidesdb_t* tdb = NULL;
 
@@ -781,6 +854,14 @@ void test_put_compact()
 
     tdb_config->db_path = TEST_DIR;
     tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
 
     tidesdb_t* tdb = NULL;
 
@@ -858,6 +939,14 @@ void test_put_compact_get()
 
     tdb_config->db_path = TEST_DIR;
     tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
 
     tidesdb_t* tdb = NULL;
 
@@ -953,6 +1042,278 @@ void test_put_compact_get()
     printf(GREEN "test_put_compact_get passed\n" RESET);
 }
 
+void check_leveled_compact_get(tidesdb_t* tdb, bool check_deleted)
+{
+    column_family_t* cf = NULL;
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+
+    /* level 0 was compacted away and no deeper level overlaps itself */
+    tidesdb_version_t* version = _pin_version(cf);
+    assert(version->level_counts[0] == 0);
+    assert(version->num_sstables > 1);
+
+    for (int i = 1; i < version->num_sstables; i++)
+    {
+        sstable_t* prev = version->sstables[i - 1];
+        sstable_t* sst = version->sstables[i];
+
+        assert(prev->level >= sst->level);
+        assert(sst->level > 0);
+        if (prev->level == sst->level)
+            assert(sstable_compare_keys(prev->max_key, prev->max_key_size, sst->min_key,
+                                        sst->min_key_size) < 0);
+    }
+
+    _release_version(version);
+
+    /* every live key is found, the deleted keys stay deleted */
+    for (int i = 0; i < 40000; i++)
+    {
+        uint8_t key[48];
+        uint8_t value[48];
+        snprintf(key, sizeof(key), "key%05d", i);
+        snprintf(value, sizeof(value), "value%05d-0123456789abcdef0123456789abcdef", i);
+
+        size_t value_len = 0;
+        uint8_t* value_out = NULL;
+
+        tidesdb_err_t* e = tidesdb_get(tdb, cf->config.name, key, strlen(key), &value_out,
+                                       &value_len);
+        if (i % 10 == 0)
+        {
+            if (check_deleted) assert(e != NULL);
+            tidesdb_err_free(e);
+            free(value_out);
+            continue;
+        }
+
+        if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+        assert(e == NULL);
+
+        assert(value_len == strlen((char*)value));
+        assert(memcmp(value_out, value, value_len) == 0);
+
+        free(value_out);
+    }
+}
+
+void test_put_delete_leveled_compact_get()
+{
+    tidesdb_config_t* tdb_config = malloc(sizeof(tidesdb_config_t));
+    if (tdb_config == NULL)
+    {
+        printf(RED "Error: Failed to allocate memory for tdb_config\n" RESET);
+        return;
+    }
+
+    tdb_config->db_path = TEST_DIR;
+    tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
+
+    tidesdb_t* tdb = NULL;
+
+    tidesdb_err_t* e = tidesdb_open(tdb_config, &tdb);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    assert(e == NULL);
+    assert(tdb != NULL);
+
+    /* we use small output files and a small multiplier so the pairs are pushed through
+     * several levels */
+    column_family_config_t config = {0};
+    config.name = TEST_COLUMN_FAMILY;
+    config.flush_threshold = 1024 * 1024;
+    config.max_level = 12;
+    config.probability = 0.24f;
+    config.target_file_size = TIDESDB_MIN_TARGET_FILE_SIZE;
+    config.level_size_multiplier = TIDESDB_MIN_LEVEL_MULTIPLIER;
+
+    e = tidesdb_create_column_family_with_config(tdb, &config);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    assert(e == NULL);
+
+    for (int i = 0; i < 40000; i++)
+    {
+        uint8_t key[48];
+        uint8_t value[48];
+        snprintf(key, sizeof(key), "key%05d", i);
+        snprintf(value, sizeof(value), "value%05d-0123456789abcdef0123456789abcdef", i);
+
+        e = tidesdb_put(tdb, TEST_COLUMN_FAMILY, key, strlen(key), value, strlen(value), -1);
+        if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+        assert(e == NULL);
+    }
+
+    /* we delete every tenth key, the tombstones must hide the pairs in the older sstables */
+    for (int i = 0; i < 40000; i += 10)
+    {
+        uint8_t key[48];
+        snprintf(key, sizeof(key), "key%05d", i);
+
+        e = tidesdb_delete(tdb, TEST_COLUMN_FAMILY, key, strlen(key));
+        if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+        assert(e == NULL);
+    }
+
+    /* we put more pairs so the tombstones are flushed */
+    for (int i = 0; i < 20000; i++)
+    {
+        uint8_t key[48];
+        uint8_t value[48];
+        snprintf(key, sizeof(key), "zfill%05d", i);
+        snprintf(value, sizeof(value), "value%05d-0123456789abcdef0123456789abcdef", i);
+
+        e = tidesdb_put(tdb, TEST_COLUMN_FAMILY, key, strlen(key), value, strlen(value), -1);
+        if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+        assert(e == NULL);
+    }
+
+    sleep(5); /* wait for the SST files to be written */
+
+    e = tidesdb_compact_sstables(tdb, TEST_COLUMN_FAMILY, 2);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    assert(e == NULL);
+
+    check_leveled_compact_get(tdb, true);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    /* the levels are restored from the sstable footers.  the wal still holds the flushed
+     * operations and replays them into the memtable, so we only check the live keys here */
+    e = tidesdb_open(tdb_config, &tdb);
+    assert(e == NULL);
+
+    check_leveled_compact_get(tdb, false);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    remove_directory(TEST_DIR);
+
+    free(tdb_config);
+
+    printf(GREEN "test_put_delete_leveled_compact_get passed\n" RESET);
+}
+
+void test_background_compaction()
+{
+    tidesdb_config_t* tdb_config = malloc(sizeof(tidesdb_config_t));
+    if (tdb_config == NULL)
+    {
+        printf(RED "Error: Failed to allocate memory for tdb_config\n" RESET);
+        return;
+    }
+
+    tdb_config->db_path = TEST_DIR;
+    tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 2;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
+
+    tidesdb_t* tdb = NULL;
+
+    tidesdb_err_t* e = tidesdb_open(tdb_config, &tdb);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    assert(e == NULL);
+    assert(tdb != NULL);
+
+    /* two level 0 sstables are enough to fire the trigger */
+    column_family_config_t config = {0};
+    config.name = TEST_COLUMN_FAMILY;
+    config.flush_threshold = 1024 * 1024;
+    config.max_level = 12;
+    config.probability = 0.24f;
+    config.target_file_size = TIDESDB_MIN_TARGET_FILE_SIZE;
+    config.level_size_multiplier = TIDESDB_MIN_LEVEL_MULTIPLIER;
+    config.l0_compaction_trigger = 2;
+
+    e = tidesdb_create_column_family_with_config(tdb, &config);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    assert(e == NULL);
+
+    column_family_t* cf = NULL;
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+
+    for (int i = 0; i < 60000; i++)
+    {
+        uint8_t key[48];
+        uint8_t value[48];
+        snprintf(key, sizeof(key), "key%05d", i);
+        snprintf(value, sizeof(value), "value%05d-0123456789abcdef0123456789abcdef", i);
+
+        e = tidesdb_put(tdb, TEST_COLUMN_FAMILY, key, strlen(key), value, strlen(value), -1);
+        if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+        assert(e == NULL);
+    }
+
+    /* we never compact ourselves, the background threads keep level 0 and every level within
+     * their triggers */
+    bool compacted = false;
+    for (int wait = 0; wait < 60 && !compacted; wait++)
+    {
+        sleep(1);
+
+        tidesdb_version_t* version = _pin_version(cf);
+        compacted = version->num_sstables > 0 && version->level_counts[0] < 2;
+        for (int level = 1; level < TIDESDB_NUM_LEVELS - 1; level++)
+            if (_level_size(version, level) > _level_target_size(cf, level)) compacted = false;
+        _release_version(version);
+    }
+
+    assert(compacted);
+
+    for (int i = 0; i < 60000; i++)
+    {
+        uint8_t key[48];
+        uint8_t value[48];
+        snprintf(key, sizeof(key), "key%05d", i);
+        snprintf(value, sizeof(value), "value%05d-0123456789abcdef0123456789abcdef", i);
+
+        size_t value_len = 0;
+        uint8_t* value_out = NULL;
+
+        e = tidesdb_get(tdb, TEST_COLUMN_FAMILY, key, strlen(key), &value_out, &value_len);
+        if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+        assert(e == NULL);
+
+        assert(value_len == strlen((char*)value));
+        assert(memcmp(value_out, value, value_len) == 0);
+
+        free(value_out);
+    }
+
+    /* a manual compaction still works next to the background threads */
+    e = tidesdb_compact_sstables(tdb, TEST_COLUMN_FAMILY, 2);
+    assert(e == NULL || e->code == 1051);
+    tidesdb_err_free(e);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    remove_directory(TEST_DIR);
+
+    free(tdb_config);
+
+    printf(GREEN "test_background_compaction passed\n" RESET);
+}
+
 void test_put_compact_reopen_get()
 {
     tidesdb_config_t* tdb_config = (malloc(sizeof(tidesdb_config_t)));
@@ -964,6 +1325,14 @@ void test_put_compact_reopen_get()
 
     tdb_config->db_path = TEST_DIR;
     tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
 
     tidesdb_t* tdb = NULL;
 
@@ -1033,6 +1402,14 @@ void test_put_compact_reopen_get()
 
     tdb_config->db_path = TEST_DIR;
     tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
 
     e = tidesdb_open(tdb_config, &tdb);
     if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
@@ -1161,6 +1538,14 @@ void test_concurrent_put_get()
 
     tdb_config->db_path = TEST_DIR;
     tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
 
     tidesdb_t* tdb = NULL;
 
@@ -1204,9 +1589,66 @@ void test_concurrent_put_get()
     printf(GREEN "test_concurrent_put_get passed\n" RESET);
 }
 
-void test_cursor()
+/* helper for test_concurrent_memtable_put_get */
+typedef struct
 {
-    tidesdb_config_t* tdb_config = malloc(sizeof(tidesdb_config_t));
+    tidesdb_t* tdb;
+    int thread_id;
+} concurrent_memtable_thread_data_t;
+
+/* helper for test_concurrent_memtable_put_get */
+void* concurrent_memtable_put_thread(void* arg)
+{
+    concurrent_memtable_thread_data_t* data = arg;
+
+    for (int i = 0; i < 10000; i++)
+    {
+        uint8_t key[32];
+        uint8_t value[128];
+        snprintf(key, sizeof(key), "key%d_%05d", data->thread_id, i);
+        snprintf(value, sizeof(value), "value%d_%05d-%0100d", data->thread_id, i, 0);
+
+        tidesdb_err_t* e =
+            tidesdb_put(data->tdb, TEST_COLUMN_FAMILY, key, strlen(key), value, strlen(value), -1);
+        if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+        assert(e == NULL);
+    }
+
+    return NULL;
+}
+
+/* helper for test_concurrent_memtable_put_get */
+void check_concurrent_memtable_get(tidesdb_t* tdb)
+{
+    for (int t = 0; t < 4; t++)
+    {
+        for (int i = 0; i < 10000; i++)
+        {
+            uint8_t key[32];
+            uint8_t value[128];
+            snprintf(key, sizeof(key), "key%d_%05d", t, i);
+            snprintf(value, sizeof(value), "value%d_%05d-%0100d", t, i, 0);
+
+            uint8_t* value_out = NULL;
+            size_t value_len = 0;
+
+            tidesdb_err_t* e =
+                tidesdb_get(tdb, TEST_COLUMN_FAMILY, key, strlen(key), &value_out, &value_len);
+            if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+            assert(e == NULL);
+            assert(value_len == strlen(value));
+            assert(memcmp(value_out, value, value_len) == 0);
+
+            free(value_out);
+        }
+    }
+}
+
+void test_concurrent_memtable_put_get()
+{
+    tidesdb_config_t* tdb_config = (malloc(sizeof(tidesdb_config_t)));
     if (tdb_config == NULL)
     {
         printf(RED "Error: Failed to allocate memory for tdb_config\n" RESET);
@@ -1215,17 +1657,32 @@ void test_cursor()
 
     tdb_config->db_path = TEST_DIR;
     tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
 
     tidesdb_t* tdb = NULL;
 
     tidesdb_err_t* e = tidesdb_open(tdb_config, &tdb);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
     assert(e == NULL);
-    assert(tdb != NULL);
 
     tidesdb_err_free(e);
 
-    /* create a column family */
-    e = tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, (1024 * 1024), 12, 0.24f, false);
+    column_family_config_t config = {0};
+    config.name = TEST_COLUMN_FAMILY;
+    config.flush_threshold = 1024 * 1024;
+    config.max_level = 12;
+    config.probability = 0.24f;
+    config.concurrent_memtable = true;
+
+    e = tidesdb_create_column_family_with_config(tdb, &config);
     if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
 
     assert(e == NULL);
@@ -1233,36 +1690,1513 @@ void test_cursor()
     tidesdb_err_free(e);
 
     column_family_t* cf = NULL;
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+    assert(cf->memtable->concurrent);
+
+    /* the writers put into the same memtable at once, rotating it a few times */
+    pthread_t threads[4];
+    concurrent_memtable_thread_data_t thread_data[4];
+    for (int t = 0; t < 4; t++)
+    {
+        thread_data[t].tdb = tdb;
+        thread_data[t].thread_id = t;
+        pthread_create(&threads[t], NULL, concurrent_memtable_put_thread, &thread_data[t]);
+    }
+
+    for (int t = 0; t < 4; t++) pthread_join(threads[t], NULL);
+
+    check_concurrent_memtable_get(tdb);
+
+    e = tidesdb_close(tdb);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    tidesdb_err_free(e);
+
+    /* the column family keeps its concurrent memtable after a reopen */
+    e = tidesdb_open(tdb_config, &tdb);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    assert(e == NULL);
+
+    tidesdb_err_free(e);
 
-    /* we should be able to get the column family */
     assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+    assert(cf->config.concurrent_memtable);
+    assert(cf->memtable->concurrent);
 
-    /* put 60000 key-value pairs */
-    for (int i = 0; i < 60000; i++)
+    e = tidesdb_close(tdb);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    tidesdb_err_free(e);
+
+    remove_directory(TEST_DIR);
+
+    free(tdb_config);
+
+    printf(GREEN "test_concurrent_memtable_put_get passed\n" RESET);
+}
+
+/* helper for test_wal_group_commit */
+void* wal_group_commit_put_thread(void* arg)
+{
+    concurrent_memtable_thread_data_t* data = arg;
+
+    for (int i = 0; i < 200; i++)
     {
-        uint8_t key[48];
-        uint8_t value[48];
-        snprintf(key, sizeof(key), "key%03d", i);
-        snprintf(value, sizeof(value), "value%03d", i);
+        uint8_t key[32];
+        uint8_t value[32];
+        snprintf(key, sizeof(key), "key%d_%03d", data->thread_id, i);
+        snprintf(value, sizeof(value), "value%d_%03d", data->thread_id, i);
 
-        e = tidesdb_put(tdb, cf->config.name, key, strlen(key), value, strlen(value), -1);
-        if (e != NULL)
-        {
-            printf(RED "Error: %s\n" RESET, e->message);
-            tidesdb_err_free(e);
-            break;
-        }
+        tidesdb_err_t* e =
+            tidesdb_put(data->tdb, TEST_COLUMN_FAMILY, key, strlen(key), value, strlen(value), -1);
+        if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+        assert(e == NULL);
     }
 
-    sleep(5); /* wait for the SST file to be written */
+    return NULL;
+}
 
-    /* initialize cursor */
-    tidesdb_cursor_t* cursor;
-    e = tidesdb_cursor_init(tdb, TEST_COLUMN_FAMILY, &cursor);
-    if (e != NULL)
+void test_wal_group_commit()
+{
+    tidesdb_config_t* tdb_config = (malloc(sizeof(tidesdb_config_t)));
+    if (tdb_config == NULL)
     {
-        printf(RED "Error: %s\n" RESET, e->message);
-        tidesdb_err_free(e);
+        printf(RED "Error: Failed to allocate memory for tdb_config\n" RESET);
+        return;
+    }
+
+    tdb_config->db_path = TEST_DIR;
+    tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = true;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
+
+    tidesdb_t* tdb = NULL;
+
+    tidesdb_err_t* e = tidesdb_open(tdb_config, &tdb);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    assert(e == NULL);
+
+    tidesdb_err_free(e);
+
+    e = tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, 1024 * 1024 * 64, 12, 0.24f, false);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    assert(e == NULL);
+
+    tidesdb_err_free(e);
+
+    /* every put waits for its wal entry to be synced, the writers share the syncs */
+    pthread_t threads[8];
+    concurrent_memtable_thread_data_t thread_data[8];
+    for (int t = 0; t < 8; t++)
+    {
+        thread_data[t].tdb = tdb;
+        thread_data[t].thread_id = t;
+        pthread_create(&threads[t], NULL, wal_group_commit_put_thread, &thread_data[t]);
+    }
+
+    for (int t = 0; t < 8; t++) pthread_join(threads[t], NULL);
+
+    /* every entry was written once, packed back to back instead of a page each */
+    column_family_t* cf = NULL;
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+    assert(cf->wal->commit_head == NULL);
+    assert(!cf->wal->committing);
+
+    size_t wal_size = 0;
+    assert(log_size(cf->wal->log, &wal_size) == 0);
+    assert(wal_size > 8 * 200 * LOG_HEADER_SIZE);
+    assert(wal_size < 8 * 200 * 100);
+
+    e = tidesdb_close(tdb);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    tidesdb_err_free(e);
+
+    /* nothing was flushed, the pairs come back from the wal */
+    e = tidesdb_open(tdb_config, &tdb);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    assert(e == NULL);
+
+    tidesdb_err_free(e);
+
+    for (int t = 0; t < 8; t++)
+    {
+        for (int i = 0; i < 200; i++)
+        {
+            uint8_t key[32];
+            uint8_t value[32];
+            snprintf(key, sizeof(key), "key%d_%03d", t, i);
+            snprintf(value, sizeof(value), "value%d_%03d", t, i);
+
+            uint8_t* value_out = NULL;
+            size_t value_len = 0;
+
+            e = tidesdb_get(tdb, TEST_COLUMN_FAMILY, key, strlen(key), &value_out, &value_len);
+            if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+            assert(e == NULL);
+            assert(value_len == strlen(value));
+            assert(memcmp(value_out, value, value_len) == 0);
+
+            free(value_out);
+        }
+    }
+
+    e = tidesdb_close(tdb);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    tidesdb_err_free(e);
+
+    remove_directory(TEST_DIR);
+
+    free(tdb_config);
+
+    printf(GREEN "test_wal_group_commit passed\n" RESET);
+}
+
+/* helper for the wal replay tests */
+void open_wal_test_db(tidesdb_config_t* tdb_config, tidesdb_t** tdb)
+{
+    tdb_config->db_path = TEST_DIR;
+    tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
+
+    tidesdb_err_t* e = tidesdb_open(tdb_config, tdb);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    assert(e == NULL);
+
+    tidesdb_err_free(e);
+}
+
+/* helper for the wal replay tests */
+void check_wal_test_get(tidesdb_t* tdb, const char* key, bool found)
+{
+    uint8_t* value_out = NULL;
+    size_t value_len = 0;
+
+    tidesdb_err_t* e =
+        tidesdb_get(tdb, TEST_COLUMN_FAMILY, (uint8_t*)key, strlen(key), &value_out, &value_len);
+
+    if (found)
+    {
+        if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+        assert(e == NULL);
+        assert(value_len == strlen(key));
+        assert(memcmp(value_out, key, value_len) == 0);
+        free(value_out);
+    }
+    else
+    {
+        assert(e != NULL);
+    }
+
+    tidesdb_err_free(e);
+}
+
+void test_wal_torn_tail_replay()
+{
+    tidesdb_config_t tdb_config;
+    tidesdb_t* tdb = NULL;
+    open_wal_test_db(&tdb_config, &tdb);
+
+    tidesdb_err_t* e =
+        tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, 1024 * 1024 * 64, 12, 0.24f, false);
+    assert(e == NULL);
+
+    for (int i = 0; i < 100; i++)
+    {
+        char key[16];
+        snprintf(key, sizeof(key), "key%03d", i);
+
+        e = tidesdb_put(tdb, TEST_COLUMN_FAMILY, (uint8_t*)key, strlen(key), (uint8_t*)key,
+                        strlen(key), -1);
+        assert(e == NULL);
+    }
+
+    /* the entries went to the segment started when the column family was created */
+    column_family_t* cf = NULL;
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+
+    char wal_path[PATH_MAX];
+    _wal_segment_path(cf->wal, cf->wal->log_number, WAL_EXT, wal_path, sizeof(wal_path));
+
+    size_t wal_size = 0;
+    assert(log_size(cf->wal->log, &wal_size) == 0);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    /* a crash tears the last entry of the segment */
+    assert(truncate(wal_path, wal_size - 3) == 0);
+
+    /* the replay stops before the torn entry */
+    open_wal_test_db(&tdb_config, &tdb);
+
+    check_wal_test_get(tdb, "key000", true);
+    check_wal_test_get(tdb, "key098", true);
+    check_wal_test_get(tdb, "key099", false);
+
+    /* new entries go to a new segment, they are replayed after the torn one */
+    e = tidesdb_put(tdb, TEST_COLUMN_FAMILY, (uint8_t*)"key100", 6, (uint8_t*)"key100", 6, -1);
+    assert(e == NULL);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    open_wal_test_db(&tdb_config, &tdb);
+
+    check_wal_test_get(tdb, "key098", true);
+    check_wal_test_get(tdb, "key100", true);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_wal_torn_tail_replay passed\n" RESET);
+}
+
+void test_legacy_wal_migration()
+{
+    tidesdb_config_t tdb_config;
+    tidesdb_t* tdb = NULL;
+    open_wal_test_db(&tdb_config, &tdb);
+
+    tidesdb_err_t* e =
+        tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, 1024 * 1024 * 64, 12, 0.24f, false);
+    assert(e == NULL);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    /* we add a wal in the paged format of older versions */
+    char legacy_path[PATH_MAX];
+    snprintf(legacy_path, sizeof(legacy_path), "%s/%s/%s", TEST_DIR, TEST_COLUMN_FAMILY,
+             LEGACY_WAL_EXT);
+
+    pager_t* pager = NULL;
+    assert(pager_open(legacy_path, &pager) == 0);
+
+    for (int i = 0; i < 10; i++)
+    {
+        char key[16];
+        snprintf(key, sizeof(key), "key%03d", i);
+
+        key_value_pair_t kv = {(uint8_t*)key, strlen(key), (uint8_t*)key, strlen(key), -1};
+        operation_t op = {OP_PUT, &kv, TEST_COLUMN_FAMILY};
+
+        uint8_t* buffer = NULL;
+        size_t buffer_size = 0;
+        assert(serialize_operation(&op, &buffer, &buffer_size, false) == 0);
+
+        unsigned int page_num = 0;
+        assert(pager_write(pager, buffer, buffer_size, &page_num) == 0);
+        free(buffer);
+    }
+
+    assert(pager_close(pager) == 0);
+
+    /* the operations are copied into a segment and the paged file is removed */
+    open_wal_test_db(&tdb_config, &tdb);
+
+    check_wal_test_get(tdb, "key000", true);
+    check_wal_test_get(tdb, "key009", true);
+    assert(access(legacy_path, F_OK) == -1);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    /* they come back from the segment from now on */
+    open_wal_test_db(&tdb_config, &tdb);
+
+    check_wal_test_get(tdb, "key005", true);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_legacy_wal_migration passed\n" RESET);
+}
+
+/* helper for the wal segment test, counts the files in a directory with an extension */
+int count_files_with_ext(const char* path, const char* ext)
+{
+    DIR* dir = opendir(path);
+    if (dir == NULL) return 0;
+
+    int count = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        size_t len = strlen(entry->d_name);
+        if (len > strlen(ext) && strcmp(entry->d_name + len - strlen(ext), ext) == 0) count++;
+    }
+
+    closedir(dir);
+
+    return count;
+}
+
+void test_wal_segments()
+{
+    tidesdb_config_t tdb_config;
+    tdb_config.db_path = TEST_DIR;
+    tdb_config.compressed_wal = false;
+    tdb_config.compaction_threads = 0;
+    tdb_config.sync_wal = false;
+    tdb_config.wal_dir = TEST_WAL_DIR;
+    tdb_config.open_progress = NULL;
+    tdb_config.open_progress_arg = NULL;
+    tdb_config.max_open_files = 0;
+    tdb_config.mmap_reads = false;
+    tdb_config.block_cache_size = 0;
+
+    tidesdb_t* tdb = NULL;
+    tidesdb_err_t* e = tidesdb_open(&tdb_config, &tdb);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    assert(e == NULL);
+
+    e = tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, 1024 * 1024, 12, 0.24f, false);
+    assert(e == NULL);
+
+    /* the memtable is rotated and flushed a few times */
+    uint8_t* value = malloc(64 * 1024);
+    assert(value != NULL);
+    memset(value, 'v', 64 * 1024);
+
+    for (int i = 0; i < 128; i++)
+    {
+        char key[16];
+        snprintf(key, sizeof(key), "key%03d", i);
+
+        e = tidesdb_put(tdb, TEST_COLUMN_FAMILY, (uint8_t*)key, strlen(key), value, 64 * 1024,
+                        -1);
+        assert(e == NULL);
+    }
+
+    sleep(3); /* wait for the SST files to be written */
+
+    /* the segments live in the wal directory, the flushed ones were retired and some of them kept
+     * for reuse */
+    char wal_path[PATH_MAX];
+    char cf_path[PATH_MAX];
+    snprintf(wal_path, sizeof(wal_path), "%s/%s", TEST_WAL_DIR, TEST_COLUMN_FAMILY);
+    snprintf(cf_path, sizeof(cf_path), "%s/%s", TEST_DIR, TEST_COLUMN_FAMILY);
+
+    column_family_t* cf = NULL;
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+    assert(cf->wal->log_number > 4);
+    assert(count_files_with_ext(cf_path, WAL_EXT) == 0);
+    assert(count_files_with_ext(wal_path, WAL_EXT) <= 2);
+    assert(count_files_with_ext(wal_path, WAL_RECYCLE_EXT) > 0);
+    assert(count_files_with_ext(wal_path, WAL_RECYCLE_EXT) <= TIDESDB_WAL_MAX_RECYCLED);
+
+    /* a segment is preallocated */
+    char segment_path[PATH_MAX];
+    _wal_segment_path(cf->wal, cf->wal->log_number, WAL_EXT, segment_path, sizeof(segment_path));
+
+    struct stat segment_stat;
+    assert(stat(segment_path, &segment_stat) == 0);
+    assert(segment_stat.st_size >= TIDESDB_WAL_SEGMENT_SIZE);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    /* what was flushed and what is left in the segments comes back */
+    e = tidesdb_open(&tdb_config, &tdb);
+    assert(e == NULL);
+
+    for (int i = 0; i < 128; i++)
+    {
+        char key[16];
+        snprintf(key, sizeof(key), "key%03d", i);
+
+        uint8_t* value_out = NULL;
+        size_t value_len = 0;
+
+        e = tidesdb_get(tdb, TEST_COLUMN_FAMILY, (uint8_t*)key, strlen(key), &value_out,
+                        &value_len);
+        assert(e == NULL);
+        assert(value_len == 64 * 1024);
+        assert(memcmp(value_out, value, value_len) == 0);
+        free(value_out);
+    }
+
+    /* dropping the column family removes its segments too */
+    e = tidesdb_drop_column_family(tdb, TEST_COLUMN_FAMILY);
+    assert(e == NULL);
+    assert(access(wal_path, F_OK) == -1);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    free(value);
+
+    remove_directory(TEST_DIR);
+    remove_directory(TEST_WAL_DIR);
+
+    printf(GREEN "test_wal_segments passed\n" RESET);
+}
+
+void test_batch_write_reopen_get()
+{
+    /* the batch is replayed the same from a plain and a compressed wal */
+    for (int compressed = 0; compressed <= 1; compressed++)
+    {
+        tidesdb_config_t tdb_config;
+        tidesdb_t* tdb = NULL;
+        open_wal_test_db(&tdb_config, &tdb);
+
+        tidesdb_err_t* e = tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, 1024 * 1024 * 64,
+                                                        12, 0.24f, false);
+        assert(e == NULL);
+
+        e = tidesdb_close(tdb);
+        assert(e == NULL);
+
+        tdb_config.compressed_wal = compressed;
+        e = tidesdb_open(&tdb_config, &tdb);
+        assert(e == NULL);
+
+        e = tidesdb_put(tdb, TEST_COLUMN_FAMILY, (uint8_t*)"key999", 6, (uint8_t*)"key999", 6, -1);
+        assert(e == NULL);
+
+        tidesdb_batch_t* batch = NULL;
+        e = tidesdb_batch_new(&batch);
+        assert(e == NULL);
+
+        /* enough operations to grow the batch buffer */
+        for (int i = 0; i < 500; i++)
+        {
+            char key[16];
+            snprintf(key, sizeof(key), "key%03d", i);
+
+            e = tidesdb_batch_put(batch, (uint8_t*)key, strlen(key), (uint8_t*)key, strlen(key),
+                                  -1);
+            assert(e == NULL);
+        }
+
+        /* later operations of a batch win over earlier ones */
+        e = tidesdb_batch_delete(batch, (uint8_t*)"key010", 6);
+        assert(e == NULL);
+        e = tidesdb_batch_delete(batch, (uint8_t*)"key999", 6);
+        assert(e == NULL);
+        e = tidesdb_batch_put(batch, (uint8_t*)"key011", 6, (uint8_t*)"other", 5, -1);
+        assert(e == NULL);
+        assert(batch->count == 503);
+
+        /* nothing is visible until the batch is written */
+        check_wal_test_get(tdb, "key000", false);
+
+        e = tidesdb_batch_write(tdb, TEST_COLUMN_FAMILY, batch);
+        assert(e == NULL);
+
+        /* a cleared batch writes nothing */
+        e = tidesdb_batch_clear(batch);
+        assert(e == NULL);
+        assert(batch->count == 0);
+
+        e = tidesdb_batch_write(tdb, TEST_COLUMN_FAMILY, batch);
+        assert(e == NULL);
+
+        e = tidesdb_batch_write(tdb, "missing", batch);
+        assert(e != NULL);
+        tidesdb_err_free(e);
+
+        e = tidesdb_batch_free(batch);
+        assert(e == NULL);
+
+        for (int reopen = 0; reopen <= 1; reopen++)
+        {
+            check_wal_test_get(tdb, "key000", true);
+            check_wal_test_get(tdb, "key499", true);
+            check_wal_test_get(tdb, "key010", false);
+            check_wal_test_get(tdb, "key999", false);
+
+            uint8_t* value_out = NULL;
+            size_t value_len = 0;
+            e = tidesdb_get(tdb, TEST_COLUMN_FAMILY, (uint8_t*)"key011", 6, &value_out,
+                            &value_len);
+            assert(e == NULL);
+            assert(value_len == 5 && memcmp(value_out, "other", 5) == 0);
+            free(value_out);
+
+            /* the batch is replayed from the wal */
+            e = tidesdb_close(tdb);
+            assert(e == NULL);
+
+            e = tidesdb_open(&tdb_config, &tdb);
+            assert(e == NULL);
+        }
+
+        e = tidesdb_close(tdb);
+        assert(e == NULL);
+
+        remove_directory(TEST_DIR);
+    }
+
+    printf(GREEN "test_batch_write_reopen_get passed\n" RESET);
+}
+
+void test_batch_torn_replay()
+{
+    tidesdb_config_t tdb_config;
+    tidesdb_t* tdb = NULL;
+    open_wal_test_db(&tdb_config, &tdb);
+
+    tidesdb_err_t* e =
+        tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, 1024 * 1024 * 64, 12, 0.24f, false);
+    assert(e == NULL);
+
+    e = tidesdb_put(tdb, TEST_COLUMN_FAMILY, (uint8_t*)"key999", 6, (uint8_t*)"key999", 6, -1);
+    assert(e == NULL);
+
+    tidesdb_batch_t* batch = NULL;
+    e = tidesdb_batch_new(&batch);
+    assert(e == NULL);
+
+    /* the batch is larger than a log block so it is written as several records */
+    for (int i = 0; i < 5000; i++)
+    {
+        char key[16];
+        snprintf(key, sizeof(key), "key%03d", i);
+
+        e = tidesdb_batch_put(batch, (uint8_t*)key, strlen(key), (uint8_t*)key, strlen(key), -1);
+        assert(e == NULL);
+    }
+
+    e = tidesdb_batch_write(tdb, TEST_COLUMN_FAMILY, batch);
+    assert(e == NULL);
+
+    e = tidesdb_batch_free(batch);
+    assert(e == NULL);
+
+    column_family_t* cf = NULL;
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+
+    char wal_path[PATH_MAX];
+    _wal_segment_path(cf->wal, cf->wal->log_number, WAL_EXT, wal_path, sizeof(wal_path));
+
+    size_t wal_size = 0;
+    assert(log_size(cf->wal->log, &wal_size) == 0);
+    assert(wal_size > LOG_BLOCK_SIZE);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    /* a crash tears the batch after its first records reached the log */
+    assert(truncate(wal_path, LOG_BLOCK_SIZE + 100) == 0);
+
+    /* none of the batch is replayed, what was written before it is */
+    open_wal_test_db(&tdb_config, &tdb);
+
+    check_wal_test_get(tdb, "key999", true);
+    check_wal_test_get(tdb, "key000", false);
+    check_wal_test_get(tdb, "key4999", false);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_batch_torn_replay passed\n" RESET);
+}
+
+void test_wal_replay_recovery_stats()
+{
+    tidesdb_config_t tdb_config;
+    tidesdb_t* tdb = NULL;
+    open_wal_test_db(&tdb_config, &tdb);
+
+    /* a fresh db has nothing to replay */
+    tidesdb_recovery_stats_t stats;
+    tidesdb_err_t* e = tidesdb_get_recovery_stats(tdb, &stats);
+    assert(e == NULL);
+    assert(stats.column_families == 0 && stats.entries == 0 && stats.bytes == 0);
+
+    e = tidesdb_get_recovery_stats(tdb, NULL);
+    assert(e != NULL);
+    tidesdb_err_free(e);
+
+    /* more column families than replay threads, each with more than a replay chunk of entries */
+    int num_cfs = TIDESDB_MAX_LOAD_THREADS + 2;
+    int num_entries = 2000;
+    uint8_t value[1024];
+
+    for (int c = 0; c < num_cfs; c++)
+    {
+        char cf_name[32];
+        snprintf(cf_name, sizeof(cf_name), "replay_cf%d", c);
+
+        e = tidesdb_create_column_family(tdb, cf_name, 1024 * 1024 * 64, 12, 0.24f, false);
+        assert(e == NULL);
+
+        for (int i = 0; i < num_entries; i++)
+        {
+            char key[32];
+            snprintf(key, sizeof(key), "key%05d", i);
+            memset(value, 'a' + (i + c) % 26, sizeof(value));
+
+            e = tidesdb_put(tdb, cf_name, (uint8_t*)key, strlen(key), value, sizeof(value), -1);
+            assert(e == NULL);
+        }
+    }
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    open_wal_test_db(&tdb_config, &tdb);
+
+    e = tidesdb_get_recovery_stats(tdb, &stats);
+    assert(e == NULL);
+    assert(stats.column_families == (uint64_t)num_cfs);
+    assert(stats.entries == (uint64_t)num_cfs * num_entries);
+    assert(stats.bytes > (uint64_t)num_cfs * num_entries * sizeof(value));
+
+    /* every column family got its own entries back, in order */
+    for (int c = 0; c < num_cfs; c++)
+    {
+        char cf_name[32];
+        snprintf(cf_name, sizeof(cf_name), "replay_cf%d", c);
+
+        for (int i = 0; i < num_entries; i += 97)
+        {
+            char key[32];
+            snprintf(key, sizeof(key), "key%05d", i);
+
+            uint8_t* value_out = NULL;
+            size_t value_len = 0;
+            e = tidesdb_get(tdb, cf_name, (uint8_t*)key, strlen(key), &value_out, &value_len);
+            assert(e == NULL);
+            assert(value_len == sizeof(value));
+            assert(value_out[0] == 'a' + (i + c) % 26);
+            free(value_out);
+        }
+    }
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_wal_replay_recovery_stats passed\n" RESET);
+}
+
+/* what the open progress callback saw, for test_open_progress */
+typedef struct
+{
+    int calls;
+    int last_loaded;
+    int total;
+    bool in_order;
+} open_progress_test_t;
+
+void open_progress_test_callback(const char* column_family, int loaded, int total, void* arg)
+{
+    open_progress_test_t* progress = arg;
+
+    assert(column_family != NULL);
+
+    /* the calls come one at a time, counting up to the total */
+    if (loaded != progress->last_loaded + 1) progress->in_order = false;
+
+    progress->calls++;
+    progress->last_loaded = loaded;
+    progress->total = total;
+}
+
+void test_open_progress()
+{
+    tidesdb_config_t tdb_config;
+    tidesdb_t* tdb = NULL;
+    open_wal_test_db(&tdb_config, &tdb);
+
+    /* several times more column families than load threads */
+    int num_cfs = TIDESDB_MAX_LOAD_THREADS * 3;
+
+    for (int c = 0; c < num_cfs; c++)
+    {
+        char cf_name[32];
+        snprintf(cf_name, sizeof(cf_name), "load_cf%d", c);
+
+        tidesdb_err_t* e =
+            tidesdb_create_column_family(tdb, cf_name, 1024 * 1024 * 64, 12, 0.24f, false);
+        assert(e == NULL);
+
+        e = tidesdb_put(tdb, cf_name, (uint8_t*)cf_name, strlen(cf_name), (uint8_t*)cf_name,
+                        strlen(cf_name), -1);
+        assert(e == NULL);
+    }
+
+    tidesdb_err_t* e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    open_progress_test_t progress = {0, 0, 0, true};
+    tdb_config.open_progress = open_progress_test_callback;
+    tdb_config.open_progress_arg = &progress;
+    tdb_config.max_open_files = 0;
+    tdb_config.mmap_reads = false;
+    tdb_config.block_cache_size = 0;
+
+    e = tidesdb_open(&tdb_config, &tdb);
+    assert(e == NULL);
+
+    assert(progress.calls == num_cfs);
+    assert(progress.last_loaded == num_cfs);
+    assert(progress.total == num_cfs);
+    assert(progress.in_order);
+
+    /* every column family was loaded into a slot of its own */
+    for (int c = 0; c < num_cfs; c++)
+    {
+        char cf_name[32];
+        snprintf(cf_name, sizeof(cf_name), "load_cf%d", c);
+
+        uint8_t* value_out = NULL;
+        size_t value_len = 0;
+        e = tidesdb_get(tdb, cf_name, (uint8_t*)cf_name, strlen(cf_name), &value_out, &value_len);
+        assert(e == NULL);
+        assert(value_len == strlen(cf_name));
+        assert(memcmp(value_out, cf_name, value_len) == 0);
+        free(value_out);
+    }
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_open_progress passed\n" RESET);
+}
+
+/* helper for test_manifest_reopen, puts a round of pairs that each tag their value with */
+void put_manifest_test_round(tidesdb_t* tdb, int round)
+{
+    for (int i = 0; i < 40000; i++)
+    {
+        uint8_t key[32];
+        uint8_t value[128];
+        snprintf(key, sizeof(key), "key%05d", i);
+        snprintf(value, sizeof(value), "value%05d-%d-%0100d", i, round, 0);
+
+        tidesdb_err_t* e =
+            tidesdb_put(tdb, TEST_COLUMN_FAMILY, key, strlen(key), value, strlen(value), -1);
+        assert(e == NULL);
+    }
+}
+
+/* helper for test_manifest_reopen, checks every pair has the value of the last round */
+void check_manifest_test_round(tidesdb_t* tdb, int round)
+{
+    for (int i = 0; i < 40000; i += 7)
+    {
+        uint8_t key[32];
+        uint8_t value[128];
+        snprintf(key, sizeof(key), "key%05d", i);
+        snprintf(value, sizeof(value), "value%05d-%d-%0100d", i, round, 0);
+
+        uint8_t* value_out = NULL;
+        size_t value_len = 0;
+        tidesdb_err_t* e =
+            tidesdb_get(tdb, TEST_COLUMN_FAMILY, key, strlen(key), &value_out, &value_len);
+        assert(e == NULL);
+        assert(value_len == strlen(value));
+        assert(memcmp(value_out, value, value_len) == 0);
+        free(value_out);
+    }
+}
+
+void test_manifest_reopen()
+{
+    tidesdb_config_t tdb_config;
+    tidesdb_t* tdb = NULL;
+    open_wal_test_db(&tdb_config, &tdb);
+
+    tidesdb_err_t* e =
+        tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, 1024 * 1024, 12, 0.24f, false);
+    assert(e == NULL);
+
+    /* compacted sstables in level 1 with newer level 0 sstables over them */
+    put_manifest_test_round(tdb, 1);
+    sleep(3); /* wait for the SST files to be written */
+
+    e = tidesdb_compact_sstables(tdb, TEST_COLUMN_FAMILY, 2);
+    assert(e == NULL);
+
+    put_manifest_test_round(tdb, 2);
+    sleep(3); /* wait for the SST files to be written */
+
+    column_family_t* cf = NULL;
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+
+    tidesdb_version_t* version = _pin_version(cf);
+    int num_sstables = version->num_sstables;
+    assert(num_sstables > 1);
+    assert(version->level_counts[0] > 0 && version->level_counts[1] > 0);
+
+    char** names = malloc(num_sstables * sizeof(char*));
+    uint32_t* levels = malloc(num_sstables * sizeof(uint32_t));
+    uint64_t* sequences = malloc(num_sstables * sizeof(uint64_t));
+    assert(names != NULL && levels != NULL && sequences != NULL);
+
+    for (int i = 0; i < num_sstables; i++)
+    {
+        names[i] = strdup(version->sstables[i]->filename);
+        levels[i] = version->sstables[i]->level;
+        sequences[i] = version->sstables[i]->sequence;
+    }
+
+    _release_version(version);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s/%s", TEST_DIR, TEST_COLUMN_FAMILY, MANIFEST_FILE);
+    assert(access(path, F_OK) == 0);
+
+    /* the directory is not scanned, a file that is not an sstable goes unnoticed */
+    char stray_path[PATH_MAX];
+    snprintf(stray_path, sizeof(stray_path), "%s/%s/sstable_stray%s", TEST_DIR, TEST_COLUMN_FAMILY,
+             SSTABLE_EXT);
+    FILE* stray = fopen(stray_path, "w");
+    assert(stray != NULL);
+    fputs("not an sstable", stray);
+    fclose(stray);
+
+    open_wal_test_db(&tdb_config, &tdb);
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+
+    /* the same sstables come back in the same order with what the manifest recorded */
+    version = _pin_version(cf);
+    assert(version->num_sstables == num_sstables);
+    for (int i = 0; i < num_sstables; i++)
+    {
+        assert(strcmp(version->sstables[i]->filename, names[i]) == 0);
+        assert(version->sstables[i]->level == levels[i]);
+        assert(version->sstables[i]->sequence == sequences[i]);
+    }
+    _release_version(version);
+
+    check_manifest_test_round(tdb, 2);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    /* a column family from before the manifest is scanned once and gets one */
+    assert(remove(path) == 0);
+    assert(remove(stray_path) == 0);
+
+    open_wal_test_db(&tdb_config, &tdb);
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+    assert(access(path, F_OK) == 0);
+
+    version = _pin_version(cf);
+    assert(version->num_sstables == num_sstables);
+    for (int i = 0; i < num_sstables; i++)
+        assert(strcmp(version->sstables[i]->filename, names[i]) == 0);
+    _release_version(version);
+
+    check_manifest_test_round(tdb, 2);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    for (int i = 0; i < num_sstables; i++) free(names[i]);
+    free(names);
+    free(levels);
+    free(sequences);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_manifest_reopen passed\n" RESET);
+}
+
+void test_overlapping_level_demotion()
+{
+    tidesdb_config_t tdb_config;
+    tidesdb_t* tdb = NULL;
+    open_wal_test_db(&tdb_config, &tdb);
+
+    tidesdb_err_t* e =
+        tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, 1024 * 1024, 12, 0.24f, false);
+    assert(e == NULL);
+
+    /* two rounds over the same keys, every sstable of the second overlaps the first */
+    put_manifest_test_round(tdb, 1);
+    put_manifest_test_round(tdb, 2);
+    sleep(3); /* wait for the SST files to be written */
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    char cf_path[PATH_MAX];
+    snprintf(cf_path, sizeof(cf_path), "%s/%s", TEST_DIR, TEST_COLUMN_FAMILY);
+
+    /* the manifest claims every sstable is in level 1 */
+    manifest_t* manifest = NULL;
+    assert(manifest_open(cf_path, &manifest) == 0);
+    uint32_t num_tables = manifest->num_tables;
+    assert(num_tables > 1);
+
+    manifest_table_t* tables = malloc(num_tables * sizeof(manifest_table_t));
+    char** names = malloc(num_tables * sizeof(char*));
+    assert(tables != NULL && names != NULL);
+    for (uint32_t i = 0; i < num_tables; i++)
+    {
+        tables[i] = manifest->tables[i];
+        tables[i].level = 1;
+        names[i] = tables[i].name;
+    }
+
+    manifest_edit_t edit = {
+        .added = tables, .num_added = num_tables, .removed = names, .num_removed = num_tables};
+    assert(manifest_append(manifest, &edit) == 0);
+    free(tables);
+    free(names);
+    assert(manifest_close(manifest) == 0);
+
+    /* the level overlaps itself, it is put back into level 0 before the version is published */
+    open_wal_test_db(&tdb_config, &tdb);
+    column_family_t* cf = NULL;
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+
+    tidesdb_version_t* version = _pin_version(cf);
+    assert(version->num_sstables == (int)num_tables);
+    assert(version->level_counts[0] == (int)num_tables);
+    _release_version(version);
+
+    /* the manifest records the demotion */
+    assert(cf->manifest->num_tables == num_tables);
+    for (uint32_t i = 0; i < num_tables; i++) assert(cf->manifest->tables[i].level == 0);
+
+    check_manifest_test_round(tdb, 2);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    /* the demotion is not done again, level 0 comes back as it was recorded */
+    open_wal_test_db(&tdb_config, &tdb);
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+
+    version = _pin_version(cf);
+    assert(version->level_counts[0] == (int)num_tables);
+    _release_version(version);
+
+    check_manifest_test_round(tdb, 2);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_overlapping_level_demotion passed\n" RESET);
+}
+
+void test_get_unreadable_sstable()
+{
+    tidesdb_config_t tdb_config;
+    tidesdb_t* tdb = NULL;
+    open_wal_test_db(&tdb_config, &tdb);
+
+    tidesdb_err_t* e =
+        tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, 1024 * 1024, 12, 0.24f, false);
+    assert(e == NULL);
+
+    /* every key is in an sstable of both rounds */
+    put_manifest_test_round(tdb, 1);
+    put_manifest_test_round(tdb, 2);
+    sleep(3); /* wait for the SST files to be written */
+
+    column_family_t* cf = NULL;
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+
+    tidesdb_version_t* version = _pin_version(cf);
+    assert(version->num_sstables > 1);
+    sstable_t* newest = version->sstables[version->num_sstables - 1];
+    char* newest_path = strdup(newest->filename);
+    uint8_t* max_key = malloc(newest->max_key_size);
+    assert(newest_path != NULL && max_key != NULL);
+    memcpy(max_key, newest->max_key, newest->max_key_size);
+    size_t max_key_size = newest->max_key_size;
+    _release_version(version);
+
+    /* the memtable holds nothing of the keys, a get has to read the sstables */
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    /* the newest sstable is gone, it is listed in the manifest and opened on first read */
+    assert(remove(newest_path) == 0);
+
+    open_wal_test_db(&tdb_config, &tdb);
+
+    /* an older sstable holds the key too, its value must not be returned in place of an error */
+    uint8_t* value_out = NULL;
+    size_t value_len = 0;
+    e = tidesdb_get(tdb, TEST_COLUMN_FAMILY, max_key, max_key_size, &value_out, &value_len);
+    assert(e != NULL);
+    assert(e->code == 1107);
+    assert(value_out == NULL);
+    tidesdb_err_free(e);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    free(newest_path);
+    free(max_key);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_get_unreadable_sstable passed\n" RESET);
+}
+
+void test_sstable_file_numbers()
+{
+    tidesdb_config_t tdb_config;
+    tidesdb_t* tdb = NULL;
+    open_wal_test_db(&tdb_config, &tdb);
+
+    tidesdb_err_t* e =
+        tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, 1024 * 1024, 12, 0.24f, false);
+    assert(e == NULL);
+
+    put_manifest_test_round(tdb, 1);
+    sleep(3); /* wait for the SST files to be written */
+
+    column_family_t* cf = NULL;
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+
+    /* every flush takes the next file number and the next sequence number */
+    tidesdb_version_t* version = _pin_version(cf);
+    assert(version->num_sstables > 1);
+    uint64_t largest_flushed = 0;
+    for (int i = 0; i < version->num_sstables; i++)
+    {
+        sstable_t* sst = version->sstables[i];
+        assert(sst->level == 0);
+        assert(sst->file_number > 0);
+
+        char name[64];
+        snprintf(name, sizeof(name), "sstable_%lu%s", sst->file_number, SSTABLE_EXT);
+        assert(strcmp(strrchr(sst->filename, '/') + 1, name) == 0);
+
+        if (i > 0)
+        {
+            assert(sst->sequence > version->sstables[i - 1]->sequence);
+            assert(sst->file_number > version->sstables[i - 1]->file_number);
+        }
+
+        if (sst->file_number > largest_flushed) largest_flushed = sst->file_number;
+    }
+    _release_version(version);
+
+    e = tidesdb_compact_sstables(tdb, TEST_COLUMN_FAMILY, 2);
+    assert(e == NULL);
+
+    /* the outputs are numbered past their inputs */
+    version = _pin_version(cf);
+    assert(version->level_counts[0] == 0);
+    uint64_t largest = 0;
+    for (int i = 0; i < version->num_sstables; i++)
+    {
+        assert(version->sstables[i]->file_number > largest_flushed);
+        if (version->sstables[i]->file_number > largest)
+            largest = version->sstables[i]->file_number;
+    }
+    _release_version(version);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    /* after a reopen the numbers carry on from where they were */
+    open_wal_test_db(&tdb_config, &tdb);
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+    assert(atomic_load(&cf->next_file_number) > largest);
+    assert(cf->sstable_sequence > 1);
+
+    uint64_t sequence = cf->sstable_sequence;
+
+    put_manifest_test_round(tdb, 2);
+    sleep(3); /* wait for the SST files to be written */
+
+    version = _pin_version(cf);
+    assert(version->level_counts[0] > 0);
+    for (int i = version->num_sstables - version->level_counts[0]; i < version->num_sstables; i++)
+    {
+        assert(version->sstables[i]->file_number > largest);
+        assert(version->sstables[i]->sequence >= sequence);
+    }
+    _release_version(version);
+
+    check_manifest_test_round(tdb, 2);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_sstable_file_numbers passed\n" RESET);
+}
+
+void test_table_cache()
+{
+    tidesdb_config_t tdb_config;
+    tidesdb_t* tdb = NULL;
+
+    /* a negative number of open files is rejected */
+    tdb_config.db_path = TEST_DIR;
+    tdb_config.compaction_threads = 0;
+    tdb_config.max_open_files = -1;
+    tdb_config.mmap_reads = false;
+    tdb_config.block_cache_size = 0;
+    tidesdb_err_t* e = tidesdb_open(&tdb_config, &tdb);
+    assert(e != NULL);
+    assert(e->code == 1103);
+    tidesdb_err_free(e);
+
+    open_wal_test_db(&tdb_config, &tdb);
+
+    e = tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, 1024 * 1024, 12, 0.24f, false);
+    assert(e == NULL);
+
+    /* two rounds flush far more sstables than the cache below keeps open */
+    put_manifest_test_round(tdb, 1);
+    put_manifest_test_round(tdb, 2);
+    sleep(3); /* wait for the SST files to be written */
+
+    column_family_t* cf = NULL;
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+
+    tidesdb_version_t* version = _pin_version(cf);
+    int num_sstables = version->num_sstables;
+    assert(num_sstables > 4);
+    _release_version(version);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    tdb_config.db_path = TEST_DIR;
+    tdb_config.compressed_wal = false;
+    tdb_config.compaction_threads = 0;
+    tdb_config.sync_wal = false;
+    tdb_config.wal_dir = NULL;
+    tdb_config.open_progress = NULL;
+    tdb_config.open_progress_arg = NULL;
+    tdb_config.max_open_files = 2;
+    tdb_config.mmap_reads = false;
+    tdb_config.block_cache_size = 0;
+    e = tidesdb_open(&tdb_config, &tdb);
+    assert(e == NULL);
+
+    /* the manifest describes the sstables, none of them is opened to load the column family */
+    assert(tdb->table_cache->capacity == 2);
+    assert(tdb->table_cache->num_open == 0);
+    assert(atomic_load(&tdb->table_cache->opens) == 0);
+
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+    version = _pin_version(cf);
+    assert(version->num_sstables == num_sstables);
+    for (int i = 0; i < version->num_sstables; i++)
+    {
+        assert(version->sstables[i]->pager == NULL);
+        assert(version->sstables[i]->num_entries > 0);
+    }
+    _release_version(version);
+
+    /* reads open the sstables they need and the cache keeps at most two of them open */
+    check_manifest_test_round(tdb, 2);
+    assert(atomic_load(&tdb->table_cache->opens) > 0);
+    assert(tdb->table_cache->num_open <= 2);
+    assert(tdb->table_cache->evictions > 0);
+
+    /* a compaction reads every sstable, what it writes joins the cache as well */
+    e = tidesdb_compact_sstables(tdb, TEST_COLUMN_FAMILY, 2);
+    assert(e == NULL);
+    assert(tdb->table_cache->num_open <= 2);
+
+    check_manifest_test_round(tdb, 2);
+    assert(tdb->table_cache->num_open <= 2);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_table_cache passed\n" RESET);
+}
+
+/* helper that checks every open sstable reader of the test column family is mapped, it returns how
+ * many are open */
+int count_mapped_test_sstables(tidesdb_t* tdb)
+{
+    column_family_t* cf = NULL;
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+
+    int open = 0;
+    tidesdb_version_t* version = _pin_version(cf);
+    assert(version->num_sstables > 0);
+    for (int i = 0; i < version->num_sstables; i++)
+    {
+        sstable_t* sst = version->sstables[i];
+        if (sst->pager == NULL) continue;
+
+        assert(sst->pager->map != NULL);
+        open++;
+    }
+    _release_version(version);
+
+    return open;
+}
+
+void test_mmap_reads()
+{
+    tidesdb_config_t tdb_config;
+    tidesdb_t* tdb = NULL;
+    open_wal_test_db(&tdb_config, &tdb);
+    tidesdb_err_t* e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    tdb_config.mmap_reads = true;
+    e = tidesdb_open(&tdb_config, &tdb);
+    assert(e == NULL);
+    assert(tdb->table_cache->mmap_reads);
+
+    e = tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, 1024 * 1024, 12, 0.24f, false);
+    assert(e == NULL);
+
+    /* the sstables a flush writes are mapped as they join the cache */
+    put_manifest_test_round(tdb, 1);
+    put_manifest_test_round(tdb, 2);
+    sleep(3); /* wait for the SST files to be written */
+
+    assert(count_mapped_test_sstables(tdb) > 0);
+    check_manifest_test_round(tdb, 2);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    /* sstables opened lazily are mapped on first access, a compaction scans the mappings */
+    e = tidesdb_open(&tdb_config, &tdb);
+    assert(e == NULL);
+    assert(count_mapped_test_sstables(tdb) == 0);
+
+    check_manifest_test_round(tdb, 2);
+    assert(count_mapped_test_sstables(tdb) > 0);
+
+    e = tidesdb_compact_sstables(tdb, TEST_COLUMN_FAMILY, 2);
+    assert(e == NULL);
+
+    assert(count_mapped_test_sstables(tdb) > 0);
+    check_manifest_test_round(tdb, 2);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_mmap_reads passed\n" RESET);
+}
+
+void test_block_cache_stats()
+{
+    tidesdb_config_t tdb_config;
+    tidesdb_t* tdb = NULL;
+    open_wal_test_db(&tdb_config, &tdb);
+
+    /* without a block cache there is nothing to count */
+    tidesdb_block_cache_stats_t stats;
+    tidesdb_err_t* e = tidesdb_get_block_cache_stats(tdb, NULL);
+    assert(e != NULL);
+    assert(e->code == 1106);
+    tidesdb_err_free(e);
+
+    e = tidesdb_get_block_cache_stats(tdb, &stats);
+    assert(e == NULL);
+    assert(stats.capacity == 0 && stats.hits == 0 && stats.misses == 0);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    tdb_config.block_cache_size = 64 * 1024 * 1024;
+    e = tidesdb_open(&tdb_config, &tdb);
+    assert(e == NULL);
+
+    e = tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, 1024 * 1024, 12, 0.24f, true);
+    assert(e == NULL);
+
+    put_manifest_test_round(tdb, 1);
+    sleep(3); /* wait for the SST files to be written */
+
+    /* the first reads fill the cache, reading the same keys again hits it */
+    check_manifest_test_round(tdb, 1);
+    e = tidesdb_get_block_cache_stats(tdb, &stats);
+    assert(e == NULL);
+    assert(stats.capacity == 64 * 1024 * 1024);
+    assert(stats.misses > 0);
+    assert(stats.entries > 0 && stats.usage > 0);
+    assert(stats.usage <= stats.capacity);
+    uint64_t misses = stats.misses;
+
+    check_manifest_test_round(tdb, 1);
+    e = tidesdb_get_block_cache_stats(tdb, &stats);
+    assert(e == NULL);
+    assert(stats.misses == misses);
+    assert(stats.hits > 0);
+    assert(stats.evictions == 0);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_block_cache_stats passed\n" RESET);
+}
+
+/* helper that counts the threads of the process */
+int count_test_threads()
+{
+    DIR* dir = opendir("/proc/self/task");
+    assert(dir != NULL);
+
+    int count = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+        if (entry->d_name[0] != '.') count++;
+
+    closedir(dir);
+    return count;
+}
+
+void test_sync_service_threads()
+{
+    tidesdb_config_t tdb_config;
+    tidesdb_t* tdb = NULL;
+    open_wal_test_db(&tdb_config, &tdb);
+    assert(tdb->sync_service != NULL);
+
+    tidesdb_err_t* e =
+        tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, 1024 * 1024, 12, 0.24f, false);
+    assert(e == NULL);
+
+    int threads = count_test_threads();
+
+    /* every flush writes an sstable and every rotation a wal segment, none of them adds a thread */
+    put_manifest_test_round(tdb, 1);
+    put_manifest_test_round(tdb, 2);
+    sleep(3); /* wait for the SST files to be written */
+
+    column_family_t* cf = NULL;
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+    tidesdb_version_t* version = _pin_version(cf);
+    assert(version->num_sstables > 4);
+    _release_version(version);
+
+    assert(count_test_threads() == threads);
+
+    /* the writes did not sync the wal, the sync service did */
+    pthread_mutex_lock(&tdb->sync_service->lock);
+    assert(tdb->sync_service->syncs > 0);
+    pthread_mutex_unlock(&tdb->sync_service->lock);
+
+    check_manifest_test_round(tdb, 2);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_sync_service_threads passed\n" RESET);
+}
+
+void test_cursor()
+{
+    tidesdb_config_t* tdb_config = malloc(sizeof(tidesdb_config_t));
+    if (tdb_config == NULL)
+    {
+        printf(RED "Error: Failed to allocate memory for tdb_config\n" RESET);
+        return;
+    }
+
+    tdb_config->db_path = TEST_DIR;
+    tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
+
+    tidesdb_t* tdb = NULL;
+
+    tidesdb_err_t* e = tidesdb_open(tdb_config, &tdb);
+    assert(e == NULL);
+    assert(tdb != NULL);
+
+    tidesdb_err_free(e);
+
+    /* create a column family */
+    e = tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, (1024 * 1024), 12, 0.24f, false);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    assert(e == NULL);
+
+    tidesdb_err_free(e);
+
+    column_family_t* cf = NULL;
+
+    /* we should be able to get the column family */
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+
+    /* put 60000 key-value pairs */
+    for (int i = 0; i < 60000; i++)
+    {
+        uint8_t key[48];
+        uint8_t value[48];
+        snprintf(key, sizeof(key), "key%03d", i);
+        snprintf(value, sizeof(value), "value%03d", i);
+
+        e = tidesdb_put(tdb, cf->config.name, key, strlen(key), value, strlen(value), -1);
+        if (e != NULL)
+        {
+            printf(RED "Error: %s\n" RESET, e->message);
+            tidesdb_err_free(e);
+            break;
+        }
+    }
+
+    sleep(5); /* wait for the SST file to be written */
+
+    /* initialize cursor */
+    tidesdb_cursor_t* cursor;
+    e = tidesdb_cursor_init(tdb, TEST_COLUMN_FAMILY, &cursor);
+    if (e != NULL)
+    {
+        printf(RED "Error: %s\n" RESET, e->message);
+        tidesdb_err_free(e);
         return;
     }
 
@@ -1326,6 +3260,325 @@ void test_cursor()
     printf(GREEN "test_cursor passed\n" RESET);
 }
 
+void test_pinned_version_compact_get()
+{
+    tidesdb_config_t* tdb_config = (malloc(sizeof(tidesdb_config_t)));
+    if (tdb_config == NULL)
+    {
+        printf(RED "Error: Failed to allocate memory for tdb_config\n" RESET);
+        return;
+    }
+
+    tdb_config->db_path = TEST_DIR;
+    tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
+
+    tidesdb_t* tdb = NULL;
+
+    tidesdb_err_t* e = tidesdb_open(tdb_config, &tdb);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    assert(e == NULL);
+
+    tidesdb_err_free(e);
+
+    e = tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, 1024 * 1024, 12, 0.24f, false);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    assert(e == NULL);
+
+    tidesdb_err_free(e);
+
+    column_family_t* cf = NULL;
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+
+    /* enough for a few level 0 sstables */
+    for (int i = 0; i < 40000; i++)
+    {
+        uint8_t key[32];
+        uint8_t value[128];
+        snprintf(key, sizeof(key), "key%05d", i);
+        snprintf(value, sizeof(value), "value%05d-%0100d", i, 0);
+
+        e = tidesdb_put(tdb, TEST_COLUMN_FAMILY, key, strlen(key), value, strlen(value), -1);
+        assert(e == NULL);
+    }
+
+    sleep(3); /* wait for the SST files to be written */
+
+    /* a reader pins the version with the flushed sstables */
+    tidesdb_version_t* version = _pin_version(cf);
+    assert(version->num_sstables > 1);
+
+    char** paths = malloc(version->num_sstables * sizeof(char*));
+    assert(paths != NULL);
+    for (int i = 0; i < version->num_sstables; i++)
+        paths[i] = strdup(version->sstables[i]->filename);
+
+    /* the compaction does not wait for the reader, it publishes a new version */
+    e = tidesdb_compact_sstables(tdb, TEST_COLUMN_FAMILY, 2);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    assert(e == NULL);
+
+    tidesdb_err_free(e);
+
+    assert(cf->version != version);
+
+    /* the compacted sstables stay readable until the reader is done with them */
+    for (int i = 0; i < version->num_sstables; i++) assert(access(paths[i], F_OK) == 0);
+
+    uint8_t* value_out = NULL;
+    size_t value_len = 0;
+    uint64_t hash = blocked_bloomfilter_hash((uint8_t*)"key00000", 8);
+    int64_t ttl = -1;
+    bool found = false;
+    for (int i = 0; i < version->num_sstables && !found; i++)
+    {
+        if (sstable_get(version->sstables[i], (uint8_t*)"key00000", 8, hash, &value_out,
+                        &value_len, &ttl) == -1)
+            continue;
+
+        found = true;
+        assert(value_len == 111);
+        assert(memcmp(value_out, "value00000-", 11) == 0);
+        free(value_out);
+    }
+
+    assert(found);
+
+    /* the last reference removes the files */
+    int num_paths = version->num_sstables;
+    _release_version(version);
+
+    for (int i = 0; i < num_paths; i++)
+    {
+        assert(access(paths[i], F_OK) == -1);
+        free(paths[i]);
+    }
+
+    free(paths);
+
+    /* the new version holds every pair */
+    for (int i = 0; i < 40000; i++)
+    {
+        uint8_t key[32];
+        uint8_t value[128];
+        snprintf(key, sizeof(key), "key%05d", i);
+        snprintf(value, sizeof(value), "value%05d-%0100d", i, 0);
+
+        value_out = NULL;
+        value_len = 0;
+
+        e = tidesdb_get(tdb, TEST_COLUMN_FAMILY, key, strlen(key), &value_out, &value_len);
+        if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+        assert(e == NULL);
+        assert(value_len == strlen(value));
+        assert(memcmp(value_out, value, value_len) == 0);
+
+        free(value_out);
+    }
+
+    e = tidesdb_close(tdb);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    tidesdb_err_free(e);
+
+    remove_directory(TEST_DIR);
+
+    free(tdb_config);
+
+    printf(GREEN "test_pinned_version_compact_get passed\n" RESET);
+}
+
+void test_flush_retry()
+{
+    tidesdb_config_t tdb_config;
+    tidesdb_t* tdb = NULL;
+    open_wal_test_db(&tdb_config, &tdb);
+
+    tidesdb_err_t* e =
+        tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, 1024 * 1024, 12, 0.24f, false);
+    assert(e == NULL);
+
+    column_family_t* cf = NULL;
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+
+    /* a directory where the first flush writes its sstable makes that flush fail, it is not
+     * empty so the writer cannot remove it */
+    uint64_t blocked = atomic_load(&cf->next_file_number);
+    char blocked_path[PATH_MAX];
+    snprintf(blocked_path, sizeof(blocked_path), "%s/%s/sstable_%lu%s", TEST_DIR,
+             TEST_COLUMN_FAMILY, blocked, SSTABLE_EXT);
+    assert(mkdir(blocked_path, 0777) == 0);
+
+    char blocker_path[PATH_MAX];
+    snprintf(blocker_path, sizeof(blocker_path), "%s/blocker", blocked_path);
+    FILE* blocker = fopen(blocker_path, "w");
+    assert(blocker != NULL);
+    fclose(blocker);
+
+    put_manifest_test_round(tdb, 1);
+    sleep(3); /* wait for the SST files to be written, the failed flush is retried */
+
+    /* every rotated memtable was flushed, the one that failed under another file number */
+    tidesdb_version_t* version = _pin_version(cf);
+    assert(version->num_memtables == 1);
+    assert(version->num_sstables > 1);
+    for (int i = 0; i < version->num_sstables; i++)
+        assert(version->sstables[i]->file_number != blocked);
+    _release_version(version);
+
+    check_manifest_test_round(tdb, 1);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    assert(remove(blocker_path) == 0);
+    assert(rmdir(blocked_path) == 0);
+
+    open_wal_test_db(&tdb_config, &tdb);
+    check_manifest_test_round(tdb, 1);
+
+    e = tidesdb_close(tdb);
+    assert(e == NULL);
+
+    remove_directory(TEST_DIR);
+
+    printf(GREEN "test_flush_retry passed\n" RESET);
+}
+
+void test_memtable_rotation_get()
+{
+    tidesdb_config_t* tdb_config = (malloc(sizeof(tidesdb_config_t)));
+    if (tdb_config == NULL)
+    {
+        printf(RED "Error: Failed to allocate memory for tdb_config\n" RESET);
+        return;
+    }
+
+    tdb_config->db_path = TEST_DIR;
+    tdb_config->compressed_wal = false;
+    tdb_config->compaction_threads = 0;
+    tdb_config->sync_wal = false;
+    tdb_config->wal_dir = NULL;
+    tdb_config->open_progress = NULL;
+    tdb_config->open_progress_arg = NULL;
+    tdb_config->max_open_files = 0;
+    tdb_config->mmap_reads = false;
+    tdb_config->block_cache_size = 0;
+
+    tidesdb_t* tdb = NULL;
+
+    tidesdb_err_t* e = tidesdb_open(tdb_config, &tdb);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    assert(e == NULL);
+
+    tidesdb_err_free(e);
+
+    e = tidesdb_create_column_family(tdb, TEST_COLUMN_FAMILY, 1024 * 1024, 12, 0.24f, false);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    assert(e == NULL);
+
+    tidesdb_err_free(e);
+
+    column_family_t* cf = NULL;
+    assert(_get_column_family(tdb, TEST_COLUMN_FAMILY, &cf) == 0);
+
+    int rotations = 0;
+
+    for (int i = 0; i < 40000; i++)
+    {
+        uint8_t key[32];
+        uint8_t value[128];
+        snprintf(key, sizeof(key), "key%05d", i);
+        snprintf(value, sizeof(value), "value%05d-%0100d", i, 0);
+
+        skiplist_t* active = cf->memtable;
+
+        e = tidesdb_put(tdb, TEST_COLUMN_FAMILY, key, strlen(key), value, strlen(value), -1);
+        assert(e == NULL);
+
+        if (cf->memtable != active)
+        {
+            /* the full memtable was swapped for an empty one instead of being copied */
+            assert(cf->memtable->total_size == 0);
+            rotations++;
+        }
+
+        /* the first pair stays visible whilst its memtable waits to be flushed */
+        uint8_t* value_out = NULL;
+        size_t value_len = 0;
+
+        e = tidesdb_get(tdb, TEST_COLUMN_FAMILY, (uint8_t*)"key00000", 8, &value_out,
+                        &value_len);
+        if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+        assert(e == NULL);
+        assert(value_len == 111);
+        assert(memcmp(value_out, "value00000-", 11) == 0);
+
+        free(value_out);
+    }
+
+    assert(rotations > 1);
+
+    /* a cursor sees every pair once, whether it is in a memtable or an sstable */
+    tidesdb_cursor_t* cursor = NULL;
+    e = tidesdb_cursor_init(tdb, TEST_COLUMN_FAMILY, &cursor);
+    assert(e == NULL);
+
+    int count = 0;
+    key_value_pair_t kv;
+
+    do
+    {
+        e = tidesdb_cursor_get(cursor, &kv);
+        if (e != NULL) break;
+
+        free(kv.key);
+        free(kv.value);
+        count++;
+    } while ((e = tidesdb_cursor_next(cursor)) == NULL);
+
+    assert(e != NULL && e->code == 1062);
+    tidesdb_err_free(e);
+
+    assert(count == 40000);
+
+    tidesdb_cursor_free(cursor);
+
+    sleep(3); /* wait for the SST files to be written */
+
+    /* the flushed memtables are gone from the current version */
+    tidesdb_version_t* version = _pin_version(cf);
+    assert(version->num_memtables == 1);
+    assert(version->memtables[0]->skiplist == cf->memtable);
+    assert(version->num_sstables == rotations);
+    _release_version(version);
+
+    e = tidesdb_close(tdb);
+    if (e != NULL) printf(RED "Error: %s\n" RESET, e->message);
+
+    tidesdb_err_free(e);
+
+    remove_directory(TEST_DIR);
+
+    free(tdb_config);
+
+    printf(GREEN "test_memtable_rotation_get passed\n" RESET);
+}
+
 /** cc -g3 -fsanitize=address,undefined src/*.c external/*.c test/tidesdb__tests.c -lzstd
  * **/
 int main(void)
@@ -1343,8 +3596,30 @@ int main(void)
     test_put_compact();
     test_put_compact_get();
     test_put_compact_reopen_get();
+    test_put_delete_leveled_compact_get();
+    test_background_compaction();
+    test_pinned_version_compact_get();
+    test_memtable_rotation_get();
+    test_flush_retry();
     test_txn_put_delete_get();
     test_cursor();
+    test_concurrent_memtable_put_get();
+    test_wal_group_commit();
+    test_wal_torn_tail_replay();
+    test_legacy_wal_migration();
+    test_wal_segments();
+    test_batch_write_reopen_get();
+    test_batch_torn_replay();
+    test_wal_replay_recovery_stats();
+    test_open_progress();
+    test_manifest_reopen();
+    test_overlapping_level_demotion();
+    test_get_unreadable_sstable();
+    test_sstable_file_numbers();
+    test_table_cache();
+    test_sync_service_threads();
+    test_mmap_reads();
+    test_block_cache_stats();
 
     return 0;
 }
\ No newline at end of file